@@ -0,0 +1,37 @@
+#ifndef APP_PACK_H
+#define APP_PACK_H
+
+#include <stdint.h>
+
+#include "app_descriptor.h"
+
+#define APP_PACK_MAGIC_WORD 0x4B504450 /* "PDPK" */
+#define APP_PACK_VERSION 1
+
+/**
+ * Header for a packed (compressed) application image.
+ *
+ * The header is followed by the packed image data, which uses the LZ4
+ * block format with match offsets limited to (1 << window_bits) bytes.
+ * The packed data is zero-padded to a multiple of 4 bytes.
+ *
+ * Note: The memory layout of this structure is not allowed to change,
+ * because it is also handled by the bootloader and the build scripts.
+ */
+typedef struct {
+    uint32_t magic_word;         /*!< Magic word APP_PACK_MAGIC_WORD */
+    uint8_t version;             /*!< Packed format version APP_PACK_VERSION */
+    uint8_t window_bits;         /*!< Log2 of the largest match offset */
+    uint16_t reserved1;          /*!< Reserved */
+    uint32_t image_size;         /*!< Size of the unpacked image */
+    uint32_t packed_size;        /*!< Size of the packed data, excluding padding */
+    uint32_t packed_crc32;       /*!< CRC-32 of the padded packed data, using the STM32F4 hardware algorithm */
+    uint32_t reserved2[3];       /*!< Reserved */
+    app_descriptor_t descriptor; /*!< Copy of the app descriptor from the unpacked image */
+} app_pack_header_t;
+
+#ifndef __CDT_PARSER__
+_Static_assert(sizeof(app_pack_header_t) == 288, "app_pack_header_t should be 288 bytes");
+#endif
+
+#endif /* APP_PACK_H */
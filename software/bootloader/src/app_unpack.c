@@ -0,0 +1,195 @@
+#include "app_unpack.h"
+
+#include <string.h>
+
+#define WINDOW_MASK (APP_UNPACK_WINDOW_SIZE - 1)
+#define MIN_MATCH 4
+
+typedef enum {
+    STATE_TOKEN = 0,
+    STATE_LITERAL_LENGTH,
+    STATE_LITERALS,
+    STATE_OFFSET_LOW,
+    STATE_OFFSET_HIGH,
+    STATE_MATCH_LENGTH,
+    STATE_DONE
+} unpack_state_t;
+
+static app_unpack_result_t unpack_put_byte(app_unpack_t *unpack, uint8_t value);
+static app_unpack_result_t unpack_copy_match(app_unpack_t *unpack);
+static bool unpack_flush(app_unpack_t *unpack, uint32_t end_pos);
+
+void app_unpack_init(app_unpack_t *unpack, uint32_t image_size,
+    app_unpack_output_func_t output_func, void *user_data)
+{
+    memset(unpack, 0, sizeof(app_unpack_t));
+    unpack->image_size = image_size;
+    unpack->output_func = output_func;
+    unpack->user_data = user_data;
+    unpack->state = (image_size > 0) ? STATE_TOKEN : STATE_DONE;
+}
+
+app_unpack_result_t app_unpack_process(app_unpack_t *unpack, const uint8_t *data, size_t length)
+{
+    app_unpack_result_t result = APP_UNPACK_OK;
+    size_t i = 0;
+
+    while (i < length && result == APP_UNPACK_OK) {
+        const uint8_t value = data[i++];
+
+        switch (unpack->state) {
+        case STATE_TOKEN:
+            unpack->token = value;
+            unpack->literal_length = value >> 4;
+            unpack->match_length = (value & 0x0F) + MIN_MATCH;
+            if (unpack->literal_length == 15) {
+                unpack->state = STATE_LITERAL_LENGTH;
+            } else if (unpack->literal_length > 0) {
+                unpack->state = STATE_LITERALS;
+            } else {
+                unpack->state = STATE_OFFSET_LOW;
+            }
+            break;
+        case STATE_LITERAL_LENGTH:
+            unpack->literal_length += value;
+            if (value != 255) {
+                unpack->state = STATE_LITERALS;
+            }
+            break;
+        case STATE_LITERALS:
+            result = unpack_put_byte(unpack, value);
+            unpack->literal_length--;
+
+            /* Copy as much of the remaining literal run as possible */
+            while (unpack->literal_length > 0 && i < length && result == APP_UNPACK_OK) {
+                result = unpack_put_byte(unpack, data[i++]);
+                unpack->literal_length--;
+            }
+
+            if (unpack->literal_length == 0) {
+                /* The last sequence of the image has no match */
+                if (unpack->output_pos == unpack->image_size) {
+                    unpack->state = STATE_DONE;
+                } else {
+                    unpack->state = STATE_OFFSET_LOW;
+                }
+            }
+            break;
+        case STATE_OFFSET_LOW:
+            unpack->match_offset = value;
+            unpack->state = STATE_OFFSET_HIGH;
+            break;
+        case STATE_OFFSET_HIGH:
+            unpack->match_offset |= (uint32_t)value << 8;
+            if (unpack->match_offset == 0
+                || unpack->match_offset > APP_UNPACK_WINDOW_SIZE
+                || unpack->match_offset > unpack->output_pos) {
+                result = APP_UNPACK_FORMAT;
+                break;
+            }
+            if ((unpack->token & 0x0F) == 15) {
+                unpack->state = STATE_MATCH_LENGTH;
+            } else {
+                result = unpack_copy_match(unpack);
+            }
+            break;
+        case STATE_MATCH_LENGTH:
+            unpack->match_length += value;
+            if (value != 255) {
+                result = unpack_copy_match(unpack);
+            }
+            break;
+        case STATE_DONE:
+        default:
+            /* Any data after the end of the image is an error */
+            result = APP_UNPACK_OVERRUN;
+            break;
+        }
+    }
+
+    /* Deliver all complete words decoded so far */
+    if (result == APP_UNPACK_OK) {
+        if (!unpack_flush(unpack, unpack->output_pos & ~0x03UL)) {
+            result = APP_UNPACK_OUTPUT;
+        }
+    }
+
+    return result;
+}
+
+app_unpack_result_t app_unpack_finish(app_unpack_t *unpack)
+{
+    if (unpack->state != STATE_DONE || unpack->output_pos != unpack->image_size) {
+        return APP_UNPACK_TRUNCATED;
+    }
+    if (!unpack_flush(unpack, unpack->output_pos)) {
+        return APP_UNPACK_OUTPUT;
+    }
+    return APP_UNPACK_OK;
+}
+
+app_unpack_result_t unpack_put_byte(app_unpack_t *unpack, uint8_t value)
+{
+    uint8_t *window = (uint8_t *)unpack->window;
+
+    if (unpack->output_pos >= unpack->image_size) {
+        return APP_UNPACK_OVERRUN;
+    }
+
+    window[unpack->output_pos & WINDOW_MASK] = value;
+    unpack->output_pos++;
+
+    /*
+     * Deliver the window contents before it wraps around, which is
+     * always the point at which the oldest undelivered data would
+     * otherwise be overwritten.
+     */
+    if ((unpack->output_pos & WINDOW_MASK) == 0) {
+        if (!unpack_flush(unpack, unpack->output_pos)) {
+            return APP_UNPACK_OUTPUT;
+        }
+    }
+
+    return APP_UNPACK_OK;
+}
+
+app_unpack_result_t unpack_copy_match(app_unpack_t *unpack)
+{
+    const uint8_t *window = (const uint8_t *)unpack->window;
+    app_unpack_result_t result = APP_UNPACK_OK;
+
+    /* Matches may overlap their own output, so copy one byte at a time */
+    for (uint32_t i = 0; i < unpack->match_length && result == APP_UNPACK_OK; i++) {
+        const uint8_t value = window[(unpack->output_pos - unpack->match_offset) & WINDOW_MASK];
+        result = unpack_put_byte(unpack, value);
+    }
+
+    if (unpack->output_pos == unpack->image_size) {
+        unpack->state = STATE_DONE;
+    } else {
+        unpack->state = STATE_TOKEN;
+    }
+    return result;
+}
+
+bool unpack_flush(app_unpack_t *unpack, uint32_t end_pos)
+{
+    const uint8_t *window = (const uint8_t *)unpack->window;
+
+    if (end_pos <= unpack->flushed_pos) {
+        return true;
+    }
+
+    /*
+     * Flushes happen at least every time the window wraps, so the
+     * pending data is always a single contiguous span of the window.
+     */
+    const uint32_t start = unpack->flushed_pos & WINDOW_MASK;
+    const uint32_t length = end_pos - unpack->flushed_pos;
+    unpack->flushed_pos = end_pos;
+
+    if (unpack->output_func) {
+        return unpack->output_func(window + start, length, unpack->user_data);
+    }
+    return true;
+}
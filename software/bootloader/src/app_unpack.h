@@ -0,0 +1,89 @@
+/*
+ * Streaming decompressor for packed application images
+ *
+ * This decodes the LZ4 block format produced by the firmware packer
+ * tool, using a small ring buffer as the match history. Input can be
+ * provided in chunks of any size, and output is delivered through a
+ * callback in word-aligned spans whose lengths are multiples of 4 bytes
+ * (except possibly the last one).
+ *
+ * This code has no dependencies on the HAL or RTOS, so it can also be
+ * compiled and tested on a host system.
+ */
+
+#ifndef APP_UNPACK_H
+#define APP_UNPACK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Log2 of the largest match offset supported by the decompressor */
+#define APP_UNPACK_WINDOW_BITS 12
+
+/** Size of the match history buffer */
+#define APP_UNPACK_WINDOW_SIZE (1UL << APP_UNPACK_WINDOW_BITS)
+
+typedef enum {
+    APP_UNPACK_OK = 0,    /*!< No error */
+    APP_UNPACK_FORMAT,    /*!< Packed data is malformed */
+    APP_UNPACK_OVERRUN,   /*!< Packed data decodes to more than the image size */
+    APP_UNPACK_TRUNCATED, /*!< Packed data ended before the image was complete */
+    APP_UNPACK_OUTPUT     /*!< Output callback reported an error */
+} app_unpack_result_t;
+
+/**
+ * Callback to receive decompressed image data.
+ *
+ * @param data Pointer to the decompressed data, which is word-aligned
+ * @param length Length of the data
+ * @param user_data Pointer passed to app_unpack_init()
+ * @return True on success, false to abort decompression
+ */
+typedef bool (*app_unpack_output_func_t)(const uint8_t *data, size_t length, void *user_data);
+
+typedef struct {
+    uint32_t window[APP_UNPACK_WINDOW_SIZE / 4];
+    uint32_t image_size;
+    uint32_t output_pos;
+    uint32_t flushed_pos;
+    uint32_t literal_length;
+    uint32_t match_length;
+    uint32_t match_offset;
+    uint8_t token;
+    uint8_t state;
+    app_unpack_output_func_t output_func;
+    void *user_data;
+} app_unpack_t;
+
+/**
+ * Initialize the decompressor.
+ *
+ * @param unpack Decompressor state
+ * @param image_size Expected size of the decompressed image
+ * @param output_func Callback to receive decompressed data
+ * @param user_data Pointer passed through to the callback
+ */
+void app_unpack_init(app_unpack_t *unpack, uint32_t image_size,
+    app_unpack_output_func_t output_func, void *user_data);
+
+/**
+ * Decompress the next chunk of packed data.
+ *
+ * @param unpack Decompressor state
+ * @param data Packed data
+ * @param length Length of the packed data
+ */
+app_unpack_result_t app_unpack_process(app_unpack_t *unpack, const uint8_t *data, size_t length);
+
+/**
+ * Finish decompression, and deliver any remaining output.
+ *
+ * This must be called after all the packed data has been processed,
+ * and fails if the decompressed image is not complete.
+ *
+ * @param unpack Decompressor state
+ */
+app_unpack_result_t app_unpack_finish(app_unpack_t *unpack);
+
+#endif /* APP_UNPACK_H */
@@ -0,0 +1,215 @@
+#include "app_verify.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "logger.h"
+#include "bootloader.h"
+#include "app_descriptor.h"
+#include "m24m01.h"
+
+/*
+ * Layout of the verification page. Everything is stored in the same
+ * big-endian format used by the rest of the EEPROM. The application
+ * may clear the marker fields to request a full verification on the
+ * next startup, but must leave the generation counter alone.
+ */
+#define APP_VERIFY_MAGIC                 0  /* 4B (uint32_t) */
+#define APP_VERIFY_GENERATION            4  /* 4B (uint32_t) */
+#define APP_VERIFY_VERIFIED_GENERATION   8  /* 4B (uint32_t) */
+#define APP_VERIFY_APP_CRC               12 /* 4B (uint32_t) */
+#define APP_VERIFY_QUICK_CRC             16 /* 4B (uint32_t) */
+#define APP_VERIFY_MARKER_CRC            20 /* 4B (uint32_t) */
+#define APP_VERIFY_SIZE                  24
+
+#define APP_VERIFY_MAGIC_WORD 0x42565259UL
+
+/**
+ * Size of the region at the start of the application that is always
+ * checked, which covers the vector table.
+ */
+#define APP_VERIFY_QUICK_SIZE 1024UL
+
+typedef struct {
+    uint32_t magic_word;
+    uint32_t generation;
+    uint32_t verified_generation;
+    uint32_t app_crc;
+    uint32_t quick_crc;
+    uint32_t marker_crc;
+} app_verify_marker_t;
+
+static bool app_verify_read(I2C_HandleTypeDef *hi2c, app_verify_marker_t *marker);
+static bool app_verify_write(I2C_HandleTypeDef *hi2c, const app_verify_marker_t *marker);
+static uint32_t app_verify_marker_crc(CRC_HandleTypeDef *hcrc, const app_verify_marker_t *marker);
+static uint32_t app_verify_quick_crc(CRC_HandleTypeDef *hcrc);
+static uint32_t copy_to_u32(const uint8_t *buf);
+static void copy_from_u32(uint8_t *buf, uint32_t val);
+
+bool app_verify_is_cached(I2C_HandleTypeDef *hi2c, CRC_HandleTypeDef *hcrc)
+{
+    const app_descriptor_t *app_descriptor = (const app_descriptor_t *)APP_DESCRIPTOR_ADDRESS;
+    app_verify_marker_t marker;
+
+    if (!app_verify_read(hi2c, &marker)) {
+        return false;
+    }
+
+    if (marker.magic_word != APP_VERIFY_MAGIC_WORD) {
+        BL_PRINTF("No verification marker\r\n");
+        return false;
+    }
+
+    if (marker.marker_crc != app_verify_marker_crc(hcrc, &marker)) {
+        BL_PRINTF("Verification marker cleared\r\n");
+        return false;
+    }
+
+    if (marker.verified_generation != marker.generation) {
+        BL_PRINTF("Flash programmed since last verification\r\n");
+        return false;
+    }
+
+    if (app_descriptor->magic_word != APP_DESCRIPTOR_MAGIC_WORD
+        || app_descriptor->crc32 != marker.app_crc) {
+        BL_PRINTF("Application descriptor changed\r\n");
+        return false;
+    }
+
+    if (app_verify_quick_crc(hcrc) != marker.quick_crc) {
+        BL_PRINTF("Application vector table changed\r\n");
+        return false;
+    }
+
+    return true;
+}
+
+void app_verify_save(I2C_HandleTypeDef *hi2c, CRC_HandleTypeDef *hcrc)
+{
+    const app_descriptor_t *app_descriptor = (const app_descriptor_t *)APP_DESCRIPTOR_ADDRESS;
+    app_verify_marker_t marker;
+
+    if (!app_verify_read(hi2c, &marker)) {
+        return;
+    }
+
+    if (marker.magic_word != APP_VERIFY_MAGIC_WORD) {
+        marker.magic_word = APP_VERIFY_MAGIC_WORD;
+        marker.generation = 0;
+    }
+
+    marker.verified_generation = marker.generation;
+    marker.app_crc = app_descriptor->crc32;
+    marker.quick_crc = app_verify_quick_crc(hcrc);
+    marker.marker_crc = app_verify_marker_crc(hcrc, &marker);
+
+    if (app_verify_write(hi2c, &marker)) {
+        BL_PRINTF("Verification marker saved: generation=%lu\r\n", marker.generation);
+    }
+}
+
+void app_verify_invalidate(I2C_HandleTypeDef *hi2c)
+{
+    app_verify_marker_t marker;
+
+    if (!app_verify_read(hi2c, &marker)) {
+        return;
+    }
+
+    if (marker.magic_word != APP_VERIFY_MAGIC_WORD) {
+        marker.magic_word = APP_VERIFY_MAGIC_WORD;
+        marker.generation = 0;
+    }
+
+    /*
+     * Advancing the generation is sufficient on its own, but the marker
+     * is also cleared so that it cannot match again if the counter wraps.
+     */
+    marker.generation++;
+    marker.verified_generation = 0;
+    marker.app_crc = 0;
+    marker.quick_crc = 0;
+    marker.marker_crc = 0;
+
+    if (app_verify_write(hi2c, &marker)) {
+        BL_PRINTF("Flash generation advanced: %lu\r\n", marker.generation);
+    }
+}
+
+bool app_verify_read(I2C_HandleTypeDef *hi2c, app_verify_marker_t *marker)
+{
+    HAL_StatusTypeDef ret = HAL_OK;
+    uint8_t data[APP_VERIFY_SIZE];
+
+    ret = m24m01_read_buffer(hi2c, APP_VERIFY_PAGE, data, sizeof(data));
+    if (ret != HAL_OK) {
+        BL_PRINTF("Unable to read verification marker: %d\r\n", ret);
+        return false;
+    }
+
+    marker->magic_word = copy_to_u32(data + APP_VERIFY_MAGIC);
+    marker->generation = copy_to_u32(data + APP_VERIFY_GENERATION);
+    marker->verified_generation = copy_to_u32(data + APP_VERIFY_VERIFIED_GENERATION);
+    marker->app_crc = copy_to_u32(data + APP_VERIFY_APP_CRC);
+    marker->quick_crc = copy_to_u32(data + APP_VERIFY_QUICK_CRC);
+    marker->marker_crc = copy_to_u32(data + APP_VERIFY_MARKER_CRC);
+    return true;
+}
+
+bool app_verify_write(I2C_HandleTypeDef *hi2c, const app_verify_marker_t *marker)
+{
+    HAL_StatusTypeDef ret = HAL_OK;
+    uint8_t data[APP_VERIFY_SIZE];
+
+    copy_from_u32(data + APP_VERIFY_MAGIC, marker->magic_word);
+    copy_from_u32(data + APP_VERIFY_GENERATION, marker->generation);
+    copy_from_u32(data + APP_VERIFY_VERIFIED_GENERATION, marker->verified_generation);
+    copy_from_u32(data + APP_VERIFY_APP_CRC, marker->app_crc);
+    copy_from_u32(data + APP_VERIFY_QUICK_CRC, marker->quick_crc);
+    copy_from_u32(data + APP_VERIFY_MARKER_CRC, marker->marker_crc);
+
+    ret = m24m01_write_page(hi2c, APP_VERIFY_PAGE, data, sizeof(data));
+    if (ret != HAL_OK) {
+        BL_PRINTF("Unable to write verification marker: %d\r\n", ret);
+        return false;
+    }
+    return true;
+}
+
+uint32_t app_verify_marker_crc(CRC_HandleTypeDef *hcrc, const app_verify_marker_t *marker)
+{
+    /* Everything except the marker checksum itself */
+    uint32_t crc = HAL_CRC_Calculate(hcrc, (uint32_t *)marker,
+        offsetof(app_verify_marker_t, marker_crc) / 4);
+
+    __HAL_RCC_CRC_FORCE_RESET();
+    __HAL_RCC_CRC_RELEASE_RESET();
+
+    return crc;
+}
+
+uint32_t app_verify_quick_crc(CRC_HandleTypeDef *hcrc)
+{
+    uint32_t crc = HAL_CRC_Calculate(hcrc, (uint32_t *)APP_ADDRESS, APP_VERIFY_QUICK_SIZE / 4);
+
+    __HAL_RCC_CRC_FORCE_RESET();
+    __HAL_RCC_CRC_RELEASE_RESET();
+
+    return crc;
+}
+
+uint32_t copy_to_u32(const uint8_t *buf)
+{
+    return (uint32_t)buf[0] << 24
+        | (uint32_t)buf[1] << 16
+        | (uint32_t)buf[2] << 8
+        | (uint32_t)buf[3];
+}
+
+void copy_from_u32(uint8_t *buf, uint32_t val)
+{
+    buf[0] = (val >> 24) & 0xFF;
+    buf[1] = (val >> 16) & 0xFF;
+    buf[2] = (val >> 8) & 0xFF;
+    buf[3] = val & 0xFF;
+}
@@ -0,0 +1,55 @@
+/*
+ * Cached verification of the application image
+ *
+ * Verifying the checksum of the entire application flash takes a
+ * noticeable amount of time, and the flash contents only change when
+ * the bootloader programs a new image. Once an image has been fully
+ * verified, a marker is saved to the EEPROM that ties the result to the
+ * image checksum and to a counter that is incremented every time the
+ * flash is about to be programmed. As long as that marker remains valid,
+ * subsequent startups can skip the full verification.
+ */
+
+#ifndef APP_VERIFY_H
+#define APP_VERIFY_H
+
+#include <stm32f4xx_hal.h>
+#include <stdbool.h>
+
+/** EEPROM page reserved for the verification marker */
+#define APP_VERIFY_PAGE 0x1FD00UL
+
+/**
+ * Check whether the application has a valid verification marker.
+ *
+ * This performs only a few quick checks on the flash contents, so it
+ * is not a substitute for bootloader_verify_checksum() if the marker
+ * is not valid.
+ *
+ * @param hi2c Handle for the I2C peripheral of the EEPROM
+ * @param hcrc Handle for the CRC peripheral
+ * @return True if the full verification can be skipped
+ */
+bool app_verify_is_cached(I2C_HandleTypeDef *hi2c, CRC_HandleTypeDef *hcrc);
+
+/**
+ * Save the verification marker for the current application.
+ *
+ * This should only be called after bootloader_verify_checksum()
+ * has succeeded.
+ *
+ * @param hi2c Handle for the I2C peripheral of the EEPROM
+ * @param hcrc Handle for the CRC peripheral
+ */
+void app_verify_save(I2C_HandleTypeDef *hi2c, CRC_HandleTypeDef *hcrc);
+
+/**
+ * Advance the flash programming generation, invalidating any marker.
+ *
+ * This must be called before the application flash is erased.
+ *
+ * @param hi2c Handle for the I2C peripheral of the EEPROM
+ */
+void app_verify_invalidate(I2C_HandleTypeDef *hi2c);
+
+#endif /* APP_VERIFY_H */
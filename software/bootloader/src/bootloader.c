@@ -115,6 +115,50 @@ bootloader_status_t bootloader_flash_next(uint32_t data)
     return BL_OK;
 }
 
+/**
+ * Program a block of 32-bit data into flash.
+ *
+ * This function writes the provided data at the current data pointer,
+ * as if by repeated calls to bootloader_flash_next().
+ *
+ * @param  data Pointer to the data to be written into flash
+ * @param  count Number of 32-bit words to write
+ * @retval BL_OK upon success
+ * @retval BL_WRITE_ERROR upon failure
+ */
+bootloader_status_t bootloader_flash_block(const uint32_t *data, uint32_t count)
+{
+    bootloader_status_t status = BL_OK;
+    for (uint32_t i = 0; i < count; i++) {
+        status = bootloader_flash_next(data[i]);
+        if (status != BL_OK) {
+            break;
+        }
+    }
+    return status;
+}
+
+/**
+ * Move the flash programming data pointer.
+ *
+ * This function allows a region of the application flash area to be
+ * skipped during programming, so that it can be written separately.
+ *
+ * @param  address New flash destination address
+ * @retval BL_OK upon success
+ * @retval BL_WRITE_ERROR if the address is outside the application area
+ */
+bootloader_status_t bootloader_flash_seek(uint32_t address)
+{
+    if (address < APP_ADDRESS || address > (FLASH_BASE + FLASH_SIZE - 4) || (address % 4) != 0) {
+        return BL_WRITE_ERROR;
+    }
+
+    flash_ptr = address;
+
+    return BL_OK;
+}
+
 /**
  * Finish flash programming.
  *
@@ -75,6 +75,8 @@ bootloader_status_t bootloader_erase(void);
 
 bootloader_status_t bootloader_flash_begin(void);
 bootloader_status_t bootloader_flash_next(uint32_t data);
+bootloader_status_t bootloader_flash_block(const uint32_t *data, uint32_t count);
+bootloader_status_t bootloader_flash_seek(uint32_t address);
 bootloader_status_t bootloader_flash_end(void);
 
 bootloader_flash_protection_t bootloader_get_protection_status(void);
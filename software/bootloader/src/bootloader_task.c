@@ -17,6 +17,9 @@
 #include "bootloader.h"
 #include "board_config.h"
 #include "app_descriptor.h"
+#include "app_pack.h"
+#include "app_unpack.h"
+#include "app_verify.h"
 #include "m24m01.h"
 
 #define FW_FILENAME "0:/DPD500FW.BIN"
@@ -56,12 +59,62 @@ typedef struct {
     char file_path[256];
 } bootloader_block_t;
 
+/*
+ * The firmware file is read in large chunks by a separate task, so that
+ * the USB transfer for the next chunk can proceed while the current one
+ * is being programmed into flash.
+ */
+#define UPDATE_CHUNK_SIZE  4096
+#define UPDATE_CHUNK_COUNT 2
+
+/*
+ * The start of the image, which contains the initial stack pointer and
+ * reset vector, is held back and only programmed once the entire image
+ * has been verified. Until then, the flash does not contain anything
+ * that will be recognized as a valid application.
+ */
+#define UPDATE_HEADER_SIZE 16
+
+typedef struct {
+    uint32_t data[UPDATE_CHUNK_SIZE / 4];
+    UINT length;
+    FRESULT res;
+} update_chunk_t;
+
+typedef struct {
+    FIL *fp;
+    osMessageQueueId_t free_queue;
+    osMessageQueueId_t filled_queue;
+} update_reader_t;
+
+typedef struct {
+    uint32_t image_size;
+    uint32_t offset;
+    uint32_t calculated_crc;
+    app_descriptor_t descriptor;
+    uint32_t header[UPDATE_HEADER_SIZE / 4];
+    bootloader_status_t status;
+} update_stage_t;
+
+static update_chunk_t update_chunks[UPDATE_CHUNK_COUNT];
+static app_unpack_t update_unpack;
+
+static const osThreadAttr_t update_reader_task_attributes = {
+    .name = "update_reader",
+    .stack_size = 1024 * 4,
+    .priority = (osPriority_t)osPriorityAboveNormal,
+};
+
 static void bootloader_task_run(void *argument);
 static void bootloader_loop_user_button();
 static void bootloader_loop_firmware_trigger();
 static void bootloader_loop_checksum_fail();
 static bool read_bootloader_block(bootloader_block_t *block);
 static update_result_t process_firmware_update(const char *file_path, uint32_t file_checksum);
+static bool update_reader_start(update_reader_t *reader, FIL *fp);
+static void update_reader_stop(update_reader_t *reader);
+static void update_reader_run(void *argument);
+static bool update_stage_data(const uint8_t *data, size_t length, void *user_data);
 static void bootloader_update_complete();
 static void bootloader_update_failed(update_result_t update_result);
 static void bootloader_start_application();
@@ -70,6 +123,9 @@ extern void deinit_peripherals();
 #ifndef MIN
 #define MIN(a, b)  (((a) < (b)) ? (a) : (b))
 #endif
+#ifndef MAX
+#define MAX(a, b)  (((a) > (b)) ? (a) : (b))
+#endif
 
 osStatus_t bootloader_task_init(bootloader_trigger_t trigger)
 {
@@ -315,17 +371,19 @@ update_result_t process_firmware_update(const char *file_path, uint32_t file_che
     FRESULT res;
     FIL fp;
     bool file_open = false;
-    uint8_t buf[512];
-    UINT bytes_remaining;
-    UINT bytes_to_read;
+    update_reader_t reader = {0};
+    bool reader_started = false;
     UINT bytes_read;
-    uint32_t calculated_crc = 0;
-    app_descriptor_t image_descriptor = {0};
-    uint32_t *flash_ptr;
-    uint32_t data;
-    uint32_t counter;
+    uint32_t file_size;
+    uint32_t file_offset;
+    uint32_t data_start;
+    uint32_t data_end;
+    bool packed = false;
+    app_pack_header_t pack_header = {0};
+    const app_descriptor_t *trailing_descriptor;
+    update_stage_t stage = {0};
+    app_unpack_result_t unpack_result = APP_UNPACK_OK;
     int key_count = 0;
-    bootloader_status_t status = BL_OK;
     update_result_t result = UPDATE_FAILED;
 
     do {
@@ -363,83 +421,91 @@ update_result_t process_firmware_update(const char *file_path, uint32_t file_che
             break;
         }
         file_open = true;
+        file_size = f_size(&fp);
 
-        /* Check size of the firmware file */
-        if (bootloader_check_size(f_size(&fp)) != BL_OK) {
-            BL_PRINTF("Firmware size is invalid: %lu\r\n", f_size(&fp));
-            result = UPDATE_FILE_BAD;
-            break;
+        /* Check whether this is a packed firmware file */
+        if (file_size > sizeof(app_pack_header_t)) {
+            res = f_read(&fp, &pack_header, sizeof(app_pack_header_t), &bytes_read);
+            if (res != FR_OK || bytes_read != sizeof(app_pack_header_t)) {
+                BL_PRINTF("Unable to read the firmware file header: %d\r\n", res);
+                result = UPDATE_FILE_READ_ERROR;
+                break;
+            }
+            packed = (pack_header.magic_word == APP_PACK_MAGIC_WORD);
         }
-        BL_PRINTF("Firmware size is okay.\r\n");
-
-        /* Calculate the firmware file checksum */
-        __HAL_CRC_DR_RESET(&hcrc);
-        bytes_remaining = f_size(&fp) - 4;
-        do {
-            bytes_to_read = MIN(sizeof(buf), bytes_remaining);
-            res = f_read(&fp, buf, bytes_to_read, &bytes_read);
-            if (res == FR_OK) {
-                /* This check should never fail, but safer to do it anyways */
-                if ((bytes_read % 4) != 0) {
-                    BL_PRINTF("Bytes read are not word aligned\r\n");
-                    result = UPDATE_FILE_READ_ERROR;
-                    break;
-                }
-
-                calculated_crc = HAL_CRC_Accumulate(&hcrc, (uint32_t *)buf, bytes_read / 4);
 
-                bytes_remaining -= bytes_read;
-
-                /* Break if at EOF */
-                if (bytes_read < bytes_to_read) {
-                    break;
-                }
-            } else {
-                BL_PRINTF("File read error: %d\r\n", res);
+        if (packed) {
+            if (pack_header.version != APP_PACK_VERSION
+                || pack_header.window_bits > APP_UNPACK_WINDOW_BITS
+                || pack_header.packed_size > file_size - sizeof(app_pack_header_t)) {
+                BL_PRINTF("Packed firmware header is invalid\r\n");
+                result = UPDATE_FILE_BAD;
                 break;
             }
-        } while (res == FR_OK && bytes_remaining > 0);
-
-        __HAL_RCC_CRC_FORCE_RESET();
-        __HAL_RCC_CRC_RELEASE_RESET();
-
-        /* Read the app descriptor from the end of the firmware file */
-        res = f_lseek(&fp, f_tell(&fp) - (sizeof(app_descriptor_t) - 4));
-        if (res != FR_OK) {
-            BL_PRINTF("Unable to seek to read the firmware file descriptor: %d\r\n", res);
-            result = UPDATE_FILE_READ_ERROR;
-            break;
-        }
-        res = f_read(&fp, &image_descriptor, sizeof(app_descriptor_t), &bytes_read);
-        if (res != FR_OK || bytes_read != sizeof(app_descriptor_t)) {
-            BL_PRINTF("Unable to read the firmware file descriptor: %d\r\n", res);
-            result = UPDATE_FILE_READ_ERROR;
-            break;
+            BL_PRINTF("Firmware file is packed: %lu -> %lu\r\n", pack_header.packed_size, pack_header.image_size);
+            stage.image_size = pack_header.image_size;
+            data_start = sizeof(app_pack_header_t);
+            data_end = data_start + pack_header.packed_size;
+            trailing_descriptor = &pack_header.descriptor;
+        } else {
+            stage.image_size = file_size;
+            data_start = 0;
+            data_end = file_size;
+            trailing_descriptor = &stage.descriptor;
         }
 
-        f_rewind(&fp);
-
-        if (calculated_crc != image_descriptor.crc32) {
-            BL_PRINTF("Firmware checksum mismatch: %08lX != %08lX\r\n",
-                image_descriptor.crc32, calculated_crc);
+        /* Check size of the firmware image */
+        if (bootloader_check_size(stage.image_size) != BL_OK
+            || stage.image_size < sizeof(app_descriptor_t) + UPDATE_HEADER_SIZE
+            || (stage.image_size % 4) != 0) {
+            BL_PRINTF("Firmware size is invalid: %lu\r\n", stage.image_size);
             result = UPDATE_FILE_BAD;
             break;
         }
-        BL_PRINTF("Firmware checksum is okay.\r\n");
+        BL_PRINTF("Firmware size is okay.\r\n");
 
-        if (image_descriptor.magic_word != APP_DESCRIPTOR_MAGIC_WORD) {
+        /*
+         * Read the app descriptor from the end of the firmware file,
+         * unless it was already provided in the packed file header.
+         * This is only a sanity check to avoid erasing the flash for
+         * the wrong file, as the actual verification of its contents
+         * happens while it is being programmed.
+         */
+        if (!packed) {
+            res = f_lseek(&fp, file_size - sizeof(app_descriptor_t));
+            if (res != FR_OK) {
+                BL_PRINTF("Unable to seek to read the firmware file descriptor: %d\r\n", res);
+                result = UPDATE_FILE_READ_ERROR;
+                break;
+            }
+            res = f_read(&fp, &stage.descriptor, sizeof(app_descriptor_t), &bytes_read);
+            if (res != FR_OK || bytes_read != sizeof(app_descriptor_t)) {
+                BL_PRINTF("Unable to read the firmware file descriptor: %d\r\n", res);
+                result = UPDATE_FILE_READ_ERROR;
+                break;
+            }
+        }
+
+        if (trailing_descriptor->magic_word != APP_DESCRIPTOR_MAGIC_WORD) {
             BL_PRINTF("Bad magic\r\n");
             result = UPDATE_FILE_BAD;
             break;
         }
 
-        if (file_checksum > 0 && file_checksum != image_descriptor.crc32) {
+        if (file_checksum > 0 && file_checksum != trailing_descriptor->crc32) {
             BL_PRINTF("Firmware checksum unexpected: %08lX != %08lX\r\n",
-            image_descriptor.crc32, file_checksum);
+            trailing_descriptor->crc32, file_checksum);
             result = UPDATE_FILE_BAD;
             break;
         }
 
+        res = f_lseek(&fp, data_start);
+        if (res != FR_OK) {
+            BL_PRINTF("Unable to seek to the firmware data: %d\r\n", res);
+            result = UPDATE_FILE_READ_ERROR;
+            break;
+        }
+
         /* Only prompt if loading the fallback file */
         if (file_checksum == 0) {
             display_graphic_update_prompt();
@@ -468,6 +534,9 @@ update_result_t process_firmware_update(const char *file_path, uint32_t file_che
         /* Initialize bootloader and prepare for flash programming */
         bootloader_init();
 
+        /* Make sure the next startup does a full verification */
+        app_verify_invalidate(&hi2c1);
+
         /* Erase existing flash contents */
         BL_PRINTF("Erasing flash...\r\n");
         display_graphic_update_progress_increment(5);
@@ -480,35 +549,93 @@ update_result_t process_firmware_update(const char *file_path, uint32_t file_che
         }
         BL_PRINTF("Flash erased\r\n");
 
-        /* Start programming */
+        if (!update_reader_start(&reader, &fp)) {
+            BL_PRINTF("Unable to start file reader\r\n");
+            display_graphic_update_progress_failure();
+            result = UPDATE_FAILED;
+            break;
+        }
+        reader_started = true;
+
+        if (packed) {
+            app_unpack_init(&update_unpack, stage.image_size, update_stage_data, &stage);
+        }
+
+        /*
+         * Program the firmware while calculating its checksum. For packed
+         * files, the data read from the file is first passed through the
+         * decompressor, and everything else happens on its output.
+         */
         BL_PRINTF("Programming firmware...\r\n");
         display_graphic_update_progress_increment(10);
-        counter = 0;
+        __HAL_CRC_DR_RESET(&hcrc);
         bootloader_flash_begin();
-        do {
-            data = 0xFFFFFFFF;
-            res = f_read(&fp, &data, 4, &bytes_read);
-            if (res == FR_OK && bytes_read > 0) {
-                status = bootloader_flash_next(data);
-                if (status == BL_OK) {
-                    counter++;
-                } else {
-                    BL_PRINTF("Programming error at byte %lu\r\n", (counter * 4));
-                    result = UPDATE_FLASH_ERROR;
+        bootloader_flash_seek(APP_ADDRESS + UPDATE_HEADER_SIZE);
+
+        file_offset = data_start;
+        res = FR_OK;
+        stage.status = BL_OK;
+        while (file_offset < data_end) {
+            uint8_t index;
+            if (osMessageQueueGet(reader.filled_queue, &index, NULL, osWaitForever) != osOK
+                || index >= UPDATE_CHUNK_COUNT) {
+                res = FR_INT_ERR;
+                break;
+            }
+
+            const update_chunk_t *chunk = &update_chunks[index];
+            uint32_t length = chunk->length;
+
+            if (chunk->res != FR_OK || length == 0 || file_offset + length > file_size) {
+                BL_PRINTF("File read error: %d\r\n", chunk->res);
+                res = (chunk->res != FR_OK) ? chunk->res : FR_INT_ERR;
+                break;
+            }
+
+            /* This check should never fail, but safer to do it anyways */
+            if ((length % 4) != 0) {
+                BL_PRINTF("Bytes read are not word aligned\r\n");
+                res = FR_INT_ERR;
+                break;
+            }
+
+            if (packed) {
+                length = MIN(length, data_end - file_offset);
+                unpack_result = app_unpack_process(&update_unpack, (const uint8_t *)chunk->data, length);
+                if (unpack_result != APP_UNPACK_OK) {
+                    BL_PRINTF("Unpack error at byte %lu: %d\r\n", file_offset, unpack_result);
                     break;
                 }
+            } else {
+                update_stage_data((const uint8_t *)chunk->data, length, &stage);
             }
-            if ((counter % 1024) == 0) {
-                uint8_t value = 10 + ((150 * counter) / APP_SIZE);
-                if (value < 10) { value = 10; }
-                else if (value > 160) { value = 160; }
-                display_graphic_update_progress_increment(value);
+            if (stage.status != BL_OK) {
+                break;
             }
-        } while (res == FR_OK && bytes_read > 0);
+
+            file_offset += length;
+            osMessageQueuePut(reader.free_queue, &index, 0, osWaitForever);
+
+            uint8_t value = 10 + ((190 * (file_offset - data_start)) / (data_end - data_start));
+            display_graphic_update_progress_increment(value);
+        }
+
+        if (packed && unpack_result == APP_UNPACK_OK && stage.status == BL_OK && res == FR_OK) {
+            unpack_result = app_unpack_finish(&update_unpack);
+            if (unpack_result != APP_UNPACK_OK) {
+                BL_PRINTF("Unpack error at end of file: %d\r\n", unpack_result);
+            }
+        }
 
         bootloader_flash_end();
 
-        if (status != BL_OK || res != FR_OK) {
+        __HAL_RCC_CRC_FORCE_RESET();
+        __HAL_RCC_CRC_RELEASE_RESET();
+
+        update_reader_stop(&reader);
+        reader_started = false;
+
+        if (stage.status != BL_OK || res != FR_OK) {
             BL_PRINTF("Programming error!\r\n");
             display_graphic_update_progress_failure();
             if (res != FR_OK) {
@@ -519,47 +646,47 @@ update_result_t process_firmware_update(const char *file_path, uint32_t file_che
             break;
         }
 
-        BL_PRINTF("Firmware programmed\r\n");
-        display_graphic_update_progress_increment(150);
+        if (unpack_result != APP_UNPACK_OK || stage.offset != stage.image_size) {
+            BL_PRINTF("Firmware image is incomplete: %lu != %lu\r\n", stage.offset, stage.image_size);
+            display_graphic_update_progress_failure();
+            result = UPDATE_FILE_BAD;
+            break;
+        }
 
-        f_rewind(&fp);
+        if (stage.calculated_crc != stage.descriptor.crc32
+            || stage.descriptor.magic_word != APP_DESCRIPTOR_MAGIC_WORD
+            || stage.descriptor.crc32 != trailing_descriptor->crc32) {
+            BL_PRINTF("Firmware checksum mismatch: %08lX != %08lX\r\n",
+                stage.descriptor.crc32, stage.calculated_crc);
+            display_graphic_update_progress_failure();
+            result = UPDATE_FILE_BAD;
+            break;
+        }
+        BL_PRINTF("Firmware checksum is okay.\r\n");
 
-        /* Verify flash content */
-        BL_PRINTF("Verifying firmware...\r\n");
+        /* Commit the image by programming the header */
+        bootloader_flash_begin();
+        stage.status = bootloader_flash_block(stage.header, UPDATE_HEADER_SIZE / 4);
+        bootloader_flash_end();
+        if (stage.status != BL_OK) {
+            BL_PRINTF("Programming error at image header\r\n");
+            display_graphic_update_progress_failure();
+            result = UPDATE_FLASH_ERROR;
+            break;
+        }
 
-        flash_ptr = (uint32_t*)APP_ADDRESS;
-        counter = 0;
-        status = BL_OK;
-        do {
-            res = f_read(&fp, buf, sizeof(buf), &bytes_read);
-            if (res != FR_OK) {
-                BL_PRINTF("File read error: %d\r\n", res);
-                break;
-            }
-            if (memcmp(flash_ptr, buf, bytes_read) == 0) {
-                counter += bytes_read;
-                flash_ptr += bytes_read / 4;
-            } else {
-                BL_PRINTF("Verify error at byte %lu\r\n", counter);
-                status = BL_CHKS_ERROR;
-                break;
-            }
-            if ((counter % 1024) == 0) {
-                uint8_t value = 160 + ((50 * counter) / APP_SIZE);
-                if (value < 160) { value = 160; }
-                else if (value > 210) { value = 210; }
-                display_graphic_update_progress_increment(value);
-            }
-        } while (res == FR_OK && bytes_read > 0);
+        BL_PRINTF("Firmware programmed\r\n");
+        display_graphic_update_progress_increment(200);
 
-        if (status != BL_OK || res != FR_OK) {
+        /*
+         * Every word is read back as it is programmed, so a checksum
+         * of the flash contents is sufficient to verify the result.
+         */
+        BL_PRINTF("Verifying firmware...\r\n");
+        if (bootloader_verify_checksum(&hcrc) != BL_OK) {
             BL_PRINTF("Verification error!\r\n");
             display_graphic_update_progress_failure();
-            if (res != FR_OK) {
-                result = UPDATE_FILE_READ_ERROR;
-            } else {
-                result = UPDATE_FLASH_ERROR;
-            }
+            result = UPDATE_FLASH_ERROR;
             break;
         }
         BL_PRINTF("Firmware verified\r\n");
@@ -585,6 +712,10 @@ update_result_t process_firmware_update(const char *file_path, uint32_t file_che
 
     } while (0);
 
+    if (reader_started) {
+        update_reader_stop(&reader);
+    }
+
     if (file_open) {
         f_close(&fp);
     }
@@ -592,6 +723,136 @@ update_result_t process_firmware_update(const char *file_path, uint32_t file_che
     return result;
 }
 
+/**
+ * Stage the next block of image data into flash.
+ *
+ * This accumulates the image checksum, captures the trailing app
+ * descriptor, and holds back the image header, before programming
+ * the remaining data into flash.
+ */
+bool update_stage_data(const uint8_t *data, size_t length, void *user_data)
+{
+    update_stage_t *stage = user_data;
+    const uint32_t image_size = stage->image_size;
+    const uint32_t offset = stage->offset;
+
+    if (offset + length > image_size || (length % 4) != 0) {
+        stage->status = BL_SIZE_ERROR;
+        return false;
+    }
+
+    /*
+     * The checksum covers everything except the last word of the image,
+     * which is the checksum field of the trailing app descriptor.
+     */
+    if (offset < image_size - 4) {
+        uint32_t crc_length = MIN(length, (image_size - 4) - offset);
+        stage->calculated_crc = HAL_CRC_Accumulate(&hcrc, (uint32_t *)data, crc_length / 4);
+    }
+
+    /* Capture the trailing app descriptor */
+    const uint32_t desc_start = image_size - sizeof(app_descriptor_t);
+    if (offset + length > desc_start) {
+        const uint32_t copy_start = MAX(offset, desc_start);
+        memcpy((uint8_t *)&stage->descriptor + (copy_start - desc_start),
+            data + (copy_start - offset),
+            (offset + length) - copy_start);
+    }
+
+    /* Hold back the image header, and program everything else */
+    uint32_t skip = 0;
+    if (offset < UPDATE_HEADER_SIZE) {
+        skip = MIN(length, UPDATE_HEADER_SIZE - offset);
+        memcpy((uint8_t *)stage->header + offset, data, skip);
+    }
+
+    stage->status = bootloader_flash_block((const uint32_t *)(data + skip), (length - skip) / 4);
+    if (stage->status != BL_OK) {
+        BL_PRINTF("Programming error at byte %lu\r\n", offset);
+        return false;
+    }
+
+    stage->offset += length;
+    return true;
+}
+
+bool update_reader_start(update_reader_t *reader, FIL *fp)
+{
+    /* Both queues have room for every chunk, plus a stop marker */
+    reader->fp = fp;
+    reader->free_queue = osMessageQueueNew(UPDATE_CHUNK_COUNT + 1, sizeof(uint8_t), NULL);
+    reader->filled_queue = osMessageQueueNew(UPDATE_CHUNK_COUNT + 1, sizeof(uint8_t), NULL);
+    if (!reader->free_queue || !reader->filled_queue) {
+        update_reader_stop(reader);
+        return false;
+    }
+
+    for (uint8_t i = 0; i < UPDATE_CHUNK_COUNT; i++) {
+        osMessageQueuePut(reader->free_queue, &i, 0, 0);
+    }
+
+    if (!osThreadNew(update_reader_run, reader, &update_reader_task_attributes)) {
+        update_reader_stop(reader);
+        return false;
+    }
+
+    return true;
+}
+
+void update_reader_stop(update_reader_t *reader)
+{
+    uint8_t index = UINT8_MAX;
+
+    if (reader->free_queue && reader->filled_queue) {
+        /*
+         * Tell the reader to stop, then wait for it to acknowledge.
+         * If it has already stopped on its own, the acknowledgment
+         * will already be in the queue.
+         */
+        osMessageQueuePut(reader->free_queue, &index, 0, osWaitForever);
+        do {
+            if (osMessageQueueGet(reader->filled_queue, &index, NULL, osWaitForever) != osOK) {
+                break;
+            }
+        } while (index != UINT8_MAX);
+    }
+
+    if (reader->free_queue) {
+        osMessageQueueDelete(reader->free_queue);
+        reader->free_queue = NULL;
+    }
+    if (reader->filled_queue) {
+        osMessageQueueDelete(reader->filled_queue);
+        reader->filled_queue = NULL;
+    }
+}
+
+void update_reader_run(void *argument)
+{
+    update_reader_t *reader = argument;
+    uint8_t index;
+
+    for (;;) {
+        if (osMessageQueueGet(reader->free_queue, &index, NULL, osWaitForever) != osOK
+            || index >= UPDATE_CHUNK_COUNT) {
+            break;
+        }
+
+        update_chunk_t *chunk = &update_chunks[index];
+        chunk->res = f_read(reader->fp, chunk->data, sizeof(chunk->data), &chunk->length);
+        osMessageQueuePut(reader->filled_queue, &index, 0, osWaitForever);
+
+        /* Stop at the end of the file, or on error */
+        if (chunk->res != FR_OK || chunk->length < sizeof(chunk->data)) {
+            break;
+        }
+    }
+
+    index = UINT8_MAX;
+    osMessageQueuePut(reader->filled_queue, &index, 0, osWaitForever);
+    osThreadExit();
+}
+
 void bootloader_update_complete()
 {
     osDelay(1000);
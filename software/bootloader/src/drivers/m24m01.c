@@ -53,3 +53,39 @@ HAL_StatusTypeDef m24m01_read_buffer(I2C_HandleTypeDef *hi2c, uint32_t address,
 
     return ret;
 }
+
+HAL_StatusTypeDef m24m01_write_page(I2C_HandleTypeDef *hi2c, uint32_t address, const uint8_t *data, size_t data_len)
+{
+    HAL_StatusTypeDef ret = HAL_OK;
+
+    BL_PRINTF("m24m01_write_page: address=0x%05lX, len=%d\r\n", address, data_len);
+
+    if (address > 0x1FFFF) {
+        BL_PRINTF("Cannot write to invalid address\r\n");
+        return HAL_ERROR;
+    }
+
+    uint8_t device_addr = DEVICE_ADDRESS(address);
+    uint16_t mem_addr = MEMORY_ADDRESS(address);
+
+    if (!data || data_len == 0) {
+        BL_PRINTF("Data is null or empty\r\n");
+        return HAL_ERROR;
+    }
+
+    uint8_t page_offset = (uint8_t)(mem_addr & 0x00FF);
+    if (data_len > 0x100U - page_offset) {
+        BL_PRINTF("Buffer exceeds page boundary\r\n");
+        return HAL_ERROR;
+    }
+
+    ret = HAL_I2C_Mem_Write(hi2c, device_addr, mem_addr, I2C_MEMADD_SIZE_16BIT,
+        (uint8_t *)data, data_len, HAL_MAX_DELAY);
+    if (ret != HAL_OK) {
+        BL_PRINTF("HAL_I2C_Mem_Write error: %d\r\n", ret);
+    }
+
+    while(HAL_I2C_IsDeviceReady(hi2c, device_addr, 1, HAL_MAX_DELAY) != HAL_OK);
+
+    return ret;
+}
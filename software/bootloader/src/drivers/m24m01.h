@@ -30,4 +30,17 @@ HAL_StatusTypeDef m24m01_read_byte(I2C_HandleTypeDef *hi2c, uint32_t address, ui
  */
 HAL_StatusTypeDef m24m01_read_buffer(I2C_HandleTypeDef *hi2c, uint32_t address, uint8_t *data, size_t data_len);
 
+/**
+ * Write a sequence of bytes to the specified address within a memory page.
+ *
+ * Buffer write operations are limited to the 256-byte page of the starting
+ * address, and will fail if they exceed these bounds.
+ *
+ * @param hi2c Pointer to a handle for the I2C peripheral
+ * @param address Address to write from
+ * @param data Pointer to the buffer to write the data from
+ * @param data_len Size of the data to be written
+ */
+HAL_StatusTypeDef m24m01_write_page(I2C_HandleTypeDef *hi2c, uint32_t address, const uint8_t *data, size_t data_len);
+
 #endif /* M24M01_H */
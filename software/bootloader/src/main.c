@@ -13,6 +13,7 @@
 #include "keypad.h"
 #include "bootloader.h"
 #include "bootloader_task.h"
+#include "app_verify.h"
 
 /* Uncomment for testing */
 /* #define FORCE_BOOTLOADER */
@@ -551,12 +552,21 @@ bool start_application()
     BL_PRINTF("Check for application\r\n");
 
     if (bootloader_check_for_application() == BL_OK) {
-        /* Verify application checksum */
-        if(bootloader_verify_checksum(&hcrc) != BL_OK) {
+        /*
+         * Skip the full checksum verification if the current image has
+         * already been verified, and nothing suggests it has changed.
+         * A watchdog reset is treated as a reason to check again.
+         */
+        if (!__HAL_RCC_GET_FLAG(RCC_FLAG_IWDGRST) && !__HAL_RCC_GET_FLAG(RCC_FLAG_WWDGRST)
+            && app_verify_is_cached(&hi2c1, &hcrc)) {
+            BL_PRINTF("Checksum previously verified.\r\n");
+        } else if (bootloader_verify_checksum(&hcrc) != BL_OK) {
+            /* Verify application checksum */
             BL_PRINTF("Checksum Error.\r\n");
             return false;
         } else {
             BL_PRINTF("Checksum OK.\r\n");
+            app_verify_save(&hi2c1, &hcrc);
         }
         BL_PRINTF("Launching Application...\r\n");
 
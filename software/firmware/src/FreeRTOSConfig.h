@@ -57,7 +57,7 @@
 #define configSUPPORT_STATIC_ALLOCATION          1
 #define configSUPPORT_DYNAMIC_ALLOCATION         1
 #define configUSE_IDLE_HOOK                      0
-#define configUSE_TICK_HOOK                      0
+#define configUSE_TICK_HOOK                      1
 #define configCPU_CLOCK_HZ                       ( SystemCoreClock )
 #define configTICK_RATE_HZ                       ((TickType_t)1000)
 #define configMAX_PRIORITIES                     ( 56 )
@@ -161,4 +161,15 @@ standard names. */
 
 #define USE_CUSTOM_SYSTICK_HANDLER_IMPLEMENTATION 0
 
+/* Kernel hooks for the binary event trace facility */
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+  #include "trace.h"
+#endif
+#define traceTASK_SWITCHED_IN()                    trace_kernel_task_switched_in(pxCurrentTCB->uxTCBNumber)
+#define traceQUEUE_CREATE(pxNewQueue)              trace_kernel_queue_create(pxNewQueue)
+#define traceQUEUE_SEND(pxQueue)                   trace_kernel_queue_event(TRACE_EVENT_QUEUE_SEND, pxQueue)
+#define traceQUEUE_SEND_FROM_ISR(pxQueue)          trace_kernel_queue_event(TRACE_EVENT_QUEUE_SEND_FROM_ISR, pxQueue)
+#define traceQUEUE_RECEIVE(pxQueue)                trace_kernel_queue_event(TRACE_EVENT_QUEUE_RECEIVE, pxQueue)
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue)       trace_kernel_queue_event(TRACE_EVENT_QUEUE_RECEIVE_FROM_ISR, pxQueue)
+
 #endif /* FREERTOS_CONFIG_H */
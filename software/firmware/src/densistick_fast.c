@@ -0,0 +1,107 @@
+#include "densistick_fast.h"
+
+#include <math.h>
+
+#include "exposure_math.h"
+
+void densistick_fast_init(densistick_fast_t *fast, int max_gain, int prev_gain, float prev_reading,
+    densistick_fast_density_func_t density_func, void *user_data)
+{
+    fast->density_func = density_func;
+    fast->user_data = user_data;
+    fast->max_gain = max_gain;
+    fast->prev_gain = prev_gain;
+    fast->prev_reading = prev_reading;
+
+    /* Without a previous reading, the gain was chosen by AGC */
+    fast->gain_predicted = !isnormal(prev_reading);
+
+    fast->invalid_count = 0;
+    fast->reading_count = 0;
+    fast->reading_sum = 0.0F;
+    fast->reading = NAN;
+    fast->density = NAN;
+    fast->gain = prev_gain;
+}
+
+densistick_fast_action_t densistick_fast_add_reading(densistick_fast_t *fast,
+    densistick_fast_sample_t sample, int gain, float reading)
+{
+    if (sample == DENSISTICK_FAST_SAMPLE_SATURATED) {
+        /* Back off the gain by a large step, and start over */
+        fast->invalid_count++;
+        if (fast->invalid_count > DENSISTICK_FAST_MAX_INVALID || gain <= 0) {
+            return DENSISTICK_FAST_HIGH;
+        }
+        fast->gain = (gain > 1) ? gain - 2 : 0;
+        fast->reading_count = 0;
+        fast->reading_sum = 0.0F;
+        return DENSISTICK_FAST_SET_GAIN;
+    } else if (sample != DENSISTICK_FAST_SAMPLE_VALID) {
+        fast->invalid_count++;
+        if (fast->invalid_count > DENSISTICK_FAST_MAX_INVALID) {
+            return DENSISTICK_FAST_TIMEOUT;
+        }
+        return DENSISTICK_FAST_CONTINUE;
+    }
+
+    if (!isnormal(reading) || reading < 0.0F) {
+        return DENSISTICK_FAST_FAIL;
+    }
+
+    /*
+     * Predict the gain for this patch from the previous measurement.
+     * Each gain step doubles the signal, so the gain is moved by one
+     * step for each factor of two between the readings. This keeps
+     * the signal near the level originally chosen by AGC, without
+     * having to run AGC again.
+     */
+    if (!fast->gain_predicted) {
+        fast->gain_predicted = true;
+        int new_gain = fast->prev_gain + densistick_fast_gain_steps(fast->prev_reading, reading);
+        if (new_gain < 0) {
+            new_gain = 0;
+        } else if (new_gain > fast->max_gain) {
+            new_gain = fast->max_gain;
+        }
+        if (new_gain != gain) {
+            fast->gain = new_gain;
+            return DENSISTICK_FAST_SET_GAIN;
+        }
+    }
+
+    fast->reading_sum += reading;
+    fast->reading_count++;
+
+    /*
+     * Darker patches return less light, so they are given more
+     * readings to average across before the measurement stops.
+     * Either way, it stops early once the estimate settles.
+     */
+    const float prev_density = fast->density;
+    fast->reading = fast->reading_sum / (float)fast->reading_count;
+    fast->density = fast->density_func(fast->reading, fast->user_data);
+    if (!isfinite(fast->density)) {
+        return DENSISTICK_FAST_FAIL;
+    }
+
+    int max_readings = 2 + (int)(fast->density * 2.0F);
+    if (max_readings < 2) {
+        max_readings = 2;
+    } else if (max_readings > DENSISTICK_FAST_MAX_READINGS) {
+        max_readings = DENSISTICK_FAST_MAX_READINGS;
+    }
+
+    if (fast->reading_count >= max_readings
+        || (fast->reading_count >= 2 && fabsf(fast->density - prev_density) < DENSISTICK_FAST_CONVERGED_DENSITY)) {
+        fast->gain = gain;
+        return DENSISTICK_FAST_DONE;
+    }
+
+    return DENSISTICK_FAST_CONTINUE;
+}
+
+int densistick_fast_gain_steps(float prev_reading, float reading)
+{
+    return (int)lroundf(exposure_math_log2(prev_reading / reading));
+}
@@ -0,0 +1,99 @@
+/*
+ * Decision logic for fast DensiStick measurements.
+ *
+ * A fast measurement averages a short run of sensor readings, and
+ * stops as soon as the density estimate settles. The sensor gain is
+ * predicted from the previous measurement, rather than found with AGC,
+ * and is backed off whenever a reading saturates. The caller takes
+ * each reading from the sensor, passes it in here, and then carries
+ * out the returned action.
+ *
+ * Gains are given as sensor gain steps, where each step doubles the
+ * sensitivity and step 0 is the lowest gain.
+ *
+ * This code has no dependencies on the HAL or RTOS, so it can also be
+ * compiled and tested on a host system.
+ */
+
+#ifndef DENSISTICK_FAST_H
+#define DENSISTICK_FAST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Maximum number of readings averaged together for a fast measurement */
+#define DENSISTICK_FAST_MAX_READINGS 8
+
+/* Change in density at which a fast measurement is considered converged */
+#define DENSISTICK_FAST_CONVERGED_DENSITY 0.005F
+
+/* Number of saturated or invalid readings before a measurement gives up */
+#define DENSISTICK_FAST_MAX_INVALID 5
+
+typedef enum {
+    DENSISTICK_FAST_SAMPLE_VALID = 0,
+    DENSISTICK_FAST_SAMPLE_SATURATED,
+    DENSISTICK_FAST_SAMPLE_INVALID
+} densistick_fast_sample_t;
+
+typedef enum {
+    DENSISTICK_FAST_CONTINUE = 0, /*!< Wait for the next reading */
+    DENSISTICK_FAST_SET_GAIN,     /*!< Change the sensor gain, then wait for the next reading */
+    DENSISTICK_FAST_DONE,         /*!< Measurement is complete */
+    DENSISTICK_FAST_HIGH,         /*!< Sensor is saturated at its lowest gain */
+    DENSISTICK_FAST_TIMEOUT,      /*!< Too many invalid readings */
+    DENSISTICK_FAST_FAIL          /*!< Reading could not be converted to a density */
+} densistick_fast_action_t;
+
+/**
+ * Callback to convert an averaged reading into a density.
+ */
+typedef float (*densistick_fast_density_func_t)(float reading, void *user_data);
+
+typedef struct {
+    densistick_fast_density_func_t density_func;
+    void *user_data;
+    int max_gain;
+    int prev_gain;
+    float prev_reading;
+    bool gain_predicted;
+    int invalid_count;
+    int reading_count;
+    float reading_sum;
+    float reading;   /*!< Average of the readings so far */
+    float density;   /*!< Density of the average reading */
+    int gain;        /*!< Gain to set, or the gain of the completed measurement */
+} densistick_fast_t;
+
+/**
+ * Start a new measurement.
+ *
+ * @param fast Measurement state
+ * @param max_gain Highest gain step the sensor supports
+ * @param prev_gain Gain step of the previous measurement
+ * @param prev_reading Average reading of the previous measurement, or NAN if there was none
+ * @param density_func Callback to convert a reading into a density
+ * @param user_data Pointer passed through to the callback
+ */
+void densistick_fast_init(densistick_fast_t *fast, int max_gain, int prev_gain, float prev_reading,
+    densistick_fast_density_func_t density_func, void *user_data);
+
+/**
+ * Add the next reading from the sensor to the measurement.
+ *
+ * @param fast Measurement state
+ * @param sample Status of the reading
+ * @param gain Gain step the reading was taken at
+ * @param reading Gain and integration time adjusted reading
+ * @return Action the caller should take next
+ */
+densistick_fast_action_t densistick_fast_add_reading(densistick_fast_t *fast,
+    densistick_fast_sample_t sample, int gain, float reading);
+
+/**
+ * Get the number of gain steps between two readings, where each step
+ * is a factor of two.
+ */
+int densistick_fast_gain_steps(float prev_reading, float reading);
+
+#endif /* DENSISTICK_FAST_H */
@@ -42,6 +42,14 @@ HAL_StatusTypeDef densistick_settings_clear(i2c_handle_t *hi2c);
 HAL_StatusTypeDef densistick_settings_get_tsl2585(const meter_probe_settings_handle_t *handle,
     densistick_settings_tsl2585_t *settings_tsl2585);
 
+/**
+ * Parse a raw calibration data block into the TSL2585 settings.
+ *
+ * @param data Buffer of METER_PROBE_SETTINGS_CAL_SIZE bytes
+ */
+HAL_StatusTypeDef densistick_settings_parse_tsl2585(const meter_probe_settings_handle_t *handle,
+    const uint8_t *data, densistick_settings_tsl2585_t *settings_tsl2585);
+
 HAL_StatusTypeDef densistick_settings_set_tsl2585(const meter_probe_settings_handle_t *handle,
     const densistick_settings_tsl2585_t *settings_tsl2585);
 
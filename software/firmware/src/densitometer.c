@@ -1,394 +1,303 @@
 #include "densitometer.h"
 
-#include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
-#include <math.h>
-#include <ctype.h>
 
+#include "densitometer_parse.h"
 #include "usb_host.h"
 
 #define LOG_TAG "densitometer"
 #include <elog.h>
 
-static void densitometer_clear_reading(densitometer_reading_t *reading);
-static densitometer_result_t densitometer_parse_reading(densitometer_reading_t *reading, const char *line);
-static densitometer_result_t densitometer_parse_reading_heiland(densitometer_reading_t *reading, const char *line, size_t len);
-static densitometer_result_t densitometer_parse_reading_xrite(densitometer_reading_t *reading, const char *line, size_t len);
-static densitometer_result_t densitometer_parse_reading_tobias(densitometer_reading_t *reading, const char *line, size_t len);
-static densitometer_result_t densitometer_parse_reading_fallback(densitometer_reading_t *reading, const char *line, size_t len);
-
-void densitometer_clear_reading(densitometer_reading_t *reading)
-{
-    if (reading) {
-        reading->mode = DENSITOMETER_MODE_UNKNOWN;
-        reading->visual = NAN;
-        reading->red = NAN;
-        reading->green = NAN;
-        reading->blue = NAN;
+#define REMOTE_PROBE_TIMEOUT_MS   250
+#define REMOTE_REQUEST_TIMEOUT_MS 2000
+
+/**
+ * Command set for a densitometer that accepts remote commands.
+ *
+ * Readings are returned in the device's normal output format, so they
+ * are handled by the same parsers as readings triggered by hand.
+ */
+typedef struct {
+    const char *name;
+    const char *identify_command;     /*!< Command that the device is expected to answer */
+    const char *identify_response;    /*!< Prefix of the expected response */
+    const char *reflection_command;   /*!< Command to request a reflection reading */
+    const char *transmission_command; /*!< Command to request a transmission reading */
+    const char *ack_prefix;           /*!< Prefix of lines that acknowledge a command */
+} densitometer_remote_protocol_t;
+
+static const densitometer_remote_protocol_t remote_protocols[] = {
+    {
+        .name = "Printalyzer Densitometer",
+        .identify_command = "GS V",
+        .identify_response = "GS V,",
+        .reflection_command = "IM REFL",
+        .transmission_command = "IM TRAN",
+        .ack_prefix = "IM "
     }
-}
+};
+
+typedef struct {
+    uint32_t seq;
+    uint32_t ticks;
+} densitometer_request_t;
+
+static const densitometer_remote_protocol_t *remote_protocol = NULL;
+static bool remote_probed = false;
+static uint32_t remote_attach_count = 0;
+static densitometer_request_t remote_pending[DENSITOMETER_MAX_PENDING];
+static uint8_t remote_pending_head = 0;
+static uint8_t remote_pending_count = 0;
+static uint32_t remote_next_seq = 1;
+
+static densitometer_result_t densitometer_parse_line(densitometer_reading_t *reading, const char *line);
+static bool densitometer_remote_send(const char *command);
+static void densitometer_remote_expire();
+static bool densitometer_remote_pop(uint32_t *seq);
 
-densitometer_result_t densitometer_parse_reading(densitometer_reading_t *reading, const char *line)
+static uint32_t detected_format_attach_count = 0;
+
+densitometer_result_t densitometer_parse_line(densitometer_reading_t *reading, const char *line)
 {
-    // First pass at parsing to log messages, planning to
-    // simply handle all possible formats to avoid needing device
-    // selection/detection except for advanced control features
-
-    size_t len = strlen(line);
-
-    /*
-     * Decide which format we are parsing based on a few easy-to-check
-     * characters in their respective strings. Since the Heiland format
-     * is far more rigid, and has a similar prefix as some X-Rite readings,
-     * it is easier to check for it first to avoid misidentification.
-     */
-    if (len == 7
-        && (line[0] == 'T' || line[0] == 'R' || line[0] == '0')
-        && (line[1] == '+' || line[1] == '-')
-        && (line[6] == 'D' || line[6] == 'Z' || line[6] == '%')) {
-        return densitometer_parse_reading_heiland(reading, line, len);
-    }
-    else if (len >= 4 &&
-        (line[0] == 'V' || line[0] == 'R' || line[0] == 'G' || line[0] == 'B' ||
-        line[0] == 'v' || line[0] == 'r' || line[0] == 'g' || line[0] == 'b' ||
-        line[0] == 'p' || line[0] == 'c' || line[0] == 'm' || line[0] == 'y' ||
-        line[0] == 'P' || line[0] == 'C' || line[0] == 'M' || line[0] == 'Y')
-        && ((line[1] == '-' && line[2] >= '0' && line[2] <= '9')
-            || (line[1] >= '0' && line[1] <= '9'))) {
-        return densitometer_parse_reading_xrite(reading, line, len);
+    /* Forget the detected format if the device may have changed */
+    const uint32_t attach_count = usb_serial_get_attach_count();
+    if (attach_count != detected_format_attach_count) {
+        densitometer_parse_reset();
+        detected_format_attach_count = attach_count;
     }
-    else if ((len >= 11 && strncmp(line, "Den", 3) == 0) || (len >= 12 && strncmp(line, " Den", 4) == 0)) {
-        return densitometer_parse_reading_tobias(reading, line, len);
-    }
-    else {
-        return densitometer_parse_reading_fallback(reading, line, len);
+
+    const char *prev_format = densitometer_parse_detected_format();
+    densitometer_result_t result = densitometer_parse_reading(reading, line);
+
+    const char *format = densitometer_parse_detected_format();
+    if (format && format != prev_format) {
+        log_d("Detected format: %s", format);
     }
+    return result;
 }
 
-densitometer_result_t densitometer_parse_reading_heiland(densitometer_reading_t *reading, const char *line, size_t len)
+densitometer_result_t densitometer_reading_poll(densitometer_reading_t *reading)
 {
-    /*
-     * Heiland TRD-2 Data Format
-     *
-     *  Index | Values  | Description
-     * -------+---------+---------------------------------------
-     *      0 | T/R/0   | Transmission/Reflection/StandBy
-     *      1 | +/-     | Sign
-     *      2 | 0...9/. | Value MSB
-     *      3 | 0...9/. | Value
-     *      4 | 0...9/. | Value
-     *      5 | 0...9/. | Value LSB
-     *      6 | D/Z/%   | Density/Zone/Percentage of dot area
-     *      7 | <CR>    | End of string
-     *
-     * Examples:
-     * "T+1.53D<cr>", "R-0.05D<cr>", "T+.278D<cr>", "0+....D<cr>"
-     */
-
-    char num_buf[6];
-
-    /* Parse the reading mode */
-    densitometer_mode_t mode = DENSITOMETER_MODE_UNKNOWN;
-    if (line[0] == 'T') {
-        mode = DENSITOMETER_MODE_TRANSMISSION;
-    } else if (line[0] == 'R') {
-        mode = DENSITOMETER_MODE_REFLECTION;
-    } else {
-        return DENSITOMETER_RESULT_INVALID;
-    }
+    char line_buf[64];
 
-    /* Make sure we are only reading density */
-    if (line[6] != 'D') {
+    if (!reading) {
         return DENSITOMETER_RESULT_INVALID;
     }
 
-    /* Copy the numeric portion to a separate buffer for parsing */
-    strncpy(num_buf, line + 1, 5);
-    num_buf[5] = '\0';
-
-    /* Parse and validate the number */
-    float val = strtof(num_buf, NULL);
-    if (!isnormal(val) && fpclassify(val) != FP_ZERO) {
-        return DENSITOMETER_RESULT_INVALID;
+    if (!usb_serial_is_attached()) {
+        return DENSITOMETER_RESULT_NOT_CONNECTED;
     }
 
-    /* Clean up zero values */
-    if (fabsf(val) < 0.001F) {
-        val = 0.0F;
+    if (usb_serial_receive_line((uint8_t *)line_buf, sizeof(line_buf)) == osOK) {
+        return densitometer_parse_line(reading, line_buf);
+    } else {
+        return DENSITOMETER_RESULT_TIMEOUT;
     }
-
-    densitometer_clear_reading(reading);
-    reading->mode = mode;
-    reading->visual = val;
-    return DENSITOMETER_RESULT_OK;
 }
 
-densitometer_result_t densitometer_parse_reading_xrite(densitometer_reading_t *reading, const char *line, size_t len)
+bool densitometer_remote_probe()
 {
-    /*
-     * X-Rite 810 Data Format
-     *
-     * All on one line:
-     * VX.XX<sp>RX.XX<sp>GX.XX<sp>BX.XX<sp>
-     *
-     * Separate lines:
-     * VX.XX<cr>
-     * RX.XX<cr>
-     * GX.XX<cr>
-     * BX.XX<cr>
-     *
-     * Two decimal-point formats:
-     * VX.XX or VXXX
-     *
-     * AIDm:
-     * T: p000, R: P000
-     * T: c004 m008 y000, R: C033 M030 Y033
-     *
-     * AIDa:
-     * T: v000, R: P030
-     * T: r003 g007 b000, R: C033 M030 Y033
-     *
-     */
-
-    densitometer_reading_t working_reading;
-    densitometer_clear_reading(&working_reading);
-
-    const char *p = line;
-    char *q = NULL;
-    char *r = NULL;
-    do {
-        char prefix = *p;
-        p++;
-        float val = strtof(p, &q);
-
-        /* Check if a valid number was parsed */
-        if (!isnormal(val) && fpclassify(val) != FP_ZERO) {
-            break;
-        }
+    char line_buf[64];
 
-        /* Check if an implied decimal point needs to be added */
-        r = strchr(p, '.');
-        if (!r || r >= q) {
-            val /= 100.0f;
-        }
+    if (!usb_serial_is_attached()) {
+        remote_probed = false;
+        remote_protocol = NULL;
+        return false;
+    }
 
-        /* Clean up zero values */
-        if (fabsf(val) < 0.001F) {
-            val = 0.0F;
-        }
+    /* Only probe once for each newly attached device */
+    const uint32_t attach_count = usb_serial_get_attach_count();
+    if (remote_probed && remote_attach_count == attach_count) {
+        densitometer_remote_reset();
+        usb_serial_clear_receive_buffer();
+        return remote_protocol != NULL;
+    }
 
-        /* Figure out the reading mode, if indicated by the prefix */
-        if (working_reading.mode == DENSITOMETER_MODE_UNKNOWN) {
-            switch (prefix) {
-            case 'p':
-            case 'c':
-            case 'm':
-            case 'y':
-            case 'v':
-            case 'r':
-            case 'g':
-            case 'b':
-                working_reading.mode = DENSITOMETER_MODE_TRANSMISSION;
-                break;
-            case 'P':
-            case 'C':
-            case 'M':
-            case 'Y':
-                working_reading.mode = DENSITOMETER_MODE_REFLECTION;
-                break;
-            default:
-                break;
-            }
-        }
+    densitometer_remote_reset();
+    remote_protocol = NULL;
+    remote_probed = true;
+    remote_attach_count = attach_count;
 
-        /* Assign the reading value based on the prefix */
-        switch (prefix) {
-        case 'p':
-        case 'P':
-        case 'v':
-        case 'V':
-            working_reading.visual = val;
-            break;
-        case 'c':
-        case 'C':
-        case 'r':
-        case 'R':
-            working_reading.red = val;
-            break;
-        case 'm':
-        case 'M':
-        case 'g':
-        case 'G':
-            working_reading.green = val;
-            break;
-        case 'y':
-        case 'Y':
-        case 'b':
-        case 'B':
-            working_reading.blue = val;
-            break;
-        default:
+    for (size_t i = 0; i < sizeof(remote_protocols) / sizeof(densitometer_remote_protocol_t); i++) {
+        const densitometer_remote_protocol_t *protocol = &remote_protocols[i];
+
+        usb_serial_clear_receive_buffer();
+        if (!densitometer_remote_send(protocol->identify_command)) {
             break;
         }
 
-        if (q) {
-            p = q;
-            if (*p == ' ') {
-                p++;
+        const uint32_t start_ticks = osKernelGetTickCount();
+        do {
+            if (usb_serial_receive_line((uint8_t *)line_buf, sizeof(line_buf)) == osOK) {
+                if (strncmp(line_buf, protocol->identify_response, strlen(protocol->identify_response)) == 0) {
+                    log_i("Remote densitometer: %s", protocol->name);
+                    remote_protocol = protocol;
+                    break;
+                }
+            } else {
+                osDelay(10);
             }
-        } else {
+        } while (osKernelGetTickCount() - start_ticks < pdMS_TO_TICKS(REMOTE_PROBE_TIMEOUT_MS));
+
+        if (remote_protocol) {
             break;
         }
-    } while (p && *p != '\0');
-
-    if (!isnanf(working_reading.visual)
-        || !isnanf(working_reading.red)
-        || !isnanf(working_reading.green)
-        || !isnanf(working_reading.blue)) {
-        memcpy(reading, &working_reading, sizeof(densitometer_reading_t));
-        return DENSITOMETER_RESULT_OK;
-    } else {
-        return DENSITOMETER_RESULT_INVALID;
     }
+
+    usb_serial_clear_receive_buffer();
+    return remote_protocol != NULL;
 }
 
-densitometer_result_t densitometer_parse_reading_tobias(densitometer_reading_t *reading, const char *line, size_t len)
+bool densitometer_remote_active()
 {
-    /*
-     * Tobias TBX Data Format
-     *
-     * <sp>DenXY +#.##, 0.00, 0.00, 0.00, 0.00<cr><lf>
-     *
-     * X - Channel:
-     *   A - White (Visual)
-     *   B - Red
-     *   C - Green
-     *   D - Blue
-     *
-     * Y - Format:
-     *   A - Normal   <X>A <ReadD>, 0.00, 0.00, 0.00, 0.00
-     *   R - Relative <X>R <RelD>, <RefD>, <ReadD>, 0.00, 0.00
-     *
-     * Examples:
-     * " DenAA +1.47, 0.00, 0.00, 0.00, 0.00<cr><lf>"
-     * " DenAR +0.31, +1.44, +1.75, 0.00, 0.00<cr><lf>"
-     */
-
-    const char *p = line;
-    char channel = ' ';
-    float val = NAN;
-
-    /* Swallow the leading space */
-    if (*p == ' ') { p++; }
-
-    /* Validate the prefix */
-    if (strncmp(p, "Den", 3) != 0) {
-        return DENSITOMETER_RESULT_INVALID;
-    }
-    p += 3;
+    return remote_probed && remote_protocol
+        && remote_attach_count == usb_serial_get_attach_count();
+}
 
-    /* Collect the channel and format */
-    channel = *p;
-    /* Ignoring format and only collecting the relative value */
-    p += 2;
+void densitometer_remote_reset()
+{
+    remote_pending_head = 0;
+    remote_pending_count = 0;
+}
 
-    /* Parse the next number */
-    val = strtof(p, NULL);
+densitometer_result_t densitometer_request_reading(densitometer_mode_t mode, uint32_t *seq)
+{
+    const char *command;
 
-    /* Validate the number */
-    if (!isnormal(val) && fpclassify(val) != FP_ZERO) {
+    if (!remote_protocol) {
+        return DENSITOMETER_RESULT_INVALID;
+    }
+    if (remote_pending_count >= DENSITOMETER_MAX_PENDING) {
         return DENSITOMETER_RESULT_INVALID;
     }
 
-    /* Clean up zero values */
-    if (fabsf(val) < 0.001F) {
-        val = 0.0F;
+    if (mode == DENSITOMETER_MODE_TRANSMISSION) {
+        command = remote_protocol->transmission_command;
+    } else if (mode == DENSITOMETER_MODE_REFLECTION) {
+        command = remote_protocol->reflection_command;
+    } else {
+        return DENSITOMETER_RESULT_INVALID;
     }
 
-    densitometer_clear_reading(reading);
-    reading->mode = DENSITOMETER_MODE_UNKNOWN;
-    switch (channel) {
-    case 'B':
-        reading->red = val;
-        break;
-    case 'C':
-        reading->green = val;
-        break;
-    case 'D':
-        reading->blue = val;
-        break;
-    case 'A':
-    default:
-        reading->visual = val;
-        break;
+    if (!densitometer_remote_send(command)) {
+        return DENSITOMETER_RESULT_NOT_CONNECTED;
     }
 
+    densitometer_request_t *request =
+        &remote_pending[(remote_pending_head + remote_pending_count) % DENSITOMETER_MAX_PENDING];
+    request->seq = remote_next_seq++;
+    request->ticks = osKernelGetTickCount();
+    remote_pending_count++;
+
+    /* Sequence number zero is reserved for unrequested readings */
+    if (remote_next_seq == 0) {
+        remote_next_seq = 1;
+    }
+
+    if (seq) {
+        *seq = request->seq;
+    }
     return DENSITOMETER_RESULT_OK;
 }
 
-densitometer_result_t densitometer_parse_reading_fallback(densitometer_reading_t *reading, const char *line, size_t len)
+uint8_t densitometer_pending_count()
 {
-    /*
-     * Fallback parser
-     *
-     * This parser simply looks for the first number in the result, attempts
-     * to interpret it, and returns it if it looks like it could be a density
-     * reading.
-     */
-
-    const char *p = line;
-
-    /* Advance until the first digit, sign, or decimal point */
-    while (*p != '\0') {
-        if (isdigit((unsigned char)(*p)) || *p == '-' || *p == '+' || *p == '.') {
-            break;
-        }
-        p++;
-    }
+    densitometer_remote_expire();
+    return remote_pending_count;
+}
 
-    /* Parse the current position as a number */
-    float val = strtof(p, NULL);
+densitometer_result_t densitometer_response_poll(densitometer_reading_t *reading, uint32_t *seq)
+{
+    char line_buf[64];
+    densitometer_result_t result;
 
-    /* Validate the number */
-    if (!isnormal(val) && fpclassify(val) != FP_ZERO) {
+    if (!reading) {
         return DENSITOMETER_RESULT_INVALID;
     }
 
-    /* Permissively range check the number */
-    if (fabsf(val) > 6.0F) {
-        return DENSITOMETER_RESULT_INVALID;
+    if (!usb_serial_is_attached()) {
+        densitometer_remote_reset();
+        return DENSITOMETER_RESULT_NOT_CONNECTED;
     }
 
-    /* Clean up zero values */
-    if (fabsf(val) < 0.001F) {
-        val = 0.0F;
+    densitometer_remote_expire();
+
+    if (usb_serial_receive_line((uint8_t *)line_buf, sizeof(line_buf)) != osOK) {
+        return DENSITOMETER_RESULT_TIMEOUT;
     }
 
-    /* Return as a visual channel reading */
-    densitometer_clear_reading(reading);
-    reading->mode = DENSITOMETER_MODE_UNKNOWN;
-    reading->visual = val;
+    /* Command acknowledgements only matter if they report a failure */
+    if (remote_protocol
+        && strncmp(line_buf, remote_protocol->ack_prefix, strlen(remote_protocol->ack_prefix)) == 0) {
+        if (strstr(line_buf, "ERR")) {
+            log_w("Request failed: \"%s\"", line_buf);
+            densitometer_remote_pop(seq);
+            return DENSITOMETER_RESULT_INVALID;
+        }
+        return DENSITOMETER_RESULT_TIMEOUT;
+    }
 
-    return DENSITOMETER_RESULT_OK;
+    result = densitometer_parse_line(reading, line_buf);
+    if (result == DENSITOMETER_RESULT_OK) {
+        if (!densitometer_remote_pop(seq) && seq) {
+            *seq = 0;
+        }
+    }
+    return result;
 }
 
-densitometer_result_t densitometer_reading_poll(densitometer_reading_t *reading)
+densitometer_result_t densitometer_reading_pull(densitometer_mode_t mode, densitometer_reading_t *reading)
 {
-    char line_buf[64];
+    if (!remote_protocol) {
+        return densitometer_reading_poll(reading);
+    }
 
-    if (!reading) {
-        return DENSITOMETER_RESULT_INVALID;
+    /* Keep the request pipeline full */
+    while (densitometer_pending_count() < DENSITOMETER_MAX_PENDING) {
+        if (densitometer_request_reading(mode, NULL) != DENSITOMETER_RESULT_OK) {
+            break;
+        }
     }
 
-    if (!usb_serial_is_attached()) {
-        return DENSITOMETER_RESULT_NOT_CONNECTED;
+    return densitometer_response_poll(reading, NULL);
+}
+
+bool densitometer_remote_send(const char *command)
+{
+    char buf[32];
+    size_t len = snprintf(buf, sizeof(buf), "%s\r\n", command);
+    if (len >= sizeof(buf)) {
+        return false;
     }
+    return usb_serial_transmit((const uint8_t *)buf, len) == osOK;
+}
 
-    if (usb_serial_receive_line((uint8_t *)line_buf, sizeof(line_buf)) == osOK) {
-        return densitometer_parse_reading(reading, line_buf);
-    } else {
-        return DENSITOMETER_RESULT_TIMEOUT;
+void densitometer_remote_expire()
+{
+    /* Requests are answered in order, so only the oldest can be overdue */
+    while (remote_pending_count > 0) {
+        const densitometer_request_t *request = &remote_pending[remote_pending_head];
+        if (osKernelGetTickCount() - request->ticks < pdMS_TO_TICKS(REMOTE_REQUEST_TIMEOUT_MS)) {
+            break;
+        }
+        log_w("Request %lu timed out", request->seq);
+        densitometer_remote_pop(NULL);
+    }
+}
+
+bool densitometer_remote_pop(uint32_t *seq)
+{
+    if (remote_pending_count == 0) {
+        return false;
+    }
+
+    if (seq) {
+        *seq = remote_pending[remote_pending_head].seq;
     }
+    remote_pending_head = (remote_pending_head + 1) % DENSITOMETER_MAX_PENDING;
+    remote_pending_count--;
+    return true;
 }
 
 void densitometer_log_reading(const densitometer_reading_t *reading)
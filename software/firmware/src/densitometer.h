@@ -6,6 +6,12 @@
 #define DENSITOMETER_H
 
 #include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Maximum number of reading requests that can be outstanding at once
+ */
+#define DENSITOMETER_MAX_PENDING 3
 
 typedef enum {
     DENSITOMETER_MODE_UNKNOWN = 0U,
@@ -47,6 +53,86 @@ typedef enum {
  */
 densitometer_result_t densitometer_reading_poll(densitometer_reading_t *reading);
 
+/**
+ * Check whether the attached densitometer accepts remote commands.
+ *
+ * The first call after a device is attached sends an identification
+ * command to the device and briefly waits for a recognized response,
+ * and the result is remembered until a device is attached again.
+ *
+ * This clears the serial receive buffer.
+ *
+ * @return True if reading requests can be sent to the device
+ */
+bool densitometer_remote_probe();
+
+/**
+ * Check whether readings are being requested from the attached
+ * densitometer, so that they arrive in a continuous stream.
+ *
+ * This reflects the result of the last densitometer_remote_probe()
+ * for the currently attached device, and does not send anything.
+ */
+bool densitometer_remote_active();
+
+/**
+ * Discard any outstanding reading requests.
+ *
+ * This should be called when finished with a sequence of requests,
+ * and should be followed by clearing the serial receive buffer to
+ * discard any responses that are still on the way.
+ */
+void densitometer_remote_reset();
+
+/**
+ * Send a request for a reading to the attached densitometer.
+ *
+ * Up to DENSITOMETER_MAX_PENDING requests may be outstanding at once,
+ * and their responses are collected with densitometer_response_poll().
+ *
+ * @param mode Measurement mode to request
+ * @param seq Set to the sequence number of the request, if not NULL
+ * @return 'DENSITOMETER_RESULT_OK' if the request was sent
+ */
+densitometer_result_t densitometer_request_reading(densitometer_mode_t mode, uint32_t *seq);
+
+/**
+ * Get the number of reading requests that are still outstanding.
+ */
+uint8_t densitometer_pending_count();
+
+/**
+ * Poll for the response to an outstanding reading request.
+ *
+ * Responses are matched to requests in the order that they were sent.
+ * Requests that go unanswered for too long are discarded. A reading
+ * that arrives with no request outstanding, such as from the user
+ * triggering the instrument by hand, is still returned.
+ *
+ * @param reading Latest reading, if one was received.
+ * @param seq Set to the sequence number of the answered request, or
+ *            zero if the reading was not requested
+ * @return 'DENSITOMETER_RESULT_OK' if a reading was received,
+ *         otherwise an appropriate error code
+ */
+densitometer_result_t densitometer_response_poll(densitometer_reading_t *reading, uint32_t *seq);
+
+/**
+ * Poll for a densitometer reading, requesting readings from the device
+ * if it accepts remote commands.
+ *
+ * This keeps the maximum number of requests outstanding, so that new
+ * readings arrive as fast as the instrument can produce them. For a
+ * device that does not accept remote commands, this simply behaves
+ * the same as densitometer_reading_poll().
+ *
+ * @param mode Measurement mode to request
+ * @param reading Latest reading, if one was received.
+ * @return 'DENSITOMETER_RESULT_OK' if a reading was received,
+ *         otherwise an appropriate error code
+ */
+densitometer_result_t densitometer_reading_pull(densitometer_mode_t mode, densitometer_reading_t *reading);
+
 /**
  * Log the provided reading for debugging purposes
  */
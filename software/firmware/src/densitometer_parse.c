@@ -0,0 +1,430 @@
+#include "densitometer_parse.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+
+static void densitometer_clear_reading(densitometer_reading_t *reading);
+static densitometer_result_t densitometer_parse_reading_heiland(densitometer_reading_t *reading, const char *line, size_t len);
+static densitometer_result_t densitometer_parse_reading_xrite(densitometer_reading_t *reading, const char *line, size_t len);
+static densitometer_result_t densitometer_parse_reading_tobias(densitometer_reading_t *reading, const char *line, size_t len);
+static densitometer_result_t densitometer_parse_reading_fallback(densitometer_reading_t *reading, const char *line, size_t len);
+static bool densitometer_match_heiland(const char *line, size_t len);
+static bool densitometer_match_xrite(const char *line, size_t len);
+static bool densitometer_match_tobias(const char *line, size_t len);
+static bool densitometer_match_fallback(const char *line, size_t len);
+
+/**
+ * Output format of a supported densitometer.
+ *
+ * The match function does a quick check of a few characters of the
+ * line, to decide whether it should be handled by the parse function.
+ */
+typedef struct {
+    const char *name;
+    bool (*match)(const char *line, size_t len);
+    densitometer_result_t (*parse)(densitometer_reading_t *reading, const char *line, size_t len);
+} densitometer_format_t;
+
+/* Supported formats, in the order they are checked */
+static const densitometer_format_t reading_formats[] = {
+    { "Heiland", densitometer_match_heiland, densitometer_parse_reading_heiland },
+    { "X-Rite", densitometer_match_xrite, densitometer_parse_reading_xrite },
+    { "Tobias", densitometer_match_tobias, densitometer_parse_reading_tobias },
+    { "Fallback", densitometer_match_fallback, densitometer_parse_reading_fallback }
+};
+
+static const densitometer_format_t *detected_format = NULL;
+
+void densitometer_clear_reading(densitometer_reading_t *reading)
+{
+    if (reading) {
+        reading->mode = DENSITOMETER_MODE_UNKNOWN;
+        reading->visual = NAN;
+        reading->red = NAN;
+        reading->green = NAN;
+        reading->blue = NAN;
+    }
+}
+
+void densitometer_parse_reset()
+{
+    detected_format = NULL;
+}
+
+const char *densitometer_parse_detected_format()
+{
+    return detected_format ? detected_format->name : NULL;
+}
+
+densitometer_result_t densitometer_parse_reading(densitometer_reading_t *reading, const char *line)
+{
+    const size_t len = strlen(line);
+
+    /*
+     * Devices only send readings in one format, so once that format is
+     * known, lines are checked against it before any of the others.
+     */
+    if (detected_format && detected_format->match(line, len)) {
+        return detected_format->parse(reading, line, len);
+    }
+
+    for (size_t i = 0; i < sizeof(reading_formats) / sizeof(densitometer_format_t); i++) {
+        const densitometer_format_t *format = &reading_formats[i];
+        if (!format->match(line, len)) {
+            continue;
+        }
+
+        densitometer_result_t result = format->parse(reading, line, len);
+
+        /* The fallback format matches anything, so is never remembered */
+        if (result == DENSITOMETER_RESULT_OK && format->parse != densitometer_parse_reading_fallback) {
+            detected_format = format;
+        }
+        return result;
+    }
+
+    return DENSITOMETER_RESULT_INVALID;
+}
+
+bool densitometer_match_heiland(const char *line, size_t len)
+{
+    /*
+     * Since the Heiland format is far more rigid, and has a similar prefix
+     * as some X-Rite readings, it is checked first to avoid
+     * misidentification.
+     */
+    return len == 7
+        && (line[0] == 'T' || line[0] == 'R' || line[0] == '0')
+        && (line[1] == '+' || line[1] == '-')
+        && (line[6] == 'D' || line[6] == 'Z' || line[6] == '%');
+}
+
+bool densitometer_match_xrite(const char *line, size_t len)
+{
+    return len >= 4
+        && strchr("VRGBvrgbpcmyPCMY", line[0])
+        && ((line[1] == '-' && line[2] >= '0' && line[2] <= '9')
+            || (line[1] >= '0' && line[1] <= '9'));
+}
+
+bool densitometer_match_tobias(const char *line, size_t len)
+{
+    return (len >= 11 && strncmp(line, "Den", 3) == 0)
+        || (len >= 12 && strncmp(line, " Den", 4) == 0);
+}
+
+bool densitometer_match_fallback(const char *line, size_t len)
+{
+    return true;
+}
+
+densitometer_result_t densitometer_parse_reading_heiland(densitometer_reading_t *reading, const char *line, size_t len)
+{
+    /*
+     * Heiland TRD-2 Data Format
+     *
+     *  Index | Values  | Description
+     * -------+---------+---------------------------------------
+     *      0 | T/R/0   | Transmission/Reflection/StandBy
+     *      1 | +/-     | Sign
+     *      2 | 0...9/. | Value MSB
+     *      3 | 0...9/. | Value
+     *      4 | 0...9/. | Value
+     *      5 | 0...9/. | Value LSB
+     *      6 | D/Z/%   | Density/Zone/Percentage of dot area
+     *      7 | <CR>    | End of string
+     *
+     * Examples:
+     * "T+1.53D<cr>", "R-0.05D<cr>", "T+.278D<cr>", "0+....D<cr>"
+     */
+
+    char num_buf[6];
+    char *end = NULL;
+
+    /* Parse the reading mode */
+    densitometer_mode_t mode = DENSITOMETER_MODE_UNKNOWN;
+    if (line[0] == 'T') {
+        mode = DENSITOMETER_MODE_TRANSMISSION;
+    } else if (line[0] == 'R') {
+        mode = DENSITOMETER_MODE_REFLECTION;
+    } else {
+        return DENSITOMETER_RESULT_INVALID;
+    }
+
+    /* Make sure we are only reading density */
+    if (line[6] != 'D') {
+        return DENSITOMETER_RESULT_INVALID;
+    }
+
+    /* Copy the numeric portion to a separate buffer for parsing */
+    strncpy(num_buf, line + 1, 5);
+    num_buf[5] = '\0';
+
+    /* Parse and validate the number */
+    float val = strtof(num_buf, &end);
+    if (end == num_buf || (!isnormal(val) && fpclassify(val) != FP_ZERO)) {
+        return DENSITOMETER_RESULT_INVALID;
+    }
+
+    /* Clean up zero values */
+    if (fabsf(val) < 0.001F) {
+        val = 0.0F;
+    }
+
+    densitometer_clear_reading(reading);
+    reading->mode = mode;
+    reading->visual = val;
+    return DENSITOMETER_RESULT_OK;
+}
+
+densitometer_result_t densitometer_parse_reading_xrite(densitometer_reading_t *reading, const char *line, size_t len)
+{
+    /*
+     * X-Rite 810 Data Format
+     *
+     * All on one line:
+     * VX.XX<sp>RX.XX<sp>GX.XX<sp>BX.XX<sp>
+     *
+     * Separate lines:
+     * VX.XX<cr>
+     * RX.XX<cr>
+     * GX.XX<cr>
+     * BX.XX<cr>
+     *
+     * Two decimal-point formats:
+     * VX.XX or VXXX
+     *
+     * AIDm:
+     * T: p000, R: P000
+     * T: c004 m008 y000, R: C033 M030 Y033
+     *
+     * AIDa:
+     * T: v000, R: P030
+     * T: r003 g007 b000, R: C033 M030 Y033
+     *
+     */
+
+    densitometer_reading_t working_reading;
+    densitometer_clear_reading(&working_reading);
+
+    const char *p = line;
+    char *q = NULL;
+    do {
+        char prefix = *p;
+        p++;
+        float val = strtof(p, &q);
+
+        /* Check if a valid number was parsed */
+        if (q == p || (!isnormal(val) && fpclassify(val) != FP_ZERO)) {
+            break;
+        }
+
+        /* Check if an implied decimal point needs to be added */
+        if (!memchr(p, '.', q - p)) {
+            val /= 100.0f;
+        }
+
+        /* Clean up zero values */
+        if (fabsf(val) < 0.001F) {
+            val = 0.0F;
+        }
+
+        /* Figure out the reading mode, if indicated by the prefix */
+        if (working_reading.mode == DENSITOMETER_MODE_UNKNOWN) {
+            switch (prefix) {
+            case 'p':
+            case 'c':
+            case 'm':
+            case 'y':
+            case 'v':
+            case 'r':
+            case 'g':
+            case 'b':
+                working_reading.mode = DENSITOMETER_MODE_TRANSMISSION;
+                break;
+            case 'P':
+            case 'C':
+            case 'M':
+            case 'Y':
+                working_reading.mode = DENSITOMETER_MODE_REFLECTION;
+                break;
+            default:
+                break;
+            }
+        }
+
+        /* Assign the reading value based on the prefix */
+        switch (prefix) {
+        case 'p':
+        case 'P':
+        case 'v':
+        case 'V':
+            working_reading.visual = val;
+            break;
+        case 'c':
+        case 'C':
+        case 'r':
+        case 'R':
+            working_reading.red = val;
+            break;
+        case 'm':
+        case 'M':
+        case 'g':
+        case 'G':
+            working_reading.green = val;
+            break;
+        case 'y':
+        case 'Y':
+        case 'b':
+        case 'B':
+            working_reading.blue = val;
+            break;
+        default:
+            break;
+        }
+
+        if (q) {
+            p = q;
+            if (*p == ' ') {
+                p++;
+            }
+        } else {
+            break;
+        }
+    } while (p && *p != '\0');
+
+    if (!isnanf(working_reading.visual)
+        || !isnanf(working_reading.red)
+        || !isnanf(working_reading.green)
+        || !isnanf(working_reading.blue)) {
+        memcpy(reading, &working_reading, sizeof(densitometer_reading_t));
+        return DENSITOMETER_RESULT_OK;
+    } else {
+        return DENSITOMETER_RESULT_INVALID;
+    }
+}
+
+densitometer_result_t densitometer_parse_reading_tobias(densitometer_reading_t *reading, const char *line, size_t len)
+{
+    /*
+     * Tobias TBX Data Format
+     *
+     * <sp>DenXY +#.##, 0.00, 0.00, 0.00, 0.00<cr><lf>
+     *
+     * X - Channel:
+     *   A - White (Visual)
+     *   B - Red
+     *   C - Green
+     *   D - Blue
+     *
+     * Y - Format:
+     *   A - Normal   <X>A <ReadD>, 0.00, 0.00, 0.00, 0.00
+     *   R - Relative <X>R <RelD>, <RefD>, <ReadD>, 0.00, 0.00
+     *
+     * Examples:
+     * " DenAA +1.47, 0.00, 0.00, 0.00, 0.00<cr><lf>"
+     * " DenAR +0.31, +1.44, +1.75, 0.00, 0.00<cr><lf>"
+     */
+
+    const char *p = line;
+    char *end = NULL;
+    char channel = ' ';
+    float val = NAN;
+
+    /* Swallow the leading space */
+    if (*p == ' ') { p++; }
+
+    /* Validate the prefix */
+    if (strncmp(p, "Den", 3) != 0) {
+        return DENSITOMETER_RESULT_INVALID;
+    }
+    p += 3;
+
+    /* Collect the channel and format */
+    channel = *p;
+    /* Ignoring format and only collecting the relative value */
+    p += 2;
+
+    /* Parse the next number */
+    val = strtof(p, &end);
+
+    /* Validate the number */
+    if (end == p || (!isnormal(val) && fpclassify(val) != FP_ZERO)) {
+        return DENSITOMETER_RESULT_INVALID;
+    }
+
+    /* Clean up zero values */
+    if (fabsf(val) < 0.001F) {
+        val = 0.0F;
+    }
+
+    densitometer_clear_reading(reading);
+    reading->mode = DENSITOMETER_MODE_UNKNOWN;
+    switch (channel) {
+    case 'B':
+        reading->red = val;
+        break;
+    case 'C':
+        reading->green = val;
+        break;
+    case 'D':
+        reading->blue = val;
+        break;
+    case 'A':
+    default:
+        reading->visual = val;
+        break;
+    }
+
+    return DENSITOMETER_RESULT_OK;
+}
+
+densitometer_result_t densitometer_parse_reading_fallback(densitometer_reading_t *reading, const char *line, size_t len)
+{
+    /*
+     * Fallback parser
+     *
+     * This parser simply looks for the first number in the result, attempts
+     * to interpret it, and returns it if it looks like it could be a density
+     * reading.
+     */
+
+    const char *p = line;
+
+    /* Advance until the first digit, sign, or decimal point */
+    while (*p != '\0') {
+        if (isdigit((unsigned char)(*p)) || *p == '-' || *p == '+' || *p == '.') {
+            break;
+        }
+        p++;
+    }
+
+    /* Parse the current position as a number */
+    char *end = NULL;
+    float val = strtof(p, &end);
+
+    /* Validate the number, which must be present */
+    if (end == p || (!isnormal(val) && fpclassify(val) != FP_ZERO)) {
+        return DENSITOMETER_RESULT_INVALID;
+    }
+
+    /* Permissively range check the number */
+    if (fabsf(val) > 6.0F) {
+        return DENSITOMETER_RESULT_INVALID;
+    }
+
+    /* Clean up zero values */
+    if (fabsf(val) < 0.001F) {
+        val = 0.0F;
+    }
+
+    /* Return as a visual channel reading */
+    densitometer_clear_reading(reading);
+    reading->mode = DENSITOMETER_MODE_UNKNOWN;
+    reading->visual = val;
+
+    return DENSITOMETER_RESULT_OK;
+}
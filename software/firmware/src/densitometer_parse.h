@@ -0,0 +1,39 @@
+/*
+ * Parsers for the reading formats of supported densitometers.
+ *
+ * Each line received from a densitometer is checked against the known
+ * output formats, and the first one that accepts it is used to parse
+ * the reading. Once a line has been parsed successfully, its format is
+ * remembered and checked first for the lines that follow.
+ *
+ * This code has no dependencies on the HAL or RTOS, so it can also be
+ * compiled and tested on a host system.
+ */
+
+#ifndef DENSITOMETER_PARSE_H
+#define DENSITOMETER_PARSE_H
+
+#include "densitometer.h"
+
+/**
+ * Parse a line received from a densitometer.
+ *
+ * @param reading Set to the parsed reading, if successful
+ * @param line Null-terminated line, without any line break characters
+ * @return 'DENSITOMETER_RESULT_OK' if a reading was parsed, otherwise
+ *         'DENSITOMETER_RESULT_INVALID'
+ */
+densitometer_result_t densitometer_parse_reading(densitometer_reading_t *reading, const char *line);
+
+/**
+ * Forget the remembered format, such as when a different device
+ * may have been attached.
+ */
+void densitometer_parse_reset();
+
+/**
+ * Get the name of the remembered format, or NULL if none is known yet.
+ */
+const char *densitometer_parse_detected_format();
+
+#endif /* DENSITOMETER_PARSE_H */
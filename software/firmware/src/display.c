@@ -1661,6 +1661,24 @@ uint16_t display_selection_list_params(const char *title, uint8_t start_pos, con
     return option;
 }
 
+uint32_t display_selection_list_virtual(const char *title, uint16_t start_pos, uint16_t row_count,
+    display_list_row_callback_t row_callback, void *user_data, display_menu_params_t params)
+{
+    if (!row_callback) { return 0; }
+
+    osMutexAcquire(display_mutex, portMAX_DELAY);
+
+    display_prepare_menu_font();
+    keypad_clear_events();
+
+    uint32_t option = display_UserInterfaceVirtualListCB(&u8g2, title, start_pos, row_count,
+        row_callback, user_data, display_GetMenuEvent, params);
+
+    osMutexRelease(display_mutex);
+
+    return option;
+}
+
 uint8_t display_message_graph(const char *title, const char *list, const char *buttons, const uint8_t *graph_points, size_t graph_size)
 {
     int8_t result = -1;
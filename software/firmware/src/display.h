@@ -125,6 +125,16 @@ typedef struct {
 typedef void (*display_input_value_callback_t)(uint8_t value, void *user_data);
 typedef uint16_t (*display_data_source_callback_t)(uint8_t event_action, void *user_data);
 
+/**
+ * Callback used to fetch the text of a single row of a virtual list.
+ *
+ * @param buf Buffer to write the row text into
+ * @param len Length of the buffer, which is always at least DISPLAY_MENU_ROW_LENGTH + 1
+ * @param row Index of the row to fetch (starts with 0)
+ * @param user_data Pointer passed through from the list call
+ */
+typedef void (*display_list_row_callback_t)(char *buf, size_t len, uint16_t row, void *user_data);
+
 HAL_StatusTypeDef display_init(const u8g2_display_handle_t *display_handle);
 
 void display_clear();
@@ -199,6 +209,30 @@ uint8_t display_selection_list(const char *title, uint8_t start_pos, const char
 uint16_t display_selection_list_params(const char *title, uint8_t start_pos, const char *list,
     display_menu_params_t params);
 
+/**
+ * Display a list of scrollable and selectable options, fetching
+ * only the visible rows on demand.
+ *
+ * Unlike the other list functions, this does not take the list contents
+ * as a single string. Instead, the callback is invoked for each row as
+ * it is drawn, so the memory and time needed to show the list do not
+ * depend on its length.
+ *
+ * @param title The title shown at the top of the list.
+ * @param start_pos The element, which is highlighted first (starts with 1).
+ * @param row_count Number of rows in the list.
+ * @param row_callback Callback used to fetch the text of each visible row.
+ * @param user_data Pointer passed through to the callback.
+ * @param params Bit field with various parameters for the menu behavior.
+ * @return The lower 16 bits contain 1 to n for the item that has been selected.
+ *         Bits 16-23 contain the keycode of the button that was used to
+ *         accept the item.
+ *         If the the menu timed out, then UINT32_MAX is returned.
+ *         If the user pressed the home/cancel button, then 0 is returned.
+ */
+uint32_t display_selection_list_virtual(const char *title, uint16_t start_pos, uint16_t row_count,
+    display_list_row_callback_t row_callback, void *user_data, display_menu_params_t params);
+
 /**
  * Display a list of items, selectable buttons, and a 2D graph of data.
  *
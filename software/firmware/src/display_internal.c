@@ -813,6 +813,125 @@ uint16_t display_UserInterfaceSelectionListCB(u8g2_t *u8g2, const char *title, u
     }
 }
 
+uint32_t display_UserInterfaceVirtualListCB(u8g2_t *u8g2, const char *title, uint16_t start_pos, uint16_t row_count,
+    display_list_row_callback_t row_callback, void *user_data,
+    display_GetMenuEvent_t event_callback, display_menu_params_t params)
+{
+    /*
+     * Works like display_UserInterfaceSelectionListCB(), except that
+     * list rows are fetched from the callback as they are drawn
+     * instead of being located within one large string. This keeps
+     * the cost of each redraw proportional to the number of visible
+     * rows, rather than to the length of the list.
+     */
+
+    char row_buf[DISPLAY_MENU_ROW_LENGTH + 1];
+    uint16_t first_pos = 0;
+    uint16_t current_pos;
+    uint8_t visible;
+    u8g2_uint_t yy;
+
+    u8g2_uint_t line_height = u8g2_GetAscent(u8g2) - u8g2_GetDescent(u8g2) + MY_BORDER_SIZE;
+    u8g2_uint_t list_width = u8g2_GetDisplayWidth(u8g2);
+
+    uint8_t title_lines = u8x8_GetStringLineCnt(title);
+
+    if (title_lines > 0) {
+        visible = (u8g2_GetDisplayHeight(u8g2) - 3) / line_height;
+        visible -= title_lines;
+    } else {
+        visible = u8g2_GetDisplayHeight(u8g2) / line_height;
+    }
+
+    current_pos = (start_pos > 0) ? start_pos - 1 : 0;
+    if (row_count > 0 && current_pos >= row_count) {
+        current_pos = row_count - 1;
+    }
+    if (first_pos + visible <= current_pos) {
+        first_pos = current_pos - visible + 1;
+    }
+
+    u8g2_SetFontPosBaseline(u8g2);
+
+    for(;;) {
+        u8g2_ClearBuffer(u8g2);
+        yy = u8g2_GetAscent(u8g2);
+        if (title_lines > 0) {
+            yy += u8g2_DrawUTF8Lines(u8g2, 0, yy, u8g2_GetDisplayWidth(u8g2), line_height, title);
+            u8g2_DrawHLine(u8g2, 0, yy - line_height - u8g2_GetDescent(u8g2) + 1, u8g2_GetDisplayWidth(u8g2));
+            yy += 3;
+        }
+
+        for (uint8_t i = 0; i < visible; i++) {
+            const uint16_t row = first_pos + i;
+            if (row >= row_count) { break; }
+
+            row_buf[0] = '\0';
+            row_callback(row_buf, sizeof(row_buf), row, user_data);
+            row_buf[sizeof(row_buf) - 1] = '\0';
+
+            const bool is_current = (row == current_pos);
+            u8g2_DrawUTF8Line(u8g2, MY_BORDER_SIZE, yy, list_width - 2 * MY_BORDER_SIZE, row_buf,
+                is_current ? MY_BORDER_SIZE : 0, is_current ? 1 : 0);
+            yy += line_height;
+        }
+        u8g2_SendBuffer(u8g2);
+
+        for(;;) {
+            uint8_t event_action;
+            uint8_t event_keycode;
+
+            if (event_callback) {
+                uint16_t result = event_callback(u8g2_GetU8x8(u8g2), params);
+                if (result == UINT16_MAX) {
+                    return UINT32_MAX;
+                }
+                event_action = (uint8_t)(result & 0x00FF);
+                event_keycode = (uint8_t)((result & 0xFF00) >> 8);
+            } else {
+                event_action = u8x8_GetMenuEvent(u8g2_GetU8x8(u8g2));
+                event_keycode = 0;
+            }
+
+            if (event_action == U8X8_MSG_GPIO_MENU_SELECT) {
+                if (row_count == 0) { continue; }
+                return ((uint32_t)event_keycode << 16) | ((uint32_t)current_pos + 1);
+            }
+            else if (event_action == U8X8_MSG_GPIO_MENU_HOME) {
+                return 0;
+            }
+            else if (event_action == U8X8_MSG_GPIO_MENU_NEXT || event_action == U8X8_MSG_GPIO_MENU_DOWN) {
+                if (row_count == 0) { continue; }
+                /* Move down, wrapping to the top like u8sl_Next() */
+                if (current_pos + 1 >= row_count) {
+                    current_pos = 0;
+                    first_pos = 0;
+                } else {
+                    current_pos++;
+                    if (first_pos + visible <= current_pos) {
+                        first_pos = current_pos - visible + 1;
+                    }
+                }
+                break;
+            }
+            else if (event_action == U8X8_MSG_GPIO_MENU_PREV || event_action == U8X8_MSG_GPIO_MENU_UP) {
+                if (row_count == 0) { continue; }
+                /* Move up, wrapping to the bottom like u8sl_Prev() */
+                if (current_pos == 0) {
+                    current_pos = row_count - 1;
+                    first_pos = (row_count > visible) ? row_count - visible : 0;
+                } else {
+                    current_pos--;
+                    if (first_pos > current_pos) {
+                        first_pos = current_pos;
+                    }
+                }
+                break;
+            }
+        }
+    }
+}
+
 uint8_t display_UserInterfaceMessageCB(u8g2_t *u8g2, const char *title1, const char *title2, const char *title3,
     const char *buttons,
     display_GetMenuEvent_t event_callback, display_menu_params_t params)
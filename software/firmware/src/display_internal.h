@@ -54,6 +54,10 @@ uint8_t display_UserInterfaceInputValueCB(u8g2_t *u8g2, const char *title, const
 uint16_t display_UserInterfaceSelectionListCB(u8g2_t *u8g2, const char *title, uint8_t start_pos, const char *sl,
     display_GetMenuEvent_t event_callback, display_menu_params_t params);
 
+uint32_t display_UserInterfaceVirtualListCB(u8g2_t *u8g2, const char *title, uint16_t start_pos, uint16_t row_count,
+    display_list_row_callback_t row_callback, void *user_data,
+    display_GetMenuEvent_t event_callback, display_menu_params_t params);
+
 uint8_t display_UserInterfaceMessageCB(u8g2_t *u8g2, const char *title1, const char *title2, const char *title3, const char *buttons,
     display_GetMenuEvent_t event_callback, display_menu_params_t params);
 
@@ -10,6 +10,7 @@
 #include <elog.h>
 
 #include "board_config.h"
+#include "trace.h"
 
 /**
  * Sending a complete DMX512 frame takes about 22ms,
@@ -554,6 +555,8 @@ void dmx_send_frame()
 
 void dmx_timer_notify()
 {
+    trace_record(TRACE_EVENT_DMX_TIMER, frame_state, 0);
+
     /* Stop the timer */
     HAL_TIM_OC_Stop_IT(&htim4, TIM_CHANNEL_1);
 
@@ -583,6 +586,8 @@ void dmx_timer_notify()
 
 void dmx_uart_tx_cplt()
 {
+    trace_record(TRACE_EVENT_DMX_TX_CPLT, frame_state, 0);
+
     if (frame_state == DMX_FRAME_DATA) {
         /* Set TX state to high */
         HAL_GPIO_WritePin(DMX512_TX_GPIO_Port, DMX512_TX_Pin, GPIO_PIN_SET);
@@ -23,6 +23,7 @@
 #include "relay.h"
 #include "illum_controller.h"
 #include "dmx.h"
+#include "stats.h"
 #include "util.h"
 
 #define LIGHT_STABLIZE_WAIT_MS       (5000U)
@@ -787,34 +788,23 @@ calibration_result_t calibration_build_timing_profile(const enlarger_control_t *
 
 void calculate_reading_stats(reading_stats_t *stats, uint32_t *readings, size_t len)
 {
-    if (!stats || !readings) { return; }
+    if (!stats) { return; }
 
-    uint32_t reading_min = UINT16_MAX;
-    uint32_t reading_max = 0;
-    float reading_sum = 0;
-
-    for (size_t i = 0; i < len; i++) {
-        reading_sum += readings[i];
-        if (readings[i] > reading_max) {
-            reading_max = readings[i];
-        }
-        if (readings[i] < reading_min) {
-            reading_min = readings[i];
-        }
-    }
-    float reading_mean = reading_sum / len;
-
-    float mean_dist_sum = 0;
-    for (size_t i = 0; i < len; i++) {
-        mean_dist_sum += powf(fabsf(readings[i] - reading_mean), 2);
+    if (!readings || len == 0) {
+        stats->mean = NAN;
+        stats->min = 0;
+        stats->max = 0;
+        stats->stddev = NAN;
+        return;
     }
 
-    float reading_stddev = sqrtf((mean_dist_sum / len));
+    stats_summary_t summary;
+    stats_summary_u32(&summary, readings, len);
 
-    stats->mean = reading_mean;
-    stats->min = reading_min;
-    stats->max = reading_max;
-    stats->stddev = reading_stddev;
+    stats->mean = summary.mean;
+    stats->min = lroundf(summary.min);
+    stats->max = lroundf(summary.max);
+    stats->stddev = summary.stddev;
 }
 
 bool delay_with_cancel(uint32_t time_ms)
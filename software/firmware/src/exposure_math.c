@@ -0,0 +1,151 @@
+#include "exposure_math.h"
+
+#include <math.h>
+
+#define LN2_F    (6.931471806e-01F)  /* ln(2) */
+#define LOG2_10  (3.321928095e+00F)  /* log2(10) */
+#define LOG10_2  (3.010299957e-01F)  /* log10(2) */
+#define INV_LN2  (1.442695041e+00F)  /* 1/ln(2) */
+
+/*
+ * log10(2) split into a high part with only 12 significant bits, so it
+ * can be multiplied by any float exponent without rounding, and a low
+ * part holding the remainder.
+ */
+#define LOG10_2_HI (3.01025390625e-01F)
+#define LOG10_2_LO (4.605038981195e-06F)
+
+/* Number of table entries per octave for the fractional part */
+#define FRAC_BITS  5
+#define FRAC_STEPS (1 << FRAC_BITS)
+
+/* 2^(i/32) for i = [0, 31] */
+static const float exp2_table[FRAC_STEPS] = {
+    1.000000000e+00F, 1.021897149e+00F, 1.044273782e+00F, 1.067140401e+00F,
+    1.090507733e+00F, 1.114386743e+00F, 1.138788635e+00F, 1.163724859e+00F,
+    1.189207115e+00F, 1.215247360e+00F, 1.241857812e+00F, 1.269050957e+00F,
+    1.296839555e+00F, 1.325236643e+00F, 1.354255547e+00F, 1.383909882e+00F,
+    1.414213562e+00F, 1.445180807e+00F, 1.476826146e+00F, 1.509164428e+00F,
+    1.542210825e+00F, 1.575980845e+00F, 1.610490332e+00F, 1.645755478e+00F,
+    1.681792831e+00F, 1.718619298e+00F, 1.756252160e+00F, 1.794709075e+00F,
+    1.834008086e+00F, 1.874167634e+00F, 1.915206561e+00F, 1.957144124e+00F
+};
+
+/* log2(1 + i/32) for i = [0, 32] */
+static const float log2_table[FRAC_STEPS + 1] = {
+    0.000000000e+00F, 4.439411936e-02F, 8.746284125e-02F, 1.292830169e-01F,
+    1.699250014e-01F, 2.094533656e-01F, 2.479275134e-01F, 2.854022189e-01F,
+    3.219280949e-01F, 3.575520046e-01F, 3.923174228e-01F, 4.262647547e-01F,
+    4.594316186e-01F, 4.918530963e-01F, 5.235619561e-01F, 5.545888517e-01F,
+    5.849625007e-01F, 6.147098441e-01F, 6.438561898e-01F, 6.724253420e-01F,
+    7.004397181e-01F, 7.279204546e-01F, 7.548875022e-01F, 7.813597135e-01F,
+    8.073549221e-01F, 8.328900142e-01F, 8.579809951e-01F, 8.826430494e-01F,
+    9.068905956e-01F, 9.307373376e-01F, 9.541963104e-01F, 9.772799235e-01F,
+    1.000000000e+00F
+};
+
+/* 1/(1 + i/32) for i = [0, 32] */
+static const float recip_table[FRAC_STEPS + 1] = {
+    1.000000000e+00F, 9.696969697e-01F, 9.411764706e-01F, 9.142857143e-01F,
+    8.888888889e-01F, 8.648648649e-01F, 8.421052632e-01F, 8.205128205e-01F,
+    8.000000000e-01F, 7.804878049e-01F, 7.619047619e-01F, 7.441860465e-01F,
+    7.272727273e-01F, 7.111111111e-01F, 6.956521739e-01F, 6.808510638e-01F,
+    6.666666667e-01F, 6.530612245e-01F, 6.400000000e-01F, 6.274509804e-01F,
+    6.153846154e-01F, 6.037735849e-01F, 5.925925926e-01F, 5.818181818e-01F,
+    5.714285714e-01F, 5.614035088e-01F, 5.517241379e-01F, 5.423728814e-01F,
+    5.333333333e-01F, 5.245901639e-01F, 5.161290323e-01F, 5.079365079e-01F,
+    5.000000000e-01F
+};
+
+/* 2^(i/12) for i = [0, 11] */
+static const float twelfth_table[12] = {
+    1.000000000e+00F, 1.059463094e+00F, 1.122462048e+00F, 1.189207115e+00F,
+    1.259921050e+00F, 1.334839854e+00F, 1.414213562e+00F, 1.498307077e+00F,
+    1.587401052e+00F, 1.681792831e+00F, 1.781797436e+00F, 1.887748625e+00F
+};
+
+static float exposure_math_log2_mantissa(float x, int *e);
+
+float exposure_math_twelfth_stops(int adjustment)
+{
+    /* Floor division, so negative adjustments use the same table */
+    int octave = adjustment / 12;
+    int step = adjustment % 12;
+    if (step < 0) {
+        step += 12;
+        octave--;
+    }
+    return ldexpf(twelfth_table[step], octave);
+}
+
+float exposure_math_exp2(float x)
+{
+    if (isnan(x)) { return x; }
+    if (x > 128.0F) { return INFINITY; }
+    if (x < -150.0F) { return 0.0F; }
+
+    /*
+     * Split into x = octave + (index / 32) + r, where r is in [0, 1/32),
+     * then correct the table value with a cubic for 2^r = e^(r*ln2).
+     */
+    const float scaled = x * (float)FRAC_STEPS;
+    const float whole = floorf(scaled);
+    const int32_t n = (int32_t)whole;
+    const float t = (scaled - whole) * (LN2_F / (float)FRAC_STEPS);
+    const float poly = 1.0F + t * (1.0F + t * (0.5F + t * (1.0F / 6.0F)));
+
+    return ldexpf(exp2_table[n & (FRAC_STEPS - 1)] * poly, n >> FRAC_BITS);
+}
+
+/**
+ * Split a positive, finite x into m * 2^e, with m in [1, 2), and
+ * calculate log2(m). Keeping the two parts separate lets the callers
+ * add the exponent in with as little rounding as possible.
+ */
+float exposure_math_log2_mantissa(float x, int *e)
+{
+    /*
+     * Find the nearest table entry at or below m and correct with
+     * a quartic for the remaining log2(1 + u), where u is in [0, 1/32).
+     */
+    const float m = frexpf(x, e) * 2.0F;
+    (*e)--;
+
+    const int index = (int)((m - 1.0F) * (float)FRAC_STEPS);
+    const float u = m * recip_table[index] - 1.0F;
+    const float poly = u * (1.0F + u * (-0.5F + u * ((1.0F / 3.0F) + u * -0.25F)));
+
+    return log2_table[index] + (poly * INV_LN2);
+}
+
+float exposure_math_log2(float x)
+{
+    if (isnan(x) || x < 0.0F) { return NAN; }
+    if (x == 0.0F) { return -INFINITY; }
+    if (isinf(x)) { return x; }
+
+    int e;
+    const float frac = exposure_math_log2_mantissa(x, &e);
+    return (float)e + frac;
+}
+
+float exposure_math_exp10(float x)
+{
+    return exposure_math_exp2(x * LOG2_10);
+}
+
+float exposure_math_log10(float x)
+{
+    if (isnan(x) || x < 0.0F) { return NAN; }
+    if (x == 0.0F) { return -INFINITY; }
+    if (isinf(x)) { return x; }
+
+    /*
+     * Scale the exponent and mantissa parts separately, rather than
+     * scaling the complete log2 result, so the rounding error from
+     * adding in the exponent is not carried through to the result.
+     */
+    int e;
+    const float frac = exposure_math_log2_mantissa(x, &e);
+    return ((float)e * LOG10_2_HI) + (((float)e * LOG10_2_LO) + (frac * LOG10_2));
+}
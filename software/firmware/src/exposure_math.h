@@ -0,0 +1,71 @@
+/*
+ * Fast exposure math for stops, PEV and density calculations
+ *
+ * These functions replace the general purpose libm transcendental
+ * functions on the paths that run for every keypress or sensor reading.
+ * Each one splits its argument into an integer part, handled by exponent
+ * manipulation, and a fractional part, handled by a small lookup table
+ * and a short polynomial correction.
+ *
+ * The error bounds given below are for the complete function, including
+ * single-precision rounding, and were measured against double-precision
+ * references for every float in the stated input ranges. The host tests
+ * check the same bounds on a sample of each range.
+ */
+
+#ifndef EXPOSURE_MATH_H
+#define EXPOSURE_MATH_H
+
+#include <stdint.h>
+
+/**
+ * Calculate the exposure time multiplier for an adjustment in 1/12th stops.
+ *
+ * This is a table lookup that matches a correctly rounded 2^(adj/12)
+ * to within 1 ULP (relative error < 1.2e-7) for any adjustment whose
+ * result is a normal float.
+ *
+ * @param adjustment Exposure adjustment, in 1/12th stop units
+ * @return Exposure time multiplier
+ */
+float exposure_math_twelfth_stops(int adjustment);
+
+/**
+ * Calculate 2^x, for an exposure adjustment in stops.
+ *
+ * Relative error is less than 2e-7 (about 2 ULP) for |x| <= 126.
+ * Results outside the float range saturate to 0 or +INF.
+ */
+float exposure_math_exp2(float x);
+
+/**
+ * Calculate log2(x).
+ *
+ * Absolute error is less than 1.2e-6 for x in [1e-6, 1e7], and is
+ * dominated by rounding when the exponent is added to the result.
+ * Zero returns -INF, and negative or NaN inputs return NAN.
+ */
+float exposure_math_log2(float x);
+
+/**
+ * Calculate 10^x, such as for converting density or PEV/100 values
+ * into linear exposure ratios.
+ *
+ * Relative error is less than 1.2e-6 for |x| <= 6, which covers the
+ * 0-500 PEV range and all densities. For a 100 second exposure, that is
+ * a worst case error of 0.12ms, well below the 1ms timer resolution.
+ */
+float exposure_math_exp10(float x);
+
+/**
+ * Calculate log10(x), such as for converting exposures into PEV or
+ * density values.
+ *
+ * Absolute error is less than 4e-7 for x in [1e-6, 1e7]. That is
+ * 0.00004 PEV, which is well below the resolution of any PEV or density
+ * value displayed or stored by the device.
+ * Zero returns -INF, and negative or NaN inputs return NAN.
+ */
+float exposure_math_log10(float x);
+
+#endif /* EXPOSURE_MATH_H */
@@ -8,8 +8,10 @@
 #include <elog.h>
 
 #include "settings.h"
+#include "exposure_math.h"
 #include "util.h"
 #include "paper_profile.h"
+#include "print_job.h"
 
 /**
  * Maximum number of light readings used to calculate exposure
@@ -67,6 +69,7 @@ typedef struct __exposure_state_t {
     int adjustment_increment;
     float lux_readings[MAX_LUX_READINGS];
     int lux_reading_count;
+    meter_scan_t meter_scan;
     float dens_reading_base;
     float dens_reading_current;
     uint32_t calibration_pev;
@@ -92,6 +95,9 @@ static uint32_t exposure_calculate_tone_graph_impl(const exposure_state_t *state
 static uint32_t exposure_calculate_tone_graph_element_impl(float lux_reading,
     const float *tone_graph_marks, float adjusted_time);
 static uint32_t exposure_pev_for_preset(exposure_pev_preset_t preset);
+static bool exposure_get_meter_reading_range(const exposure_state_t *state, float *log_lux_min, float *log_lux_max);
+static bool exposure_calculate_contrast_fit(const exposure_state_t *state, contrast_grade_t contrast_grade,
+    float log_lux_min, float log_lux_max, exposure_contrast_fit_t *fit);
 
 exposure_state_t *exposure_state_create()
 {
@@ -148,6 +154,7 @@ void exposure_state_defaults(exposure_state_t *state)
         state->lux_readings[i] = NAN;
     }
     state->lux_reading_count = 0;
+    meter_scan_init(&state->meter_scan);
     state->dens_reading_base = NAN;
     state->dens_reading_current = NAN;
     state->calibration_pev = 0;
@@ -193,6 +200,7 @@ void exposure_set_mode(exposure_state_t *state, exposure_mode_t mode)
                 state->lux_readings[i] = NAN;
             }
             state->lux_reading_count = 0;
+            meter_scan_init(&state->meter_scan);
         } else if (state->mode == EXPOSURE_MODE_CALIBRATION) {
             /* Clear any burn/dodge adjustments if entering calibration mode */
             if (state->burn_dodge_count > 0) {
@@ -284,7 +292,7 @@ float exposure_base_time_for_calibration_pev(float lux, uint32_t pev)
 {
     float base_time = 0;
     if (isnormal(lux) && lux > 0) {
-        base_time = powf(10, pev / 100.0F) / lux;
+        base_time = exposure_math_exp10(pev / 100.0F) / lux;
     }
     if (base_time < 0.10F) {
         base_time = 0;
@@ -360,9 +368,48 @@ void exposure_clear_meter_readings(exposure_state_t *state)
         state->lux_readings[i] = NAN;
     }
     state->lux_reading_count = 0;
+    meter_scan_init(&state->meter_scan);
     exposure_recalculate(state);
 }
 
+uint32_t exposure_set_meter_scan(exposure_state_t *state, const meter_scan_t *scan)
+{
+    float lux_min;
+    float lux_max;
+
+    if (!state || !scan) { return 0; }
+    if (state->mode != EXPOSURE_MODE_PRINTING_BW && state->mode != EXPOSURE_MODE_PRINTING_COLOR) { return 0; }
+    if (!meter_scan_trimmed_range(scan, &lux_min, &lux_max)) { return 0; }
+
+    for (int i = 0; i < MAX_LUX_READINGS; i++) {
+        state->lux_readings[i] = NAN;
+    }
+
+    /* The scan extremes take the place of individually placed readings */
+    state->lux_readings[0] = lux_min;
+    state->lux_reading_count = 1;
+    if (lux_max > lux_min) {
+        state->lux_readings[1] = lux_max;
+        state->lux_reading_count = 2;
+    }
+    memcpy(&state->meter_scan, scan, sizeof(meter_scan_t));
+
+    exposure_recalculate_base_time(state);
+    exposure_recalculate(state);
+
+    uint32_t tone_elements = 0;
+    for (int i = 0; i < state->lux_reading_count; i++) {
+        tone_elements |= exposure_calculate_tone_graph_element_impl(state->lux_readings[i], state->tone_graph_marks, state->adjusted_time);
+    }
+    return tone_elements;
+}
+
+const meter_scan_t *exposure_get_meter_scan(const exposure_state_t *state)
+{
+    if (!state || state->meter_scan.count == 0) { return NULL; }
+    return &state->meter_scan;
+}
+
 uint32_t exposure_get_tone_graph(const exposure_state_t *state)
 {
     if (!state) { return 0; }
@@ -372,8 +419,7 @@ uint32_t exposure_get_tone_graph(const exposure_state_t *state)
 uint32_t exposure_get_adjusted_tone_graph(const exposure_state_t *state, int adjustment)
 {
     if (!state) { return 0; }
-    float stops = adjustment / 12.0f;
-    float adjusted_time = state->base_time * powf(2.0f, stops);
+    float adjusted_time = state->base_time * exposure_math_twelfth_stops(adjustment);
     return exposure_calculate_tone_graph(state, adjusted_time);
 }
 
@@ -391,11 +437,11 @@ uint32_t exposure_get_burn_dodge_tone_graph(const exposure_state_t *state, const
         float tone_graph_marks[TONE_GRAPH_MARKS_SIZE];
         exposure_recalculate_tone_graph_marks_impl(state, burn_dodge->contrast_grade, tone_graph_marks);
         float stops = (float)burn_dodge->numerator / (float)burn_dodge->denominator;
-        float adjusted_time = state->adjusted_time * powf(2.0f, stops);
+        float adjusted_time = state->adjusted_time * exposure_math_exp2(stops);
         return exposure_calculate_tone_graph_impl(state, tone_graph_marks, adjusted_time);
     } else {
         float stops = (float)burn_dodge->numerator / (float)burn_dodge->denominator;
-        float adjusted_time = state->adjusted_time * powf(2.0f, stops);
+        float adjusted_time = state->adjusted_time * exposure_math_exp2(stops);
         return exposure_calculate_tone_graph(state, adjusted_time);
     }
 }
@@ -511,6 +557,125 @@ void exposure_contrast_decrease(exposure_state_t *state)
     }
 }
 
+bool exposure_get_contrast_fit(const exposure_state_t *state, contrast_grade_t contrast_grade, exposure_contrast_fit_t *fit)
+{
+    float log_lux_min;
+    float log_lux_max;
+
+    if (!state || !fit) { return false; }
+    if (contrast_grade < CONTRAST_GRADE_00 || contrast_grade >= CONTRAST_GRADE_MAX) { return false; }
+    if (!exposure_get_meter_reading_range(state, &log_lux_min, &log_lux_max)) { return false; }
+
+    return exposure_calculate_contrast_fit(state, contrast_grade, log_lux_min, log_lux_max, fit);
+}
+
+bool exposure_solve_contrast_grade(const exposure_state_t *state, exposure_contrast_fit_t *fit)
+{
+    float log_lux_min;
+    float log_lux_max;
+    exposure_contrast_fit_t grade_fit;
+    float best_error = NAN;
+
+    if (!state || !fit) { return false; }
+    if (state->mode != EXPOSURE_MODE_PRINTING_BW) { return false; }
+    if (!exposure_get_meter_reading_range(state, &log_lux_min, &log_lux_max)) { return false; }
+
+    /* A single tone has no range to fit a grade to */
+    if (log_lux_max - log_lux_min < 0.01F) { return false; }
+
+    for (contrast_grade_t grade = CONTRAST_GRADE_00; grade < CONTRAST_GRADE_MAX; grade++) {
+        if (!exposure_calculate_contrast_fit(state, grade, log_lux_min, log_lux_max, &grade_fit)) {
+            continue;
+        }
+
+        /*
+         * The highlight is only off its mark when the time was clamped to
+         * the minimum, so this mostly measures how far the shadow falls
+         * from the grade's Hs. Ties go to the softer grade.
+         */
+        const float error = fabsf(grade_fit.highlight_offset) + fabsf(grade_fit.shadow_offset);
+        if (isnan(best_error) || error < best_error) {
+            best_error = error;
+            memcpy(fit, &grade_fit, sizeof(exposure_contrast_fit_t));
+        }
+    }
+
+    return !isnan(best_error);
+}
+
+bool exposure_solve_split_grade(const exposure_state_t *state, exposure_split_grade_t *split)
+{
+    float log_lux_min;
+    float log_lux_max;
+
+    if (!state || !split) { return false; }
+    if (state->mode != EXPOSURE_MODE_PRINTING_BW) { return false; }
+    if (!exposure_get_meter_reading_range(state, &log_lux_min, &log_lux_max)) { return false; }
+    if (log_lux_max - log_lux_min < 0.01F) { return false; }
+
+    const paper_profile_grade_t *soft = &state->paper_profile.grade[CONTRAST_GRADE_00];
+    const paper_profile_grade_t *hard = &state->paper_profile.grade[CONTRAST_GRADE_5];
+    if (soft->ht_lev100 == 0 || soft->hs_lev100 <= soft->ht_lev100
+        || hard->ht_lev100 == 0 || hard->hs_lev100 <= hard->ht_lev100) {
+        return false;
+    }
+
+    /*
+     * Each pass is treated as contributing its share of the exposure its
+     * own grade needs to reach a given density. The shares must add up
+     * to one for the highlight at Ht, and for the shadow at Hs:
+     *   (t_soft * Lh / Ht_00) + (t_hard * Lh / Ht_5) = 1
+     *   (t_soft * Ls / Hs_00) + (t_hard * Ls / Hs_5) = 1
+     */
+    const float a11 = exposure_math_exp10(log_lux_min - (soft->ht_lev100 / 100.0F));
+    const float a12 = exposure_math_exp10(log_lux_min - (hard->ht_lev100 / 100.0F));
+    const float a21 = exposure_math_exp10(log_lux_max - (soft->hs_lev100 / 100.0F));
+    const float a22 = exposure_math_exp10(log_lux_max - (hard->hs_lev100 / 100.0F));
+    const float det = (a11 * a22) - (a12 * a21);
+
+    float soft_time = NAN;
+    float hard_time = NAN;
+    if (isnormal(det)) {
+        soft_time = (a22 - a12) / det;
+        hard_time = (a11 - a21) / det;
+    }
+
+    /*
+     * A range beyond either end of the paper can only be printed at that
+     * end, so fall back to a single pass that places the highlight.
+     */
+    if (!(hard_time > 0.0F)) {
+        soft_time = 1.0F / a11;
+        hard_time = 0.0F;
+    } else if (!(soft_time > 0.0F)) {
+        soft_time = 0.0F;
+        hard_time = 1.0F / a12;
+    }
+
+    const float adjustment = exposure_math_twelfth_stops(state->adjustment_value);
+    soft_time *= adjustment;
+    hard_time *= adjustment;
+
+    /* Drop any pass too short for the enlarger, and refit the other one */
+    if (state->min_exposure_time > 0.0F) {
+        if (hard_time > 0.0F && hard_time < state->min_exposure_time) {
+            soft_time = adjustment / a11;
+            hard_time = 0.0F;
+        } else if (soft_time > 0.0F && soft_time < state->min_exposure_time) {
+            soft_time = 0.0F;
+            hard_time = adjustment / a12;
+        }
+    }
+
+    if (!is_valid_number(soft_time) || !is_valid_number(hard_time)) {
+        return false;
+    }
+
+    split->soft_time = soft_time;
+    split->hard_time = hard_time;
+    return true;
+}
+
 uint16_t exposure_get_channel_value(const exposure_state_t *state, int index)
 {
     if (!state || index > 2) { return 0; }
@@ -840,8 +1005,7 @@ float exposure_get_test_strip_time_complete(const exposure_state_t *state, int p
     if (!state) { return NAN; }
 
     int patch_adjustment = state->adjustment_increment * patch;
-    float patch_stops = patch_adjustment / 12.0f;
-    float patch_time = state->adjusted_time * powf(2.0f, patch_stops);
+    float patch_time = state->adjusted_time * exposure_math_twelfth_stops(patch_adjustment);
     return patch_time;
 }
 
@@ -853,23 +1017,78 @@ uint32_t exposure_get_test_strip_patch_pev(const exposure_state_t *state, int pa
         && state->lux_reading_count > 0
         && isnormal(state->lux_readings[0]) && state->lux_readings[0] > 0) {
         float patch_time = exposure_get_test_strip_time_complete(state, patch);
-        float calculated_pev = log10f(patch_time * state->lux_readings[0]) * 100.0;
+        float calculated_pev = exposure_math_log10(patch_time * state->lux_readings[0]) * 100.0;
         return (calculated_pev > 0.5) ? lroundf(calculated_pev) : 0;
     } else {
         return 0;
     }
 }
 
+bool exposure_get_print_job(const exposure_state_t *state, print_job_t *job)
+{
+    if (!state || !job) { return false; }
+
+    if (state->mode != EXPOSURE_MODE_PRINTING_BW && state->mode != EXPOSURE_MODE_PRINTING_COLOR) {
+        return false;
+    }
+
+    memset(job, 0, sizeof(print_job_t));
+    job->mode = state->mode;
+    job->base_time = state->base_time;
+    job->adjustment_value = state->adjustment_value;
+    job->adjustment_increment = state->adjustment_increment;
+    job->contrast_grade = state->contrast_grade;
+    for (size_t i = 0; i < 3; i++) {
+        job->channel_values[i] = state->channel_values[i];
+    }
+    for (int i = 0; i < state->burn_dodge_count; i++) {
+        memcpy(&job->burn_dodge_entry[i], &state->burn_dodge_entry[i], sizeof(exposure_burn_dodge_t));
+    }
+    job->burn_dodge_count = state->burn_dodge_count;
+    job->copies = 1;
+
+    return true;
+}
+
+void exposure_set_print_job(exposure_state_t *state, const print_job_t *job)
+{
+    if (!state || !job) { return; }
+
+    exposure_set_mode(state, job->mode);
+
+    state->base_time = job->base_time;
+    state->adjustment_value = job->adjustment_value;
+    state->adjustment_increment = job->adjustment_increment;
+    state->contrast_grade = job->contrast_grade;
+    for (size_t i = 0; i < 3; i++) {
+        state->channel_values[i] = job->channel_values[i];
+    }
+
+    exposure_burn_dodge_delete_all(state);
+    for (int i = 0; i < job->burn_dodge_count && i < EXPOSURE_BURN_DODGE_MAX; i++) {
+        memcpy(&state->burn_dodge_entry[i], &job->burn_dodge_entry[i], sizeof(exposure_burn_dodge_t));
+    }
+    state->burn_dodge_count = MIN(job->burn_dodge_count, EXPOSURE_BURN_DODGE_MAX);
+
+    for (size_t i = 0; i < MAX_LUX_READINGS; i++) {
+        state->lux_readings[i] = NAN;
+    }
+    state->lux_reading_count = 0;
+    meter_scan_init(&state->meter_scan);
+
+    exposure_recalculate_tone_graph_marks(state);
+    exposure_recalculate(state);
+}
+
 void exposure_recalculate(exposure_state_t *state)
 {
-    float stops = state->adjustment_value / 12.0f;
-    state->adjusted_time = state->base_time * powf(2.0f, stops);
+    state->adjusted_time = state->base_time * exposure_math_twelfth_stops(state->adjustment_value);
 
     if (state->mode == EXPOSURE_MODE_PRINTING_BW || state->mode == EXPOSURE_MODE_PRINTING_COLOR) {
         exposure_populate_tone_graph(state);
     } else if (state->mode == EXPOSURE_MODE_CALIBRATION) {
         if (state->lux_reading_count > 0 && isnormal(state->lux_readings[0]) && state->lux_readings[0] > 0) {
-            float calculated_pev = log10f(state->adjusted_time * state->lux_readings[0]) * 100.0;
+            float calculated_pev = exposure_math_log10(state->adjusted_time * state->lux_readings[0]) * 100.0;
             state->calibration_pev = (calculated_pev > 0.5) ? lroundf(calculated_pev) : 0;
         } else {
             state->calibration_pev = 0;
@@ -968,7 +1187,7 @@ void exposure_recalculate_base_time(exposure_state_t *state)
 
     /* Find the target exposure time */
     float ht_lev100 = state->paper_profile.grade[state->contrast_grade].ht_lev100;
-    float target_time = powf(10, ht_lev100 / 100.0F) / lux_value;
+    float target_time = exposure_math_exp10(ht_lev100 / 100.0F) / lux_value;
 
     /* Adjust exposure time if it is too low */
     float min_time = MAX(state->min_exposure_time, EXPOSURE_TIME_CALCULATION_LOWER_BOUND);
@@ -983,6 +1202,55 @@ void exposure_recalculate_base_time(exposure_state_t *state)
     }
 }
 
+bool exposure_get_meter_reading_range(const exposure_state_t *state, float *log_lux_min, float *log_lux_max)
+{
+    float lux_min = NAN;
+    float lux_max = NAN;
+
+    for (int i = 0; i < state->lux_reading_count; i++) {
+        if (isnan(lux_min) || state->lux_readings[i] < lux_min) {
+            lux_min = state->lux_readings[i];
+        }
+        if (isnan(lux_max) || state->lux_readings[i] > lux_max) {
+            lux_max = state->lux_readings[i];
+        }
+    }
+
+    if (!isnormal(lux_min) || lux_min <= 0.0F || !isnormal(lux_max)) {
+        return false;
+    }
+
+    *log_lux_min = exposure_math_log10(lux_min);
+    *log_lux_max = exposure_math_log10(lux_max);
+    return true;
+}
+
+bool exposure_calculate_contrast_fit(const exposure_state_t *state, contrast_grade_t contrast_grade,
+    float log_lux_min, float log_lux_max, exposure_contrast_fit_t *fit)
+{
+    const paper_profile_grade_t *profile_grade = &state->paper_profile.grade[contrast_grade];
+    if (profile_grade->ht_lev100 == 0 || profile_grade->hs_lev100 <= profile_grade->ht_lev100) {
+        return false;
+    }
+
+    const float ht_lev = profile_grade->ht_lev100 / 100.0F;
+    const float hs_lev = profile_grade->hs_lev100 / 100.0F;
+
+    /* Place the highlight at Ht, the same way as exposure_recalculate_base_time() */
+    float log_time = ht_lev - log_lux_min;
+    const float min_time = MAX(state->min_exposure_time, EXPOSURE_TIME_CALCULATION_LOWER_BOUND);
+    const float log_min_time = exposure_math_log10(min_time);
+    if (log_time < log_min_time) {
+        log_time = log_min_time;
+    }
+
+    fit->contrast_grade = contrast_grade;
+    fit->base_time = exposure_math_exp10(log_time);
+    fit->highlight_offset = (log_lux_min + log_time - ht_lev) * 100.0F;
+    fit->shadow_offset = (log_lux_max + log_time - hs_lev) * 100.0F;
+    return true;
+}
+
 void exposure_populate_tone_graph(exposure_state_t *state)
 {
     state->tone_graph = exposure_calculate_tone_graph(state, state->adjusted_time);
@@ -1014,7 +1282,7 @@ uint32_t exposure_calculate_tone_graph_element_impl(float lux_reading, const flo
     }
 
     /* Calculate the log-exposure value for the next reading */
-    float lev_value = log10f(lux_reading * adjusted_time) * 100.0F;
+    float lev_value = exposure_math_log10(lux_reading * adjusted_time) * 100.0F;
 
     if (lev_value < tone_graph_marks[0]) {
         /* Check whether to set the lower-bound mark */
@@ -9,6 +9,7 @@
 #include <stdbool.h>
 
 #include "contrast.h"
+#include "meter_scan.h"
 
 #define EXPOSURE_BURN_DODGE_MAX 9
 
@@ -39,8 +40,34 @@ typedef struct __exposure_adjustment_t {
     uint8_t denominator;
 } exposure_burn_dodge_t;
 
+/**
+ * How well the current light readings fit a particular contrast grade.
+ *
+ * Offsets are in PEV units, and are relative to the grade's Ht and Hs
+ * values from the active paper profile. A negative shadow offset means
+ * the shadows will not reach full density, and a positive one means
+ * shadow detail will be lost.
+ */
+typedef struct {
+    contrast_grade_t contrast_grade;
+    float base_time;        /*!< Base time that places the highlight at Ht */
+    float highlight_offset; /*!< Highlight exposure relative to Ht */
+    float shadow_offset;    /*!< Shadow exposure relative to Hs */
+} exposure_contrast_fit_t;
+
+/**
+ * Exposure pair for split-grade printing, where the print receives one
+ * exposure at the softest grade and another at the hardest grade.
+ */
+typedef struct {
+    float soft_time; /*!< Exposure time at grade 00 */
+    float hard_time; /*!< Exposure time at grade 5 */
+} exposure_split_grade_t;
+
 typedef struct __exposure_state_t exposure_state_t;
 
+typedef struct __print_job_t print_job_t;
+
 #define EXPOSURE_TONE_IS_LOWER_BOUND(x) ((x) & 0x00000001UL)
 #define EXPOSURE_TONE_IS_UPPER_BOUND(x) ((x) & 0x00010000UL)
 #define EXPOSURE_TONE_IS_SET(x, i)      ((x) & (1UL << (i)))
@@ -69,6 +96,27 @@ uint32_t exposure_get_meter_reading_tone(const exposure_state_t *state, float lu
 float exposure_get_lowest_meter_reading(exposure_state_t *state);
 void exposure_clear_meter_readings(exposure_state_t *state);
 
+/**
+ * Replace the current light readings with the results of a scan.
+ *
+ * The lowest and highest readings from the scan, after outliers are
+ * rejected, become the highlight and shadow readings, and the scan
+ * itself is kept so its histogram can be used later. Scans are only
+ * accepted in printing modes, and only if they have enough readings
+ * to reject outliers.
+ *
+ * @return Tone graph elements for the highlight and shadow readings
+ */
+uint32_t exposure_set_meter_scan(exposure_state_t *state, const meter_scan_t *scan);
+
+/**
+ * Get the most recent scan committed to the exposure state.
+ *
+ * @return Scan results, or NULL if there has been no scan since the
+ *         readings were last cleared
+ */
+const meter_scan_t *exposure_get_meter_scan(const exposure_state_t *state);
+
 /*
  * Get the tone graph for the current exposure and readings.
  *
@@ -103,6 +151,46 @@ contrast_grade_t exposure_get_contrast_grade(const exposure_state_t *state);
 void exposure_contrast_increase(exposure_state_t *state);
 void exposure_contrast_decrease(exposure_state_t *state);
 
+/**
+ * Calculate how well the current light readings fit a contrast grade.
+ *
+ * The lowest reading is treated as the highlight and the highest
+ * reading as the shadow, just like for the tone graph.
+ *
+ * @return True if there are readings and the grade has a usable profile
+ */
+bool exposure_get_contrast_fit(const exposure_state_t *state, contrast_grade_t contrast_grade, exposure_contrast_fit_t *fit);
+
+/**
+ * Find the contrast grade that best fits the range of the current
+ * light readings.
+ *
+ * Every grade with a usable profile is evaluated, and the one whose
+ * Ht to Hs range best matches the highlight and shadow readings is
+ * returned along with its base time. This only does a few arithmetic
+ * operations per grade, so it is cheap enough to run on every reading.
+ *
+ * @return True if a grade was found, which requires B&W printing mode
+ *         and at least two readings that are not the same
+ */
+bool exposure_solve_contrast_grade(const exposure_state_t *state, exposure_contrast_fit_t *fit);
+
+/**
+ * Find the grade 00 and grade 5 exposure times that place the lowest
+ * reading at Ht and the highest reading at Hs, using the profiles for
+ * those two grades.
+ *
+ * If the range of the readings is beyond what either grade can cover,
+ * or one of the times would be shorter than the minimum exposure time,
+ * then the result is a single pass at one grade and the other time is
+ * zero. The current exposure adjustment is applied to both times.
+ *
+ * @return True if a solution was found, which requires B&W printing mode,
+ *         at least two readings that are not the same, and usable
+ *         profiles for both grades
+ */
+bool exposure_solve_split_grade(const exposure_state_t *state, exposure_split_grade_t *split);
+
 uint16_t exposure_get_channel_value(const exposure_state_t *state, int index);
 void exposure_set_channel_default_value(exposure_state_t *state, int index, uint16_t value);
 void exposure_channel_increase(exposure_state_t *state, int index, uint8_t amount);
@@ -131,4 +219,19 @@ float exposure_get_test_strip_time_incremental(const exposure_state_t *state,
 float exposure_get_test_strip_time_complete(const exposure_state_t *state, int patch);
 uint32_t exposure_get_test_strip_patch_pev(const exposure_state_t *state, int patch);
 
+/**
+ * Capture the current printing exposure settings into a print job.
+ *
+ * @return True if the current mode supports print jobs
+ */
+bool exposure_get_print_job(const exposure_state_t *state, print_job_t *job);
+
+/**
+ * Replace the current exposure settings with those from a print job.
+ *
+ * Any light readings are cleared, so that the base time from the job
+ * is used as-is.
+ */
+void exposure_set_print_job(exposure_state_t *state, const print_job_t *job);
+
 #endif /* EXPOSURE_STATE_H */
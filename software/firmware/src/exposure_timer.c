@@ -13,8 +13,10 @@
 #include "enlarger_config.h"
 #include "enlarger_control.h"
 #include "buzzer.h"
+#include "keypad.h"
 #include "dmx.h"
 #include "settings.h"
+#include "trace.h"
 #include "util.h"
 
 static TIM_HandleTypeDef *timer_htim = 0;
@@ -25,7 +27,9 @@ static TaskHandle_t timer_task_handle = 0;
 static bool enlarger_activated = false;
 static bool enlarger_deactivated = false;
 static bool enlarger_deactivate_pending = false;
+static bool enlarger_split_switched = false;
 static bool timer_notify_end = false;
+static bool timer_notify_done = false;
 static bool timer_cancel_request = false;
 static exposure_timer_state_t timer_state = EXPOSURE_TIMER_STATE_NONE;
 static uint32_t time_elapsed = 0;
@@ -33,6 +37,11 @@ static uint32_t buzz_start = 0;
 static uint32_t buzz_stop = 0;
 static uint32_t enlarger_on_event_ticks = 0;
 static uint32_t enlarger_off_event_ticks = 0;
+static uint32_t cancel_key_ticks = 0;
+
+static bool exposure_timer_priority_key_callback(keypad_key_t key, bool pressed, TickType_t ticks, void *user_data);
+static bool exposure_timer_countdown_step(uint16_t frequency);
+static void exposure_timer_trace_cancel(bool cancel_flag);
 
 void exposure_timer_init(TIM_HandleTypeDef *htim)
 {
@@ -112,53 +121,41 @@ HAL_StatusTypeDef exposure_timer_run()
             timer_config.enlarger_off_delay, timer_config.exposure_time);
         return HAL_ERROR;
     }
+    if (timer_config.split_time >= timer_config.exposure_time) {
+        log_e("Split time must be within the exposure time: %ld >= %ld",
+            timer_config.split_time, timer_config.exposure_time);
+        return HAL_ERROR;
+    }
 
     timer_task_handle = xTaskGetCurrentTaskHandle();
     enlarger_activated = false;
     enlarger_deactivated = false;
     enlarger_deactivate_pending = false;
+    enlarger_split_switched = false;
     timer_notify_end = false;
+    timer_notify_done = false;
     timer_cancel_request = false;
     timer_state = EXPOSURE_TIMER_STATE_NONE;
     time_elapsed = 0;
     enlarger_on_event_ticks = 0;
     enlarger_off_event_ticks = 0;
+    cancel_key_ticks = 0;
 
     buzzer_volume_t current_volume = buzzer_get_volume();
     uint16_t current_frequency = buzzer_get_frequency();
     buzzer_set_volume(settings_get_buzzer_volume());
 
+    /*
+     * Let cancel key presses bypass the normal keypad event queues, so they
+     * can be acted upon by the timer ISR on its very next tick.
+     */
+    keypad_set_priority_callback(exposure_timer_priority_key_callback, NULL);
+
     if (timer_config.start_tone == EXPOSURE_TIMER_START_TONE_COUNTDOWN) {
         do {
-            buzzer_set_frequency(2000);
-            buzzer_start();
-            osDelay(pdMS_TO_TICKS(50));
-            buzzer_stop();
-            osDelay(pdMS_TO_TICKS(950));
-            if (!timer_config.timer_callback(EXPOSURE_TIMER_STATE_NONE, UINT32_MAX, timer_config.user_data)) {
-                timer_cancel_request = true;
-                break;
-            }
-
-            buzzer_set_frequency(1500);
-            buzzer_start();
-            osDelay(pdMS_TO_TICKS(50));
-            buzzer_stop();
-            osDelay(pdMS_TO_TICKS(950));
-            if (!timer_config.timer_callback(EXPOSURE_TIMER_STATE_NONE, UINT32_MAX, timer_config.user_data)) {
-                timer_cancel_request = true;
-                break;
-            }
-
-            buzzer_set_frequency(500);
-            buzzer_start();
-            osDelay(pdMS_TO_TICKS(50));
-            buzzer_stop();
-            osDelay(pdMS_TO_TICKS(950));
-            if (!timer_config.timer_callback(EXPOSURE_TIMER_STATE_NONE, UINT32_MAX, timer_config.user_data)) {
-                timer_cancel_request = true;
-                break;
-            }
+            if (!exposure_timer_countdown_step(2000)) { break; }
+            if (!exposure_timer_countdown_step(1500)) { break; }
+            if (!exposure_timer_countdown_step(500)) { break; }
         } while (0);
     }
 
@@ -175,6 +172,9 @@ HAL_StatusTypeDef exposure_timer_run()
             dmx_enable_direct_frame_update();
         }
 
+        /* Make sure nothing left over from a previous run can end this one */
+        xTaskNotifyStateClear(NULL);
+
         HAL_TIM_Base_Start_IT(timer_htim);
 
         uint32_t ulNotifiedValue = 0;
@@ -202,6 +202,9 @@ HAL_StatusTypeDef exposure_timer_run()
             }
         }
 
+        /* The exposure is over, so a late cancel press must not change its result */
+        keypad_set_priority_callback(NULL, NULL);
+
         if (enlarger_control.dmx_control) {
             osDelay(30);
             dmx_start();
@@ -214,6 +217,11 @@ HAL_StatusTypeDef exposure_timer_run()
         log_d("Actual enlarger on/off time: %lums",
             (enlarger_off_event_ticks - enlarger_on_event_ticks) / portTICK_RATE_MS);
 
+        if (cancel_key_ticks > 0 && enlarger_off_event_ticks >= cancel_key_ticks) {
+            log_i("Cancel key to enlarger off latency: %lums",
+                (enlarger_off_event_ticks - cancel_key_ticks) / portTICK_RATE_MS);
+        }
+
         /* Handling the completion beep outside the ISR for simplicity. */
         if (timer_cancel_request) {
             buzzer_set_frequency(1000);
@@ -246,28 +254,92 @@ HAL_StatusTypeDef exposure_timer_run()
             }
         }
         osDelay(pdMS_TO_TICKS(500));
+    } else {
+        keypad_set_priority_callback(NULL, NULL);
     }
+
     buzzer_set_volume(current_volume);
     buzzer_set_frequency(current_frequency);
 
     return timer_cancel_request ? HAL_TIMEOUT : HAL_OK;
 }
 
+bool exposure_timer_countdown_step(uint16_t frequency)
+{
+    buzzer_set_frequency(frequency);
+    buzzer_start();
+    osDelay(pdMS_TO_TICKS(50));
+    buzzer_stop();
+    osDelay(pdMS_TO_TICKS(950));
+    if (timer_cancel_request) {
+        return false;
+    }
+    if (!timer_config.timer_callback(EXPOSURE_TIMER_STATE_NONE, UINT32_MAX, timer_config.user_data)) {
+        timer_cancel_request = true;
+        return false;
+    }
+    return true;
+}
+
+bool exposure_timer_priority_key_callback(keypad_key_t key, bool pressed, TickType_t ticks, void *user_data)
+{
+    if (key == KEYPAD_CANCEL && pressed) {
+        taskENTER_CRITICAL();
+        if (!timer_cancel_request) {
+            timer_cancel_request = true;
+            cancel_key_ticks = ticks;
+        }
+        taskEXIT_CRITICAL();
+        return true;
+    }
+    return false;
+}
+
+void exposure_timer_trace_cancel(bool cancel_flag)
+{
+    if (cancel_flag && cancel_key_ticks > 0) {
+        trace_record(TRACE_EVENT_EXPOSURE_CANCEL, 0,
+            (uint16_t)MIN(enlarger_off_event_ticks - cancel_key_ticks, UINT16_MAX));
+    }
+}
+
 void exposure_timer_notify()
 {
     if (!timer_htim || timer_config.exposure_time == 0) { return; }
 
+    trace_record(TRACE_EVENT_EXPOSURE_TICK, timer_state, (uint16_t)(time_elapsed / 10));
+
     bool cancel_flag = timer_cancel_request;
 
     /*
      * If we are in the DONE state, then make sure this is the last
-     * time we enter this function
+     * time we enter this function, and that the task is only ever
+     * notified of completion once.
      */
     if (timer_state == EXPOSURE_TIMER_STATE_DONE) {
         HAL_TIM_Base_Stop_IT(timer_htim);
+        if (!timer_notify_done) {
+            timer_notify_done = true;
+            uint32_t notify_value = ((uint32_t)EXPOSURE_TIMER_STATE_DONE << 24);
+            xTaskNotifyFromISR(timer_task_handle, notify_value, eSetValueWithOverwrite, NULL);
+        }
+        return;
     }
 
-    if (!enlarger_activated) {
+    if (!enlarger_activated && cancel_flag) {
+        /*
+         * Canceled before the enlarger was ever turned on, which can happen
+         * with a fast-path cancel during the safelight off delay.
+         */
+        HAL_TIM_Base_Stop_IT(timer_htim);
+        enlarger_activated = true;
+        enlarger_deactivated = true;
+        timer_state = EXPOSURE_TIMER_STATE_DONE;
+        timer_notify_done = true;
+        uint32_t notify_value = ((uint32_t)EXPOSURE_TIMER_STATE_DONE << 24);
+        xTaskNotifyFromISR(timer_task_handle, notify_value, eSetValueWithOverwrite, NULL);
+        return;
+    } else if (!enlarger_activated) {
         enlarger_on_event_ticks = osKernelGetTickCount();
         enlarger_control_set_state(&enlarger_control,
             ENLARGER_CONTROL_STATE_EXPOSURE, timer_config.contrast_grade,
@@ -280,6 +352,22 @@ void exposure_timer_notify()
     } else {
         time_elapsed += 10;
 
+        /*
+         * Switch to the second grade of a split-grade exposure. With DMX,
+         * this only updates the frame, which goes out with the next
+         * periodic frame below. Those are sent every 30ms, so the first
+         * grade can run up to 30ms past the split time.
+         */
+        if (timer_config.split_time > 0 && !enlarger_split_switched
+            && !enlarger_deactivated && !enlarger_deactivate_pending && !cancel_flag
+            && time_elapsed >= timer_config.enlarger_on_delay + timer_config.split_time) {
+            enlarger_control_set_state(&enlarger_control,
+                ENLARGER_CONTROL_STATE_EXPOSURE, timer_config.split_contrast_grade,
+                timer_config.channel_red, timer_config.channel_green, timer_config.channel_blue,
+                false);
+            enlarger_split_switched = true;
+        }
+
         if (!enlarger_deactivated && !enlarger_deactivate_pending
             && ((time_elapsed >= timer_config.enlarger_on_delay + (timer_config.exposure_time - timer_config.enlarger_off_delay)) || cancel_flag)) {
             if (enlarger_control.dmx_control) {
@@ -288,6 +376,7 @@ void exposure_timer_notify()
                 enlarger_control_set_state_off(&enlarger_control, false);
                 enlarger_off_event_ticks = osKernelGetTickCount();
                 enlarger_deactivated = true;
+                exposure_timer_trace_cancel(cancel_flag);
             }
         }
 
@@ -300,6 +389,7 @@ void exposure_timer_notify()
                 enlarger_off_event_ticks = osKernelGetTickCount();
                 enlarger_deactivate_pending = false;
                 enlarger_deactivated = true;
+                exposure_timer_trace_cancel(cancel_flag);
             }
         }
     }
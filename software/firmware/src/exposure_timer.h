@@ -66,6 +66,17 @@ typedef struct {
     /* Blue channel value, if RGB-capable and contrast grade is unset */
     uint16_t channel_blue;
 
+    /*
+     * Time into the exposure at which to switch to the second contrast
+     * grade, for split-grade exposures on enlargers with contrast control.
+     * Set to zero for a normal single-grade exposure. With DMX, the
+     * switch takes effect with the next 30ms frame. (ms)
+     */
+    uint32_t split_time;
+
+    /* The contrast grade to switch to at the split time */
+    contrast_grade_t split_contrast_grade;
+
     /* Callback function to be invoked at the specified rate */
     exposure_timer_callback_t timer_callback;
 
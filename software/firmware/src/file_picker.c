@@ -1,7 +1,10 @@
 #include "file_picker.h"
 
+#include <FreeRTOS.h>
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ff.h>
 
 #define LOG_TAG "file_picker"
@@ -10,7 +13,6 @@
 #include "display.h"
 #include "util.h"
 #include "main_menu.h"
-#include "utarray.h"
 #include "bsdlib.h"
 #include "usb_msc_fatfs.h"
 
@@ -23,24 +25,82 @@ typedef struct {
 typedef struct {
     BYTE fattrib;
     TCHAR altname[13];
-    uint8_t option;
+    uint16_t option;
 } file_picker_selection_t;
 
+/*
+ * Directory listings are never held in memory in full. Instead, a
+ * window of entries is kept in sorted order, and the directory is read
+ * again whenever the list scrolls outside of that window.
+ *
+ * Each window is filled by a single pass over the directory, which
+ * keeps the entries that sort immediately after the last entry before
+ * the window. The first pass also counts the directory. Along the way,
+ * the last entry before every Nth row is recorded, so that moving the
+ * window only needs a small number of passes from the nearest recorded
+ * row, rather than one for every window ahead of it.
+ *
+ * Consecutive windows overlap, so that a full screen of rows can
+ * always be drawn from a single window without thrashing between
+ * neighboring windows.
+ */
+#define FILE_PICKER_WINDOW_SIZE    32
+#define FILE_PICKER_WINDOW_OVERLAP 8
+#define FILE_PICKER_SEEK_SLOTS     32
+
+/*
+ * The most recent listing is retained for each drive, so that reopening
+ * the picker does not need to re-read the directory. A retained listing
+ * is only reused if the drive has not been remounted or written to
+ * since it was read.
+ */
+#define FILE_PICKER_CACHE_SLOTS    2
+#define FILE_PICKER_PATH_LEN       128
+
+typedef struct {
+    uint8_t drive;
+    char path[FILE_PICKER_PATH_LEN];
+    file_picker_filter_func_t filter_func;
+    uint32_t generation;
+    uint32_t stamp;
+    bool valid;
+    uint16_t total;
+    uint16_t seek_stride; /*!< Number of rows between recorded entries */
+    uint32_t seek_valid;  /*!< Bit mask of the recorded entries */
+    file_picker_entry_t seek_key[FILE_PICKER_SEEK_SLOTS]; /*!< Last entry before each stride of rows */
+    uint16_t base;
+    uint16_t count;
+    file_picker_entry_t entries[FILE_PICKER_WINDOW_SIZE];
+} file_picker_listing_t;
+
+typedef struct {
+    file_picker_listing_t *listing;
+    const char *path;
+    file_picker_filter_func_t filter_func;
+} file_picker_context_t;
+
+static file_picker_listing_t *listing_cache[FILE_PICKER_CACHE_SLOTS] = {0};
+static uint32_t listing_cache_stamp = 0;
+
 static uint8_t mounted_drive_count();
 static menu_result_t drive_selection_impl(const char *title, uint8_t *num);
-static menu_result_t file_picker_impl(const char *title, const char *path, uint8_t option, file_picker_selection_t *selection, file_picker_filter_func_t filter_func);
+static menu_result_t file_picker_impl(const char *title, const char *path, uint16_t option, file_picker_selection_t *selection, file_picker_filter_func_t filter_func);
+static void file_picker_row_callback(char *buf, size_t len, uint16_t row, void *user_data);
+static file_picker_listing_t *file_picker_listing_acquire(const char *path, file_picker_filter_func_t filter_func, bool *cache_hit);
+static const file_picker_entry_t *file_picker_listing_row(file_picker_context_t *context, uint16_t row);
+static bool file_picker_read_directory(file_picker_context_t *context);
+static bool file_picker_load_window(file_picker_context_t *context, uint16_t base);
+static bool file_picker_scan(file_picker_context_t *context, const file_picker_entry_t *after, uint16_t limit, uint16_t *total);
+static void file_picker_record_keys(file_picker_listing_t *listing);
+static FRESULT file_picker_dir_read(DIR *dir, FILINFO *fno, file_picker_filter_func_t filter_func);
 static void build_file_list_entry(file_picker_entry_t *entry, const FILINFO *fno);
 static int file_entry_sort(const void *a, const void *b);
 
-static UT_icd file_picker_entry_icd = {
-    sizeof(file_picker_entry_t), NULL, NULL, NULL
-};
-
 menu_result_t file_picker_show(const char *title, char *filepath, size_t len, file_picker_filter_func_t filter_func)
 {
     menu_result_t result;
     file_picker_selection_t selection;
-    uint8_t option_list[32];
+    uint16_t option_list[32];
     char path_buf[512];
     size_t path_len = 0;
     size_t name_len;
@@ -69,7 +129,7 @@ menu_result_t file_picker_show(const char *title, char *filepath, size_t len, fi
         result = file_picker_impl(title, path_buf, option_list[option_index], &selection, filter_func);
         if (result == MENU_OK) {
             name_len = strlen(selection.altname);
-            if (path_len + name_len + 1 > sizeof(path_buf) - 1 || option_index > sizeof(option_list) - 1) {
+            if (path_len + name_len + 1 > sizeof(path_buf) - 1 || option_index > (sizeof(option_list) / sizeof(uint16_t)) - 1) {
                 log_w("Path too long");
                 continue;
             }
@@ -192,102 +252,371 @@ menu_result_t drive_selection_impl(const char *title, uint8_t *num)
     return menu_result;
 }
 
-menu_result_t file_picker_impl(const char *title, const char *path, uint8_t option, file_picker_selection_t *selection, file_picker_filter_func_t filter_func)
+menu_result_t file_picker_impl(const char *title, const char *path, uint16_t option, file_picker_selection_t *selection, file_picker_filter_func_t filter_func)
 {
     menu_result_t menu_result = MENU_CANCEL;
-    FRESULT res;
-    DIR dir;
-    FILINFO fno;
-    file_picker_entry_t file_entry;
-    UT_array *file_entry_list = NULL;
-    file_picker_entry_t *p;
-    char *list_buf = NULL;
-    size_t list_size = 0;
-    size_t offset = 0;
+    file_picker_context_t context;
+    const file_picker_entry_t *p;
+    bool cache_hit = false;
+    uint32_t result;
 
     log_i("Preparing file picker");
 
-    res = f_opendir(&dir, path);
-    if (res == FR_OK) {
-        utarray_new(file_entry_list, &file_picker_entry_icd);
-        if (!file_entry_list) {
+    context.listing = file_picker_listing_acquire(path, filter_func, &cache_hit);
+    context.path = path;
+    context.filter_func = filter_func;
+    if (!context.listing) {
+        return menu_result;
+    }
+
+    if (!cache_hit) {
+        display_static_list(title, "\n\nReading directory...");
+        if (!file_picker_read_directory(&context)) {
             return menu_result;
         }
+        if (context.listing->generation != 0 && strlen(path) < FILE_PICKER_PATH_LEN) {
+            context.listing->valid = true;
+        }
+    } else {
+        log_d("Using cached listing");
+    }
 
-        for (;;) {
-            res = f_readdir(&dir, &fno);
-            if (res != FR_OK || fno.fname[0] == 0) break;
-            if (fno.fattrib & AM_HID) { continue; }
-            if (filter_func) {
-                if (!filter_func(&fno)) { continue; }
-            }
-            build_file_list_entry(&file_entry, &fno);
-            utarray_push_back(file_entry_list, &file_entry);
-            if (utarray_has_oom(file_entry_list)) {
+    if (option == 0 || option > context.listing->total) {
+        option = 1;
+    }
+
+    log_i("Showing picker");
+    result = display_selection_list_virtual(title, option, context.listing->total,
+        file_picker_row_callback, &context, DISPLAY_MENU_ACCEPT_MENU);
+    if (result == 0) {
+        menu_result = MENU_CANCEL;
+    } else if (result == UINT32_MAX) {
+        menu_result = MENU_TIMEOUT;
+    } else {
+        option = (uint16_t)(result & 0xFFFF);
+        p = file_picker_listing_row(&context, option - 1);
+        if (p && selection) {
+            selection->fattrib = p->fattrib;
+            strncpy(selection->altname, p->altname, 13);
+            selection->option = option;
+            menu_result = MENU_OK;
+        } else {
+            menu_result = MENU_CANCEL;
+        }
+    }
+
+    return menu_result;
+}
+
+void file_picker_row_callback(char *buf, size_t len, uint16_t row, void *user_data)
+{
+    file_picker_context_t *context = user_data;
+    const file_picker_entry_t *entry = file_picker_listing_row(context, row);
+    if (entry) {
+        strncpy(buf, entry->list_entry, len);
+    }
+}
+
+file_picker_listing_t *file_picker_listing_acquire(const char *path, file_picker_filter_func_t filter_func, bool *cache_hit)
+{
+    const uint8_t drive = path[0] - '0';
+    file_picker_listing_t *listing = NULL;
+    uint8_t i;
+
+    /*
+     * The generation changes whenever the drive is mounted or written
+     * to, which catches renames and edits that leave the volume
+     * looking otherwise unchanged, without any device access.
+     */
+    const uint32_t generation = usbh_msc_drive_generation(drive);
+
+    /* Find the slot belonging to this drive, if there is one */
+    for (i = 0; i < FILE_PICKER_CACHE_SLOTS; i++) {
+        if (listing_cache[i] && listing_cache[i]->drive == drive) {
+            listing = listing_cache[i];
+            break;
+        }
+    }
+
+    if (listing && listing->valid && generation != 0
+        && listing->generation == generation
+        && listing->filter_func == filter_func
+        && strcmp(listing->path, path) == 0) {
+        listing->stamp = ++listing_cache_stamp;
+        *cache_hit = true;
+        return listing;
+    }
+
+    /* Otherwise use an empty slot, or replace the least recently used */
+    if (!listing) {
+        for (i = 0; i < FILE_PICKER_CACHE_SLOTS; i++) {
+            if (!listing_cache[i]) {
+                listing_cache[i] = pvPortMalloc(sizeof(file_picker_listing_t));
+                if (!listing_cache[i]) {
+                    log_e("Unable to allocate memory for file listing");
+                    return NULL;
+                }
+                listing = listing_cache[i];
                 break;
             }
+            if (!listing || listing_cache[i]->stamp < listing->stamp) {
+                listing = listing_cache[i];
+            }
         }
-        f_closedir(&dir);
+    }
+
+    memset(listing, 0, sizeof(file_picker_listing_t));
+    listing->drive = drive;
+    strncpy(listing->path, path, sizeof(listing->path) - 1);
+    listing->filter_func = filter_func;
+    listing->generation = generation;
+    listing->stamp = ++listing_cache_stamp;
+
+    *cache_hit = false;
+    return listing;
+}
 
-        utarray_sort(file_entry_list, file_entry_sort);
+const file_picker_entry_t *file_picker_listing_row(file_picker_context_t *context, uint16_t row)
+{
+    file_picker_listing_t *listing = context->listing;
+    uint16_t base;
+
+    if (row >= listing->total) {
+        return NULL;
     }
 
-    if (!file_entry_list) {
-        return menu_result;
+    if (row >= listing->base && row < listing->base + listing->count) {
+        return &listing->entries[row - listing->base];
     }
 
     /*
-     * Until the whole u8g2 selection list implementation is rewritten,
-     * we have to cap the length of the file list at an 8-bit row count.
-     * Whenever that changes, the entire way this list is generated should
-     * change to more efficiently support long lists.
+     * Place the new window so that it also covers the rows just behind
+     * the requested one, in the direction the list is moving.
      */
-    list_size = utarray_len(file_entry_list);
-    if (list_size > UINT8_MAX - 2) {
-        list_size = UINT8_MAX - 2;
+    if (row >= listing->base + listing->count) {
+        base = (row > FILE_PICKER_WINDOW_OVERLAP) ? row - FILE_PICKER_WINDOW_OVERLAP : 0;
+    } else if (row + FILE_PICKER_WINDOW_OVERLAP + 1 > FILE_PICKER_WINDOW_SIZE) {
+        base = row + FILE_PICKER_WINDOW_OVERLAP + 1 - FILE_PICKER_WINDOW_SIZE;
+    } else {
+        base = 0;
     }
 
-    if (option == 0 || option > list_size) {
-        option = 1;
+    if (file_picker_load_window(context, base)
+        && row >= listing->base && row < listing->base + listing->count) {
+        return &listing->entries[row - listing->base];
     }
 
-    list_buf = pvPortMalloc(list_size * (DISPLAY_MENU_ROW_LENGTH + 1));
-    if (!list_buf) {
-        log_e("Unable to allocate list buffer");
-        utarray_free(file_entry_list);
-        return menu_result;
-    }
+    log_w("Unable to load row %d", row);
+    listing->valid = false;
+    return NULL;
+}
 
-    p = NULL;
-    while ((p = (file_picker_entry_t*)utarray_next(file_entry_list, p))) {
-        strncpy(list_buf + offset, p->list_entry, DISPLAY_MENU_ROW_LENGTH);
-        offset += DISPLAY_MENU_ROW_LENGTH;
-        list_buf[offset++] = '\n';
+/**
+ * Count the directory and load its first window of entries.
+ */
+bool file_picker_read_directory(file_picker_context_t *context)
+{
+    file_picker_listing_t *listing = context->listing;
+
+    listing->base = 0;
+    if (!file_picker_scan(context, NULL, FILE_PICKER_WINDOW_SIZE, &listing->total)) {
+        listing->valid = false;
+        return false;
     }
-    if (offset > 0) {
-        list_buf[offset - 1] = '\0';
+
+    /* Spread the recorded entries evenly across the whole directory */
+    const uint32_t span = FILE_PICKER_WINDOW_SIZE * FILE_PICKER_SEEK_SLOTS;
+    listing->seek_stride = FILE_PICKER_WINDOW_SIZE * ((listing->total + span - 1) / span);
+    if (listing->seek_stride == 0) {
+        listing->seek_stride = FILE_PICKER_WINDOW_SIZE;
     }
+    listing->seek_valid = 0;
+    file_picker_record_keys(listing);
 
-    log_i("Showing picker");
-    option = display_selection_list(title, option, list_buf);
-    if (option == 0) {
-        menu_result = MENU_CANCEL;
-    } else if (option == UINT8_MAX) {
-        menu_result = MENU_TIMEOUT;
+    log_d("Directory read: total=%d, stride=%d", listing->total, listing->seek_stride);
+    return true;
+}
+
+/**
+ * Load the window of entries starting at a specific row.
+ *
+ * The window is reached from the closest earlier row whose preceding
+ * entry is known, with one pass over the directory for each window's
+ * worth of rows in between.
+ */
+bool file_picker_load_window(file_picker_context_t *context, uint16_t base)
+{
+    file_picker_listing_t *listing = context->listing;
+    file_picker_entry_t after;
+    bool has_after;
+    uint16_t row;
+
+    if (listing->count > 0 && base > listing->base && base <= listing->base + listing->count) {
+        /* The entry before the window is in the current window */
+        after = listing->entries[base - listing->base - 1];
+        has_after = true;
+        row = base;
     } else {
-        p = utarray_eltptr(file_entry_list, option - 1);
-        if (p && selection) {
-            selection->fattrib = p->fattrib;
-            strncpy(selection->altname, p->altname, 13);
-            selection->option = option;
+        uint16_t slot = base / listing->seek_stride;
+        if (slot >= FILE_PICKER_SEEK_SLOTS) {
+            slot = FILE_PICKER_SEEK_SLOTS - 1;
         }
-        menu_result = MENU_OK;
+        while (slot > 0 && !(listing->seek_valid & (1UL << slot))) {
+            slot--;
+        }
+        has_after = (slot > 0);
+        if (has_after) {
+            after = listing->seek_key[slot];
+        }
+        row = slot * listing->seek_stride;
     }
 
-    vPortFree(list_buf);
-    utarray_free(file_entry_list);
+    log_d("Directory window: base=%d, start=%d", base, row);
 
-    return menu_result;
+    for (;;) {
+        const uint16_t limit = (base - row > FILE_PICKER_WINDOW_SIZE || base == row)
+            ? FILE_PICKER_WINDOW_SIZE : base - row;
+
+        listing->base = row;
+        if (!file_picker_scan(context, has_after ? &after : NULL, limit, NULL)) {
+            return false;
+        }
+        file_picker_record_keys(listing);
+
+        if (row == base) {
+            break;
+        }
+
+        /* A short pass means the directory no longer matches the count */
+        if (listing->count < limit) {
+            listing->count = 0;
+            return false;
+        }
+        after = listing->entries[limit - 1];
+        has_after = true;
+        row += limit;
+    }
+
+    return true;
+}
+
+/**
+ * Make a pass over the directory, keeping the entries that sort
+ * immediately after a given entry, in sorted order.
+ *
+ * @param after Entry that all kept entries must sort after, or NULL to start from the first entry
+ * @param limit Number of entries to keep, up to the window size
+ * @param total Set to the number of listed entries in the directory, or NULL if not needed
+ * @return True if successful, false if the directory could not be read
+ */
+bool file_picker_scan(file_picker_context_t *context, const file_picker_entry_t *after, uint16_t limit, uint16_t *total)
+{
+    file_picker_listing_t *listing = context->listing;
+    file_picker_entry_t entry;
+    FRESULT res;
+    DIR dir;
+    FILINFO fno;
+    uint16_t count = 0;
+
+    listing->count = 0;
+
+    res = f_opendir(&dir, context->path);
+    if (res != FR_OK) {
+        log_w("Unable to open directory: %d", res);
+        return false;
+    }
+
+    for (;;) {
+        res = file_picker_dir_read(&dir, &fno, context->filter_func);
+        if (res != FR_OK || fno.fname[0] == 0) {
+            break;
+        }
+
+        /*
+         * The list is drawn through a row callback, so its length is only
+         * limited by the 16-bit row index of the list widget.
+         */
+        if (total) {
+            if (count == UINT16_MAX - 1) {
+                break;
+            }
+            count++;
+        }
+
+        build_file_list_entry(&entry, &fno);
+        if (after && file_entry_sort(&entry, after) <= 0) {
+            continue;
+        }
+        if (listing->count == limit && file_entry_sort(&entry, &listing->entries[limit - 1]) >= 0) {
+            continue;
+        }
+
+        /* Insert the entry in order, dropping the last one if the window is full */
+        uint16_t lo = 0;
+        uint16_t hi = listing->count;
+        while (lo < hi) {
+            const uint16_t mid = (lo + hi) / 2;
+            if (file_entry_sort(&entry, &listing->entries[mid]) < 0) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        if (listing->count < limit) {
+            listing->count++;
+        }
+        memmove(&listing->entries[lo + 1], &listing->entries[lo],
+            sizeof(file_picker_entry_t) * (listing->count - lo - 1));
+        listing->entries[lo] = entry;
+    }
+    f_closedir(&dir);
+
+    if (res != FR_OK) {
+        log_w("Unable to read directory: %d", res);
+        listing->count = 0;
+        return false;
+    }
+
+    if (total) {
+        *total = count;
+    }
+    return true;
+}
+
+/**
+ * Record the last entry before each stride of rows that falls within
+ * the current window.
+ */
+void file_picker_record_keys(file_picker_listing_t *listing)
+{
+    for (uint16_t i = 1; i <= listing->count; i++) {
+        const uint32_t row = (uint32_t)listing->base + i;
+        if (row % listing->seek_stride != 0) { continue; }
+
+        const uint32_t slot = row / listing->seek_stride;
+        if (slot >= FILE_PICKER_SEEK_SLOTS) { break; }
+
+        listing->seek_key[slot] = listing->entries[i - 1];
+        listing->seek_valid |= (1UL << slot);
+    }
+}
+
+/**
+ * Read the next directory entry that should be listed, skipping any
+ * hidden entries and any rejected by the filter.
+ * An empty name is returned at the end of the directory.
+ */
+FRESULT file_picker_dir_read(DIR *dir, FILINFO *fno, file_picker_filter_func_t filter_func)
+{
+    FRESULT res;
+    for (;;) {
+        res = f_readdir(dir, fno);
+        if (res != FR_OK || fno->fname[0] == 0) { break; }
+        if (fno->fattrib & AM_HID) { continue; }
+        if (filter_func && !filter_func(fno)) { continue; }
+        break;
+    }
+    return res;
 }
 
 void build_file_list_entry(file_picker_entry_t *entry, const FILINFO *fno)
@@ -345,6 +674,8 @@ int file_entry_sort(const void *a, const void *b) {
         /* Try sorting on the non-truncated portion of the display name */
         strxfrm(sort_buf1, entry1->list_entry, sizeof(sort_buf1));
         strxfrm(sort_buf2, entry2->list_entry, sizeof(sort_buf2));
+        sort_buf1[sizeof(sort_buf1) - 1] = '\0';
+        sort_buf2[sizeof(sort_buf2) - 1] = '\0';
         result = strcmp(sort_buf1, sort_buf2);
         if (result == 0) {
             /* As a last resort, sort on the altname */
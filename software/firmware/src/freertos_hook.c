@@ -5,6 +5,7 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "util.h"
+#include "trace.h"
 
 void vApplicationMallocFailedHook(void)
 {
@@ -23,3 +24,8 @@ void vApplicationStackOverflowHook(xTaskHandle pxTask, char *pcTaskName)
     __ASM volatile("BKPT #01");
     while (1) { }
 }
+
+void vApplicationTickHook(void)
+{
+    trace_tick();
+}
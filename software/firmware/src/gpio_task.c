@@ -11,6 +11,12 @@
 
 #include "board_config.h"
 #include "keypad.h"
+#include "trace.h"
+
+typedef struct {
+    uint16_t gpio_pin;
+    uint32_t ticks;
+} gpio_event_t;
 
 static osMessageQueueId_t gpio_event_queue = NULL;
 static const osMessageQueueAttr_t gpio_event_queue_attributes = {
@@ -21,11 +27,11 @@ static const osMessageQueueAttr_t gpio_event_queue_attributes = {
 void gpio_task_run(void *argument)
 {
     osSemaphoreId_t task_start_semaphore = argument;
-    uint16_t gpio_pin;
+    gpio_event_t gpio_event;
 
     log_d("gpio_task start");
 
-    gpio_event_queue = osMessageQueueNew(16, sizeof(uint16_t), &gpio_event_queue_attributes);
+    gpio_event_queue = osMessageQueueNew(16, sizeof(gpio_event_t), &gpio_event_queue_attributes);
     if (!gpio_event_queue) {
         log_e("Unable to create GPIO event queue");
         return;
@@ -39,18 +45,18 @@ void gpio_task_run(void *argument)
 
     /* Start the GPIO interrupt handling event loop */
     for (;;) {
-        if(osMessageQueueGet(gpio_event_queue, &gpio_pin, NULL, portMAX_DELAY) == osOK) {
-            if(gpio_pin == KEY_INT_Pin) {
+        if(osMessageQueueGet(gpio_event_queue, &gpio_event, NULL, portMAX_DELAY) == osOK) {
+            if(gpio_event.gpio_pin == KEY_INT_Pin) {
                 /* Keypad controller interrupt */
-                keypad_int_event_handler();
-            } else if (gpio_pin == ENC_CH1_Pin) {
+                keypad_int_event_handler(gpio_event.ticks);
+            } else if (gpio_event.gpio_pin == ENC_CH1_Pin) {
                 /* Encoder counter interrupt, counter-clockwise rotation */
                 keypad_event_t keypad_event = {
                     .key = KEYPAD_ENCODER_CCW,
                     .pressed = true
                 };
                 keypad_inject_event(&keypad_event);
-            } else if (gpio_pin == ENC_CH2_Pin) {
+            } else if (gpio_event.gpio_pin == ENC_CH2_Pin) {
                 /* Encoder counter interrupt, clockwise rotation */
                 keypad_event_t keypad_event = {
                     .key = KEYPAD_ENCODER_CW,
@@ -58,7 +64,7 @@ void gpio_task_run(void *argument)
                 };
                 keypad_inject_event(&keypad_event);
             } else {
-                log_i("GPIO[%d] interrupt", gpio_pin);
+                log_i("GPIO[%d] interrupt", gpio_event.gpio_pin);
             }
         }
     }
@@ -66,6 +72,11 @@ void gpio_task_run(void *argument)
 
 void gpio_task_notify_gpio_int(uint16_t gpio_pin)
 {
-    osMessageQueuePut(gpio_event_queue, &gpio_pin, 0, 0);
+    gpio_event_t gpio_event = {
+        .gpio_pin = gpio_pin,
+        .ticks = osKernelGetTickCount()
+    };
+    trace_record(TRACE_EVENT_GPIO_INT, 0, gpio_pin);
+    osMessageQueuePut(gpio_event_queue, &gpio_event, 0, 0);
 }
 
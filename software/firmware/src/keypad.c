@@ -17,6 +17,7 @@
 #include <usb_hid.h>
 
 #include "tca8418.h"
+#include "trace.h"
 #include "util.h"
 
 #define KEYPAD_INDEX_MAX       14
@@ -29,6 +30,7 @@ typedef struct {
     bool pressed;
     TickType_t ticks;
     bool repeated;
+    bool consumed;
 } keypad_raw_event_t;
 
 /* Handle to I2C peripheral used by the keypad controller */
@@ -74,6 +76,15 @@ static keypad_blackout_callback_t blackout_callback = NULL;
 /* User data for the blackout callback */
 static void *blackout_callback_user_data = NULL;
 
+/* Callback for key events that bypass the normal event queues */
+static keypad_priority_callback_t priority_callback = NULL;
+
+/* User data for the priority callback */
+static void *priority_callback_user_data = NULL;
+
+/* Keys whose press was consumed by the priority callback */
+static uint16_t consumed_state = 0;
+
 /* Current blackout state */
 static bool blackout_state = false;
 
@@ -82,7 +93,7 @@ static bool keypad_initialized = false;
 
 static HAL_StatusTypeDef keypad_controller_init();
 static void keypad_task_loop();
-static void keypad_handle_key_event(uint8_t keycode, bool pressed, TickType_t ticks);
+static void keypad_handle_key_event(uint8_t keycode, bool pressed, bool consumed, TickType_t ticks);
 static void keypad_handle_key_repeat(uint8_t keycode, TickType_t ticks);
 static void keypad_button_repeat_timer_callback(TimerHandle_t xTimer);
 static uint8_t keypad_keycode_to_index(keypad_key_t keycode);
@@ -149,6 +160,7 @@ void task_keypad_run(void *argument)
 
     /* Clear the button state */
     button_state = 0;
+    consumed_state = 0;
 
     /* Create the timer to handle key repeat events */
     button_repeat_timer = xTimerCreate(
@@ -282,7 +294,7 @@ void keypad_task_loop()
             }
 
             if (!raw_event.repeated) {
-                keypad_handle_key_event(raw_event.keycode, raw_event.pressed, raw_event.ticks);
+                keypad_handle_key_event(raw_event.keycode, raw_event.pressed, raw_event.consumed, raw_event.ticks);
             } else {
                 keypad_handle_key_repeat(raw_event.keycode, raw_event.ticks);
             }
@@ -301,13 +313,22 @@ void keypad_set_blackout_callback(keypad_blackout_callback_t callback, void *use
     }
 }
 
+void keypad_set_priority_callback(keypad_priority_callback_t callback, void *user_data)
+{
+    taskENTER_CRITICAL();
+    priority_callback = callback;
+    priority_callback_user_data = user_data;
+    taskEXIT_CRITICAL();
+}
+
 HAL_StatusTypeDef keypad_inject_raw_event(keypad_key_t keycode, bool pressed, TickType_t ticks)
 {
     keypad_raw_event_t raw_event = {
         .keycode = keycode,
         .pressed = pressed,
         .ticks = ticks,
-        .repeated = false
+        .repeated = false,
+        .consumed = false
     };
     osStatus_t ret = osMessageQueuePut(keypad_raw_event_queue, &raw_event, 0, 0);
     return os_to_hal_status(ret);
@@ -408,10 +429,9 @@ HAL_StatusTypeDef keypad_wait_for_event(keypad_event_t *event, int msecs_to_wait
     return ret;
 }
 
-HAL_StatusTypeDef keypad_int_event_handler()
+HAL_StatusTypeDef keypad_int_event_handler(TickType_t ticks)
 {
     HAL_StatusTypeDef ret = HAL_OK;
-    TickType_t ticks = xTaskGetTickCount();
 
     if (!keypad_initialized) {
         return ret;
@@ -461,6 +481,19 @@ HAL_StatusTypeDef keypad_int_event_handler()
                 break;
             }
 
+            /*
+             * Give the priority callback the first look at the event,
+             * before it goes through the normal event queues.
+             */
+            bool consumed = false;
+            taskENTER_CRITICAL();
+            keypad_priority_callback_t callback = priority_callback;
+            void *callback_user_data = priority_callback_user_data;
+            taskEXIT_CRITICAL();
+            if (callback) {
+                consumed = callback(keycode, pressed, ticks, callback_user_data);
+            }
+
             /*
              * Send the raw event to the queue used by the keypad
              * event processing task
@@ -469,7 +502,8 @@ HAL_StatusTypeDef keypad_int_event_handler()
                 .keycode = keycode,
                 .pressed = pressed,
                 .ticks = ticks,
-                .repeated = false
+                .repeated = false,
+                .consumed = consumed
             };
             osMessageQueuePut(keypad_raw_event_queue, &raw_event, 0, 0);
 
@@ -501,7 +535,7 @@ HAL_StatusTypeDef keypad_int_event_handler()
     return ret;
 }
 
-void keypad_handle_key_event(uint8_t keycode, bool pressed, TickType_t ticks)
+void keypad_handle_key_event(uint8_t keycode, bool pressed, bool consumed, TickType_t ticks)
 {
     /* Update the button state information */
     uint8_t index = keypad_keycode_to_index(keycode);
@@ -512,6 +546,21 @@ void keypad_handle_key_event(uint8_t keycode, bool pressed, TickType_t ticks)
         } else {
             button_state &= ~mask;
         }
+
+        /*
+         * If the press was consumed by the priority callback, then
+         * suppress all events for the key until it is released.
+         */
+        if (pressed && consumed) {
+            consumed_state |= mask;
+        }
+        if (consumed_state & mask) {
+            if (!pressed) {
+                consumed_state &= ~mask;
+            }
+            log_d("Key event: key=%d, pressed=%d, state=%04X (consumed)", keycode, pressed, button_state);
+            return;
+        }
     }
 
     /* Handle keys that can repeat */
@@ -544,6 +593,7 @@ void keypad_handle_key_event(uint8_t keycode, bool pressed, TickType_t ticks)
         .keypad_state = button_state
     };
     log_d("Key event: key=%d, pressed=%d, state=%04X", keycode, pressed, button_state);
+    trace_record(TRACE_EVENT_KEYPAD, keycode, pressed ? 0x01 : 0x00);
 
     osMutexAcquire(keypad_event_mutex, portMAX_DELAY);
     osMessageQueuePut(keypad_event_queue, &keypad_event, 0, 0);
@@ -557,7 +607,7 @@ void keypad_handle_key_repeat(uint8_t keycode, TickType_t ticks)
      * it is not.
      */
     int index = keypad_keycode_to_index(keycode);
-    if (index < KEYPAD_INDEX_MAX && !(button_state & (1 << index))) {
+    if (index < KEYPAD_INDEX_MAX && (!(button_state & (1 << index)) || (consumed_state & (1 << index)))) {
         xTimerStop(button_repeat_timer, portMAX_DELAY);
         return;
     }
@@ -579,6 +629,7 @@ void keypad_handle_key_repeat(uint8_t keycode, TickType_t ticks)
         .keypad_state = button_state
     };
     log_d("Key event: key=%d, pressed=1, state=%04X (repeat)", keycode, button_state);
+    trace_record(TRACE_EVENT_KEYPAD, keycode, 0x03);
 
     osMutexAcquire(keypad_event_mutex, portMAX_DELAY);
     osMessageQueuePut(keypad_event_queue, &keypad_event, 0, 0);
@@ -594,7 +645,8 @@ void keypad_button_repeat_timer_callback(TimerHandle_t xTimer)
         .keycode = (uint16_t)keycode_id,
         .pressed = true,
         .ticks = ticks,
-        .repeated = true
+        .repeated = true,
+        .consumed = false
     };
 
     osMessageQueuePut(keypad_raw_event_queue, &raw_event, 0, 0);
@@ -45,6 +45,21 @@ typedef struct {
 
 typedef void (*keypad_blackout_callback_t)(bool enabled, void *user_data);
 
+/**
+ * Callback for keys that need to bypass the normal event queues.
+ *
+ * This is invoked from the keypad interrupt handler, in the context of the
+ * GPIO task, as soon as a key event has been read from the controller.
+ * It must not block.
+ *
+ * @param key The key code
+ * @param pressed True if the key was pressed, false if released
+ * @param ticks Tick count at the time of the keypad interrupt
+ * @return True if a key press was consumed, in which case no further events
+ *         will be generated for that key until it has been released.
+ */
+typedef bool (*keypad_priority_callback_t)(keypad_key_t key, bool pressed, TickType_t ticks, void *user_data);
+
 /**
  * Initialize keypad hardware configuration.
  *
@@ -64,6 +79,14 @@ void task_keypad_run(void *argument);
  */
 void keypad_set_blackout_callback(keypad_blackout_callback_t callback, void *user_data);
 
+/**
+ * Set the function to be called for key events ahead of the normal queues.
+ *
+ * This is intended for time-critical handling, such as canceling a running
+ * exposure, and should be cleared as soon as it is no longer needed.
+ */
+void keypad_set_priority_callback(keypad_priority_callback_t callback, void *user_data);
+
 /**
  * Enable handling of meter probe button events
  *
@@ -90,6 +113,11 @@ char keypad_usb_get_ascii(const keypad_event_t *event);
 uint8_t keypad_usb_get_keycode(const keypad_event_t *event);
 keypad_key_t keypad_usb_get_keypad_equivalent(const keypad_event_t *event);
 
-HAL_StatusTypeDef keypad_int_event_handler();
+/**
+ * Handle an interrupt from the keypad controller.
+ *
+ * @param ticks Tick count at the time the interrupt was raised
+ */
+HAL_StatusTypeDef keypad_int_event_handler(TickType_t ticks);
 
 #endif /* KEYPAD_H */
@@ -14,6 +14,7 @@
 #include "main_task.h"
 #include "gpio_task.h"
 #include "dmx.h"
+#include "trace.h"
 
 CRC_HandleTypeDef hcrc;
 
@@ -631,6 +632,9 @@ int main(void)
     /* Initialize the MPU */
     mpu_config();
 
+    /* Start the event trace timestamp counter */
+    trace_init();
+
 #ifdef USE_SEGGER_RTT
     SEGGER_RTT_ConfigUpBuffer(0, NULL, NULL, 0, SEGGER_RTT_MODE_NO_BLOCK_SKIP);
 #endif
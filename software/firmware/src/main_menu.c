@@ -20,6 +20,7 @@
 #include "menu_enlarger.h"
 #include "menu_safelight.h"
 #include "menu_paper.h"
+#include "menu_print_job.h"
 #include "menu_step_wedge.h"
 #include "menu_import_export.h"
 #include "menu_meter_probe.h"
@@ -42,6 +43,7 @@ menu_result_t main_menu_start(state_controller_t *controller)
                 "Enlarger Configuration\n"
                 "Safelight Configuration\n"
                 "Paper Profiles\n"
+                "Print Jobs\n"
                 "Step Wedge Properties\n"
                 "Import / Export\n"
                 "Meter Probe\n"
@@ -59,23 +61,25 @@ menu_result_t main_menu_start(state_controller_t *controller)
         } else if (option == 4) {
             menu_result = menu_paper_profiles(controller);
         } else if (option == 5) {
-            menu_result = menu_step_wedge();
+            menu_result = menu_print_jobs(controller);
         } else if (option == 6) {
-            menu_result = menu_import_export(controller);
+            menu_result = menu_step_wedge();
         } else if (option == 7) {
-            menu_result = menu_meter_probe();
+            menu_result = menu_import_export(controller);
         } else if (option == 8) {
-            menu_result = menu_densistick();
+            menu_result = menu_meter_probe();
         } else if (option == 9) {
-            menu_result = menu_diagnostics();
+            menu_result = menu_densistick();
         } else if (option == 10) {
-            menu_result = menu_firmware();
+            menu_result = menu_diagnostics();
         } else if (option == 11) {
+            menu_result = menu_firmware();
+        } else if (option == 12) {
             menu_result = menu_about();
         } else if (option == UINT8_MAX) {
             menu_result = MENU_TIMEOUT;
         }
-    } while (option > 0 && menu_result != MENU_TIMEOUT);
+    } while (option > 0 && menu_result != MENU_TIMEOUT && menu_result != MENU_EXIT);
 
     return menu_result;
 }
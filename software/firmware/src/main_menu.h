@@ -10,6 +10,7 @@ typedef enum {
     MENU_CANCEL = 1,
     MENU_SAVE = 3,
     MENU_DELETE = 4,
+    MENU_EXIT = 5,
     MENU_TIMEOUT = 99
 } menu_result_t;
 
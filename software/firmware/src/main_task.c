@@ -42,12 +42,19 @@ extern TIM_HandleTypeDef htim10;
 
 static void main_task_run(void *argument);
 static void main_task_startup_log();
+static void main_task_init_graph_run();
+static void main_task_init_worker_run(void *argument);
+static void main_task_init_stage_run(uint8_t stage, osSemaphoreId_t semaphore);
+static void main_task_settings_init();
 static void main_task_display_init();
+static void main_task_display_config();
 static void main_task_led_init();
+static void main_task_encoder_init();
 static void main_task_buzzer_init();
 static void main_task_relay_init();
 static void main_task_exposure_timer_init();
 static void main_task_keypad_init();
+static void main_task_usb_host_init();
 static void main_task_enable_interrupts();
 static void main_task_disable_interrupts();
 extern void deinit_peripherals();
@@ -70,6 +77,13 @@ static const osSemaphoreAttr_t task_start_semaphore_attributes = {
 #define TASK_DMX_STACK_SIZE         (2048U)
 #define TASK_METER_PROBE_STACK_SIZE (2048U)
 
+/* Indices into the task list */
+#define TASK_INDEX_GPIO        1
+#define TASK_INDEX_KEYPAD      2
+#define TASK_INDEX_DMX         3
+#define TASK_INDEX_METER_PROBE 4
+#define TASK_INDEX_DENSISTICK  5
+
 static task_params_t task_list[] = {
     {
         .task_func = main_task_run,
@@ -121,6 +135,132 @@ static task_params_t task_list[] = {
     }
 };
 
+/**
+ * Startup stages, which are run in parallel as soon as all of their
+ * dependencies have finished.
+ */
+typedef enum {
+    INIT_SETTINGS = 0,
+    INIT_DISPLAY,
+    INIT_DISPLAY_CONFIG,
+    INIT_LED,
+    INIT_ENCODER,
+    INIT_BUZZER,
+    INIT_RELAY,
+    INIT_EXPOSURE_TIMER,
+    INIT_KEYPAD,
+    INIT_TASK_GPIO,
+    INIT_TASK_KEYPAD,
+    INIT_TASK_DMX,
+    INIT_USB_HOST,
+    INIT_TASK_METER_PROBE,
+    INIT_TASK_DENSISTICK,
+    INIT_STAGE_COUNT
+} init_stage_t;
+
+#define INIT_DEP(x) (1UL << (x))
+#define INIT_ALL_STAGES ((1UL << INIT_STAGE_COUNT) - 1UL)
+
+typedef struct {
+    const char *name;
+    void (*init_func)();
+    uint8_t task_index;
+    uint32_t depends;
+} init_stage_def_t;
+
+/*
+ * Each stage either calls an initialization function, or creates one of
+ * the tasks from the task list and waits for it to report that it has
+ * started. Stages that share a bus will still serialize on that bus,
+ * so the dependencies here only need to capture the required ordering.
+ */
+static const init_stage_def_t init_stages[INIT_STAGE_COUNT] = {
+    [INIT_SETTINGS] = {
+        .name = "settings",
+        .init_func = main_task_settings_init
+    },
+    [INIT_DISPLAY] = {
+        .name = "display",
+        .init_func = main_task_display_init
+    },
+    [INIT_DISPLAY_CONFIG] = {
+        .name = "logo",
+        .init_func = main_task_display_config,
+        .depends = INIT_DEP(INIT_DISPLAY) | INIT_DEP(INIT_SETTINGS)
+    },
+    [INIT_LED] = {
+        .name = "led",
+        .init_func = main_task_led_init,
+        .depends = INIT_DEP(INIT_SETTINGS)
+    },
+    [INIT_ENCODER] = {
+        .name = "encoder",
+        .init_func = main_task_encoder_init
+    },
+    [INIT_BUZZER] = {
+        .name = "buzzer",
+        .init_func = main_task_buzzer_init
+    },
+    [INIT_RELAY] = {
+        .name = "relay",
+        .init_func = main_task_relay_init
+    },
+    [INIT_EXPOSURE_TIMER] = {
+        .name = "timer",
+        .init_func = main_task_exposure_timer_init
+    },
+    [INIT_KEYPAD] = {
+        .name = "keypad",
+        .init_func = main_task_keypad_init
+    },
+    [INIT_TASK_GPIO] = {
+        .name = "gpio_task",
+        .task_index = TASK_INDEX_GPIO,
+        .depends = INIT_DEP(INIT_KEYPAD) | INIT_DEP(INIT_ENCODER) | INIT_DEP(INIT_EXPOSURE_TIMER)
+    },
+    [INIT_TASK_KEYPAD] = {
+        .name = "keypad_task",
+        .task_index = TASK_INDEX_KEYPAD,
+        .depends = INIT_DEP(INIT_KEYPAD) | INIT_DEP(INIT_BUZZER) | INIT_DEP(INIT_SETTINGS)
+    },
+    [INIT_TASK_DMX] = {
+        .name = "dmx_task",
+        .task_index = TASK_INDEX_DMX
+    },
+    [INIT_USB_HOST] = {
+        .name = "usb_host",
+        .init_func = main_task_usb_host_init,
+        .depends = INIT_DEP(INIT_TASK_KEYPAD)
+    },
+    [INIT_TASK_METER_PROBE] = {
+        .name = "probe_task",
+        .task_index = TASK_INDEX_METER_PROBE,
+        .depends = INIT_DEP(INIT_USB_HOST)
+    },
+    [INIT_TASK_DENSISTICK] = {
+        .name = "stick_task",
+        .task_index = TASK_INDEX_DENSISTICK,
+        .depends = INIT_DEP(INIT_USB_HOST)
+    }
+};
+
+#define INIT_WORKER_COUNT      2
+#define INIT_WORKER_STACK_SIZE (4096U)
+
+static const osThreadAttr_t init_worker_attributes = {
+    .name = "init_worker",
+    .stack_size = INIT_WORKER_STACK_SIZE,
+    .priority = osPriorityNormal
+};
+
+static osMessageQueueId_t init_stage_queue = NULL;
+static osEventFlagsId_t init_stage_flags = NULL;
+static volatile uint32_t logo_ticks = 0;
+
+/* Boot timeline, with an extra entry for the overall startup time */
+#define BOOT_TIMELINE_TOTAL INIT_STAGE_COUNT
+static main_task_boot_stage_t boot_timeline[INIT_STAGE_COUNT + 1] = {0};
+
 static osMutexId_t i2c1_mutex;
 static const osMutexAttr_t i2c1_mutex_attributes = {
     .name = "i2c1_mutex",
@@ -162,73 +302,23 @@ bool task_main_is_running()
 void main_task_run(void *argument)
 {
     UNUSED(argument);
-    const uint8_t task_count = sizeof(task_list) / sizeof(task_params_t);
-    uint32_t logo_ticks = 0;
+
+    boot_timeline[BOOT_TIMELINE_TOTAL].name = "total";
+    boot_timeline[BOOT_TIMELINE_TOTAL].start_ticks = HAL_GetTick();
 
     log_d("main_task start");
 
     /* Print various startup log messages */
     main_task_startup_log();
 
-    /*
-     * All hardware that does not have dedicated management tasks,
-     * or which has initialization functions that need to be called
-     * prior to task startup, is handled here.
-     */
-
-    /* Initialize the system settings */
-    settings_init(&hi2c1, i2c1_mutex);
-
-    /* Initialize the illumination controller */
+    /* Initialize the illumination controller, which most stages query */
     illum_controller_init();
 
-    /* Initialize the display */
-    main_task_display_init();
-    display_draw_logo();
-    logo_ticks = osKernelGetTickCount();
-
-    /* Initialize the LED driver */
-    main_task_led_init();
-
-    /* Rotary encoder */
-    HAL_TIM_Encoder_Start_IT(&htim1, TIM_CHANNEL_ALL);
-
-    /* Piezo buzzer */
-    main_task_buzzer_init();
-
-    /* Relay driver */
-    main_task_relay_init();
-
-    /* Countdown timer init */
-    main_task_exposure_timer_init();
-
-    /* Keypad hardware configuration */
-    main_task_keypad_init();
-
     /*
-     * Hardware that does depend on dedicated management tasks
-     * is initialized here as part of the startup of those tasks.
+     * Bring up all the hardware and tasks, according to the
+     * dependencies between them.
      */
-
-    /* Loop through the remaining tasks and create them */
-    log_d("Starting tasks...");
-    for (uint8_t i = 1; i < task_count; i++) {
-        log_d("Task: %s", task_list[i].task_attrs.name);
-
-        /* Create the next task */
-        task_list[i].task_handle = osThreadNew(task_list[i].task_func, task_start_semaphore, &task_list[i].task_attrs);
-        if (!task_list[i].task_handle) {
-            log_e("%s create error", task_list[i].task_attrs.name);
-            continue;
-        }
-
-        /* Wait for the semaphore set once the task initializes */
-        if (osSemaphoreAcquire(task_start_semaphore, portMAX_DELAY) != osOK) {
-            log_e("Unable to acquire task_start_semaphore");
-            return;
-        }
-    }
-    log_d("Task start loop complete");
+    main_task_init_graph_run();
 
     /* Keypad controller post-init */
     keypad_set_blackout_callback(illum_controller_keypad_blackout_callback, NULL);
@@ -240,15 +330,6 @@ void main_task_run(void *argument)
     illum_controller_refresh();
     illum_controller_safelight_state(ILLUM_SAFELIGHT_HOME);
 
-    /*
-     * Initialize the USB host framework.
-     * This framework does have a dedicated management task, but it is
-     * not handled as part of the application code.
-     */
-    if (!usb_host_init()) {
-        log_e("Unable to initialize USB host");
-    }
-
     /* Startup beep */
     buzzer_set_frequency(PAM8904E_FREQ_DEFAULT);
     buzzer_set_volume(settings_get_buzzer_volume());
@@ -263,6 +344,9 @@ void main_task_run(void *argument)
     /* Initialize state controller */
     state_controller_init();
 
+    boot_timeline[BOOT_TIMELINE_TOTAL].end_ticks = HAL_GetTick();
+    log_i("Startup took %lums", boot_timeline[BOOT_TIMELINE_TOTAL].end_ticks - boot_timeline[BOOT_TIMELINE_TOTAL].start_ticks);
+
     main_task_running = true;
 
     /* Main state controller loop, which should never exit */
@@ -270,6 +354,144 @@ void main_task_run(void *argument)
     state_controller_loop();
 }
 
+void main_task_init_graph_run()
+{
+    osThreadId_t workers[INIT_WORKER_COUNT] = {0};
+    uint8_t worker_count = 0;
+    uint32_t started = 0;
+    uint32_t finished = 0;
+
+    init_stage_queue = osMessageQueueNew(INIT_STAGE_COUNT + INIT_WORKER_COUNT, sizeof(uint8_t), NULL);
+    init_stage_flags = osEventFlagsNew(NULL);
+    if (init_stage_queue && init_stage_flags) {
+        for (uint8_t i = 0; i < INIT_WORKER_COUNT; i++) {
+            workers[i] = osThreadNew(main_task_init_worker_run, (void *)(uint32_t)i, &init_worker_attributes);
+            if (workers[i]) {
+                worker_count++;
+            }
+        }
+    }
+
+    /* Without any workers, just run every stage here in order */
+    if (worker_count == 0) {
+        log_w("Unable to start init workers, running stages in sequence");
+        for (uint8_t i = 0; i < INIT_STAGE_COUNT; i++) {
+            main_task_init_stage_run(i, task_start_semaphore);
+        }
+    } else {
+        while (finished != INIT_ALL_STAGES) {
+            /* Queue up every stage whose dependencies have all finished */
+            for (uint8_t i = 0; i < INIT_STAGE_COUNT; i++) {
+                if (!(started & INIT_DEP(i)) && (init_stages[i].depends & finished) == init_stages[i].depends) {
+                    started |= INIT_DEP(i);
+                    osMessageQueuePut(init_stage_queue, &i, 0, osWaitForever);
+                }
+            }
+
+            const uint32_t pending = started & ~finished;
+            if (pending == 0) {
+                log_e("Init stages have unresolvable dependencies: %08lX", ~finished & INIT_ALL_STAGES);
+                break;
+            }
+
+            uint32_t flags = osEventFlagsWait(init_stage_flags, pending,
+                osFlagsWaitAny | osFlagsNoClear, osWaitForever);
+            if (flags & osFlagsError) {
+                log_e("Init flags wait error: %08lX", flags);
+                break;
+            }
+            finished |= flags & INIT_ALL_STAGES;
+        }
+
+        /* Tell the workers to exit once they are done */
+        for (uint8_t i = 0; i < worker_count; i++) {
+            const uint8_t stop = UINT8_MAX;
+            osMessageQueuePut(init_stage_queue, &stop, 0, osWaitForever);
+        }
+        for (uint8_t i = 0; i < INIT_WORKER_COUNT; i++) {
+            if (workers[i]) {
+                osEventFlagsWait(init_stage_flags, INIT_DEP(INIT_STAGE_COUNT + i), osFlagsWaitAny, osWaitForever);
+            }
+        }
+    }
+
+    if (init_stage_queue) {
+        osMessageQueueDelete(init_stage_queue);
+        init_stage_queue = NULL;
+    }
+    if (init_stage_flags) {
+        osEventFlagsDelete(init_stage_flags);
+        init_stage_flags = NULL;
+    }
+
+    for (uint8_t i = 0; i < INIT_STAGE_COUNT; i++) {
+        log_d("Init %s: %lu-%lums", boot_timeline[i].name,
+            boot_timeline[i].start_ticks - boot_timeline[BOOT_TIMELINE_TOTAL].start_ticks,
+            boot_timeline[i].end_ticks - boot_timeline[BOOT_TIMELINE_TOTAL].start_ticks);
+    }
+}
+
+void main_task_init_worker_run(void *argument)
+{
+    const uint8_t worker_index = (uint8_t)((uint32_t)argument);
+    uint8_t stage;
+
+    /* Each worker needs its own semaphore for tasks to signal startup */
+    osSemaphoreId_t semaphore = osSemaphoreNew(1, 0, NULL);
+
+    for (;;) {
+        if (osMessageQueueGet(init_stage_queue, &stage, NULL, osWaitForever) != osOK) {
+            continue;
+        }
+        if (stage >= INIT_STAGE_COUNT) {
+            break;
+        }
+        main_task_init_stage_run(stage, semaphore);
+        osEventFlagsSet(init_stage_flags, INIT_DEP(stage));
+    }
+
+    if (semaphore) {
+        osSemaphoreDelete(semaphore);
+    }
+
+    /* Report that this worker is exiting, using flags above the stage flags */
+    osEventFlagsSet(init_stage_flags, INIT_DEP(INIT_STAGE_COUNT + worker_index));
+    osThreadExit();
+}
+
+void main_task_init_stage_run(uint8_t stage, osSemaphoreId_t semaphore)
+{
+    const init_stage_def_t *def = &init_stages[stage];
+
+    boot_timeline[stage].name = def->name;
+    boot_timeline[stage].start_ticks = HAL_GetTick();
+
+    if (def->init_func) {
+        def->init_func();
+    } else {
+        task_params_t *task = &task_list[def->task_index];
+        log_d("Task: %s", task->task_attrs.name);
+
+        /* Create the task, and wait for it to report that it has initialized */
+        task->task_handle = osThreadNew(task->task_func, semaphore, &task->task_attrs);
+        if (!task->task_handle) {
+            log_e("%s create error", task->task_attrs.name);
+        } else if (!semaphore || osSemaphoreAcquire(semaphore, portMAX_DELAY) != osOK) {
+            log_e("Unable to acquire task start semaphore");
+        }
+    }
+
+    boot_timeline[stage].end_ticks = HAL_GetTick();
+}
+
+size_t main_task_get_boot_timeline(const main_task_boot_stage_t **stages)
+{
+    if (stages) {
+        *stages = boot_timeline;
+    }
+    return sizeof(boot_timeline) / sizeof(main_task_boot_stage_t);
+}
+
 void main_task_startup_log()
 {
     const app_descriptor_t *app_descriptor = app_descriptor_get();
@@ -304,6 +526,11 @@ void main_task_startup_log()
     fflush(stdout);
 }
 
+void main_task_settings_init()
+{
+    settings_init(&hi2c1, i2c1_mutex);
+}
+
 void main_task_display_init()
 {
     const u8g2_display_handle_t display_handle = {
@@ -316,6 +543,10 @@ void main_task_display_init()
         .dc_gpio_pin = DISP_DC_Pin
     };
     display_init(&display_handle);
+}
+
+void main_task_display_config()
+{
     display_set_brightness(settings_get_display_brightness());
 
     if (illum_controller_is_blackout()) {
@@ -323,6 +554,9 @@ void main_task_display_init()
     } else {
         display_enable(true);
     }
+
+    display_draw_logo();
+    logo_ticks = osKernelGetTickCount();
 }
 
 void main_task_led_init()
@@ -339,6 +573,11 @@ void main_task_led_init()
     }
 }
 
+void main_task_encoder_init()
+{
+    HAL_TIM_Encoder_Start_IT(&htim1, TIM_CHANNEL_ALL);
+}
+
 void main_task_buzzer_init()
 {
     const pam8904e_handle_t buzzer_handle = {
@@ -381,6 +620,18 @@ void main_task_keypad_init()
     keypad_init(&hi2c1, i2c1_mutex);
 }
 
+void main_task_usb_host_init()
+{
+    /*
+     * Initialize the USB host framework.
+     * This framework does have a dedicated management task, but it is
+     * not handled as part of the application code.
+     */
+    if (!usb_host_init()) {
+        log_e("Unable to initialize USB host");
+    }
+}
+
 void main_task_enable_interrupts()
 {
     /*
@@ -3,8 +3,18 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <cmsis_os.h>
 
+/**
+ * Timing of a single stage of the startup process.
+ */
+typedef struct {
+    const char *name;     /*!< Name of the stage */
+    uint32_t start_ticks; /*!< HAL tick count when the stage started */
+    uint32_t end_ticks;   /*!< HAL tick count when the stage finished */
+} main_task_boot_stage_t;
+
 /**
  * Initialize the main FreeRTOS task.
  *
@@ -20,6 +30,17 @@ bool main_task_is_running();
 
 void main_task_notify_countdown_timer();
 
+/**
+ * Get the timeline of the startup process.
+ *
+ * The last entry covers the whole startup process, from the start of
+ * the main task until the state controller is ready to accept input.
+ *
+ * @param stages Set to point to the array of startup stages
+ * @return Number of entries in the array
+ */
+size_t main_task_get_boot_timeline(const main_task_boot_stage_t **stages);
+
 /**
  * Shutdown the system hardware in preparation for a restart
  */
@@ -1,5 +1,6 @@
 #include "menu_diagnostics.h"
 
+#include <stm32f4xx_hal.h>
 #include <FreeRTOS.h>
 #include <task.h>
 #include <cmsis_os.h>
@@ -7,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <ff.h>
 
 #define LOG_TAG "menu_diagnostics"
 #include <elog.h>
@@ -22,7 +24,10 @@
 #include "densitometer.h"
 #include "usb_host.h"
 #include "dmx.h"
+#include "trace.h"
+#include "stats.h"
 #include "util.h"
+#include "main_task.h"
 
 static menu_result_t diagnostics_keypad();
 static menu_result_t diagnostics_led();
@@ -31,45 +36,66 @@ static menu_result_t diagnostics_relay();
 static menu_result_t diagnostics_dmx512();
 static menu_result_t diagnostics_densitometer();
 static menu_result_t diagnostics_screenshot_mode();
+static menu_result_t diagnostics_trace_dump();
+static menu_result_t diagnostics_firmware_verify();
+static menu_result_t diagnostics_boot_timeline();
+static menu_result_t diagnostics_stats_benchmark();
+static void boot_timeline_row_callback(char *buf, size_t len, uint16_t row, void *user_data);
+static void menu_diagnostics_row_callback(char *buf, size_t len, uint16_t row, void *user_data);
+
+typedef struct {
+    const char *name;
+    menu_result_t (*func)();
+} menu_diagnostics_item_t;
+
+static const menu_diagnostics_item_t menu_diagnostics_items[] = {
+    { "Keypad Test", diagnostics_keypad },
+    { "LED Test", diagnostics_led },
+    { "Buzzer Test", diagnostics_buzzer },
+    { "Relay Test", diagnostics_relay },
+    { "DMX512 Control Test", diagnostics_dmx512 },
+    { "Densitometer Test", diagnostics_densitometer },
+    { "Screenshot Mode", diagnostics_screenshot_mode },
+    { "Event Trace Dump", diagnostics_trace_dump },
+    { "Firmware Verify", diagnostics_firmware_verify },
+    { "Boot Timeline", diagnostics_boot_timeline },
+    { "Stats Benchmark", diagnostics_stats_benchmark }
+};
+
+#define MENU_DIAGNOSTICS_ITEM_COUNT (sizeof(menu_diagnostics_items) / sizeof(menu_diagnostics_item_t))
 
 menu_result_t menu_diagnostics()
 {
     menu_result_t menu_result = MENU_OK;
-    uint8_t option = 1;
+    uint16_t option = 1;
 
     do {
-        option = display_selection_list(
-                "Diagnostics", option,
-                "Keypad Test\n"
-                "LED Test\n"
-                "Buzzer Test\n"
-                "Relay Test\n"
-                "DMX512 Control Test\n"
-                "Densitometer Test\n"
-                "Screenshot Mode");
+        uint32_t result = display_selection_list_virtual(
+            "Diagnostics", option, MENU_DIAGNOSTICS_ITEM_COUNT,
+            menu_diagnostics_row_callback, NULL,
+            DISPLAY_MENU_ACCEPT_MENU);
 
-        if (option == 1) {
-            menu_result = diagnostics_keypad();
-        } else if (option == 2) {
-            menu_result = diagnostics_led();
-        } else if (option == 3) {
-            menu_result = diagnostics_buzzer();
-        } else if (option == 4) {
-            menu_result = diagnostics_relay();
-        } else if (option == 5) {
-            menu_result = diagnostics_dmx512();
-        } else if (option == 6) {
-            menu_result = diagnostics_densitometer();
-        } else if (option == 7) {
-            menu_result = diagnostics_screenshot_mode();
-        } else if (option == UINT8_MAX) {
+        if (result == UINT32_MAX) {
             menu_result = MENU_TIMEOUT;
+            break;
+        }
+
+        option = (uint16_t)(result & 0xFFFF);
+        if (option > 0 && option <= MENU_DIAGNOSTICS_ITEM_COUNT) {
+            menu_result = menu_diagnostics_items[option - 1].func();
         }
     } while (option > 0 && menu_result != MENU_TIMEOUT);
 
     return menu_result;
 }
 
+void menu_diagnostics_row_callback(char *buf, size_t len, uint16_t row, void *user_data)
+{
+    if (row < MENU_DIAGNOSTICS_ITEM_COUNT) {
+        strncpy(buf, menu_diagnostics_items[row].name, len);
+    }
+}
+
 menu_result_t diagnostics_keypad()
 {
     char buf[512];
@@ -727,3 +753,193 @@ menu_result_t diagnostics_screenshot_mode()
 
     return menu_result;
 }
+
+menu_result_t diagnostics_trace_dump()
+{
+    static uint16_t trace_index = 1;
+    char buf[128];
+    char filename[32];
+    uint8_t option;
+
+    if (!usb_msc_is_mounted()) {
+        option = display_message(
+                "Event Trace Dump",
+                NULL,
+                "\n"
+                "Please insert a USB storage\n"
+                "device and try again.\n", " OK ");
+        return (option == UINT8_MAX) ? MENU_TIMEOUT : MENU_OK;
+    }
+
+    /*
+     * The index restarts on every boot, so step past any dumps that are
+     * already on the device rather than overwriting them.
+     */
+    for (uint16_t i = 0; i < 10000; i++) {
+        sprintf(filename, "trace-%04d.bin", trace_index % 10000);
+        if (f_stat(filename, NULL) != FR_OK) {
+            break;
+        }
+        trace_index++;
+    }
+
+    if (trace_dump_to_file(filename)) {
+        trace_index++;
+        sprintf(buf,
+            "\n"
+            "Event trace saved to file:\n"
+            "%s\n", filename);
+        option = display_message(
+            "Event Trace Dump",
+            NULL, buf, " OK ");
+    } else {
+        option = display_message(
+            "Event Trace Dump",
+            NULL,
+            "\n"
+            "Unable to save event trace!\n", " OK ");
+    }
+
+    return (option == UINT8_MAX) ? MENU_TIMEOUT : MENU_OK;
+}
+
+menu_result_t diagnostics_firmware_verify()
+{
+    uint8_t option;
+
+    option = display_message(
+        "Firmware Verify",
+        NULL,
+        "Fully verify the installed\n"
+        "firmware the next time the\n"
+        "device is started?\n", " Yes \n No ");
+    if (option == UINT8_MAX) {
+        return MENU_TIMEOUT;
+    } else if (option != 1) {
+        return MENU_OK;
+    }
+
+    if (settings_request_firmware_verify()) {
+        option = display_message(
+            "Firmware Verify",
+            NULL,
+            "\n"
+            "Firmware will be verified\n"
+            "on next startup.\n", " OK ");
+    } else {
+        option = display_message(
+            "Firmware Verify",
+            NULL,
+            "\n"
+            "Unable to save request.\n", " OK ");
+    }
+    return (option == UINT8_MAX) ? MENU_TIMEOUT : MENU_OK;
+}
+
+menu_result_t diagnostics_boot_timeline()
+{
+    const main_task_boot_stage_t *stages;
+    uint16_t option = 1;
+
+    size_t count = main_task_get_boot_timeline(&stages);
+    if (count == 0) {
+        return MENU_OK;
+    }
+
+    do {
+        uint32_t result = display_selection_list_virtual(
+            "Boot Timeline (ms)", option, count,
+            boot_timeline_row_callback, (void *)stages,
+            DISPLAY_MENU_ACCEPT_MENU);
+        if (result == UINT32_MAX) {
+            return MENU_TIMEOUT;
+        }
+        option = (uint16_t)(result & 0xFFFF);
+    } while (option > 0);
+
+    return MENU_OK;
+}
+
+void boot_timeline_row_callback(char *buf, size_t len, uint16_t row, void *user_data)
+{
+    const main_task_boot_stage_t *stages = user_data;
+    size_t count = main_task_get_boot_timeline(NULL);
+
+    /* Times are shown relative to the start of the overall startup */
+    const uint32_t base_ticks = stages[count - 1].start_ticks;
+    const main_task_boot_stage_t *stage = &stages[row];
+
+    if (!stage->name) {
+        buf[0] = '\0';
+        return;
+    }
+
+    snprintf(buf, len, "%-12s %5lu %5lu", stage->name,
+        stage->start_ticks - base_ticks, stage->end_ticks - base_ticks);
+}
+
+/**
+ * Number of values used for each statistics benchmark run, which is
+ * the same as the enlarger calibration reference reading count.
+ */
+#define STATS_BENCHMARK_LEN 96U
+
+menu_result_t diagnostics_stats_benchmark()
+{
+    static float values_f32[STATS_BENCHMARK_LEN];
+    static uint32_t values_u32[STATS_BENCHMARK_LEN];
+    stats_summary_t summary_lib;
+    stats_summary_t summary_ref;
+    uint32_t cycles[4];
+    uint32_t start;
+    char buf[192];
+
+    /* Fill with a repeatable spread of values, like a run of sensor readings */
+    for (uint32_t i = 0; i < STATS_BENCHMARK_LEN; i++) {
+        values_u32[i] = 40000U + ((i * 7919U) % 997U);
+        values_f32[i] = (float)values_u32[i] / 100.0F;
+    }
+
+    /* Enable the DWT cycle counter, which is not running unless tracing is enabled */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    taskENTER_CRITICAL();
+    start = DWT->CYCCNT;
+    stats_summary_f32(&summary_lib, values_f32, STATS_BENCHMARK_LEN);
+    cycles[0] = DWT->CYCCNT - start;
+    taskEXIT_CRITICAL();
+
+    taskENTER_CRITICAL();
+    start = DWT->CYCCNT;
+    stats_reference_summary_f32(&summary_ref, values_f32, STATS_BENCHMARK_LEN);
+    cycles[1] = DWT->CYCCNT - start;
+    taskEXIT_CRITICAL();
+
+    log_i("f32: lib=%lu ref=%lu cycles, mean=%f/%f, stddev=%f/%f", cycles[0], cycles[1],
+        summary_lib.mean, summary_ref.mean, summary_lib.stddev, summary_ref.stddev);
+
+    taskENTER_CRITICAL();
+    start = DWT->CYCCNT;
+    stats_summary_u32(&summary_lib, values_u32, STATS_BENCHMARK_LEN);
+    cycles[2] = DWT->CYCCNT - start;
+    taskEXIT_CRITICAL();
+
+    taskENTER_CRITICAL();
+    start = DWT->CYCCNT;
+    stats_reference_summary_u32(&summary_ref, values_u32, STATS_BENCHMARK_LEN);
+    cycles[3] = DWT->CYCCNT - start;
+    taskEXIT_CRITICAL();
+
+    log_i("u32: lib=%lu ref=%lu cycles, mean=%f/%f, stddev=%f/%f", cycles[2], cycles[3],
+        summary_lib.mean, summary_ref.mean, summary_lib.stddev, summary_ref.stddev);
+
+    sprintf(buf,
+        "Cycles for %u values\n"
+        "f32  Library %6lu  C %6lu\n"
+        "u32  Library %6lu  C %6lu",
+        STATS_BENCHMARK_LEN, cycles[0], cycles[1], cycles[2], cycles[3]);
+
+    uint8_t option = display_message("Stats Benchmark", NULL, buf, " OK ");
+    return (option == UINT8_MAX) ? MENU_TIMEOUT : MENU_OK;
+}
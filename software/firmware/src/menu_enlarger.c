@@ -32,71 +32,55 @@ static menu_result_t menu_enlarger_config_control_test_relay(const enlarger_cont
 static menu_result_t menu_enlarger_config_control_test_dmx(const enlarger_control_t *enlarger_control);
 static uint16_t dmx_adjust_value(uint16_t value, bool wide_mode);
 static menu_result_t menu_enlarger_config_timing_edit(enlarger_timing_t *timing_profile);
+static void menu_enlarger_list_row_callback(char *buf, size_t len, uint16_t row, void *user_data);
 static void menu_enlarger_delete_config(uint8_t index, size_t config_count);
 static bool menu_enlarger_config_delete_prompt(const enlarger_config_t *config, uint8_t index);
 
+typedef struct {
+    size_t config_count;
+    uint8_t default_index;
+} menu_enlarger_list_t;
+
 menu_result_t menu_enlarger_configs(state_controller_t *controller)
 {
     menu_result_t menu_result = MENU_OK;
-
-    char *config_name_list;
-    config_name_list = pvPortMalloc(PROFILE_NAME_LEN * MAX_ENLARGER_CONFIGS);
-    if (!config_name_list) {
-        log_e("Unable to allocate memory for config name list");
-        return MENU_OK;
-    }
-
-    char buf[640];
-    size_t offset;
+    menu_enlarger_list_t list;
     bool reload_configs = true;
-    uint8_t config_default_index = 0;
-    size_t config_count = 0;
     uint8_t option = 1;
+
+    memset(&list, 0, sizeof(menu_enlarger_list_t));
+
     do {
-        offset = 0;
         if (reload_configs) {
-            config_count = 0;
-            config_default_index = settings_get_default_enlarger_config_index();
+            list.config_count = 0;
+            list.default_index = settings_get_default_enlarger_config_index();
+            char config_name[PROFILE_NAME_LEN];
             for (size_t i = 0; i < MAX_ENLARGER_CONFIGS; i++) {
-                if (!settings_get_enlarger_config_name(config_name_list + (i * PROFILE_NAME_LEN), i)) {
+                if (!settings_get_enlarger_config_name(config_name, i)) {
                     break;
                 } else {
-                    config_count = i + 1;
+                    list.config_count = i + 1;
                 }
             }
-            log_i("Loaded %d configs, default is %d", config_count, config_default_index);
+            log_i("Loaded %d configs, default is %d", list.config_count, list.default_index);
             reload_configs = false;
         }
 
-        for (size_t i = 0; i < config_count; i++) {
-            const char *config_name = config_name_list + (i * PROFILE_NAME_LEN);
-            if (config_name && strlen(config_name) > 0) {
-                sprintf(buf + offset, "%c%02d%c %s",
-                    ((i == config_default_index) ? '<' : '['),
-                    i + 1,
-                    ((i == config_default_index) ? '>' : ']'),
-                    config_name);
-            } else {
-                sprintf(buf + offset, "%c%02d%c Enlarger profile %d",
-                    ((i == config_default_index) ? '<' : '['),
-                    i + 1,
-                    ((i == config_default_index) ? '>' : ']'),
-                    i + 1);
-            }
-            offset += pad_str_to_length(buf + offset, ' ', DISPLAY_MENU_ROW_LENGTH);
-            if (i < config_count) {
-                buf[offset++] = '\n';
-                buf[offset] = '\0';
-            }
-        }
-        if (config_count < MAX_ENLARGER_CONFIGS) {
-            sprintf(buf + offset, "*** Add New Profile ***");
+        uint16_t row_count = list.config_count;
+        if (list.config_count < MAX_ENLARGER_CONFIGS) {
+            row_count++;
         }
 
-        uint16_t result = display_selection_list_params("Enlarger Configurations", option, buf,
+        uint32_t result = display_selection_list_virtual("Enlarger Configurations", option, row_count,
+            menu_enlarger_list_row_callback, &list,
             DISPLAY_MENU_ACCEPT_MENU | DISPLAY_MENU_ACCEPT_ADD_ADJUSTMENT);
-        option = (uint8_t)(result & 0x00FF);
-        keypad_key_t option_key = (uint8_t)((result & 0xFF00) >> 8);
+        if (result == UINT32_MAX) {
+            option = UINT8_MAX;
+        } else {
+            option = (uint8_t)(result & 0xFFFF);
+        }
+        keypad_key_t option_key = (uint8_t)((result & 0xFF0000) >> 16);
+        const size_t config_count = list.config_count;
 
         if (option == 0) {
             menu_result = MENU_CANCEL;
@@ -111,9 +95,7 @@ menu_result_t menu_enlarger_configs(state_controller_t *controller)
                 menu_result = MENU_OK;
                 if (settings_set_enlarger_config(&working_config, config_count)) {
                     log_i("New config added at index: %d", config_count);
-                    strncpy(config_name_list + (config_count * PROFILE_NAME_LEN), working_config.name, PROFILE_NAME_LEN);
-                    config_name_list[((config_count * PROFILE_NAME_LEN) + PROFILE_NAME_LEN) - 1] = '\0';
-                    config_count++;
+                    list.config_count++;
                 }
             }
         } else if (option == UINT8_MAX) {
@@ -134,9 +116,6 @@ menu_result_t menu_enlarger_configs(state_controller_t *controller)
                     menu_result = MENU_OK;
                     if (settings_set_enlarger_config(&working_config, config_index)) {
                         log_i("Config saved at index: %d", config_index);
-
-                        strncpy(config_name_list + (config_index * PROFILE_NAME_LEN), working_config.name, PROFILE_NAME_LEN);
-                        config_name_list[((config_index * PROFILE_NAME_LEN) + PROFILE_NAME_LEN) - 1] = '\0';
                     }
                 } else if (menu_result == MENU_DELETE) {
                     menu_result = MENU_OK;
@@ -146,13 +125,11 @@ menu_result_t menu_enlarger_configs(state_controller_t *controller)
             } else if (option_key == KEYPAD_ADD_ADJUSTMENT) {
                 log_i("Set default config at index: %d", config_index);
                 settings_set_default_enlarger_config_index(config_index);
-                config_default_index = option - 1;
+                list.default_index = option - 1;
             }
         }
     } while (option > 0 && menu_result != MENU_TIMEOUT);
 
-    vPortFree(config_name_list);
-
     // There are many paths in this menu that can change profile settings,
     // so its easiest to just reload the state controller's active profile
     // whenever exiting from this menu.
@@ -165,6 +142,31 @@ menu_result_t menu_enlarger_configs(state_controller_t *controller)
     return menu_result;
 }
 
+void menu_enlarger_list_row_callback(char *buf, size_t len, uint16_t row, void *user_data)
+{
+    const menu_enlarger_list_t *list = user_data;
+    char config_name[PROFILE_NAME_LEN];
+
+    if (row >= list->config_count) {
+        strncpy(buf, "*** Add New Profile ***", len);
+        return;
+    }
+
+    if (settings_get_enlarger_config_name(config_name, row) && strlen(config_name) > 0) {
+        snprintf(buf, len, "%c%02d%c %s",
+            ((row == list->default_index) ? '<' : '['),
+            row + 1,
+            ((row == list->default_index) ? '>' : ']'),
+            config_name);
+    } else {
+        snprintf(buf, len, "%c%02d%c Enlarger profile %d",
+            ((row == list->default_index) ? '<' : '['),
+            row + 1,
+            ((row == list->default_index) ? '>' : ']'),
+            row + 1);
+    }
+}
+
 void menu_enlarger_delete_config(uint8_t index, size_t config_count)
 {
     for (size_t i = index; i < MAX_ENLARGER_CONFIGS; i++) {
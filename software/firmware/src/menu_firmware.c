@@ -13,6 +13,7 @@
 #include "display.h"
 #include "file_picker.h"
 #include "app_descriptor.h"
+#include "app_pack.h"
 #include "usb_msc_fatfs.h"
 
 extern CRC_HandleTypeDef hcrc;
@@ -31,6 +32,7 @@ typedef enum {
 
 static bool file_picker_firmware_filter(const FILINFO *fno);
 static validate_result_t validate_selected_file(const char *filename, app_descriptor_t *fw_descriptor);
+static validate_result_t validate_file_checksum(FIL *fp, uint32_t length, uint32_t *crc);
 static bool query_file_device(const char *file_path, char *dev_serial, size_t len);
 
 menu_result_t menu_firmware()
@@ -163,11 +165,9 @@ validate_result_t validate_selected_file(const char *filename, app_descriptor_t
     FRESULT res;
     FIL fp;
     bool file_open = false;
-    uint8_t buf[512];
-    UINT bytes_remaining;
-    UINT bytes_to_read;
     UINT bytes_read;
     uint32_t calculated_crc = 0;
+    app_pack_header_t pack_header = {0};
     app_descriptor_t image_descriptor = {0};
     validate_result_t result = VALIDATE_FAILED;
 
@@ -183,71 +183,86 @@ validate_result_t validate_selected_file(const char *filename, app_descriptor_t
         }
         file_open = true;
 
-        /* Check size of the firmware file */
-        if (f_size(&fp) != FIRMWARE_SIZE) {
-            log_w("Firmware size is invalid: %lu", f_size(&fp));
-            result = VALIDATE_FILE_BAD;
-            break;
-        }
-        log_i("Firmware size is okay.");
-
-        /* Calculate the firmware file checksum */
-        __HAL_CRC_DR_RESET(&hcrc);
-        bytes_remaining = f_size(&fp) - 4;
-        do {
-            bytes_to_read = MIN(sizeof(buf), bytes_remaining);
-            res = f_read(&fp, buf, bytes_to_read, &bytes_read);
-            if (res == FR_OK) {
-                /* This check should never fail, but safer to do it anyways */
-                if ((bytes_read % 4) != 0) {
-                    log_w("Bytes read are not word aligned");
-                    result = VALIDATE_FILE_READ_ERROR;
-                    break;
-                }
-
-                calculated_crc = HAL_CRC_Accumulate(&hcrc, (uint32_t *)buf, bytes_read / 4);
-
-                bytes_remaining -= bytes_read;
-
-                /* Break if at EOF */
-                if (bytes_read < bytes_to_read) {
-                    break;
-                }
-            } else {
-                log_w("File read error: %d", res);
+        /* Check whether this is a packed firmware file */
+        if (f_size(&fp) > sizeof(app_pack_header_t)) {
+            res = f_read(&fp, &pack_header, sizeof(app_pack_header_t), &bytes_read);
+            if (res != FR_OK || bytes_read != sizeof(app_pack_header_t)) {
+                log_w("Unable to read the firmware file header: %d", res);
                 result = VALIDATE_FILE_READ_ERROR;
                 break;
             }
-        } while (res == FR_OK && bytes_remaining > 0);
+        }
 
-        __HAL_RCC_CRC_FORCE_RESET();
-        __HAL_RCC_CRC_RELEASE_RESET();
+        if (pack_header.magic_word == APP_PACK_MAGIC_WORD) {
+            /*
+             * Packed files carry a copy of the image descriptor in their
+             * header, and a checksum of the packed data. The image itself
+             * is only verified by the bootloader as it gets unpacked.
+             */
+            const uint32_t packed_length = (pack_header.packed_size + 3UL) & ~3UL;
+            if (pack_header.version != APP_PACK_VERSION
+                || pack_header.image_size != FIRMWARE_SIZE
+                || f_size(&fp) != sizeof(app_pack_header_t) + packed_length) {
+                log_w("Packed firmware header is invalid");
+                result = VALIDATE_FILE_BAD;
+                break;
+            }
+            log_i("Packed firmware size is okay.");
 
-        if (result == VALIDATE_FILE_READ_ERROR) { break; }
+            result = validate_file_checksum(&fp, packed_length, &calculated_crc);
+            if (result != VALIDATE_SUCCESS) { break; }
+            result = VALIDATE_FAILED;
 
-        /* Read the app descriptor from the end of the firmware file */
-        res = f_lseek(&fp, f_tell(&fp) - (sizeof(app_descriptor_t) - 4));
-        if (res != FR_OK) {
-            log_w("Unable to seek to read the firmware file descriptor: %d", res);
-            result = VALIDATE_FILE_READ_ERROR;
-            break;
-        }
-        res = f_read(&fp, &image_descriptor, sizeof(app_descriptor_t), &bytes_read);
-        if (res != FR_OK || bytes_read != sizeof(app_descriptor_t)) {
-            log_w("Unable to read the firmware file descriptor: %d", res);
-            result = VALIDATE_FILE_READ_ERROR;
-            break;
-        }
+            f_rewind(&fp);
 
-        f_rewind(&fp);
+            if (calculated_crc != pack_header.packed_crc32) {
+                log_w("Packed firmware checksum mismatch: %08lX != %08lX",
+                    pack_header.packed_crc32, calculated_crc);
+                result = VALIDATE_FILE_BAD;
+                break;
+            }
+            log_i("Packed firmware checksum is okay.");
 
-        if (calculated_crc != image_descriptor.crc32) {
-            log_w("Firmware checksum mismatch: %08lX != %08lX",
-                image_descriptor.crc32, calculated_crc);
-            result = VALIDATE_FILE_BAD;
-            break;
+            memcpy(&image_descriptor, &pack_header.descriptor, sizeof(app_descriptor_t));
+        } else {
+            /* Check size of the firmware file */
+            if (f_size(&fp) != FIRMWARE_SIZE) {
+                log_w("Firmware size is invalid: %lu", f_size(&fp));
+                result = VALIDATE_FILE_BAD;
+                break;
+            }
+            log_i("Firmware size is okay.");
+
+            /* Calculate the firmware file checksum */
+            f_rewind(&fp);
+            result = validate_file_checksum(&fp, f_size(&fp) - 4, &calculated_crc);
+            if (result != VALIDATE_SUCCESS) { break; }
+            result = VALIDATE_FAILED;
+
+            /* Read the app descriptor from the end of the firmware file */
+            res = f_lseek(&fp, f_tell(&fp) - (sizeof(app_descriptor_t) - 4));
+            if (res != FR_OK) {
+                log_w("Unable to seek to read the firmware file descriptor: %d", res);
+                result = VALIDATE_FILE_READ_ERROR;
+                break;
+            }
+            res = f_read(&fp, &image_descriptor, sizeof(app_descriptor_t), &bytes_read);
+            if (res != FR_OK || bytes_read != sizeof(app_descriptor_t)) {
+                log_w("Unable to read the firmware file descriptor: %d", res);
+                result = VALIDATE_FILE_READ_ERROR;
+                break;
+            }
+
+            f_rewind(&fp);
+
+            if (calculated_crc != image_descriptor.crc32) {
+                log_w("Firmware checksum mismatch: %08lX != %08lX",
+                    image_descriptor.crc32, calculated_crc);
+                result = VALIDATE_FILE_BAD;
+                break;
+            }
+            log_i("Firmware checksum is okay.");
         }
-        log_i("Firmware checksum is okay.");
 
         if (image_descriptor.magic_word != APP_DESCRIPTOR_MAGIC_WORD) {
             log_w("Bad magic");
@@ -269,6 +284,55 @@ validate_result_t validate_selected_file(const char *filename, app_descriptor_t
     return result;
 }
 
+/**
+ * Calculate the checksum of the next part of an open file.
+ *
+ * @param fp File positioned at the start of the data to check
+ * @param length Length of the data to check, which must be word aligned
+ * @param crc Calculated checksum
+ */
+validate_result_t validate_file_checksum(FIL *fp, uint32_t length, uint32_t *crc)
+{
+    FRESULT res;
+    uint8_t buf[512];
+    UINT bytes_remaining = length;
+    UINT bytes_to_read;
+    UINT bytes_read;
+    validate_result_t result = VALIDATE_SUCCESS;
+
+    __HAL_CRC_DR_RESET(&hcrc);
+    do {
+        bytes_to_read = MIN(sizeof(buf), bytes_remaining);
+        res = f_read(fp, buf, bytes_to_read, &bytes_read);
+        if (res == FR_OK) {
+            /* This check should never fail, but safer to do it anyways */
+            if ((bytes_read % 4) != 0) {
+                log_w("Bytes read are not word aligned");
+                result = VALIDATE_FILE_READ_ERROR;
+                break;
+            }
+
+            *crc = HAL_CRC_Accumulate(&hcrc, (uint32_t *)buf, bytes_read / 4);
+
+            bytes_remaining -= bytes_read;
+
+            /* Break if at EOF */
+            if (bytes_read < bytes_to_read) {
+                break;
+            }
+        } else {
+            log_w("File read error: %d", res);
+            result = VALIDATE_FILE_READ_ERROR;
+            break;
+        }
+    } while (res == FR_OK && bytes_remaining > 0);
+
+    __HAL_RCC_CRC_FORCE_RESET();
+    __HAL_RCC_CRC_RELEASE_RESET();
+
+    return result;
+}
+
 bool query_file_device(const char *file_path, char *dev_serial, size_t len)
 {
     size_t path_len;
@@ -539,6 +539,11 @@ bool import_section_settings(const char *buf, size_t len, int *enlarger_config_i
                 if (num >= 0 && num <= UINT8_MAX) {
                     settings_set_teststrip_patches(num);
                 }
+            } else if (strncmp("teststrip_pause", pair.key, pair.keyLength) == 0 && pair.jsonType == JSONNumber) {
+                int num = json_parse_int(pair.value, pair.valueLength, -1);
+                if (num >= 0 && num <= 10000) {
+                    settings_set_teststrip_pause(num);
+                }
             } else if (strncmp("enlarger_config_index", pair.key, pair.keyLength) == 0 && pair.jsonType == JSONNumber) {
                 int num = json_parse_int(pair.value, pair.valueLength, -1);
                 if (num >= 0 && num < MAX_ENLARGER_CONFIGS) {
@@ -1008,6 +1013,7 @@ bool write_section_config(FIL *fp)
     json_write_int(fp, 4, "buzzer_volume", (uint8_t)settings_get_buzzer_volume(), true);
     json_write_int(fp, 4, "teststrip_mode", (uint8_t)settings_get_teststrip_mode(), true);
     json_write_int(fp, 4, "teststrip_patches", (uint8_t)settings_get_teststrip_patches(), true);
+    json_write_int(fp, 4, "teststrip_pause", settings_get_teststrip_pause(), true);
     json_write_int(fp, 4, "enlarger_config_index", settings_get_default_enlarger_config_index(), true);
     json_write_int(fp, 4, "paper_profile_index", settings_get_default_paper_profile_index(), true);
     f_printf(fp, "\n  }");
@@ -18,6 +18,7 @@
 #include "settings.h"
 #include "illum_controller.h"
 #include "enlarger_control.h"
+#include "stats.h"
 #include "util.h"
 #include "json_util.h"
 #include "usb_host.h"
@@ -1382,12 +1383,8 @@ menu_result_t meter_probe_diagnostics(const char *title, meter_probe_handle_t *h
                 elapsed_tick_buf[elapsed_tick_buf_pos] = sensor_reading.elapsed_ticks;
                 elapsed_tick_buf_pos++;
 
-                float elapsed_tick_sum = 0;
-                size_t elapsed_tick_sum_len = (elapsed_tick_buf_full ? elapsed_tick_buf_len : elapsed_tick_buf_pos);
-                for (size_t i = 0; i < elapsed_tick_sum_len; i++) {
-                    elapsed_tick_sum += (float)elapsed_tick_buf[i];
-                }
-                elapsed_tick_avg = elapsed_tick_sum / (float)elapsed_tick_sum_len;
+                size_t elapsed_tick_avg_len = (elapsed_tick_buf_full ? elapsed_tick_buf_len : elapsed_tick_buf_pos);
+                elapsed_tick_avg = stats_mean_u32(elapsed_tick_buf, elapsed_tick_avg_len);
 
                 if (elapsed_tick_buf_pos >= elapsed_tick_buf_len) {
                     elapsed_tick_buf_full = true;
@@ -5,7 +5,6 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <math.h>
-#include <arm_math.h>
 
 #define LOG_TAG "menu_paper"
 #include <elog.h>
@@ -21,7 +20,7 @@
 #include "menu_step_wedge.h"
 #include "exposure_state.h"
 #include "meter_probe.h"
-#include "util.h"
+#include "paper_curve.h"
 
 typedef struct {
     step_wedge_t *wedge;
@@ -29,6 +28,8 @@ typedef struct {
     float paper_dmax;
     uint32_t calibration_pev;
     float *patch_density;
+    void *curve_arena;
+    size_t curve_arena_size;
 } wedge_calibration_params_t;
 
 typedef struct {
@@ -36,7 +37,19 @@ typedef struct {
     bool stick_enable;
 } menu_paper_callback_data_t;
 
+typedef struct {
+    menu_paper_callback_data_t dens_data;
+    float paper_dmin;
+    float paper_dmax;
+} menu_paper_sequence_data_t;
+
+/**
+ * Tolerance used when checking paper readings taken in sequence
+ */
+#define PAPER_SEQUENCE_TOLERANCE 0.02F
+
 static menu_result_t menu_paper_profile_edit(state_controller_t *controller, paper_profile_t *profile, uint8_t index);
+static void menu_paper_list_row_callback(char *buf, size_t len, uint16_t row, void *user_data);
 static void menu_paper_delete_profile(uint8_t index, size_t profile_count);
 static bool menu_paper_profile_delete_prompt(const paper_profile_t *profile, uint8_t index);
 static menu_result_t menu_paper_profile_edit_grade(state_controller_t *controller, paper_profile_t *profile, uint8_t index, contrast_grade_t grade);
@@ -44,71 +57,58 @@ static menu_result_t menu_paper_profile_calibrate_grade(state_controller_t *cont
 static void menu_paper_densitometer_setup(menu_paper_callback_data_t *data);
 static void menu_paper_densitometer_shutdown(const menu_paper_callback_data_t *data);
 static uint16_t menu_paper_densitometer_data_callback(uint8_t event_action, void *user_data);
+static uint16_t menu_paper_sequence_data_callback(uint8_t event_action, void *user_data);
+static step_wedge_reading_check_t menu_paper_sequence_check_callback(const step_wedge_t *wedge,
+    const float *patch_density, uint32_t step, float density, void *user_data);
 static menu_result_t menu_paper_profile_calibrate_grade_validate(const wedge_calibration_params_t *params);
 static menu_result_t menu_paper_profile_calibrate_grade_calculate(const char *title, const wedge_calibration_params_t *params, paper_profile_grade_t *paper_grade);
 
+typedef struct {
+    size_t profile_count;
+    uint8_t default_index;
+} menu_paper_list_t;
+
 menu_result_t menu_paper_profiles(state_controller_t *controller)
 {
     menu_result_t menu_result = MENU_OK;
-
-    paper_profile_t *profile_list;
-    profile_list = pvPortMalloc(sizeof(paper_profile_t) * MAX_PAPER_PROFILES);
-    if (!profile_list) {
-        log_e("Unable to allocate memory for profile list");
-        return MENU_OK;
-    }
-
-    char buf[640];
-    size_t offset;
+    menu_paper_list_t list;
     bool reload_profiles = true;
     bool default_profile_changed = false;
-    uint8_t profile_default_index = 0;
-    size_t profile_count = 0;
     uint8_t option = 1;
+
+    memset(&list, 0, sizeof(menu_paper_list_t));
+
     do {
-        offset = 0;
         if (reload_profiles) {
-            profile_count = 0;
-            profile_default_index = settings_get_default_paper_profile_index();
+            list.profile_count = 0;
+            list.default_index = settings_get_default_paper_profile_index();
+            char profile_name[PROFILE_NAME_LEN];
             for (size_t i = 0; i < MAX_PAPER_PROFILES; i++) {
-                if (!settings_get_paper_profile(&profile_list[i], i)) {
+                if (!settings_get_paper_profile_name(profile_name, i)) {
                     break;
                 } else {
-                    profile_count = i + 1;
+                    list.profile_count = i + 1;
                 }
             }
-            log_i("Loaded %d profiles, default is %d", profile_count, profile_default_index);
+            log_i("Loaded %d profiles, default is %d", list.profile_count, list.default_index);
             reload_profiles = false;
         }
 
-        for (size_t i = 0; i < profile_count; i++) {
-            if (strlen(profile_list[i].name) > 0) {
-                sprintf(buf + offset, "%c%02d%c %s",
-                    (i == profile_default_index) ? '<' : '[',
-                    i + 1,
-                    (i == profile_default_index) ? '>' : ']',
-                    profile_list[i].name);
-            } else {
-                sprintf(buf + offset, "%c%02d%c Paper profile %d",
-                    (i == profile_default_index) ? '<' : '[',
-                    i + 1,
-                    (i == profile_default_index) ? '>' : ']',
-                    i + 1);
-            }
-            offset += pad_str_to_length(buf + offset, ' ', DISPLAY_MENU_ROW_LENGTH);
-            if (i < profile_count) {
-                buf[offset++] = '\n';
-                buf[offset] = '\0';
-            }
-        }
-        if (profile_count < MAX_PAPER_PROFILES) {
-            sprintf(buf + offset, "*** Add New Profile ***");
+        uint16_t row_count = list.profile_count;
+        if (list.profile_count < MAX_PAPER_PROFILES) {
+            row_count++;
         }
 
-        uint16_t result = display_selection_list_params("Paper Profiles", option, buf,
+        uint32_t result = display_selection_list_virtual("Paper Profiles", option, row_count,
+            menu_paper_list_row_callback, &list,
             DISPLAY_MENU_ACCEPT_MENU | DISPLAY_MENU_ACCEPT_ADD_ADJUSTMENT);
-        option = (uint8_t)(result & 0x00FF);
-        keypad_key_t option_key = (uint8_t)((result & 0xFF00) >> 8);
+        if (result == UINT32_MAX) {
+            option = UINT8_MAX;
+        } else {
+            option = (uint8_t)(result & 0xFFFF);
+        }
+        keypad_key_t option_key = (uint8_t)((result & 0xFF0000) >> 16);
+        const size_t profile_count = list.profile_count;
 
         if (option == 0) {
             menu_result = MENU_CANCEL;
@@ -137,8 +137,7 @@ menu_result_t menu_paper_profiles(state_controller_t *controller)
                     menu_result = MENU_OK;
                     if (settings_set_paper_profile(&working_profile, profile_count)) {
                         log_i("New profile manually added at index: %d", profile_count);
-                        memcpy(&profile_list[profile_count], &working_profile, sizeof(paper_profile_t));
-                        profile_count++;
+                        list.profile_count++;
                     }
                 }
             }
@@ -147,13 +146,16 @@ menu_result_t menu_paper_profiles(state_controller_t *controller)
         } else {
             if (option_key == KEYPAD_MENU) {
                 paper_profile_t working_profile;
-                memcpy(&working_profile, &profile_list[option - 1], sizeof(paper_profile_t));
+                if (!settings_get_paper_profile(&working_profile, option - 1)) {
+                    log_w("Unable to load profile at index: %d", option - 1);
+                    paper_profile_set_defaults(&working_profile);
+                }
+
                 menu_result = menu_paper_profile_edit(controller, &working_profile, option - 1);
                 if (menu_result == MENU_SAVE) {
                     menu_result = MENU_OK;
                     if (settings_set_paper_profile(&working_profile, option - 1)) {
                         log_i("Profile saved at index: %d", option - 1);
-                        memcpy(&profile_list[option - 1], &working_profile, sizeof(paper_profile_t));
                     }
                 } else if (menu_result == MENU_DELETE) {
                     menu_result = MENU_OK;
@@ -163,14 +165,12 @@ menu_result_t menu_paper_profiles(state_controller_t *controller)
             } else if (option_key == KEYPAD_ADD_ADJUSTMENT) {
                 log_i("Set default profile at index: %d", option - 1);
                 settings_set_default_paper_profile_index(option - 1);
-                profile_default_index = option - 1;
+                list.default_index = option - 1;
                 default_profile_changed = true;
             }
         }
     } while (option > 0 && menu_result != MENU_TIMEOUT);
 
-    vPortFree(profile_list);
-
     // There are many paths in this menu that can change profile settings,
     // so its easiest to just reload the state controller's active profile
     // whenever exiting from this menu.
@@ -179,6 +179,31 @@ menu_result_t menu_paper_profiles(state_controller_t *controller)
     return menu_result;
 }
 
+void menu_paper_list_row_callback(char *buf, size_t len, uint16_t row, void *user_data)
+{
+    const menu_paper_list_t *list = user_data;
+    char profile_name[PROFILE_NAME_LEN];
+
+    if (row >= list->profile_count) {
+        strncpy(buf, "*** Add New Profile ***", len);
+        return;
+    }
+
+    if (settings_get_paper_profile_name(profile_name, row) && strlen(profile_name) > 0) {
+        snprintf(buf, len, "%c%02d%c %s",
+            ((row == list->default_index) ? '<' : '['),
+            row + 1,
+            ((row == list->default_index) ? '>' : ']'),
+            profile_name);
+    } else {
+        snprintf(buf, len, "%c%02d%c Paper profile %d",
+            ((row == list->default_index) ? '<' : '['),
+            row + 1,
+            ((row == list->default_index) ? '>' : ']'),
+            row + 1);
+    }
+}
+
 size_t menu_paper_profile_edit_append_grade(char *str, const paper_profile_t *profile, contrast_grade_t grade)
 {
     size_t offset;
@@ -527,6 +552,8 @@ menu_result_t menu_paper_profile_calibrate_grade(state_controller_t *controller,
     char *buf = NULL;
     step_wedge_t *wedge = NULL;
     float *patch_density = NULL;
+    void *curve_arena = NULL;
+    size_t curve_arena_size = 0;
     uint8_t option = 1;
     float paper_dmin = 0.0F;
     float paper_dmax = 0.0F;
@@ -555,9 +582,19 @@ menu_result_t menu_paper_profile_calibrate_grade(state_controller_t *controller,
         return MENU_OK;
     }
 
+    /* Allocate a scratch arena for the curve calculation */
+    curve_arena_size = paper_curve_arena_size(wedge->step_count);
+    curve_arena = pvPortMalloc(curve_arena_size);
+    if (!curve_arena) {
+        vPortFree(patch_density);
+        vPortFree(wedge);
+        return MENU_OK;
+    }
+
     /* Allocate a buffer for the menu text */
-    buf = pvPortMalloc((wedge->step_count * (sizeof(char) * 33)) + (5 * 33));
+    buf = pvPortMalloc((wedge->step_count * (sizeof(char) * 33)) + (6 * 33));
     if (!buf) {
+        vPortFree(curve_arena);
         vPortFree(patch_density);
         vPortFree(wedge);
         return MENU_OK;
@@ -618,7 +655,9 @@ menu_result_t menu_paper_profile_calibrate_grade(state_controller_t *controller,
                     step_wedge_get_density(wedge, i));
             }
         }
-        sprintf(buf + offset, "*** Calculate Profile ***");
+        sprintf(buf + offset,
+            "*** Read All Steps ***\n"
+            "*** Calculate Profile ***");
 
         option = display_selection_list(title, option, buf);
 
@@ -717,6 +756,30 @@ menu_result_t menu_paper_profile_calibrate_grade(state_controller_t *controller,
 
             menu_paper_densitometer_shutdown(&dens_data);
         } else if (option == 5 + wedge->step_count) {
+            menu_paper_sequence_data_t sequence_data = {
+                .paper_dmin = paper_dmin,
+                .paper_dmax = paper_dmax
+            };
+            menu_paper_densitometer_setup(&sequence_data.dens_data);
+
+            if (sequence_data.dens_data.dens_enable || sequence_data.dens_data.stick_enable) {
+                menu_result = menu_step_wedge_read_sequence(wedge, patch_density,
+                    menu_paper_sequence_data_callback,
+                    menu_paper_sequence_check_callback, &sequence_data);
+            } else {
+                uint8_t msg_option = display_message(
+                    "Densitometer Not Connected",
+                    NULL,
+                    "Reading all steps in sequence\n"
+                    "requires a densitometer or\n"
+                    "DensiStick to be connected.", " OK ");
+                if (msg_option == UINT8_MAX) {
+                    menu_result = MENU_TIMEOUT;
+                }
+            }
+
+            menu_paper_densitometer_shutdown(&sequence_data.dens_data);
+        } else if (option == 6 + wedge->step_count) {
             menu_result_t val_result;
             log_i("Calculate profile");
 
@@ -726,7 +789,9 @@ menu_result_t menu_paper_profile_calibrate_grade(state_controller_t *controller,
                 .paper_dmin = paper_dmin,
                 .paper_dmax = paper_dmax,
                 .calibration_pev = calibration_pev,
-                .patch_density = patch_density
+                .patch_density = patch_density,
+                .curve_arena = curve_arena,
+                .curve_arena_size = curve_arena_size
             };
 
             /* Validate the parameters */
@@ -760,6 +825,7 @@ menu_result_t menu_paper_profile_calibrate_grade(state_controller_t *controller,
     } while (option > 0 && menu_result != MENU_TIMEOUT);
 
     vPortFree(buf);
+    vPortFree(curve_arena);
     vPortFree(patch_density);
     vPortFree(wedge);
 
@@ -772,7 +838,8 @@ void menu_paper_densitometer_setup(menu_paper_callback_data_t *data)
 
     data->dens_enable = usb_serial_is_attached();
     if (data->dens_enable) {
-        usb_serial_clear_receive_buffer();
+        /* Also clears the receive buffer */
+        densitometer_remote_probe();
     }
 
     meter_probe_handle_t *handle = densistick_handle();
@@ -790,6 +857,7 @@ void menu_paper_densitometer_shutdown(const menu_paper_callback_data_t *data)
     if (!data) { return; }
 
     if (data->dens_enable) {
+        densitometer_remote_reset();
         usb_serial_clear_receive_buffer();
     }
 
@@ -808,7 +876,7 @@ uint16_t menu_paper_densitometer_data_callback(uint8_t event_action, void *user_
     menu_paper_callback_data_t *data = (menu_paper_callback_data_t *)user_data;
     if (data->dens_enable) {
         densitometer_reading_t reading;
-        if (densitometer_reading_poll(&reading) == DENSITOMETER_RESULT_OK) {
+        if (densitometer_reading_pull(DENSITOMETER_MODE_REFLECTION, &reading) == DENSITOMETER_RESULT_OK) {
             if ((reading.mode == DENSITOMETER_MODE_UNKNOWN || reading.mode == DENSITOMETER_MODE_REFLECTION)
                 && !isnanf(reading.visual) && reading.visual > 0.0F) {
                 return lroundf(reading.visual * 100);
@@ -819,7 +887,7 @@ uint16_t menu_paper_densitometer_data_callback(uint8_t event_action, void *user_
         meter_probe_result_t result = METER_READING_OK;
         float density = NAN;
         buzzer_sequence(BUZZER_SEQUENCE_STICK_START);
-        result = densistick_measure(densistick_handle(), &density, NULL);
+        result = densistick_measure_fast(densistick_handle(), &density, NULL);
         buzzer_sequence(BUZZER_SEQUENCE_STICK_SUCCESS);
         if (result == METER_READING_OK) {
             return lroundf(density * 100);
@@ -830,6 +898,62 @@ uint16_t menu_paper_densitometer_data_callback(uint8_t event_action, void *user_
     return UINT16_MAX;
 }
 
+uint16_t menu_paper_sequence_data_callback(uint8_t event_action, void *user_data)
+{
+    menu_paper_sequence_data_t *data = (menu_paper_sequence_data_t *)user_data;
+
+    uint16_t value = menu_paper_densitometer_data_callback(event_action, &data->dens_data);
+    if (value == UINT16_MAX) {
+        return UINT16_MAX;
+    }
+
+    /* Constrain the reading based on Dmin and Dmax, the same as manual entry */
+    const uint16_t min_value = lroundf(data->paper_dmin * 100);
+    const uint16_t max_value = lroundf(data->paper_dmax * 100);
+    if (value < min_value) {
+        value = min_value;
+    }
+    if (value > max_value) {
+        value = max_value;
+    }
+    return value;
+}
+
+step_wedge_reading_check_t menu_paper_sequence_check_callback(const step_wedge_t *wedge,
+    const float *patch_density, uint32_t step, float density, void *user_data)
+{
+    const menu_paper_sequence_data_t *data = (const menu_paper_sequence_data_t *)user_data;
+
+    if (step == 0 || !is_valid_number(patch_density[step - 1])) {
+        return STEP_WEDGE_READING_ACCEPT;
+    }
+
+    /*
+     * Each step wedge patch passes less light than the one before it,
+     * so the density of the exposed paper can only go down across the
+     * sequence.
+     */
+    const float prev_density = patch_density[step - 1];
+    if (density > prev_density + PAPER_SEQUENCE_TOLERANCE) {
+        return STEP_WEDGE_READING_OUT_OF_ORDER;
+    }
+
+    /*
+     * Repeated values are expected where the paper is saturated at
+     * either end of its curve. Anywhere else, they are far more likely
+     * to be the same patch being read twice.
+     */
+    if (fabsf(density - prev_density) < PAPER_SEQUENCE_TOLERANCE) {
+        const float first_density = is_valid_number(patch_density[0]) ? patch_density[0] : data->paper_dmax;
+        if (density > data->paper_dmin + PAPER_SEQUENCE_TOLERANCE
+            && density < first_density - PAPER_SEQUENCE_TOLERANCE) {
+            return STEP_WEDGE_READING_DUPLICATE;
+        }
+    }
+
+    return STEP_WEDGE_READING_ACCEPT;
+}
+
 menu_result_t menu_paper_profile_calibrate_grade_validate(const wedge_calibration_params_t *params)
 {
     /* Validate arguments that should never be in question */
@@ -962,15 +1086,19 @@ menu_result_t menu_paper_profile_calibrate_grade_calculate(const char *title, co
     char buf[128];
     uint8_t msg_option = 0;
     size_t num_patches = 0;
-    size_t num_output = 0;
     int32_t Ht_lev100 = 0;
     int32_t Hm_lev100 = 0;
     int32_t Hs_lev100 = 0;
     uint32_t iso_r = 0;
     bool calculation_completed = false;
+    paper_curve_t curve;
+
+    /* Output Y-axis scaled for the display graph */
+    uint8_t graph_points[127];
+    const size_t num_graph = sizeof(graph_points);
 
     /* Validate arguments that should never be in question */
-    if (!params || !params->wedge || !params->patch_density) {
+    if (!params || !params->wedge || !params->patch_density || !params->curve_arena) {
         return MENU_CANCEL;
     }
 
@@ -982,124 +1110,65 @@ menu_result_t menu_paper_profile_calibrate_grade_calculate(const char *title, co
     }
     log_i("Found %d patches with valid measurements", num_patches);
 
-    /* X-axis is the calculated PEV values for the step wedge exposure */
-    float32_t *x_pev_f32 = NULL;
-
-    /* Y-axis is the measured density values from the paper */
-    float32_t *y_density_f32 = NULL;
-
-    /* Coefficients array used for the interpolation */
-    float32_t *coeffs = NULL;
-
-    /* Buffer array used for the interpolation */
-    float32_t *temp_buffer = NULL;
-
-    /* Output X-axis is the full range of PEV values from min to max */
-    float32_t *xq_pev_f32 = NULL;
-
-    /* Output Y-axis is the corresponding calculated density values */
-    float32_t *yq_density_f32 = NULL;
-
-    /* Output Y-axis scaled for the display graph */
-    uint8_t *graph_points = NULL;
-
     do {
-        arm_spline_instance_f32 S;
-
-        /* Allocate the arrays needed for the cubic spline interpolation */
-        x_pev_f32 = pvPortMalloc(sizeof(float32_t) * num_patches);
-        if (!x_pev_f32) { break; }
-
-        y_density_f32 = pvPortMalloc(sizeof(float32_t) * num_patches);
-        if (!y_density_f32) { break; }
-
-        coeffs = pvPortMalloc(sizeof(float32_t) * (3 * (num_patches - 1))); /* 3*(n-1) */
-        if (!coeffs) { break; }
-
-        temp_buffer = pvPortMalloc(sizeof(float32_t) * (num_patches + num_patches - 1)); /* n+n-1 */
-        if (!temp_buffer) { break; }
+        /* Lay out the curve arrays within the scratch arena */
+        if (!paper_curve_init(&curve, params->curve_arena, params->curve_arena_size, num_patches)) {
+            log_w("Unable to initialize curve for %d patches", num_patches);
+            break;
+        }
 
-        /* Apply wedge data to populate PEV and density values for each patch */
+        /*
+         * Apply wedge data to populate PEV and density values for each patch,
+         * where the X-axis is the calculated PEV values for the step wedge
+         * exposure and the Y-axis is the measured density values from the paper.
+         */
         uint32_t p = 0;
         for (int i = params->wedge->step_count - 1; i >= 0; --i) {
             if (is_valid_number(params->patch_density[i])) {
-                x_pev_f32[p] = roundf((float)params->calibration_pev - (params->wedge->step_density[i] * 100.0F));
-#if 0
-                log_i("[i=%lu,p=%lu] %0.02f = %lu - (%0.02f * 100)",
-                    i, p,
-                    x_pev_f32[p], params->calibration_pev, params->wedge->step_density[i]);
-#endif
-                y_density_f32[p] = params->patch_density[i];
+                curve.x[p] = roundf((float)params->calibration_pev - (params->wedge->step_density[i] * 100.0F));
+                curve.y[p] = params->patch_density[i];
                 p++;
             }
         }
 
-        /* Initialize the cubic spline interpolation */
-        arm_spline_init_f32(&S, ARM_SPLINE_NATURAL,
-            x_pev_f32, y_density_f32, num_patches,
-            coeffs, temp_buffer);
+        /* Calculate the cubic spline coefficients for the characteristic curve */
+        if (!paper_curve_solve(&curve)) {
+            log_w("Unable to fit curve to patch PEV values");
+            break;
+        }
 
-        num_output = abs(lroundf(x_pev_f32[num_patches - 1]) - lroundf(x_pev_f32[0]));
+        const float min_xq = curve.x[0];
+        const float max_xq = curve.x[num_patches - 1];
+        const size_t num_output = lroundf(max_xq - min_xq);
         if (num_output > 500) {
             log_w("Interpolation range unusually large: %d", num_output);
             break;
         }
-        float min_xq = MIN(x_pev_f32[0], x_pev_f32[num_patches - 1]);
-        log_i("Interpolating curve from PEV=%ld to %ld (%d steps)",
-            lroundf(x_pev_f32[0]), lroundf(x_pev_f32[num_patches - 1]), num_output);
-
-        /* Allocate the arrays needed for interpolation results */
-        xq_pev_f32 = pvPortMalloc(sizeof(float32_t) * num_output);
-        if (!xq_pev_f32) { break; }
-
-        yq_density_f32 = pvPortMalloc(sizeof(float32_t) * num_output);
-        if (!yq_density_f32) { break; }
-
-        /* Fill the interpolation output X-value array */
-        for (uint32_t i = 0; i < num_output; i++) {
-            xq_pev_f32[i] = min_xq + i;
-        }
-
-        /* Run the cubic spline interpolation to get the characteristic curve */
-        arm_spline_f32(&S, xq_pev_f32, yq_density_f32, num_output);
+        log_i("Solving curve from PEV=%ld to %ld", lroundf(min_xq), lroundf(max_xq));
 
         /* Declare the reference point density values */
-        const float32_t Ht_D = params->paper_dmin + 0.04F; /* paper base + 0.04 */
-        const float32_t Hm_D = params->paper_dmin + 0.60F; /* paper base + 0.60 */
-        const float32_t Hs_D = params->paper_dmin + ((params->paper_dmax - params->paper_dmin) * 0.90F); /* 90% of Dnet */
-
-        /* Iterate across the output to find PEV values for each reference point */
-        float32_t Ht_x = NAN;
-        float32_t Ht_y = NAN;
-        float32_t Hm_x = NAN;
-        float32_t Hm_y = NAN;
-        float32_t Hs_x = NAN;
-        float32_t Hs_y = NAN;
-        for (uint32_t i = 0; i < num_output; i++) {
-            if (isnanf(Ht_y) || fabsf(Ht_D - yq_density_f32[i]) < fabsf(Ht_D - Ht_y)) {
-                Ht_y = yq_density_f32[i];
-                Ht_x = xq_pev_f32[i];
-            }
-            if (isnanf(Hm_y) || fabsf(Hm_D - yq_density_f32[i]) < fabsf(Hm_D - Hm_y)) {
-                Hm_y = yq_density_f32[i];
-                Hm_x = xq_pev_f32[i];
-            }
-            if (isnanf(Hs_y) || fabsf(Hs_D - yq_density_f32[i]) < fabsf(Hs_D - Hs_y)) {
-                Hs_y = yq_density_f32[i];
-                Hs_x = xq_pev_f32[i];
-            }
-        }
+        const float Ht_D = params->paper_dmin + 0.04F; /* paper base + 0.04 */
+        const float Hm_D = params->paper_dmin + 0.60F; /* paper base + 0.60 */
+        const float Hs_D = params->paper_dmin + ((params->paper_dmax - params->paper_dmin) * 0.90F); /* 90% of Dnet */
+
+        /* Solve the curve for the PEV values at each reference point */
+        bool Ht_exact;
+        bool Hm_exact;
+        bool Hs_exact;
+        const float Ht_x = paper_curve_find_x(&curve, Ht_D, &Ht_exact);
+        const float Hm_x = paper_curve_find_x(&curve, Hm_D, &Hm_exact);
+        const float Hs_x = paper_curve_find_x(&curve, Hs_D, &Hs_exact);
 
         /* Assign the results, keeping signs */
         Ht_lev100 = lroundf(Ht_x);
         Hm_lev100 = lroundf(Hm_x);
         Hs_lev100 = lroundf(Hs_x);
-        iso_r = abs(lroundf(Hs_lev100 - Ht_lev100));
+        iso_r = abs(Hs_lev100 - Ht_lev100);
 
         /* Log the results */
-        log_i("Ht: PEV=%ld, D=%0.02f (%0.02f)", Ht_lev100, Ht_y, Ht_D);
-        log_i("Hm: PEV=%ld, D=%0.02f (%0.02f)", Hm_lev100, Hm_y, Hm_D);
-        log_i("Hs: PEV=%ld, D=%0.02f (%0.02f)", Hs_lev100, Hs_y, Hs_D);
+        log_i("Ht: PEV=%ld, D=%0.02f (%0.02f)%s", Ht_lev100, paper_curve_evaluate(&curve, Ht_x), Ht_D, Ht_exact ? "" : " [nearest]");
+        log_i("Hm: PEV=%ld, D=%0.02f (%0.02f)%s", Hm_lev100, paper_curve_evaluate(&curve, Hm_x), Hm_D, Hm_exact ? "" : " [nearest]");
+        log_i("Hs: PEV=%ld, D=%0.02f (%0.02f)%s", Hs_lev100, paper_curve_evaluate(&curve, Hs_x), Hs_D, Hs_exact ? "" : " [nearest]");
         log_i("ISO(R) = %ld", iso_r);
 
         /*
@@ -1109,52 +1178,28 @@ menu_result_t menu_paper_profile_calibrate_grade_calculate(const char *title, co
          * calculated ISO(R) even if everything else is not usable.
          */
         if (Ht_lev100 > 999 && Hm_lev100 > 999 && Hs_lev100 > 999) {
-            return false;
+            break;
         }
         if (Ht_lev100 >= Hs_lev100) {
-            return false;
+            break;
         }
         if (Hm_lev100 <= Ht_lev100 || Hm_lev100 >= Hs_lev100) {
-            return false;
+            break;
         }
 
-        /* Free the interpolation result arrays */
-        vPortFree(xq_pev_f32);
-        vPortFree(yq_density_f32);
-        xq_pev_f32 = NULL;
-        yq_density_f32 = NULL;
-
         log_i("Preparing results display graph");
 
-        /* Reallocate the result arrays for the display graph */
-        size_t num_graph = 127;
-        xq_pev_f32 = pvPortMalloc(sizeof(float32_t) * num_graph);
-        if (!xq_pev_f32) { break; }
-
-        yq_density_f32 = pvPortMalloc(sizeof(float32_t) * num_graph);
-        if (!yq_density_f32) { break; }
-
-        graph_points = pvPortMalloc(sizeof(uint8_t) * num_graph);
-        if (!graph_points) { break; }
-
-        /* Fill the interpolation display graph output X-value array */
-        float xq_increment = (float)num_output / (float)num_graph;
-        for (uint32_t i = 0; i < num_graph; i++) {
-            xq_pev_f32[i] = min_xq + (i * xq_increment);
-        }
-
-        /* Run the cubic spline interpolation to get the display graph curve */
-        arm_spline_f32(&S, xq_pev_f32, yq_density_f32, num_graph);
-
         /* Find the minimum and maximum values in the display graph curve */
+        const float xq_increment = (max_xq - min_xq) / (float)num_graph;
         float yq_density_min = NAN;
         float yq_density_max = NAN;
-        for (uint32_t i = 0; i < num_graph; i++) {
-            if (isnanf(yq_density_min) || yq_density_f32[i] < yq_density_min) {
-                yq_density_min = yq_density_f32[i];
+        for (size_t i = 0; i < num_graph; i++) {
+            const float yq = paper_curve_evaluate(&curve, min_xq + (i * xq_increment));
+            if (isnanf(yq_density_min) || yq < yq_density_min) {
+                yq_density_min = yq;
             }
-            if (isnanf(yq_density_max) || yq_density_f32[i] > yq_density_max) {
-                yq_density_max = yq_density_f32[i];
+            if (isnanf(yq_density_max) || yq > yq_density_max) {
+                yq_density_max = yq;
             }
         }
 
@@ -1165,8 +1210,9 @@ menu_result_t menu_paper_profile_calibrate_grade_calculate(const char *title, co
         }
 
         /* Scale the display graph curve values */
-        for (uint32_t i = 0; i < num_graph; i++) {
-            graph_points[i] = lroundf(42.0F * ((yq_density_f32[i] - yq_density_min) / (yq_density_max - yq_density_min))) + 4;
+        for (size_t i = 0; i < num_graph; i++) {
+            const float yq = paper_curve_evaluate(&curve, min_xq + (i * xq_increment));
+            graph_points[i] = lroundf(42.0F * ((yq - yq_density_min) / (yq_density_max - yq_density_min))) + 4;
         }
 
         log_i("Showing results display graph");
@@ -1193,15 +1239,6 @@ menu_result_t menu_paper_profile_calibrate_grade_calculate(const char *title, co
 
     } while (0);
 
-    /* Free dynamically allocated arrays */
-    vPortFree(x_pev_f32);
-    vPortFree(y_density_f32);
-    vPortFree(coeffs);
-    vPortFree(temp_buffer);
-    vPortFree(xq_pev_f32);
-    vPortFree(yq_density_f32);
-    vPortFree(graph_points);
-
     if (!calculation_completed) {
         msg_option = display_message(
             "Calculation Error\n",
@@ -0,0 +1,192 @@
+#include "menu_print_job.h"
+
+#include <FreeRTOS.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#define LOG_TAG "menu_print_job"
+#include <elog.h>
+
+#include "display.h"
+#include "settings.h"
+#include "print_job.h"
+#include "exposure_state.h"
+#include "util.h"
+
+static menu_result_t menu_print_job_save_current(state_controller_t *controller, uint8_t index);
+static menu_result_t menu_print_job_detail(state_controller_t *controller, print_job_t *job, uint8_t index);
+static void menu_print_job_delete(uint8_t index, size_t job_count);
+
+menu_result_t menu_print_jobs(state_controller_t *controller)
+{
+    menu_result_t menu_result = MENU_OK;
+
+    print_job_t *job_list;
+    job_list = pvPortMalloc(sizeof(print_job_t) * MAX_PRINT_JOBS);
+    if (!job_list) {
+        log_e("Unable to allocate memory for job list");
+        return MENU_OK;
+    }
+
+    char buf[MAX_PRINT_JOBS * (DISPLAY_MENU_ROW_LENGTH + 1) + 32];
+    char summary[DISPLAY_MENU_ROW_LENGTH];
+    size_t offset;
+    bool reload_jobs = true;
+    size_t job_count = 0;
+    uint8_t option = 1;
+    do {
+        offset = 0;
+        if (reload_jobs) {
+            job_count = 0;
+            for (size_t i = 0; i < MAX_PRINT_JOBS; i++) {
+                if (!settings_get_print_job(&job_list[i], i)) {
+                    break;
+                } else {
+                    job_count = i + 1;
+                }
+            }
+            log_i("Loaded %d print jobs", job_count);
+            reload_jobs = false;
+        }
+
+        for (size_t i = 0; i < job_count; i++) {
+            print_job_summary_str(summary, sizeof(summary) - 5, &job_list[i]);
+            sprintf(buf + offset, "[%02d] %s", i + 1, summary);
+            offset += pad_str_to_length(buf + offset, ' ', DISPLAY_MENU_ROW_LENGTH);
+            buf[offset++] = '\n';
+            buf[offset] = '\0';
+        }
+        if (job_count < MAX_PRINT_JOBS) {
+            sprintf(buf + offset, "*** Save Current Exposure ***");
+        } else if (offset > 0) {
+            buf[offset - 1] = '\0';
+        }
+
+        option = display_selection_list("Print Jobs", option, buf);
+
+        if (option == 0) {
+            menu_result = MENU_CANCEL;
+            break;
+        } else if (option == UINT8_MAX) {
+            menu_result = MENU_TIMEOUT;
+        } else if (option - 1 == job_count) {
+            menu_result = menu_print_job_save_current(controller, job_count);
+            reload_jobs = true;
+        } else {
+            menu_result = menu_print_job_detail(controller, &job_list[option - 1], option - 1);
+            if (menu_result == MENU_DELETE) {
+                menu_result = MENU_OK;
+                menu_print_job_delete(option - 1, job_count);
+                reload_jobs = true;
+            }
+        }
+    } while (option > 0 && menu_result != MENU_TIMEOUT && menu_result != MENU_EXIT);
+
+    vPortFree(job_list);
+
+    return menu_result;
+}
+
+menu_result_t menu_print_job_save_current(state_controller_t *controller, uint8_t index)
+{
+    const exposure_state_t *exposure_state = state_controller_get_exposure_state(controller);
+    print_job_t job;
+    uint8_t option;
+
+    if (!exposure_get_print_job(exposure_state, &job)) {
+        option = display_message(
+            "Print Jobs\n",
+            NULL,
+            "Only exposures in a printing\nmode can be saved as jobs.\n",
+            " OK ");
+        return (option == UINT8_MAX) ? MENU_TIMEOUT : MENU_OK;
+    }
+
+    if (!settings_set_print_job(&job, index)) {
+        log_w("Unable to save print job at index: %d", index);
+        option = display_message(
+            "Print Jobs\n",
+            NULL,
+            "Unable to save print job\n",
+            " OK ");
+        return (option == UINT8_MAX) ? MENU_TIMEOUT : MENU_OK;
+    }
+
+    log_i("Print job saved at index: %d", index);
+    return MENU_OK;
+}
+
+menu_result_t menu_print_job_detail(state_controller_t *controller, print_job_t *job, uint8_t index)
+{
+    menu_result_t menu_result = MENU_OK;
+    char buf_title[32];
+    char buf[256];
+    size_t offset = 0;
+
+    sprintf(buf_title, "Print Job %d", index + 1);
+
+    float exposure_time = print_job_exposure_time(job);
+    if (job->mode == EXPOSURE_MODE_PRINTING_COLOR) {
+        offset += sprintf(buf + offset, "%.1fs, RGB [%d,%d,%d]\n",
+            exposure_time, job->channel_values[0], job->channel_values[1], job->channel_values[2]);
+    } else {
+        offset += sprintf(buf + offset, "%.1fs, Grade %s\n",
+            exposure_time, contrast_grade_str(job->contrast_grade));
+    }
+    offset += sprintf(buf + offset, "%d burn/dodge adjustments\n", job->burn_dodge_count);
+    sprintf(buf + offset, "%d copies\n", job->copies);
+
+    uint8_t option = display_message(buf_title, NULL, buf, " Run \n Load \n Delete ");
+    if (option == 1) {
+        uint8_t copies = job->copies;
+        option = display_input_value("Copies", "\n", "", &copies, 1, PRINT_JOB_COPIES_MAX, 2, " copies");
+        if (option == UINT8_MAX) {
+            menu_result = MENU_TIMEOUT;
+        } else if (option > 0) {
+            if (copies != job->copies) {
+                job->copies = copies;
+                settings_set_print_job(job, index);
+            }
+
+            log_i("Running print job %d, copies=%d", index + 1, job->copies);
+            exposure_set_print_job(state_controller_get_exposure_state(controller), job);
+            state_controller_set_next_state(controller, STATE_TIMER, job->copies);
+            menu_result = MENU_EXIT;
+        }
+    } else if (option == 2) {
+        log_i("Loading print job %d", index + 1);
+        exposure_set_print_job(state_controller_get_exposure_state(controller), job);
+        menu_result = MENU_EXIT;
+    } else if (option == 3) {
+        sprintf(buf_title, "Delete Print Job %d?", index + 1);
+        option = display_message(buf_title, NULL, "\n\n\n", " Yes \n No ");
+        if (option == 1) {
+            menu_result = MENU_DELETE;
+        } else if (option == UINT8_MAX) {
+            menu_result = MENU_TIMEOUT;
+        }
+    } else if (option == UINT8_MAX) {
+        menu_result = MENU_TIMEOUT;
+    }
+
+    return menu_result;
+}
+
+void menu_print_job_delete(uint8_t index, size_t job_count)
+{
+    for (size_t i = index; i < MAX_PRINT_JOBS; i++) {
+        if (i < job_count - 1) {
+            print_job_t job;
+            if (!settings_get_print_job(&job, i + 1)) {
+                return;
+            }
+            if (!settings_set_print_job(&job, i)) {
+                return;
+            }
+        } else {
+            settings_clear_print_job(i);
+            break;
+        }
+    }
+}
@@ -0,0 +1,9 @@
+#ifndef MENU_PRINT_JOB_H
+#define MENU_PRINT_JOB_H
+
+#include "main_menu.h"
+#include "state_controller.h"
+
+menu_result_t menu_print_jobs(state_controller_t *controller);
+
+#endif /* MENU_PRINT_JOB_H */
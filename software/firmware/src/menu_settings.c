@@ -326,6 +326,7 @@ menu_result_t menu_settings_test_strip_mode()
 
     teststrip_mode_t mode_setting = settings_get_teststrip_mode();
     teststrip_patches_t patch_setting = settings_get_teststrip_patches();
+    uint32_t pause_setting = settings_get_teststrip_pause();
 
     bool accepted = false;
 
@@ -335,12 +336,14 @@ menu_result_t menu_settings_test_strip_mode()
         } else {
             sprintf(buf1, "Incremental exposures");
         }
-        if (patch_setting == TESTSTRIP_PATCHES_5) {
-            sprintf(buf2, "5 patches\n");
+        if (pause_setting > 0) {
+            sprintf(buf2, "%d patches, %lds pause\n",
+                (patch_setting == TESTSTRIP_PATCHES_5) ? 5 : 7, pause_setting / 1000);
         } else {
-            sprintf(buf2, "7 patches\n");
+            sprintf(buf2, "%d patches\n",
+                (patch_setting == TESTSTRIP_PATCHES_5) ? 5 : 7);
         }
-        uint8_t option = display_message("Test Strip Mode\n", buf1, buf2, " OK \n Mode \n Patches ");
+        uint8_t option = display_message("Test Strip Mode\n", buf1, buf2, " OK \n Mode \n Patches \n Pause ");
 
         if (option == 1) {
             accepted = true;
@@ -357,12 +360,26 @@ menu_result_t menu_settings_test_strip_mode()
             } else {
                 patch_setting = TESTSTRIP_PATCHES_5;
             }
+        } else if (option == 4) {
+            /* Cycle through the automatic pause options for continuous mode */
+            if (pause_setting == 0) {
+                pause_setting = 1000;
+            } else if (pause_setting < 3000) {
+                pause_setting += 1000;
+            } else if (pause_setting < 5000) {
+                pause_setting = 5000;
+            } else if (pause_setting < 10000) {
+                pause_setting = 10000;
+            } else {
+                pause_setting = 0;
+            }
         } else if (option == UINT8_MAX) {
             menu_result = MENU_TIMEOUT;
             break;
         } else if (option == 0) {
             if (mode_setting != settings_get_teststrip_mode()
-                || patch_setting != settings_get_teststrip_patches()) {
+                || patch_setting != settings_get_teststrip_patches()
+                || pause_setting != settings_get_teststrip_pause()) {
                 menu_result = menu_confirm_cancel("Test Strip Mode");
                 if (menu_result == MENU_SAVE) {
                     menu_result = MENU_OK;
@@ -380,6 +397,7 @@ menu_result_t menu_settings_test_strip_mode()
     if (accepted) {
         settings_set_teststrip_mode(mode_setting);
         settings_set_teststrip_patches(patch_setting);
+        settings_set_teststrip_pause(pause_setting);
     }
 
     return menu_result;
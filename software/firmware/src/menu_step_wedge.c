@@ -1,5 +1,8 @@
 #include "menu_step_wedge.h"
 
+#include <FreeRTOS.h>
+#include <cmsis_os.h>
+
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
@@ -10,14 +13,26 @@
 #include "settings.h"
 #include "step_wedge.h"
 #include "display.h"
+#include "keypad.h"
+#include "buzzer.h"
 #include "util.h"
 #include "usb_host.h"
 #include "densitometer.h"
 
+/*
+ * When readings are streamed from a densitometer, the probe may still be
+ * moving between patches. A streamed reading is only used once this many
+ * consecutive readings agree with each other.
+ */
+#define SEQUENCE_STABLE_READINGS  3
+#define SEQUENCE_STABLE_TOLERANCE 0.02F
+
 static int calibration_status(const step_wedge_t *wedge);
 static int menu_step_wedge_list_selection();
 static menu_result_t menu_step_wedge_calibration(step_wedge_t *wedge);
 static uint16_t menu_step_wedge_densitometer_data_callback(uint8_t event_action, void *user_data);
+static step_wedge_reading_check_t menu_step_wedge_check_callback(const step_wedge_t *wedge,
+    const float *patch_density, uint32_t step, float density, void *user_data);
 
 menu_result_t menu_step_wedge()
 {
@@ -246,7 +261,7 @@ menu_result_t menu_step_wedge_calibration(step_wedge_t *wedge)
     int option = 1;
     size_t offset = 0;
     char *buf = NULL;
-    buf = pvPortMalloc((wedge->step_count * (sizeof(char) * 33)) + 64);
+    buf = pvPortMalloc((wedge->step_count * (sizeof(char) * 33)) + 96);
     if (!buf) {
         return MENU_OK;
     }
@@ -279,6 +294,7 @@ menu_result_t menu_step_wedge_calibration(step_wedge_t *wedge)
                 (is_calibrated ? ']' : '}'));
         }
         sprintf(buf + offset,
+            "*** Read All Steps ***\n"
             "*** Accept Changes ***\n"
             "*** Reset Values ***");
 
@@ -301,22 +317,48 @@ menu_result_t menu_step_wedge_calibration(step_wedge_t *wedge)
 
             bool dens_enable = usb_serial_is_attached();
             if (dens_enable) {
-                usb_serial_clear_receive_buffer();
+                /* Also clears the receive buffer */
+                densitometer_remote_probe();
             }
 
             patch_option = display_input_value_f16_data_cb(
                 patch_title_buf, patch_buf,
                 "D=", &value_sel, 0, 999, 1, 2, "",
                 menu_step_wedge_densitometer_data_callback, &dens_enable);
+
+            if (dens_enable) {
+                densitometer_remote_reset();
+                usb_serial_clear_receive_buffer();
+            }
             if (patch_option == 1) {
                 wedge->step_density[option - 1] = (float)value_sel / 100.0F;
             } else if (patch_option == UINT8_MAX) {
                 menu_result = MENU_TIMEOUT;
             }
         } else if (option == wedge->step_count + 1) {
+            bool dens_enable = usb_serial_is_attached();
+            if (dens_enable) {
+                densitometer_remote_probe();
+                menu_result = menu_step_wedge_read_sequence(wedge, wedge->step_density,
+                    menu_step_wedge_densitometer_data_callback,
+                    menu_step_wedge_check_callback, &dens_enable);
+                densitometer_remote_reset();
+                usb_serial_clear_receive_buffer();
+            } else {
+                uint8_t msg_option = display_message(
+                    "Densitometer Not Connected",
+                    NULL,
+                    "Reading all steps in sequence\n"
+                    "requires a densitometer to be\n"
+                    "connected over USB.", " OK ");
+                if (msg_option == UINT8_MAX) {
+                    menu_result = MENU_TIMEOUT;
+                }
+            }
+        } else if (option == wedge->step_count + 2) {
             menu_result = MENU_SAVE;
             break;
-        } else if (option == wedge->step_count + 2) {
+        } else if (option == wedge->step_count + 3) {
             for (uint32_t i = 0; i < wedge->step_count; i++) {
                 wedge->step_density[i] = NAN;
             }
@@ -387,12 +429,163 @@ menu_result_t menu_step_wedge_show(const step_wedge_t *wedge)
     return menu_result;
 }
 
+menu_result_t menu_step_wedge_read_sequence(const step_wedge_t *wedge, float *patch_density,
+    display_data_source_callback_t data_callback, menu_step_wedge_check_callback_t check_callback,
+    void *user_data)
+{
+    char title_buf[32];
+    char buf[256];
+    const char *status_str = "Waiting for reading";
+    uint32_t step = 0;
+    float stable_sum = 0;
+    float stable_first = NAN;
+    uint8_t stable_count = 0;
+    float settled_density = NAN;
+
+    if (!wedge || !patch_density || !data_callback || !check_callback) {
+        return MENU_OK;
+    }
+
+    /* Resume from the first patch that has not been read yet */
+    while (step < wedge->step_count && is_valid_number(patch_density[step])) {
+        step++;
+    }
+    if (step == wedge->step_count) {
+        step = 0;
+    }
+
+    /* Streamed readings need to settle, while triggered ones are used as-is */
+    const bool streaming = densitometer_remote_active();
+
+    keypad_clear_events();
+
+    uint32_t activity_ticks = osKernelGetTickCount();
+
+    while (step < wedge->step_count) {
+        if (osKernelGetTickCount() - activity_ticks >= pdMS_TO_TICKS(MENU_TIMEOUT_MS)) {
+            log_i("Reading sequence timed out");
+            return MENU_TIMEOUT;
+        }
+
+        /* Show the current patch, preceded by the last two captured ones */
+        const uint32_t first_row = (step > 2) ? step - 2 : 0;
+        const uint32_t end_row = MIN(first_row + 3, wedge->step_count);
+        size_t offset = 0;
+
+        for (uint32_t i = first_row; i < end_row; i++) {
+            if (is_valid_number(patch_density[i])) {
+                offset += sprintf(buf + offset,
+                    "Step %-2lu      %c {D=%0.02f} [D=%0.02f]\n",
+                    i + 1, (i == step) ? '>' : ' ',
+                    step_wedge_get_density(wedge, i),
+                    patch_density[i]);
+            } else {
+                offset += sprintf(buf + offset,
+                    "Step %-2lu      %c {D=%0.02f} [------]\n",
+                    i + 1, (i == step) ? '>' : ' ',
+                    step_wedge_get_density(wedge, i));
+            }
+        }
+        sprintf(buf + offset, "%s", status_str);
+
+        sprintf(title_buf, "Reading Step %lu of %lu", step + 1, wedge->step_count);
+        display_static_list(title_buf, buf);
+
+        uint8_t event_action = 0;
+        keypad_event_t keypad_event;
+        if (keypad_wait_for_event(&keypad_event, 100) == HAL_OK) {
+            activity_ticks = osKernelGetTickCount();
+
+            /* Let the patch under the probe be evaluated again after a manual step change */
+            settled_density = NAN;
+
+            if (keypad_is_key_released_or_repeated(&keypad_event, KEYPAD_DENSISTICK)) {
+                event_action = 5 /*U8X8_MSG_GPIO_MENU_STICK_BTN*/;
+            } else if (keypad_is_key_released_or_repeated(&keypad_event, KEYPAD_DEC_EXPOSURE)) {
+                if (step > 0) {
+                    step--;
+                    status_str = "Re-reading previous step";
+                }
+                continue;
+            } else if (keypad_is_key_released_or_repeated(&keypad_event, KEYPAD_INC_EXPOSURE)) {
+                if (step < wedge->step_count - 1) {
+                    step++;
+                    status_str = "Skipped a step";
+                }
+                continue;
+            } else if (keypad_event.key == KEYPAD_CANCEL && !keypad_event.pressed) {
+                break;
+            } else if (keypad_event.key == KEYPAD_USB_KEYBOARD && keypad_event.pressed
+                && keypad_usb_get_keypad_equivalent(&keypad_event) == KEYPAD_CANCEL) {
+                break;
+            }
+        }
+
+        uint16_t value = data_callback(event_action, user_data);
+        if (value == UINT16_MAX) {
+            continue;
+        }
+        float density = (float)value / 100.0F;
+
+        if (streaming && event_action == 0) {
+            /* Ignore the patch that was last evaluated, while it stays under the probe */
+            if (is_valid_number(settled_density)
+                && fabsf(density - settled_density) <= SEQUENCE_STABLE_TOLERANCE) {
+                stable_count = 0;
+                continue;
+            }
+            settled_density = NAN;
+
+            /* Wait for consecutive readings to agree before using them */
+            if (stable_count > 0 && fabsf(density - stable_first) <= SEQUENCE_STABLE_TOLERANCE) {
+                stable_sum += density;
+                stable_count++;
+            } else {
+                stable_first = density;
+                stable_sum = density;
+                stable_count = 1;
+            }
+            if (stable_count < SEQUENCE_STABLE_READINGS) {
+                continue;
+            }
+
+            density = roundf((stable_sum / (float)stable_count) * 100.0F) / 100.0F;
+            settled_density = density;
+            stable_count = 0;
+        }
+
+        activity_ticks = osKernelGetTickCount();
+
+        switch (check_callback(wedge, patch_density, step, density, user_data)) {
+        case STEP_WEDGE_READING_ACCEPT:
+            log_i("Step %lu: D=%0.02f", step + 1, density);
+            patch_density[step] = density;
+            status_str = "Waiting for reading";
+            step++;
+            break;
+        case STEP_WEDGE_READING_DUPLICATE:
+            /* Repeats are expected while the probe lingers, so they are not worth a beep */
+            log_d("Step %lu: D=%0.02f is a duplicate", step + 1, density);
+            status_str = "Duplicate reading ignored";
+            break;
+        case STEP_WEDGE_READING_OUT_OF_ORDER:
+        default:
+            log_w("Step %lu: D=%0.02f is out of order", step + 1, density);
+            status_str = "Out of order reading ignored";
+            buzzer_sequence(BUZZER_SEQUENCE_PROBE_WARNING);
+            break;
+        }
+    }
+
+    return MENU_OK;
+}
+
 uint16_t menu_step_wedge_densitometer_data_callback(uint8_t event_action, void *user_data)
 {
     bool dens_enable = *((bool *)user_data);
     if (dens_enable) {
         densitometer_reading_t reading;
-        if (densitometer_reading_poll(&reading) == DENSITOMETER_RESULT_OK) {
+        if (densitometer_reading_pull(DENSITOMETER_MODE_TRANSMISSION, &reading) == DENSITOMETER_RESULT_OK) {
             if ((reading.mode == DENSITOMETER_MODE_UNKNOWN || reading.mode == DENSITOMETER_MODE_TRANSMISSION)
                 && !isnanf(reading.visual) && reading.visual > 0.0F) {
                 return lroundf(reading.visual * 100);
@@ -401,3 +594,11 @@ uint16_t menu_step_wedge_densitometer_data_callback(uint8_t event_action, void *
     }
     return UINT16_MAX;
 }
+
+step_wedge_reading_check_t menu_step_wedge_check_callback(const step_wedge_t *wedge,
+    const float *patch_density, uint32_t step, float density, void *user_data)
+{
+    /* Captured readings are stored in the wedge itself */
+    const float prev_density = (step > 0) ? step_wedge_get_density(wedge, step - 1) : NAN;
+    return step_wedge_check_reading(wedge, step, prev_density, density);
+}
@@ -3,9 +3,43 @@
 
 #include "main_menu.h"
 #include "step_wedge.h"
+#include "display.h"
+
+/**
+ * Callback to check whether a reading is plausible for a patch,
+ * given the readings already captured for the other patches.
+ */
+typedef step_wedge_reading_check_t (*menu_step_wedge_check_callback_t)(const step_wedge_t *wedge,
+    const float *patch_density, uint32_t step, float density, void *user_data);
 
 menu_result_t menu_step_wedge();
 
 menu_result_t menu_step_wedge_show(const step_wedge_t *wedge);
 
+/**
+ * Capture readings for a series of patches in a continuous sweep.
+ *
+ * Readings are accepted from the data callback as they arrive, and each
+ * one that passes the check callback is stored before automatically
+ * advancing to the next patch. A live table of the captured patches is
+ * shown while waiting. The sweep finishes when the last patch has been
+ * read, or when the user cancels it.
+ *
+ * When the densitometer is streaming readings, a value is only used once
+ * several consecutive readings agree, and is then ignored for as long as
+ * it stays the same. Readings that repeat the previous patch are ignored
+ * silently, while readings out of order sound a warning.
+ *
+ * @param wedge Step wedge whose patches are being read
+ * @param patch_density Array of 'step_count' elements to store readings in
+ * @param data_callback Callback used to poll for readings
+ * @param check_callback Callback used to validate each reading
+ * @param user_data Pointer passed through to both callbacks
+ * @return MENU_TIMEOUT if there was no activity for the menu timeout period,
+ *         otherwise MENU_OK
+ */
+menu_result_t menu_step_wedge_read_sequence(const step_wedge_t *wedge, float *patch_density,
+    display_data_source_callback_t data_callback, menu_step_wedge_check_callback_t check_callback,
+    void *user_data);
+
 #endif /* MENU_STEP_WEDGE_H */
@@ -14,10 +14,14 @@
 
 #include "board_config.h"
 #include "meter_probe_settings.h"
+#include "settings.h"
 #include "tsl2585.h"
 #include "keypad.h"
 #include "usb_host.h"
 #include "usb_ft260.h"
+#include "stats.h"
+#include "exposure_math.h"
+#include "densistick_fast.h"
 #include "util.h"
 
 /* I2C address of the digital potentiometer used to control DensiStick light intensity */
@@ -29,6 +33,21 @@ static const uint8_t MCP4017_ADDRESS = 0x2F; /* Use 7-bit address */
  */
 #define FIFO_ALS_ENTRY_SIZE 7
 
+/*
+ * Delay after starting with cached calibration data before the data on
+ * the device itself is checked against it.
+ */
+#define CAL_CHECK_DELAY_MS 1000
+
+/* Number of readings averaged together for a DensiStick measurement */
+#define DENSISTICK_MEASURE_READING_COUNT 2
+
+/*
+ * Sample count for each reading taken by a fast DensiStick measurement,
+ * which is 50ms at the sample time used for all DensiStick measurements.
+ */
+#define DENSISTICK_FAST_SAMPLE_COUNT 49
+
 typedef enum {
     METER_PROBE_DEVICE_METER_PROBE = 0,
     METER_PROBE_DEVICE_DENSISTICK
@@ -60,6 +79,7 @@ typedef enum {
     METER_PROBE_CONTROL_SENSOR_TRIGGER_NEXT_READING,
     METER_PROBE_CONTROL_STICK_SET_LIGHT_ENABLE,
     METER_PROBE_CONTROL_STICK_SET_LIGHT_VALUE,
+    METER_PROBE_CONTROL_SENSOR_SET_READING_CALLBACK,
     METER_PROBE_CONTROL_INTERRUPT
 } meter_probe_control_event_type_t;
 
@@ -92,6 +112,11 @@ typedef struct {
     uint32_t ticks;
 } sensor_control_interrupt_params_t;
 
+typedef struct {
+    meter_probe_sensor_reading_callback_t callback;
+    void *user_data;
+} sensor_control_reading_callback_params_t;
+
 /**
  * Meter probe control event data.
  */
@@ -105,6 +130,7 @@ typedef struct {
         sensor_control_mod_cal_params_t mod_calibration;
         sensor_control_agc_params_t agc;
         sensor_control_interrupt_params_t interrupt;
+        sensor_control_reading_callback_params_t reading_callback;
         int value;
     };
 } meter_probe_control_event_t;
@@ -180,6 +206,9 @@ typedef struct __meter_probe_handle_t {
     volatile meter_probe_state_t probe_state;
     bool has_sensor_settings;
     meter_probe_settings_handle_t settings_handle;
+    uint8_t cal_data[METER_PROBE_SETTINGS_CAL_SIZE];
+    bool cal_check_pending;
+    uint32_t cal_check_ticks;
     union {
         meter_probe_settings_tsl2585_t probe_settings;
         densistick_settings_tsl2585_t stick_settings;
@@ -189,6 +218,10 @@ typedef struct __meter_probe_handle_t {
     uint32_t last_aint_ticks;
     bool stick_light_enabled;
     uint8_t stick_light_brightness;
+    tsl2585_gain_t stick_fast_gain;
+    float stick_fast_reading;
+    meter_probe_sensor_reading_callback_t reading_callback;
+    void *reading_callback_user_data;
 
     /* Queues and semaphores */
     osMessageQueueId_t control_queue;
@@ -222,6 +255,9 @@ static osStatus_t meter_probe_detach(meter_probe_handle_t *handle);
 /* Meter probe control implementation functions */
 static osStatus_t meter_probe_control_start(meter_probe_handle_t *handle);
 static osStatus_t meter_probe_control_stop(meter_probe_handle_t *handle);
+static HAL_StatusTypeDef meter_probe_load_sensor_settings(meter_probe_handle_t *handle);
+static HAL_StatusTypeDef meter_probe_parse_sensor_settings(meter_probe_handle_t *handle, const uint8_t *data);
+static void meter_probe_control_check_cal(meter_probe_handle_t *handle);
 static osStatus_t meter_probe_control_attach(meter_probe_handle_t *handle);
 static osStatus_t meter_probe_control_detach(meter_probe_handle_t *handle);
 static osStatus_t meter_probe_sensor_enable_impl(meter_probe_handle_t *handle, sensor_control_start_mode_t start_mode);
@@ -235,10 +271,16 @@ static osStatus_t meter_probe_control_sensor_disable_agc(meter_probe_handle_t *h
 static osStatus_t meter_probe_control_sensor_trigger_next_reading(meter_probe_handle_t *handle);
 static osStatus_t meter_probe_control_set_light_enable(meter_probe_handle_t *handle, bool enable);
 static osStatus_t meter_probe_control_set_light_value(meter_probe_handle_t *handle, uint8_t value);
+static osStatus_t meter_probe_control_sensor_set_reading_callback(meter_probe_handle_t *handle, const sensor_control_reading_callback_params_t *params);
 static osStatus_t meter_probe_control_interrupt(meter_probe_handle_t *handle, const sensor_control_interrupt_params_t *params);
 
 static void usb_meter_probe_event_callback(ft260_device_t *device, ft260_device_event_t event_type, uint32_t ticks, void *user_data);
 static void meter_probe_int_handler(meter_probe_handle_t *handle, uint32_t ticks);
+static bool densistick_is_fast_ready(const meter_probe_handle_t *handle);
+static osStatus_t densistick_start_fast(meter_probe_handle_t *handle);
+static float densistick_calculate_density(const meter_probe_handle_t *handle, float reading);
+static float densistick_fast_density_callback(float reading, void *user_data);
+static float meter_probe_basic_result_impl(const meter_probe_handle_t *handle, const meter_probe_sensor_reading_t *sensor_reading, uint8_t index);
 
 static HAL_StatusTypeDef sensor_control_read_fifo(meter_probe_handle_t *handle, tsl2585_fifo_data_t *fifo_data, bool *overflow);
 static HAL_StatusTypeDef sensor_control_read_fifo_fast_mode(meter_probe_handle_t *handle, tsl2585_fifo_data_t *fifo_data, bool *overflow, uint32_t ticks);
@@ -344,7 +386,18 @@ void task_meter_probe_run_loop(meter_probe_handle_t *handle)
 
     /* Start the main control event loop */
     for (;;) {
-        if(osMessageQueueGet(handle->control_queue, &control_event, NULL, portMAX_DELAY) == osOK) {
+        /*
+         * Wait for the next event, but only until the calibration check
+         * is due if one is pending. The timeout is based on a fixed
+         * deadline, so a steady stream of events cannot hold it off.
+         */
+        uint32_t timeout = portMAX_DELAY;
+        if (handle->cal_check_pending) {
+            const int32_t remaining = (int32_t)(handle->cal_check_ticks - osKernelGetTickCount());
+            timeout = (remaining > 0) ? (uint32_t)remaining : 0;
+        }
+
+        if(osMessageQueueGet(handle->control_queue, &control_event, NULL, timeout) == osOK) {
             osStatus_t ret = osOK;
             switch (control_event.event_type) {
             case METER_PROBE_CONTROL_STOP:
@@ -389,6 +442,9 @@ void task_meter_probe_run_loop(meter_probe_handle_t *handle)
             case METER_PROBE_CONTROL_STICK_SET_LIGHT_VALUE:
                 ret = meter_probe_control_set_light_value(handle, control_event.value);
                 break;
+            case METER_PROBE_CONTROL_SENSOR_SET_READING_CALLBACK:
+                ret = meter_probe_control_sensor_set_reading_callback(handle, &control_event.reading_callback);
+                break;
             case METER_PROBE_CONTROL_INTERRUPT:
                 ret = meter_probe_control_interrupt(handle, &control_event.interrupt);
                 break;
@@ -408,6 +464,11 @@ void task_meter_probe_run_loop(meter_probe_handle_t *handle)
                 }
             }
         }
+
+        if (handle->cal_check_pending
+            && (int32_t)(handle->cal_check_ticks - osKernelGetTickCount()) <= 0) {
+            meter_probe_control_check_cal(handle);
+        }
     }
 
 }
@@ -556,11 +617,7 @@ osStatus_t meter_probe_control_start(meter_probe_handle_t *handle)
         }
 
         /* Read the settings for the current sensor type */
-        if (handle->device_type == METER_PROBE_DEVICE_DENSISTICK) {
-            ret = densistick_settings_get_tsl2585(&handle->settings_handle, &handle->stick_settings);
-        } else {
-            ret = meter_probe_settings_get_tsl2585(&handle->settings_handle, &handle->probe_settings);
-        }
+        ret = meter_probe_load_sensor_settings(handle);
         if (ret == HAL_OK) {
             handle->has_sensor_settings = true;
         } else {
@@ -602,6 +659,105 @@ osStatus_t meter_probe_control_start(meter_probe_handle_t *handle)
     return hal_to_os_status(ret);
 }
 
+HAL_StatusTypeDef meter_probe_load_sensor_settings(meter_probe_handle_t *handle)
+{
+    HAL_StatusTypeDef ret = HAL_OK;
+    accessory_cal_t cal;
+
+    _Static_assert(ACCESSORY_CAL_DATA_SIZE == METER_PROBE_SETTINGS_CAL_SIZE, "Cache size does not match calibration data");
+
+    memset(&cal, 0, sizeof(accessory_cal_t));
+    cal.device_type = handle->device_type;
+    strncpy(cal.serial, handle->settings_handle.id.probe_serial, ACCESSORY_SERIAL_LEN - 1);
+    cal.cal_version = handle->settings_handle.cal_version;
+
+    /*
+     * Use the cached copy of the calibration data if there is one for
+     * this device, and schedule a check of the device's own copy for
+     * once the device has had a chance to be put into use.
+     */
+    if (settings_get_accessory_cal(&cal)) {
+        ret = meter_probe_parse_sensor_settings(handle, cal.data);
+        if (ret == HAL_OK) {
+            log_d("Using cached calibration");
+            memcpy(handle->cal_data, cal.data, METER_PROBE_SETTINGS_CAL_SIZE);
+            handle->cal_check_ticks = osKernelGetTickCount() + pdMS_TO_TICKS(CAL_CHECK_DELAY_MS);
+            handle->cal_check_pending = true;
+            return ret;
+        }
+        log_w("Unable to use cached calibration");
+        settings_clear_accessory_cal(cal.device_type, cal.serial);
+    }
+
+    ret = meter_probe_settings_read_cal(&handle->settings_handle, cal.data);
+    if (ret != HAL_OK) { return ret; }
+
+    ret = meter_probe_parse_sensor_settings(handle, cal.data);
+    if (ret != HAL_OK) { return ret; }
+
+    memcpy(handle->cal_data, cal.data, METER_PROBE_SETTINGS_CAL_SIZE);
+    settings_set_accessory_cal(&cal);
+
+    return ret;
+}
+
+HAL_StatusTypeDef meter_probe_parse_sensor_settings(meter_probe_handle_t *handle, const uint8_t *data)
+{
+    if (handle->device_type == METER_PROBE_DEVICE_DENSISTICK) {
+        return densistick_settings_parse_tsl2585(&handle->settings_handle, data, &handle->stick_settings);
+    } else {
+        return meter_probe_settings_parse_tsl2585(&handle->settings_handle, data, &handle->probe_settings);
+    }
+}
+
+void meter_probe_control_check_cal(meter_probe_handle_t *handle)
+{
+    HAL_StatusTypeDef ret = HAL_OK;
+    accessory_cal_t cal;
+
+    if (handle->probe_state < METER_PROBE_STATE_STARTED) {
+        handle->cal_check_pending = false;
+        return;
+    }
+
+    /* Avoid adding bus traffic while sensor readings are in progress */
+    if (handle->sensor_state.running) {
+        handle->cal_check_ticks = osKernelGetTickCount() + pdMS_TO_TICKS(CAL_CHECK_DELAY_MS);
+        return;
+    }
+
+    handle->cal_check_pending = false;
+
+    memset(&cal, 0, sizeof(accessory_cal_t));
+    ret = meter_probe_settings_read_cal(&handle->settings_handle, cal.data);
+    if (ret != HAL_OK) {
+        log_w("Unable to read calibration for check: %d", ret);
+        return;
+    }
+
+    if (memcmp(cal.data, handle->cal_data, METER_PROBE_SETTINGS_CAL_SIZE) == 0) {
+        log_d("Cached calibration matches device");
+        return;
+    }
+
+    log_w("Cached calibration does not match device");
+
+    cal.device_type = handle->device_type;
+    strncpy(cal.serial, handle->settings_handle.id.probe_serial, ACCESSORY_SERIAL_LEN - 1);
+    cal.cal_version = handle->settings_handle.cal_version;
+
+    ret = meter_probe_parse_sensor_settings(handle, cal.data);
+    if (ret == HAL_OK) {
+        memcpy(handle->cal_data, cal.data, METER_PROBE_SETTINGS_CAL_SIZE);
+        handle->has_sensor_settings = true;
+        settings_set_accessory_cal(&cal);
+    } else {
+        log_w("Unable to load sensor calibration");
+        handle->has_sensor_settings = false;
+        settings_clear_accessory_cal(cal.device_type, cal.serial);
+    }
+}
+
 osStatus_t meter_probe_stop(meter_probe_handle_t *handle)
 {
     if (!handle) { return osErrorParameter; }
@@ -630,17 +786,22 @@ osStatus_t meter_probe_control_stop(meter_probe_handle_t *handle)
 
     /* Clear the settings */
     memset(&handle->settings_handle, 0, sizeof(meter_probe_settings_handle_t));
+    memset(handle->cal_data, 0, sizeof(handle->cal_data));
+    handle->cal_check_pending = false;
 
     if (handle->device_type == METER_PROBE_DEVICE_DENSISTICK) {
         meter_probe_control_set_light_enable(handle, false);
         memset(&handle->stick_settings, 0, sizeof(densistick_settings_tsl2585_t));
         handle->stick_light_brightness = 0;
+        handle->stick_fast_reading = NAN;
     } else {
         memset(&handle->probe_settings, 0, sizeof(meter_probe_settings_tsl2585_t));
     }
 
     memset(&handle->sensor_state, 0, sizeof(tsl2585_state_t));
     handle->has_sensor_settings = false;
+    handle->reading_callback = NULL;
+    handle->reading_callback_user_data = NULL;
 
     return osOK;
 }
@@ -773,6 +934,9 @@ osStatus_t meter_probe_set_settings(meter_probe_handle_t *handle, const meter_pr
 
     if (settings->type == METER_PROBE_SENSOR_TSL2585 || settings->type == METER_PROBE_SENSOR_TSL2521) {
         HAL_StatusTypeDef ret = meter_probe_settings_set_tsl2585(&handle->settings_handle, &settings->settings_tsl2585);
+        if (ret == HAL_OK) {
+            settings_clear_accessory_cal(handle->device_type, handle->settings_handle.id.probe_serial);
+        }
         return hal_to_os_status(ret);
     } else {
         log_w("Unsupported settings type");
@@ -810,6 +974,9 @@ osStatus_t densistick_set_settings(meter_probe_handle_t *handle, const densistic
 
     if (settings->type == METER_PROBE_SENSOR_TSL2585 || settings->type == METER_PROBE_SENSOR_TSL2521) {
         HAL_StatusTypeDef ret = densistick_settings_set_tsl2585(&handle->settings_handle, &settings->settings_tsl2585);
+        if (ret == HAL_OK) {
+            settings_clear_accessory_cal(handle->device_type, handle->settings_handle.id.probe_serial);
+        }
         return hal_to_os_status(ret);
     } else {
         log_w("Unsupported settings type");
@@ -825,6 +992,9 @@ osStatus_t densistick_set_settings_target(meter_probe_handle_t *handle, const de
 
     if (handle->settings_handle.id.probe_type == METER_PROBE_SENSOR_TSL2585 || handle->settings_handle.id.probe_type == METER_PROBE_SENSOR_TSL2521) {
         HAL_StatusTypeDef ret = densistick_settings_set_tsl2585_target(&handle->settings_handle, cal_target);
+        if (ret == HAL_OK) {
+            settings_clear_accessory_cal(handle->device_type, handle->settings_handle.id.probe_serial);
+        }
         return hal_to_os_status(ret);
     } else {
         log_w("Unsupported settings type");
@@ -1471,6 +1641,34 @@ osStatus_t meter_probe_control_sensor_trigger_next_reading(meter_probe_handle_t
     return hal_to_os_status(ret);
 }
 
+osStatus_t meter_probe_sensor_set_reading_callback(meter_probe_handle_t *handle,
+    meter_probe_sensor_reading_callback_t callback, void *user_data)
+{
+    if (!handle) { return osErrorParameter; }
+    if (handle->probe_state < METER_PROBE_STATE_STARTED) { return osErrorResource; }
+
+    osStatus_t result = osOK;
+    const meter_probe_control_event_t control_event = {
+        .event_type = METER_PROBE_CONTROL_SENSOR_SET_READING_CALLBACK,
+        .result = &result,
+        .reading_callback = {
+            .callback = callback,
+            .user_data = user_data
+        }
+    };
+    osMessageQueuePut(handle->control_queue, &control_event, 0, portMAX_DELAY);
+    osSemaphoreAcquire(handle->control_semaphore, portMAX_DELAY);
+    return result;
+}
+
+osStatus_t meter_probe_control_sensor_set_reading_callback(meter_probe_handle_t *handle, const sensor_control_reading_callback_params_t *params)
+{
+    log_d("meter_probe_control_sensor_set_reading_callback: %s", params->callback ? "set" : "clear");
+    handle->reading_callback = params->callback;
+    handle->reading_callback_user_data = params->user_data;
+    return osOK;
+}
+
 osStatus_t meter_probe_sensor_clear_last_reading(meter_probe_handle_t *handle)
 {
     if (!handle) { return osErrorParameter; }
@@ -1597,7 +1795,7 @@ meter_probe_result_t densistick_measure(meter_probe_handle_t *handle, float *den
     int agc_step;
     int invalid_count;
     int reading_count;
-    float reading_sum;
+    float reading_list[DENSISTICK_MEASURE_READING_COUNT];
 
     if (!handle) {
         return METER_READING_FAIL;
@@ -1641,7 +1839,6 @@ meter_probe_result_t densistick_measure(meter_probe_handle_t *handle, float *den
         agc_step = 1;
         invalid_count = 0;
         reading_count = 0;
-        reading_sum = 0;
         do {
             ret = meter_probe_sensor_get_next_reading(handle, &reading, 500);
             if (ret == osErrorTimeout) {
@@ -1679,28 +1876,15 @@ meter_probe_result_t densistick_measure(meter_probe_handle_t *handle, float *den
             }
 
             /* Collect the measurement */
-            float basic_reading = meter_probe_basic_result(handle, &reading);
-            reading_sum += basic_reading;
-            reading_count++;
-        } while (reading_count < 2);
+            reading_list[reading_count++] = meter_probe_basic_result(handle, &reading);
+        } while (reading_count < DENSISTICK_MEASURE_READING_COUNT);
         if (ret != osOK) { break; }
 
-        float avg_reading = reading_sum / (float)reading_count;
+        float avg_reading = stats_mean_f32(reading_list, reading_count);
 
         log_d("Raw reading: %f", avg_reading);
 
-        const densistick_settings_tsl2585_cal_target_t *cal_target = &handle->stick_settings.cal_target;
-
-        /* Convert all values into log units */
-        float meas_ll = log10f(avg_reading);
-        float cal_hi_ll = log10f(cal_target->hi_reading);
-        float cal_lo_ll = log10f(cal_target->lo_reading);
-
-        /* Calculate the slope of the line */
-        float m = (cal_target->hi_density - cal_target->lo_density) / (cal_hi_ll - cal_lo_ll);
-
-        /* Calculate the measured density */
-        float meas_d = (m * (meas_ll - cal_lo_ll)) + cal_target->lo_density;
+        float meas_d = densistick_calculate_density(handle, avg_reading);
 
         log_d("Target density: %f", meas_d);
 
@@ -1725,27 +1909,240 @@ meter_probe_result_t densistick_measure(meter_probe_handle_t *handle, float *den
     return result;
 }
 
+meter_probe_result_t densistick_measure_fast(meter_probe_handle_t *handle, float *density, float *raw_reading)
+{
+    meter_probe_result_t result = METER_READING_OK;
+    osStatus_t ret = osOK;
+    meter_probe_sensor_reading_t reading;
+    densistick_fast_t fast;
+
+    if (!handle) {
+        return METER_READING_FAIL;
+    }
+
+    if (handle->device_type != METER_PROBE_DEVICE_DENSISTICK) { return METER_READING_FAIL; }
+
+    const uint32_t start_ticks = osKernelGetTickCount();
+
+    do {
+        if (!densistick_is_fast_ready(handle)) {
+            ret = densistick_start_fast(handle);
+            if (ret != osOK) { break; }
+        }
+
+        densistick_fast_init(&fast, TSL2585_GAIN_256X, handle->stick_fast_gain, handle->stick_fast_reading,
+            densistick_fast_density_callback, handle);
+
+        /* Discard anything left over from before this measurement */
+        meter_probe_sensor_clear_last_reading(handle);
+
+        densistick_fast_action_t action = DENSISTICK_FAST_CONTINUE;
+        do {
+            ret = meter_probe_sensor_get_next_reading(handle, &reading, 500);
+            if (ret == osErrorTimeout) {
+                result = METER_READING_TIMEOUT;
+                break;
+            } else if (ret != osOK) {
+                result = METER_READING_FAIL;
+                break;
+            }
+
+            /* Skip readings where integration began before this measurement */
+            const float atime_ms = tsl2585_integration_time_ms(reading.sample_time, reading.sample_count);
+            if ((int32_t)(reading.ticks - start_ticks) < (int32_t)lroundf(atime_ms)) {
+                continue;
+            }
+
+            densistick_fast_sample_t sample;
+            float basic_reading = NAN;
+            if (reading.reading[0].status == METER_SENSOR_RESULT_SATURATED_ANALOG
+                || reading.reading[0].status == METER_SENSOR_RESULT_SATURATED_DIGITAL) {
+                sample = DENSISTICK_FAST_SAMPLE_SATURATED;
+            } else if (reading.reading[0].status != METER_SENSOR_RESULT_VALID) {
+                sample = DENSISTICK_FAST_SAMPLE_INVALID;
+            } else {
+                sample = DENSISTICK_FAST_SAMPLE_VALID;
+                basic_reading = meter_probe_basic_result(handle, &reading);
+            }
+
+            action = densistick_fast_add_reading(&fast, sample, reading.reading[0].gain, basic_reading);
+            if (action == DENSISTICK_FAST_SET_GAIN) {
+                log_d("Fast measurement gain: %s", tsl2585_gain_str((tsl2585_gain_t)fast.gain));
+                ret = meter_probe_sensor_set_gain(handle, (tsl2585_gain_t)fast.gain);
+                if (ret != osOK) { break; }
+            } else if (action == DENSISTICK_FAST_HIGH) {
+                result = METER_READING_HIGH;
+            } else if (action == DENSISTICK_FAST_TIMEOUT) {
+                result = METER_READING_TIMEOUT;
+            } else if (action == DENSISTICK_FAST_FAIL) {
+                result = METER_READING_FAIL;
+            }
+        } while (action == DENSISTICK_FAST_CONTINUE || action == DENSISTICK_FAST_SET_GAIN);
+        if (ret != osOK || result != METER_READING_OK) { break; }
+
+        handle->stick_fast_gain = (tsl2585_gain_t)fast.gain;
+        handle->stick_fast_reading = fast.reading;
+
+        log_d("Fast reading: %f, D=%f, %d readings, %lums",
+            fast.reading, fast.density, fast.reading_count, osKernelGetTickCount() - start_ticks);
+
+        if (density) {
+            *density = fast.density;
+        }
+
+        if (raw_reading) {
+            *raw_reading = fast.reading;
+        }
+    } while (0);
+
+    /* Fix any missed errors */
+    if (ret != osOK && result == METER_READING_OK) {
+        result = METER_READING_FAIL;
+    }
+
+    /* Start from scratch next time, if anything went wrong */
+    if (result != METER_READING_OK) {
+        handle->stick_fast_reading = NAN;
+    }
+
+    return result;
+}
+
+float densistick_fast_density_callback(float reading, void *user_data)
+{
+    return densistick_calculate_density((const meter_probe_handle_t *)user_data, reading);
+}
+
+bool densistick_is_fast_ready(const meter_probe_handle_t *handle)
+{
+    return handle->probe_state == METER_PROBE_STATE_RUNNING
+        && handle->sensor_state.start_mode == METER_PROBE_START_NORMAL
+        && !handle->sensor_state.agc_enabled
+        && handle->sensor_state.sample_time == 719
+        && handle->sensor_state.sample_count == DENSISTICK_FAST_SAMPLE_COUNT
+        && handle->stick_light_enabled
+        && handle->stick_light_brightness == 0;
+}
+
+osStatus_t densistick_start_fast(meter_probe_handle_t *handle)
+{
+    osStatus_t ret = osOK;
+    meter_probe_sensor_reading_t reading;
+    const bool has_gain = isnormal(handle->stick_fast_reading);
+
+    do {
+        if (handle->probe_state == METER_PROBE_STATE_RUNNING) {
+            ret = meter_probe_sensor_disable(handle);
+            if (ret != osOK) { break; }
+        }
+
+        /* Configure light for full power */
+        ret = densistick_set_light_brightness(handle, 0);
+        if (ret != osOK) { break; }
+
+        ret = densistick_set_light_enable(handle, true);
+        if (ret != osOK) { break; }
+
+        if (has_gain) {
+            /* Start directly from the gain of the previous measurement */
+            ret = meter_probe_sensor_set_gain(handle, handle->stick_fast_gain);
+            if (ret != osOK) { break; }
+
+            ret = meter_probe_sensor_set_integration(handle, 719, DENSISTICK_FAST_SAMPLE_COUNT);
+            if (ret != osOK) { break; }
+
+            ret = meter_probe_sensor_enable(handle);
+            if (ret != osOK) { break; }
+        } else {
+            /* Use AGC to find the initial gain, as with a normal measurement */
+            ret = meter_probe_sensor_set_gain(handle, TSL2585_GAIN_256X);
+            if (ret != osOK) { break; }
+
+            ret = meter_probe_sensor_set_integration(handle, 719, 29);
+            if (ret != osOK) { break; }
+
+            ret = meter_probe_sensor_enable_agc(handle, 19);
+            if (ret != osOK) { break; }
+
+            ret = meter_probe_sensor_enable(handle);
+            if (ret != osOK) { break; }
+
+            int invalid_count = 0;
+            do {
+                ret = meter_probe_sensor_get_next_reading(handle, &reading, 500);
+                if (ret != osOK) { break; }
+                if (reading.reading[0].status == METER_SENSOR_RESULT_VALID) { break; }
+                invalid_count++;
+            } while (invalid_count <= 5);
+            if (ret != osOK) { break; }
+            if (reading.reading[0].status != METER_SENSOR_RESULT_VALID) {
+                ret = osErrorTimeout;
+                break;
+            }
+
+            /* Disable AGC, which keeps the gain it settled on */
+            ret = meter_probe_sensor_disable_agc(handle);
+            if (ret != osOK) { break; }
+
+            ret = meter_probe_sensor_get_next_reading(handle, &reading, 500);
+            if (ret != osOK) { break; }
+
+            ret = meter_probe_sensor_set_integration(handle, 719, DENSISTICK_FAST_SAMPLE_COUNT);
+            if (ret != osOK) { break; }
+        }
+    } while (0);
+
+    if (ret != osOK) {
+        densistick_set_light_enable(handle, false);
+        if (handle->probe_state == METER_PROBE_STATE_RUNNING) {
+            meter_probe_sensor_disable(handle);
+        }
+    }
+
+    return ret;
+}
+
+float densistick_calculate_density(const meter_probe_handle_t *handle, float reading)
+{
+    const densistick_settings_tsl2585_cal_target_t *cal_target = &handle->stick_settings.cal_target;
+
+    /* Convert all values into log units */
+    float meas_ll = exposure_math_log10(reading);
+    float cal_hi_ll = exposure_math_log10(cal_target->hi_reading);
+    float cal_lo_ll = exposure_math_log10(cal_target->lo_reading);
+
+    /* Calculate the slope of the line */
+    float m = (cal_target->hi_density - cal_target->lo_density) / (cal_hi_ll - cal_lo_ll);
+
+    /* Calculate the measured density */
+    return (m * (meas_ll - cal_lo_ll)) + cal_target->lo_density;
+}
+
 float meter_probe_basic_result(const meter_probe_handle_t *handle, const meter_probe_sensor_reading_t *sensor_reading)
 {
     if (!handle || !sensor_reading) { return NAN; }
+    return meter_probe_basic_result_impl(handle, sensor_reading, 0);
+}
 
+float meter_probe_basic_result_impl(const meter_probe_handle_t *handle, const meter_probe_sensor_reading_t *sensor_reading, uint8_t index)
+{
     const float atime_ms = tsl2585_integration_time_ms(sensor_reading->sample_time, sensor_reading->sample_count);
 
     float als_gain;
-    if (sensor_reading->reading[0].gain <= TSL2585_GAIN_256X) {
+    if (sensor_reading->reading[index].gain <= TSL2585_GAIN_256X) {
         if (handle->device_type == METER_PROBE_DEVICE_METER_PROBE) {
-            als_gain = handle->probe_settings.cal_gain.values[sensor_reading->reading[0].gain];
+            als_gain = handle->probe_settings.cal_gain.values[sensor_reading->reading[index].gain];
         } else {
-            als_gain = handle->stick_settings.cal_gain.values[sensor_reading->reading[0].gain];
+            als_gain = handle->stick_settings.cal_gain.values[sensor_reading->reading[index].gain];
         }
     } else {
-        als_gain = tsl2585_gain_value(sensor_reading->reading[0].gain);
+        als_gain = tsl2585_gain_value(sensor_reading->reading[index].gain);
     }
 
     if (!is_valid_number(atime_ms) || !is_valid_number(als_gain)) { return NAN; }
 
     /* Divide to get numbers in a similar range as previous sensors */
-    float als_reading = (float)sensor_reading->reading[0].data / 16.0F;
+    float als_reading = (float)sensor_reading->reading[index].data / 16.0F;
 
     /* Calculate the basic reading */
     float basic_reading = als_reading / (atime_ms * als_gain);
@@ -1758,9 +2155,9 @@ float meter_probe_basic_result(const meter_probe_handle_t *handle, const meter_p
      */
     const meter_probe_settings_tsl2585_cal_slope_t *cal_slope = &handle->probe_settings.cal_slope;
     if (!isnanf(cal_slope->b0) && !isnanf(cal_slope->b1) && !isnanf(cal_slope->b2)) {
-        float l_reading = log10f(basic_reading);
-        float l_expected = cal_slope->b0 + (cal_slope->b1 * l_reading) + (cal_slope->b2 * powf(l_reading, 2.0F));
-        float corr_reading = powf(10.0F, l_expected);
+        float l_reading = exposure_math_log10(basic_reading);
+        float l_expected = cal_slope->b0 + (cal_slope->b1 * l_reading) + (cal_slope->b2 * l_reading * l_reading);
+        float corr_reading = exposure_math_exp10(l_expected);
         return corr_reading;
     } else {
         return basic_reading;
@@ -1769,8 +2166,13 @@ float meter_probe_basic_result(const meter_probe_handle_t *handle, const meter_p
 
 float meter_probe_lux_result(const meter_probe_handle_t *handle, const meter_probe_sensor_reading_t *sensor_reading)
 {
-    if (!handle || !sensor_reading) { return NAN; }
-    if (sensor_reading->reading[0].gain >= TSL2585_GAIN_MAX) { return NAN; }
+    return meter_probe_lux_result_at(handle, sensor_reading, 0);
+}
+
+float meter_probe_lux_result_at(const meter_probe_handle_t *handle, const meter_probe_sensor_reading_t *sensor_reading, uint8_t index)
+{
+    if (!handle || !sensor_reading || index >= MAX_ALS_COUNT) { return NAN; }
+    if (sensor_reading->reading[index].gain >= TSL2585_GAIN_MAX) { return NAN; }
     if (!handle->has_sensor_settings) { return NAN; }
     if (handle->device_type != METER_PROBE_DEVICE_METER_PROBE) { return NAN; }
 
@@ -1778,7 +2180,7 @@ float meter_probe_lux_result(const meter_probe_handle_t *handle, const meter_pro
     const float lux_intercept = handle->probe_settings.cal_target.lux_intercept;
     if (!is_valid_number(lux_slope) || !is_valid_number(lux_intercept)) { return NAN; }
 
-    const float basic_value = meter_probe_basic_result(handle, sensor_reading);
+    const float basic_value = meter_probe_basic_result_impl(handle, sensor_reading, index);
     if (!is_valid_number(basic_value)) { return NAN; }
 
     float lux = (basic_value * lux_slope) + lux_intercept;
@@ -1937,6 +2339,14 @@ osStatus_t meter_probe_control_interrupt(meter_probe_handle_t *handle, const sen
             tsl2585_integration_time_ms(sensor_state.sample_time, sensor_state.sample_count));
 #endif
 
+        /*
+         * The callback sees every reading, while the queue only holds
+         * whichever one is the most recent when the consumer gets to it.
+         */
+        if (handle->reading_callback) {
+            handle->reading_callback(handle, &sensor_reading, handle->reading_callback_user_data);
+        }
+
         QueueHandle_t queue = (QueueHandle_t)handle->sensor_reading_queue;
         xQueueOverwrite(queue, &sensor_reading);
     }
@@ -81,6 +81,15 @@ typedef struct {
 
 typedef struct __meter_probe_handle_t meter_probe_handle_t;
 
+/**
+ * Callback to receive every sensor reading as it is produced.
+ *
+ * This is called from within the meter probe task, so it must return
+ * quickly and must not call any of the meter probe control functions.
+ */
+typedef void (*meter_probe_sensor_reading_callback_t)(const meter_probe_handle_t *handle,
+    const meter_probe_sensor_reading_t *reading, void *user_data);
+
 /**
 * Get the handle to the meter probe instance
 */
@@ -339,6 +348,23 @@ osStatus_t meter_probe_sensor_clear_last_reading(meter_probe_handle_t *handle);
  */
 osStatus_t meter_probe_sensor_get_next_reading(meter_probe_handle_t *handle, meter_probe_sensor_reading_t *reading, uint32_t timeout);
 
+/**
+ * Set a callback to receive every sensor reading.
+ *
+ * Unlike meter_probe_sensor_get_next_reading(), which only ever returns
+ * the most recent reading, this never misses a reading because the
+ * consumer was busy. This makes it suitable for collecting statistics
+ * across all the readings in fast mode.
+ *
+ * Once this function returns, the previous callback is guaranteed to
+ * no longer be running.
+ *
+ * @param callback Callback function, or NULL to clear it
+ * @param user_data Pointer passed through to the callback
+ */
+osStatus_t meter_probe_sensor_set_reading_callback(meter_probe_handle_t *handle,
+    meter_probe_sensor_reading_callback_t callback, void *user_data);
+
 /**
  * High level function to get a light reading in lux.
  *
@@ -365,6 +391,21 @@ meter_probe_result_t meter_probe_try_measure(meter_probe_handle_t *handle, float
 */
 meter_probe_result_t densistick_measure(meter_probe_handle_t *handle, float *density, float *raw_reading);
 
+/**
+ * Get a reflection density reading from the DensiStick, optimized for
+ * taking many measurements back-to-back.
+ *
+ * The first measurement finds the sensor gain using AGC, the same as
+ * the standard measurement cycle. Later measurements start from the gain
+ * used last time, adjusted for the difference between the readings,
+ * and integration stops as soon as the density estimate converges.
+ *
+ * The light and sensor are left running at the end of the measurement,
+ * so the next one can start immediately. The caller is responsible for
+ * disabling them once it is done taking measurements.
+ */
+meter_probe_result_t densistick_measure_fast(meter_probe_handle_t *handle, float *density, float *raw_reading);
+
 /**
  * Get the result in a gain and integration time adjusted format.
  *
@@ -387,4 +428,14 @@ float meter_probe_basic_result(const meter_probe_handle_t *handle, const meter_p
  */
 float meter_probe_lux_result(const meter_probe_handle_t *handle, const meter_probe_sensor_reading_t *sensor_reading);
 
+/**
+ * Get the result in lux units for a specific ALS result within a
+ * sensor reading, as returned in batches in fast mode.
+ *
+ * @param sensor_reading Sensor reading data
+ * @param index Index of the ALS result within the reading
+ * @return Calibrated lux value
+ */
+float meter_probe_lux_result_at(const meter_probe_handle_t *handle, const meter_probe_sensor_reading_t *sensor_reading, uint8_t index);
+
 #endif /* METER_PROBE_H */
@@ -69,12 +69,18 @@ extern CRC_HandleTypeDef hcrc;
 HAL_StatusTypeDef meter_probe_settings_init(meter_probe_settings_handle_t *handle, i2c_handle_t *hi2c)
 {
     HAL_StatusTypeDef ret;
-    uint8_t header_data[PAGE_HEADER_SIZE];
+    uint8_t header_data[PAGE_HEADER_SIZE + 4];
+
+    _Static_assert(PAGE_HEADER + PAGE_HEADER_SIZE == PAGE_CAL, "Calibration must follow the header");
 
     if (!handle || handle->initialized || !hi2c) { return HAL_ERROR; }
 
     do {
-        /* Read the identification area of the meter probe memory */
+        /*
+         * Read the identification area of the meter probe memory, along
+         * with the version field at the start of the calibration data
+         * that immediately follows it.
+         */
         ret = m24c08_read_buffer(hi2c, PAGE_HEADER, header_data, sizeof(header_data));
         if (ret != HAL_OK) { break; }
 
@@ -95,6 +101,7 @@ HAL_StatusTypeDef meter_probe_settings_init(meter_probe_settings_handle_t *handl
         handle->id.probe_type = header_data[HEADER_DEV_TYPE];
         handle->id.probe_rev_major = header_data[HEADER_DEV_REV_MAJOR];
         handle->id.probe_rev_minor = header_data[HEADER_DEV_REV_MINOR];
+        handle->cal_version = copy_to_u32(header_data + PAGE_HEADER_SIZE + CAL_TSL2585_VERSION);
 
         handle->hi2c = hi2c;
 
@@ -128,26 +135,46 @@ HAL_StatusTypeDef meter_probe_settings_clear(i2c_handle_t *hi2c)
     return ret;
 }
 
+HAL_StatusTypeDef meter_probe_settings_read_cal(const meter_probe_settings_handle_t *handle, uint8_t *data)
+{
+    _Static_assert(PAGE_CAL_SIZE == METER_PROBE_SETTINGS_CAL_SIZE, "Unexpected calibration data size");
+
+    if (!handle || !data) { return HAL_ERROR; }
+    if (!handle->initialized) { return HAL_ERROR; }
+
+    return m24c08_read_buffer(handle->hi2c, PAGE_CAL, data, PAGE_CAL_SIZE);
+}
+
 HAL_StatusTypeDef meter_probe_settings_get_tsl2585(const meter_probe_settings_handle_t *handle,
     meter_probe_settings_tsl2585_t *settings_tsl2585)
 {
     HAL_StatusTypeDef ret = HAL_OK;
+    uint8_t data[PAGE_CAL_SIZE];
+
     if (!handle || !settings_tsl2585) { return HAL_ERROR; }
     if (!handle->initialized) { return HAL_ERROR; }
+
+    /* Read the whole data buffer */
+    ret = m24c08_read_buffer(handle->hi2c, PAGE_CAL, data, PAGE_CAL_SIZE);
+    if (ret != HAL_OK) { return ret; }
+
+    return meter_probe_settings_parse_tsl2585(handle, data, settings_tsl2585);
+}
+
+HAL_StatusTypeDef meter_probe_settings_parse_tsl2585(const meter_probe_settings_handle_t *handle,
+    const uint8_t *data, meter_probe_settings_tsl2585_t *settings_tsl2585)
+{
+    HAL_StatusTypeDef ret = HAL_OK;
+    if (!handle || !data || !settings_tsl2585) { return HAL_ERROR; }
     if (handle->id.probe_type != METER_PROBE_SENSOR_TSL2585
         && handle->id.probe_type != METER_PROBE_SENSOR_TSL2521) {
         return HAL_ERROR;
     }
 
-    uint8_t data[PAGE_CAL_SIZE];
     uint32_t version;
     uint32_t crc;
     uint32_t calculated_crc;
 
-    /* Read the whole data buffer */
-    ret = m24c08_read_buffer(handle->hi2c, PAGE_CAL, data, PAGE_CAL_SIZE);
-    if (ret != HAL_OK) { return ret; }
-
     /* Get the version */
     version = copy_to_u32(data + CAL_TSL2585_VERSION);
 
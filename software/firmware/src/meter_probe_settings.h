@@ -8,6 +8,12 @@
 
 typedef struct i2c_handle_t i2c_handle_t;
 
+/**
+ * Size of the raw calibration data block, which has the same location
+ * and size on both the Meter Probe and the DensiStick.
+ */
+#define METER_PROBE_SETTINGS_CAL_SIZE 112
+
 typedef enum {
     METER_PROBE_SENSOR_UNKNOWN = 0,
     METER_PROBE_SENSOR_TSL2585 = 1,
@@ -25,6 +31,7 @@ typedef struct __meter_probe_settings_handle_t {
     i2c_handle_t *hi2c;
     bool initialized;
     meter_probe_id_t id;
+    uint32_t cal_version;
 } meter_probe_settings_handle_t;
 
 typedef struct __meter_probe_settings_tsl2585_cal_gain_t {
@@ -65,9 +72,27 @@ HAL_StatusTypeDef meter_probe_settings_init(meter_probe_settings_handle_t *handl
  */
 HAL_StatusTypeDef meter_probe_settings_clear(i2c_handle_t *hi2c);
 
+/**
+ * Read the raw calibration data block from the connected device.
+ *
+ * This works for both the Meter Probe and the DensiStick, and the
+ * result can be passed to the matching parse function.
+ *
+ * @param data Buffer of METER_PROBE_SETTINGS_CAL_SIZE bytes
+ */
+HAL_StatusTypeDef meter_probe_settings_read_cal(const meter_probe_settings_handle_t *handle, uint8_t *data);
+
 HAL_StatusTypeDef meter_probe_settings_get_tsl2585(const meter_probe_settings_handle_t *handle,
     meter_probe_settings_tsl2585_t *settings_tsl2585);
 
+/**
+ * Parse a raw calibration data block into the TSL2585 settings.
+ *
+ * @param data Buffer of METER_PROBE_SETTINGS_CAL_SIZE bytes
+ */
+HAL_StatusTypeDef meter_probe_settings_parse_tsl2585(const meter_probe_settings_handle_t *handle,
+    const uint8_t *data, meter_probe_settings_tsl2585_t *settings_tsl2585);
+
 HAL_StatusTypeDef meter_probe_settings_set_tsl2585(const meter_probe_settings_handle_t *handle,
     const meter_probe_settings_tsl2585_t *settings_tsl2585);
 
@@ -0,0 +1,105 @@
+#include "meter_scan.h"
+
+#include <string.h>
+#include <math.h>
+
+void meter_scan_init(meter_scan_t *scan)
+{
+    memset(scan, 0, sizeof(meter_scan_t));
+    scan->lux_min = NAN;
+    scan->lux_max = NAN;
+    for (int i = 0; i <= METER_SCAN_TRIM_COUNT; i++) {
+        scan->lux_low[i] = NAN;
+        scan->lux_high[i] = NAN;
+    }
+}
+
+bool meter_scan_add(meter_scan_t *scan, float lux)
+{
+    /* Zero has no place on a log scale, and is no use for exposure either */
+    if (!isfinite(lux) || lux <= 0.0F) {
+        scan->invalid++;
+        return false;
+    }
+
+    if (scan->count == 0 || lux < scan->lux_min) {
+        scan->lux_min = lux;
+    }
+    if (scan->count == 0 || lux > scan->lux_max) {
+        scan->lux_max = lux;
+    }
+
+    /* Insert into the lists of extreme readings, which are kept in order */
+    const bool full = scan->count > METER_SCAN_TRIM_COUNT;
+    const int last = full ? METER_SCAN_TRIM_COUNT : (int)scan->count;
+    if (!full || lux < scan->lux_low[METER_SCAN_TRIM_COUNT]) {
+        int i = last;
+        for (; i > 0 && scan->lux_low[i - 1] > lux; i--) {
+            scan->lux_low[i] = scan->lux_low[i - 1];
+        }
+        scan->lux_low[i] = lux;
+    }
+    if (!full || lux > scan->lux_high[METER_SCAN_TRIM_COUNT]) {
+        int i = last;
+        for (; i > 0 && scan->lux_high[i - 1] < lux; i--) {
+            scan->lux_high[i] = scan->lux_high[i - 1];
+        }
+        scan->lux_high[i] = lux;
+    }
+    scan->count++;
+
+    int bin = 0;
+    const float pos = (log10f(lux) - METER_SCAN_HISTOGRAM_MIN) / METER_SCAN_HISTOGRAM_STEP;
+    if (pos >= (float)METER_SCAN_HISTOGRAM_BINS) {
+        bin = METER_SCAN_HISTOGRAM_BINS - 1;
+    } else if (pos > 0.0F) {
+        bin = (int)pos;
+    }
+    scan->histogram[bin]++;
+
+    return true;
+}
+
+void meter_scan_add_rejected(meter_scan_t *scan, bool saturated)
+{
+    if (saturated) {
+        scan->saturated++;
+    } else {
+        scan->invalid++;
+    }
+}
+
+bool meter_scan_trimmed_range(const meter_scan_t *scan, float *lux_min, float *lux_max)
+{
+    /* There must be at least one reading left after dropping both ends */
+    if (scan->count < (METER_SCAN_TRIM_COUNT * 2) + 1) {
+        return false;
+    }
+
+    if (lux_min) {
+        *lux_min = scan->lux_low[METER_SCAN_TRIM_COUNT];
+    }
+    if (lux_max) {
+        *lux_max = scan->lux_high[METER_SCAN_TRIM_COUNT];
+    }
+    return true;
+}
+
+float meter_scan_range_stops(const meter_scan_t *scan)
+{
+    float lux_min;
+    float lux_max;
+
+    if (!meter_scan_trimmed_range(scan, &lux_min, &lux_max)) {
+        return NAN;
+    }
+    return log2f(lux_max / lux_min);
+}
+
+float meter_scan_bin_lux(uint8_t bin)
+{
+    if (bin >= METER_SCAN_HISTOGRAM_BINS) {
+        return NAN;
+    }
+    return powf(10.0F, METER_SCAN_HISTOGRAM_MIN + (METER_SCAN_HISTOGRAM_STEP * ((float)bin + 0.5F)));
+}
@@ -0,0 +1,91 @@
+#ifndef METER_SCAN_H
+#define METER_SCAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Running statistics for a scan across the easel with the meter probe.
+ *
+ * Readings are folded into a minimum, a maximum, and a histogram of
+ * log10(lux) as they arrive, so the cost of each reading is constant
+ * and no reading ever needs to be kept around.
+ *
+ * A sweep across the easel can pick up stray readings, such as from a
+ * reflection or the edge of the probe passing over the easel blades.
+ * So the few most extreme readings at each end are also kept, and the
+ * range used for exposure drops those outliers.
+ *
+ * This code has no dependencies on the HAL or RTOS, so it can also be
+ * compiled and tested on a host system.
+ */
+
+/** Number of bins in the scan histogram */
+#define METER_SCAN_HISTOGRAM_BINS 64
+
+/** Lower edge of the first histogram bin, in log10(lux) */
+#define METER_SCAN_HISTOGRAM_MIN (-3.0F)
+
+/** Width of each histogram bin, in log10(lux), which is 1/3 stop */
+#define METER_SCAN_HISTOGRAM_STEP (0.1F)
+
+/** Number of readings at each end of the scan rejected as outliers */
+#define METER_SCAN_TRIM_COUNT 2
+
+typedef struct {
+    float lux_min;      /*!< Lowest reading, which is the print highlight */
+    float lux_max;      /*!< Highest reading, which is the print shadow */
+    uint32_t count;     /*!< Number of valid readings */
+    uint32_t saturated; /*!< Number of readings discarded for sensor saturation */
+    uint32_t invalid;   /*!< Number of readings discarded for any other reason */
+    float lux_low[METER_SCAN_TRIM_COUNT + 1];  /*!< Lowest readings, in ascending order */
+    float lux_high[METER_SCAN_TRIM_COUNT + 1]; /*!< Highest readings, in descending order */
+    uint32_t histogram[METER_SCAN_HISTOGRAM_BINS];
+} meter_scan_t;
+
+/**
+ * Initialize or clear the scan statistics.
+ */
+void meter_scan_init(meter_scan_t *scan);
+
+/**
+ * Add a lux reading to the scan statistics.
+ *
+ * Readings outside the range of the histogram are counted in its
+ * first or last bin, but still update the minimum and maximum.
+ * Readings of zero are counted as invalid.
+ *
+ * @return True if the reading was valid and added
+ */
+bool meter_scan_add(meter_scan_t *scan, float lux);
+
+/**
+ * Count a reading that the sensor could not provide.
+ *
+ * @param saturated True if the sensor was saturated, false for any other reason
+ */
+void meter_scan_add_rejected(meter_scan_t *scan, bool saturated);
+
+/**
+ * Get the lowest and highest readings of the scan, with outliers
+ * rejected by dropping the METER_SCAN_TRIM_COUNT most extreme readings
+ * at each end.
+ *
+ * @return True if the scan has enough readings to reject outliers
+ */
+bool meter_scan_trimmed_range(const meter_scan_t *scan, float *lux_min, float *lux_max);
+
+/**
+ * Get the range of the scan, in stops between its lowest and
+ * highest readings, with outliers rejected.
+ *
+ * @return Range in stops, or NAN if the scan has too few readings
+ */
+float meter_scan_range_stops(const meter_scan_t *scan);
+
+/**
+ * Get the lux value at the center of a histogram bin.
+ */
+float meter_scan_bin_lux(uint8_t bin);
+
+#endif /* METER_SCAN_H */
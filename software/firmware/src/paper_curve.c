@@ -0,0 +1,177 @@
+#include "paper_curve.h"
+
+#include <math.h>
+
+/**
+ * Maximum number of iterations used when solving for a crossing point.
+ */
+#define PAPER_CURVE_MAX_ITERATIONS 32
+
+/**
+ * Convergence tolerance for the crossing point, in PEV units.
+ */
+#define PAPER_CURVE_TOLERANCE (0.001F)
+
+static float paper_curve_segment_value(const paper_curve_t *curve, size_t i, float t);
+static float paper_curve_segment_slope(const paper_curve_t *curve, size_t i, float t);
+static float paper_curve_segment_solve(const paper_curve_t *curve, size_t i, float y);
+
+size_t paper_curve_arena_size(size_t count)
+{
+    if (count < 2) { return 0; }
+
+    /* x[n], y[n], b[n-1], c[n], d[n-1] */
+    return sizeof(float) * ((5 * count) - 2);
+}
+
+bool paper_curve_init(paper_curve_t *curve, void *arena, size_t arena_size, size_t count)
+{
+    if (!curve || !arena || count < 2) { return false; }
+    if (arena_size < paper_curve_arena_size(count)) { return false; }
+
+    float *buf = arena;
+    curve->count = count;
+    curve->x = buf;
+    curve->y = curve->x + count;
+    curve->b = curve->y + count;
+    curve->c = curve->b + (count - 1);
+    curve->d = curve->c + count;
+    return true;
+}
+
+bool paper_curve_solve(paper_curve_t *curve)
+{
+    if (!curve || curve->count < 2) { return false; }
+
+    const size_t n = curve->count;
+    const float *x = curve->x;
+    const float *y = curve->y;
+    float *b = curve->b;
+    float *c = curve->c;
+    float *d = curve->d;
+
+    for (size_t i = 0; i < n - 1; i++) {
+        if (!(x[i + 1] > x[i])) {
+            return false;
+        }
+    }
+
+    /*
+     * Solve the tridiagonal system for the natural spline.
+     * During the forward sweep, the b and d arrays are borrowed to hold
+     * the intermediate mu and z terms, which are consumed by the back
+     * substitution just before each slot receives its final value.
+     */
+    float *mu = b;
+    float *z = d;
+    mu[0] = 0.0F;
+    z[0] = 0.0F;
+    for (size_t i = 1; i < n - 1; i++) {
+        const float h0 = x[i] - x[i - 1];
+        const float h1 = x[i + 1] - x[i];
+        const float alpha = (3.0F / h1) * (y[i + 1] - y[i]) - (3.0F / h0) * (y[i] - y[i - 1]);
+        const float l = 2.0F * (x[i + 1] - x[i - 1]) - h0 * mu[i - 1];
+        mu[i] = h1 / l;
+        z[i] = (alpha - h0 * z[i - 1]) / l;
+    }
+
+    c[n - 1] = 0.0F;
+    for (size_t j = n - 1; j-- > 0;) {
+        const float h = x[j + 1] - x[j];
+        c[j] = z[j] - mu[j] * c[j + 1];
+        b[j] = (y[j + 1] - y[j]) / h - h * (c[j + 1] + 2.0F * c[j]) / 3.0F;
+        d[j] = (c[j + 1] - c[j]) / (3.0F * h);
+    }
+
+    return true;
+}
+
+float paper_curve_segment_value(const paper_curve_t *curve, size_t i, float t)
+{
+    return curve->y[i] + t * (curve->b[i] + t * (curve->c[i] + t * curve->d[i]));
+}
+
+float paper_curve_segment_slope(const paper_curve_t *curve, size_t i, float t)
+{
+    return curve->b[i] + t * (2.0F * curve->c[i] + t * 3.0F * curve->d[i]);
+}
+
+float paper_curve_evaluate(const paper_curve_t *curve, float x)
+{
+    if (!curve || curve->count < 2) { return NAN; }
+
+    /* Find the segment containing the value, clamped to the end segments */
+    size_t i = 0;
+    while (i < curve->count - 2 && x >= curve->x[i + 1]) {
+        i++;
+    }
+
+    return paper_curve_segment_value(curve, i, x - curve->x[i]);
+}
+
+/**
+ * Find the crossing point within a segment whose endpoint values are
+ * already known to bracket the target value.
+ */
+float paper_curve_segment_solve(const paper_curve_t *curve, size_t i, float y)
+{
+    const float h = curve->x[i + 1] - curve->x[i];
+    const bool rising = curve->y[i + 1] >= curve->y[i];
+    float lo = 0.0F;
+    float hi = h;
+    float t = h * 0.5F;
+
+    for (int iter = 0; iter < PAPER_CURVE_MAX_ITERATIONS; iter++) {
+        const float f = paper_curve_segment_value(curve, i, t) - y;
+
+        /* Narrow the bracket around the crossing */
+        if ((f < 0.0F) == rising) {
+            lo = t;
+        } else {
+            hi = t;
+        }
+
+        /* Take a Newton step, falling back to bisection if it leaves the bracket */
+        const float slope = paper_curve_segment_slope(curve, i, t);
+        float t_next = (slope != 0.0F) ? t - (f / slope) : NAN;
+        if (!(t_next > lo && t_next < hi)) {
+            t_next = (lo + hi) * 0.5F;
+        }
+
+        if (fabsf(t_next - t) < PAPER_CURVE_TOLERANCE) {
+            t = t_next;
+            break;
+        }
+        t = t_next;
+    }
+
+    return curve->x[i] + t;
+}
+
+float paper_curve_find_x(const paper_curve_t *curve, float y, bool *exact)
+{
+    if (exact) { *exact = false; }
+    if (!curve || curve->count < 2) { return NAN; }
+
+    for (size_t i = 0; i < curve->count - 1; i++) {
+        const float f0 = curve->y[i] - y;
+        const float f1 = curve->y[i + 1] - y;
+        if (f0 == 0.0F) {
+            if (exact) { *exact = true; }
+            return curve->x[i];
+        }
+        if ((f0 < 0.0F) != (f1 < 0.0F)) {
+            if (exact) { *exact = true; }
+            return paper_curve_segment_solve(curve, i, y);
+        }
+    }
+
+    /* No crossing was found, so return the closest point */
+    size_t closest = 0;
+    for (size_t i = 1; i < curve->count; i++) {
+        if (fabsf(curve->y[i] - y) < fabsf(curve->y[closest] - y)) {
+            closest = i;
+        }
+    }
+    return curve->x[closest];
+}
@@ -0,0 +1,83 @@
+/*
+ * Characteristic curve solver for paper calibration
+ *
+ * Fits a natural cubic spline through a set of measured (PEV, density)
+ * points, and finds the PEV values where the curve crosses specific
+ * density values. All working storage is provided by the caller as a
+ * single scratch arena, so this module never allocates memory.
+ *
+ * This module has no dependencies beyond the C standard library, so it
+ * can also be built and exercised on a host system.
+ */
+
+#ifndef PAPER_CURVE_H
+#define PAPER_CURVE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef struct {
+    size_t count; /*!< Number of curve points */
+    float *x;     /*!< Point X values (PEV), must be strictly increasing */
+    float *y;     /*!< Point Y values (density) */
+    float *b;     /*!< Linear spline coefficients, one per segment */
+    float *c;     /*!< Quadratic spline coefficients, one per point */
+    float *d;     /*!< Cubic spline coefficients, one per segment */
+} paper_curve_t;
+
+/**
+ * Get the size of the scratch arena required for a curve.
+ *
+ * @param count Number of points on the curve
+ * @return Arena size in bytes
+ */
+size_t paper_curve_arena_size(size_t count);
+
+/**
+ * Initialize a curve to use the provided scratch arena.
+ *
+ * After this call, the caller should populate the x and y arrays
+ * of the curve before calling paper_curve_solve().
+ *
+ * @param curve Curve to initialize
+ * @param arena Scratch arena, aligned for float access
+ * @param arena_size Size of the scratch arena in bytes
+ * @param count Number of points on the curve, at least 2
+ * @return True if the arena is large enough
+ */
+bool paper_curve_init(paper_curve_t *curve, void *arena, size_t arena_size, size_t count);
+
+/**
+ * Calculate the spline coefficients for the curve.
+ *
+ * @return True if successful, false if the X values are not strictly increasing
+ */
+bool paper_curve_solve(paper_curve_t *curve);
+
+/**
+ * Evaluate the curve at a specific X value.
+ *
+ * Values outside the range of the curve points are extrapolated
+ * from the first or last segment.
+ */
+float paper_curve_evaluate(const paper_curve_t *curve, float x);
+
+/**
+ * Find the lowest X value at which the curve crosses a specific Y value.
+ *
+ * Each segment is checked for a sign change in its endpoint values,
+ * and the crossing point is found by a bracketed Newton iteration on
+ * that segment's polynomial.
+ *
+ * If the curve never reaches the requested value, then the X value of
+ * the curve point with the closest Y value is returned instead.
+ *
+ * @param curve Solved curve to search
+ * @param y Y value to search for
+ * @param exact Set to true if an actual crossing was found
+ * @return X value of the crossing
+ */
+float paper_curve_find_x(const paper_curve_t *curve, float y, bool *exact);
+
+#endif /* PAPER_CURVE_H */
@@ -0,0 +1,77 @@
+#include "print_job.h"
+
+#include <stdio.h>
+#include <math.h>
+
+#include "exposure_math.h"
+
+bool print_job_is_valid(const print_job_t *job)
+{
+    if (!job) {
+        return false;
+    }
+
+    if (job->mode != EXPOSURE_MODE_PRINTING_BW && job->mode != EXPOSURE_MODE_PRINTING_COLOR) {
+        return false;
+    }
+
+    if (!isnormal(job->base_time) || job->base_time < 0.01F || job->base_time > 999.0F) {
+        return false;
+    }
+
+    if (job->adjustment_value < -144 || job->adjustment_value > 144) {
+        return false;
+    }
+
+    if (job->adjustment_increment < EXPOSURE_ADJ_TWELFTH || job->adjustment_increment > EXPOSURE_ADJ_WHOLE) {
+        return false;
+    }
+
+    if (job->contrast_grade > CONTRAST_GRADE_5) {
+        return false;
+    }
+
+    if (job->burn_dodge_count > EXPOSURE_BURN_DODGE_MAX) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < job->burn_dodge_count; i++) {
+        if (job->burn_dodge_entry[i].denominator == 0
+            || job->burn_dodge_entry[i].contrast_grade > CONTRAST_GRADE_MAX) {
+            return false;
+        }
+    }
+
+    if (job->copies == 0 || job->copies > PRINT_JOB_COPIES_MAX) {
+        return false;
+    }
+
+    return true;
+}
+
+float print_job_exposure_time(const print_job_t *job)
+{
+    if (!job) { return 0; }
+    return job->base_time * exposure_math_twelfth_stops(job->adjustment_value);
+}
+
+size_t print_job_summary_str(char *buf, size_t len, const print_job_t *job)
+{
+    if (!buf || len == 0) { return 0; }
+    if (!job) {
+        buf[0] = '\0';
+        return 0;
+    }
+
+    int n;
+    if (job->mode == EXPOSURE_MODE_PRINTING_COLOR) {
+        n = snprintf(buf, len, "%.1fs RGB, %d adj, x%d",
+            print_job_exposure_time(job), job->burn_dodge_count, job->copies);
+    } else {
+        n = snprintf(buf, len, "%.1fs G%s, %d adj, x%d",
+            print_job_exposure_time(job), contrast_grade_str(job->contrast_grade),
+            job->burn_dodge_count, job->copies);
+    }
+
+    return (n < 0) ? 0 : (size_t)n;
+}
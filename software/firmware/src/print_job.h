@@ -0,0 +1,76 @@
+#ifndef PRINT_JOB_H
+#define PRINT_JOB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "exposure_state.h"
+#include "contrast.h"
+
+#define PRINT_JOB_COPIES_MAX 99
+
+/**
+ * Saved exposure settings for a print, used to make repeated copies
+ * of the same image without having to re-enter everything.
+ */
+typedef struct __print_job_t {
+    /**
+     * Printing mode, either black and white or color.
+     */
+    exposure_mode_t mode;
+
+    /**
+     * Base exposure time, in seconds.
+     */
+    float base_time;
+
+    /**
+     * Exposure adjustment from the base time, in 1/12th stops.
+     */
+    int16_t adjustment_value;
+
+    /**
+     * Exposure adjustment increment, in 1/12th stops.
+     */
+    uint8_t adjustment_increment;
+
+    /**
+     * Contrast grade, used in black and white mode.
+     */
+    contrast_grade_t contrast_grade;
+
+    /**
+     * RGB channel values, used in color mode.
+     */
+    uint16_t channel_values[3];
+
+    /**
+     * Burn and dodge adjustments, applied in order after the
+     * main exposure.
+     */
+    exposure_burn_dodge_t burn_dodge_entry[EXPOSURE_BURN_DODGE_MAX];
+    uint8_t burn_dodge_count;
+
+    /**
+     * Number of copies to print when the job is run.
+     */
+    uint8_t copies;
+} print_job_t;
+
+bool print_job_is_valid(const print_job_t *job);
+
+/**
+ * Calculate the adjusted exposure time of the job's main exposure.
+ *
+ * @return Exposure time in seconds
+ */
+float print_job_exposure_time(const print_job_t *job);
+
+/**
+ * Build a short single-line summary of the job, suitable for use in a
+ * selection list.
+ */
+size_t print_job_summary_str(char *buf, size_t len, const print_job_t *job);
+
+#endif /* PRINT_JOB_H */
@@ -0,0 +1,190 @@
+#include "session_log.h"
+
+#include <stm32f4xx_hal.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <cmsis_os.h>
+
+#include <string.h>
+#include <ff.h>
+
+#define LOG_TAG "session_log"
+#include <elog.h>
+
+#include "usb_host.h"
+#include "util.h"
+
+#define SESSION_LOG_FILE_MAGIC   "PSLG"
+#define SESSION_LOG_FILE_VERSION 1
+
+/**
+ * Header at the start of the session log file.
+ *
+ * This is written when the file is first created, and is followed by
+ * records appended across any number of sessions.
+ * All multi-byte values are little endian.
+ */
+typedef struct __attribute__((packed)) {
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size;
+} session_log_file_header_t;
+
+static session_log_record_t log_buffer[SESSION_LOG_BUFFER_COUNT];
+static volatile uint32_t log_head = 0;
+static volatile uint32_t log_tail = 0;
+static volatile uint32_t log_dropped = 0;
+static bool log_session_started = false;
+
+static void session_log_push(const session_log_record_t *record);
+
+void session_log_record(const session_log_record_t *record)
+{
+    if (!record) { return; }
+
+    if (!log_session_started) {
+        session_log_record_t start_record = {
+            .type = SESSION_LOG_TYPE_SESSION_START,
+            .contrast_grade = CONTRAST_GRADE_MAX
+        };
+        log_session_started = true;
+        session_log_push(&start_record);
+    }
+
+    session_log_push(record);
+}
+
+void session_log_push(const session_log_record_t *record)
+{
+    const uint32_t ticks = osKernelGetTickCount() / portTICK_RATE_MS;
+
+    /*
+     * The buffer is only ever written at the head and flushed from the
+     * tail, so a brief critical section is all that is needed here.
+     * When the buffer is full, new records are dropped so that a flush
+     * in progress can safely write out the existing ones.
+     */
+    taskENTER_CRITICAL();
+    if (log_head - log_tail < SESSION_LOG_BUFFER_COUNT) {
+        session_log_record_t *entry = &log_buffer[log_head % SESSION_LOG_BUFFER_COUNT];
+        memcpy(entry, record, sizeof(session_log_record_t));
+        entry->ticks = ticks;
+        log_head++;
+    } else {
+        log_dropped++;
+    }
+    taskEXIT_CRITICAL();
+}
+
+void session_log_exposure(session_log_type_t type, session_log_result_t result,
+    uint32_t time_ms, contrast_grade_t contrast_grade, const uint16_t *channels,
+    uint8_t index, int8_t adj_numerator, uint8_t adj_denominator)
+{
+    session_log_record_t record = {
+        .type = type,
+        .result = result,
+        .contrast_grade = contrast_grade,
+        .index = index,
+        .value = time_ms,
+        .adj_numerator = adj_numerator,
+        .adj_denominator = adj_denominator
+    };
+    if (channels) {
+        record.channel_red = channels[0];
+        record.channel_green = channels[1];
+        record.channel_blue = channels[2];
+    }
+    session_log_record(&record);
+}
+
+session_log_result_t session_log_timer_result(HAL_StatusTypeDef ret)
+{
+    if (ret == HAL_OK) {
+        return SESSION_LOG_RESULT_OK;
+    } else if (ret == HAL_TIMEOUT) {
+        return SESSION_LOG_RESULT_CANCELED;
+    } else {
+        return SESSION_LOG_RESULT_ERROR;
+    }
+}
+
+void session_log_meter_reading(float lux)
+{
+    session_log_record_t record = {
+        .type = SESSION_LOG_TYPE_METER_READING,
+        .result = SESSION_LOG_RESULT_OK,
+        .contrast_grade = CONTRAST_GRADE_MAX
+    };
+    memcpy(&record.value, &lux, sizeof(uint32_t));
+    session_log_record(&record);
+}
+
+bool session_log_flush()
+{
+    FRESULT res = FR_OK;
+    FIL fp;
+    UINT bw;
+    bool file_open = false;
+    bool success = false;
+
+    const uint32_t tail = log_tail;
+    const uint32_t count = log_head - tail;
+    if (count == 0) {
+        return true;
+    }
+
+    if (!usb_msc_is_mounted()) {
+        return false;
+    }
+
+    do {
+        memset(&fp, 0, sizeof(FIL));
+
+        res = f_open(&fp, SESSION_LOG_FILENAME, FA_WRITE | FA_OPEN_APPEND);
+        if (res != FR_OK) { break; }
+        file_open = true;
+
+        /* Write the file header if this is a newly created file */
+        if (f_size(&fp) == 0) {
+            session_log_file_header_t header = {
+                .magic = SESSION_LOG_FILE_MAGIC,
+                .version = SESSION_LOG_FILE_VERSION,
+                .record_size = sizeof(session_log_record_t)
+            };
+            res = f_write(&fp, &header, sizeof(header), &bw);
+            if (res != FR_OK || bw != sizeof(header)) { break; }
+        }
+
+        /* Write the buffered records, which may wrap around the end of the buffer */
+        const uint32_t start = tail % SESSION_LOG_BUFFER_COUNT;
+        const uint32_t first_len = MIN(count, SESSION_LOG_BUFFER_COUNT - start);
+        res = f_write(&fp, &log_buffer[start], first_len * sizeof(session_log_record_t), &bw);
+        if (res != FR_OK || bw != first_len * sizeof(session_log_record_t)) { break; }
+        if (count > first_len) {
+            res = f_write(&fp, &log_buffer[0], (count - first_len) * sizeof(session_log_record_t), &bw);
+            if (res != FR_OK || bw != (count - first_len) * sizeof(session_log_record_t)) { break; }
+        }
+
+        success = true;
+    } while (0);
+
+    if (file_open) {
+        f_close(&fp);
+    }
+
+    if (success) {
+        taskENTER_CRITICAL();
+        log_tail = tail + count;
+        taskEXIT_CRITICAL();
+
+        if (log_dropped > 0) {
+            log_w("Session log records dropped: %lu", log_dropped);
+            log_dropped = 0;
+        }
+        log_d("Session log flushed: %lu records", count);
+    } else {
+        log_e("Error writing session log: %d", res);
+    }
+
+    return success && (log_head == log_tail);
+}
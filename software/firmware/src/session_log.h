@@ -0,0 +1,101 @@
+/*
+ * Exposure session log
+ *
+ * Compact fixed-size records describing each exposure and measurement
+ * are collected in a RAM buffer, and periodically appended to a log file
+ * on a USB storage device. The file can be converted to CSV on the host
+ * with "tools/sessionlog.pl".
+ *
+ * Recording a log entry only copies it into the RAM buffer, and all file
+ * access happens in session_log_flush(), which must only be called from
+ * outside the exposure timer process.
+ */
+
+#ifndef SESSION_LOG_H
+#define SESSION_LOG_H
+
+#include <stm32f4xx_hal.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "contrast.h"
+
+/**
+ * Name of the session log file on the USB storage device.
+ */
+#define SESSION_LOG_FILENAME "printlog.bin"
+
+/**
+ * Number of records held in RAM between flushes.
+ */
+#define SESSION_LOG_BUFFER_COUNT (32U)
+
+typedef enum {
+    SESSION_LOG_TYPE_NONE = 0,
+    SESSION_LOG_TYPE_SESSION_START, /*!< First record logged after startup */
+    SESSION_LOG_TYPE_EXPOSURE,      /*!< Main print exposure, value = time (ms) */
+    SESSION_LOG_TYPE_BURN_DODGE,    /*!< Burn/dodge exposure, value = time (ms) */
+    SESSION_LOG_TYPE_TEST_STRIP,    /*!< Test strip patch exposure, value = time (ms) */
+    SESSION_LOG_TYPE_METER_READING  /*!< Meter probe reading, value = lux (float bits) */
+} session_log_type_t;
+
+typedef enum {
+    SESSION_LOG_RESULT_OK = 0,
+    SESSION_LOG_RESULT_CANCELED,
+    SESSION_LOG_RESULT_ERROR
+} session_log_result_t;
+
+/**
+ * Session log record, as stored in the RAM buffer and in the log file.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t ticks;          /*!< Milliseconds since startup */
+    uint8_t type;            /*!< Record type (session_log_type_t) */
+    uint8_t result;          /*!< Outcome (session_log_result_t) */
+    uint8_t contrast_grade;  /*!< Contrast grade, or CONTRAST_GRADE_MAX if unused */
+    uint8_t index;           /*!< Burn/dodge entry, test strip patch, or print copy */
+    uint32_t value;          /*!< Type-specific value */
+    uint16_t channel_red;    /*!< Red channel value, if in color mode */
+    uint16_t channel_green;  /*!< Green channel value, if in color mode */
+    uint16_t channel_blue;   /*!< Blue channel value, if in color mode */
+    int8_t adj_numerator;    /*!< Burn/dodge stop adjustment numerator */
+    uint8_t adj_denominator; /*!< Burn/dodge stop adjustment denominator */
+    uint32_t reserved;
+} session_log_record_t;
+
+/**
+ * Add a record to the RAM buffer.
+ *
+ * The ticks field is filled in automatically. If the buffer is full,
+ * the record is dropped and counted.
+ */
+void session_log_record(const session_log_record_t *record);
+
+/**
+ * Convenience function for logging an exposure.
+ */
+void session_log_exposure(session_log_type_t type, session_log_result_t result,
+    uint32_t time_ms, contrast_grade_t contrast_grade, const uint16_t *channels,
+    uint8_t index, int8_t adj_numerator, uint8_t adj_denominator);
+
+/**
+ * Convert the return value of exposure_timer_run() into a log result.
+ */
+session_log_result_t session_log_timer_result(HAL_StatusTypeDef ret);
+
+/**
+ * Convenience function for logging a meter probe reading.
+ */
+void session_log_meter_reading(float lux);
+
+/**
+ * Append any buffered records to the log file.
+ *
+ * This does nothing if no USB storage device is mounted, in which case
+ * the records remain buffered until the next successful flush.
+ *
+ * @return True if the buffer is now empty
+ */
+bool session_log_flush();
+
+#endif /* SESSION_LOG_H */
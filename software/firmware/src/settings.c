@@ -32,15 +32,18 @@ _Static_assert(CONTRAST_WHOLE_GRADE_COUNT == 7, "CONTRAST_WHOLE_GRADE_COUNT leng
 #define DEFAULT_BUZZER_VOLUME           BUZZER_VOLUME_MEDIUM
 #define DEFAULT_TESTSTRIP_MODE          TESTSTRIP_MODE_INCREMENTAL
 #define DEFAULT_TESTSTRIP_PATCHES       TESTSTRIP_PATCHES_7
+#define DEFAULT_TESTSTRIP_PAUSE         0
 #define DEFAULT_ENLARGER_CONFIG         0
 #define DEFAULT_PAPER_PROFILE           0
 
 #define LATEST_CONFIG2_VERSION          1
 #define DEFAULT_SAFELIGHT_CONFIG        { SAFELIGHT_MODE_AUTO, SAFELIGHT_CONTROL_RELAY, 0, false, 255 }
 
-#define LATEST_ENLARGER_CONFIG_VERSION  1
-#define LATEST_PAPER_PROFILE_VERSION    1
+#define LATEST_ENLARGER_CONFIG_VERSION  2
+#define LATEST_PAPER_PROFILE_VERSION    2
 #define LATEST_STEP_WEDGE_VERSION       1
+#define LATEST_PRINT_JOB_VERSION        1
+#define LATEST_ACCESSORY_CAL_VERSION    1
 
 /* Handle to I2C peripheral used by the EEPROM */
 static I2C_HandleTypeDef *eeprom_i2c = NULL;
@@ -56,10 +59,45 @@ static uint8_t setting_led_brightness = DEFAULT_LED_BRIGHTNESS;
 static buzzer_volume_t setting_buzzer_volume = DEFAULT_BUZZER_VOLUME;
 static teststrip_mode_t setting_teststrip_mode = DEFAULT_TESTSTRIP_MODE;
 static teststrip_patches_t setting_teststrip_patches = DEFAULT_TESTSTRIP_PATCHES;
+static uint32_t setting_teststrip_pause = DEFAULT_TESTSTRIP_PAUSE;
 static uint8_t setting_enlarger_config = DEFAULT_ENLARGER_CONFIG;
 static uint8_t setting_paper_profile = DEFAULT_PAPER_PROFILE;
 static safelight_config_t setting_safelight_config = DEFAULT_SAFELIGHT_CONFIG;
 
+/**
+ * Summary of a saved enlarger configuration or paper profile.
+ *
+ * These entries are loaded at startup, and updated whenever a profile
+ * is saved or cleared, so that listing the saved profiles does not
+ * require any EEPROM access.
+ */
+typedef struct {
+    uint32_t version;  /*!< Saved version, or 0 if the slot is empty or invalid */
+    bool dmx_control;  /*!< Enlarger DMX control flag */
+    char name[PROFILE_NAME_LEN];
+} settings_profile_index_t;
+
+static settings_profile_index_t enlarger_config_index[MAX_ENLARGER_CONFIGS] = {0};
+static settings_profile_index_t paper_profile_index[MAX_PAPER_PROFILES] = {0};
+
+/**
+ * Summary of a cached accessory calibration entry.
+ *
+ * These entries are loaded at startup, so that looking up an accessory
+ * only requires reading the data of the matching entry.
+ */
+typedef struct {
+    bool valid;
+    uint8_t device_type;
+    uint32_t sequence;
+    uint32_t cal_version;
+    char serial[ACCESSORY_SERIAL_LEN];
+} settings_accessory_cal_index_t;
+
+static settings_accessory_cal_index_t accessory_cal_index[MAX_ACCESSORY_CALS] = {0};
+
+extern CRC_HandleTypeDef hcrc;
+
 /**
  * Header Page (256B)
  * Mostly unused at the moment, will be populated if any top-level system
@@ -92,7 +130,8 @@ static safelight_config_t setting_safelight_config = DEFAULT_SAFELIGHT_CONFIG;
 #define CONFIG_TESTSTRIP_PATCHES         40
 #define CONFIG_ENLARGER_CONFIG           44
 #define CONFIG_PAPER_PROFILE             48
-/* RESERVED                              52*/
+#define CONFIG_TESTSTRIP_PAUSE           52
+/* RESERVED                              56*/
 
 /**
  * Detailed configuration page (256B)
@@ -134,6 +173,8 @@ static safelight_config_t setting_safelight_config = DEFAULT_SAFELIGHT_CONFIG;
 #define ENLARGER_CONFIG_CONTROL_FOCUS_VALUE   140 /* 2B (uint16_t) */
 #define ENLARGER_CONFIG_CONTROL_SAFE_VALUE    142 /* 2B (uint16_t) */
 #define ENLARGER_CONFIG_CONTROL_GRADE_VALUES  144 /* 56B (7 * (4 * uint16_t)) */
+/* RESERVED (52B) */
+#define ENLARGER_CONFIG_CRC                   252 /* 4B (uint32_t), from version 2 */
 
 /**
  * Paper profiles (4096B)
@@ -166,6 +207,8 @@ static safelight_config_t setting_safelight_config = DEFAULT_SAFELIGHT_CONFIG;
 #define PAPER_PROFILE_GRADE5_HM          112
 #define PAPER_PROFILE_GRADE5_HS          116
 #define PAPER_PROFILE_DNET               120
+/* RESERVED (128B) */
+#define PAPER_PROFILE_CRC                252 /* 4B (uint32_t), from version 2 */
 
 /**
  * Step wedge profile (256B)
@@ -180,6 +223,48 @@ static safelight_config_t setting_safelight_config = DEFAULT_SAFELIGHT_CONFIG;
 #define STEP_WEDGE_STEP_COUNT            44
 #define STEP_WEDGE_STEP_DENSITY_0        48 /* up to 51 steps supported */
 
+/**
+ * Print jobs (4096B)
+ * Each print job is allocated a full 256-byte page,
+ * starting at this address, up to a maximum of 16
+ * job entries.
+ */
+#define PAGE_PRINT_JOB_BASE              0x04000UL
+#define PRINT_JOB_VERSION                0
+#define PRINT_JOB_MODE                   4  /* 1B (exposure_mode_t) */
+#define PRINT_JOB_CONTRAST_GRADE         5  /* 1B (contrast_grade_t) */
+#define PRINT_JOB_ADJUSTMENT_INCREMENT   6  /* 1B (uint8_t) */
+#define PRINT_JOB_COPIES                 7  /* 1B (uint8_t) */
+#define PRINT_JOB_BASE_TIME              8  /* 4B (float) */
+#define PRINT_JOB_ADJUSTMENT_VALUE       12 /* 2B (int16_t) */
+#define PRINT_JOB_CHANNEL_RED            14 /* 2B (uint16_t) */
+#define PRINT_JOB_CHANNEL_GREEN          16 /* 2B (uint16_t) */
+#define PRINT_JOB_CHANNEL_BLUE           18 /* 2B (uint16_t) */
+#define PRINT_JOB_BURN_DODGE_COUNT       20 /* 1B (uint8_t) */
+/* RESERVED (3B) */
+#define PRINT_JOB_BURN_DODGE_LIST        24 /* 27B (9 * (3 * uint8_t)) */
+
+/**
+ * Accessory calibration cache (1024B)
+ * Each entry holds a copy of the calibration data read from a USB
+ * accessory, so it can be used without waiting on the relatively slow
+ * accessory EEPROM. Each entry is allocated a full 256-byte page,
+ * starting at this address, up to a maximum of 4 entries.
+ *
+ * The sequence field is incremented on every save, and is used to
+ * pick the entry to replace when the cache is full.
+ */
+#define PAGE_ACCESSORY_CAL_BASE          0x05000UL
+#define ACCESSORY_CAL_VERSION            0   /* 4B (uint32_t) */
+#define ACCESSORY_CAL_DEVICE_TYPE        4   /* 1B (uint8_t) */
+/* RESERVED (3B) */
+#define ACCESSORY_CAL_SEQUENCE           8   /* 4B (uint32_t) */
+#define ACCESSORY_CAL_DATA_VERSION       12  /* 4B (uint32_t) */
+#define ACCESSORY_CAL_SERIAL             16  /* char[32] */
+#define ACCESSORY_CAL_DATA               48  /* 112B */
+#define ACCESSORY_CAL_CRC                160 /* 4B (uint32_t) */
+#define ACCESSORY_CAL_SIZE               164
+
 /**
  * Bootloader page (512B)
  * Reserved page at the end of the settings memory used to pass instructions
@@ -192,6 +277,17 @@ static safelight_config_t setting_safelight_config = DEFAULT_SAFELIGHT_CONFIG;
 /* Rest of the first page is unused */
 #define BOOTLOADER_FW_FILE               256 /* char[256] */
 
+/**
+ * Boot verification page (256B)
+ * Reserved page used by the bootloader to remember that the installed
+ * firmware image has already been verified. The application may only
+ * clear the marker, to request a full verification on the next startup.
+ */
+#define PAGE_BOOT_VERIFY                 0x1FD00UL
+#define BOOT_VERIFY_MAGIC                0  /* 4B (uint32_t) */
+#define BOOT_VERIFY_GENERATION           4  /* 4B (uint32_t) */
+#define BOOT_VERIFY_MARKER               8  /* 16B */
+
 /**
  * Size of a memory page.
  */
@@ -215,6 +311,12 @@ static void settings_set_safelight_config_defaults(safelight_config_t *safelight
 static bool settings_validate_safelight_config(const safelight_config_t *safelight_config);
 static bool settings_load_safelight_config();
 
+static HAL_StatusTypeDef settings_init_profile_index();
+static bool settings_profile_page_check_crc(const uint8_t *data, uint32_t version, size_t crc_offset);
+static HAL_StatusTypeDef settings_init_accessory_cal_index();
+static bool settings_accessory_cal_parse_page(settings_accessory_cal_index_t *entry, const uint8_t *data);
+static int settings_accessory_cal_find(uint8_t device_type, const char *serial);
+
 static void settings_enlarger_config_parse_page(enlarger_config_t *config, const uint8_t *data);
 static void settings_enlarger_config_populate_page(const enlarger_config_t *config, uint8_t *data);
 static void settings_paper_profile_parse_page(paper_profile_t *profile, const uint8_t *data);
@@ -222,6 +324,9 @@ static void settings_paper_profile_populate_page(const paper_profile_t *profile,
 static void settings_step_wedge_parse_page(step_wedge_t **wedge, const uint8_t *data);
 static void settings_step_wedge_populate_page(const step_wedge_t *wedge, uint8_t *data);
 
+static void settings_print_job_parse_page(print_job_t *job, const uint8_t *data);
+static void settings_print_job_populate_page(const print_job_t *job, uint8_t *data);
+
 static bool settings_cleanup_bootloader_firmware();
 
 static bool read_u32(uint32_t address, uint32_t *val);
@@ -255,6 +360,12 @@ HAL_StatusTypeDef settings_init(I2C_HandleTypeDef *hi2c, osMutexId_t i2c_mutex)
         if (!settings_init_config(!valid)) { break; }
         if (!settings_init_config2(!valid)) { break; }
 
+        /* Load the index of saved enlarger configurations and paper profiles */
+        settings_init_profile_index();
+
+        /* Load the index of cached accessory calibration data */
+        settings_init_accessory_cal_index();
+
         /* Initialize the header page if necessary */
         if (!valid) {
             ret = settings_write_header();
@@ -269,6 +380,111 @@ HAL_StatusTypeDef settings_init(I2C_HandleTypeDef *hi2c, osMutexId_t i2c_mutex)
 }
 
 
+HAL_StatusTypeDef settings_init_profile_index()
+{
+    HAL_StatusTypeDef ret = HAL_OK;
+    uint8_t data[PAGE_SIZE] __attribute__((aligned(4)));
+    uint32_t version;
+    uint8_t enlarger_count = 0;
+    uint8_t paper_count = 0;
+
+    memset(enlarger_config_index, 0, sizeof(enlarger_config_index));
+    memset(paper_profile_index, 0, sizeof(paper_profile_index));
+
+    /*
+     * The whole page has to be read to validate its checksum, so that
+     * the index only lists profiles that would also load successfully.
+     */
+    for (uint8_t i = 0; i < MAX_ENLARGER_CONFIGS; i++) {
+        ret = m24m01_read_buffer(eeprom_i2c,
+            PAGE_ENLARGER_CONFIG_BASE + (PAGE_SIZE * i),
+            data, sizeof(data));
+        if (ret != HAL_OK) { break; }
+
+        version = copy_to_u32(data + ENLARGER_CONFIG_VERSION);
+        if (version == 0 || version > LATEST_ENLARGER_CONFIG_VERSION) { continue; }
+        if (!settings_profile_page_check_crc(data, version, ENLARGER_CONFIG_CRC)) { continue; }
+
+        settings_profile_index_t *entry = &enlarger_config_index[i];
+        entry->version = version;
+        entry->dmx_control = (bool)data[ENLARGER_CONFIG_CONTROL_DMX_ENABLED];
+        strncpy(entry->name, (const char *)(data + ENLARGER_CONFIG_NAME), PROFILE_NAME_LEN);
+        entry->name[PROFILE_NAME_LEN - 1] = '\0';
+        enlarger_count++;
+    }
+    if (ret != HAL_OK) {
+        log_e("Unable to read enlarger config index: %d", ret);
+        return ret;
+    }
+
+    for (uint8_t i = 0; i < MAX_PAPER_PROFILES; i++) {
+        ret = m24m01_read_buffer(eeprom_i2c,
+            PAGE_PAPER_PROFILE_BASE + (PAGE_SIZE * i),
+            data, sizeof(data));
+        if (ret != HAL_OK) { break; }
+
+        version = copy_to_u32(data + PAPER_PROFILE_VERSION);
+        if (version == 0 || version > LATEST_PAPER_PROFILE_VERSION) { continue; }
+        if (!settings_profile_page_check_crc(data, version, PAPER_PROFILE_CRC)) { continue; }
+
+        settings_profile_index_t *entry = &paper_profile_index[i];
+        entry->version = version;
+        strncpy(entry->name, (const char *)(data + PAPER_PROFILE_NAME), PROFILE_NAME_LEN);
+        entry->name[PROFILE_NAME_LEN - 1] = '\0';
+        paper_count++;
+    }
+    if (ret != HAL_OK) {
+        log_e("Unable to read paper profile index: %d", ret);
+        return ret;
+    }
+
+    log_i("Indexed %d enlarger configs, %d paper profiles", enlarger_count, paper_count);
+    return ret;
+}
+
+bool settings_profile_page_check_crc(const uint8_t *data, uint32_t version, size_t crc_offset)
+{
+    /* Pages written before version 2 do not have a checksum */
+    if (version < 2) {
+        return true;
+    }
+
+    uint32_t crc = copy_to_u32(data + crc_offset);
+    uint32_t calculated_crc = HAL_CRC_Calculate(&hcrc, (uint32_t *)data, crc_offset / 4UL);
+    return crc == calculated_crc;
+}
+
+HAL_StatusTypeDef settings_init_accessory_cal_index()
+{
+    HAL_StatusTypeDef ret = HAL_OK;
+    uint8_t data[ACCESSORY_CAL_SIZE] __attribute__((aligned(4)));
+    uint8_t count = 0;
+
+    memset(accessory_cal_index, 0, sizeof(accessory_cal_index));
+
+    /*
+     * The whole entry has to be read to validate its checksum, but this
+     * only happens once at startup for a small number of entries.
+     */
+    for (uint8_t i = 0; i < MAX_ACCESSORY_CALS; i++) {
+        ret = m24m01_read_buffer(eeprom_i2c,
+            PAGE_ACCESSORY_CAL_BASE + (PAGE_SIZE * i),
+            data, sizeof(data));
+        if (ret != HAL_OK) { break; }
+
+        if (settings_accessory_cal_parse_page(&accessory_cal_index[i], data)) {
+            count++;
+        }
+    }
+    if (ret != HAL_OK) {
+        log_e("Unable to read accessory calibration index: %d", ret);
+        return ret;
+    }
+
+    log_i("Indexed %d cached accessory calibrations", count);
+    return ret;
+}
+
 HAL_StatusTypeDef settings_read_header(bool *valid)
 {
     HAL_StatusTypeDef ret = HAL_OK;
@@ -374,6 +590,7 @@ HAL_StatusTypeDef settings_init_default_config()
     copy_from_u32(data + CONFIG_TESTSTRIP_PATCHES,      DEFAULT_TESTSTRIP_PATCHES);
     copy_from_u32(data + CONFIG_ENLARGER_CONFIG,        DEFAULT_ENLARGER_CONFIG);
     copy_from_u32(data + CONFIG_PAPER_PROFILE,          DEFAULT_PAPER_PROFILE);
+    copy_from_u32(data + CONFIG_TESTSTRIP_PAUSE,        DEFAULT_TESTSTRIP_PAUSE);
     return m24m01_write_page(eeprom_i2c, PAGE_CONFIG, data, sizeof(data));
 }
 
@@ -456,6 +673,13 @@ void settings_init_parse_config_page(const uint8_t *data)
     } else {
         setting_paper_profile = DEFAULT_PAPER_PROFILE;
     }
+
+    val = copy_to_u32(data + CONFIG_TESTSTRIP_PAUSE);
+    if (val <= 10000) {
+        setting_teststrip_pause = val;
+    } else {
+        setting_teststrip_pause = DEFAULT_TESTSTRIP_PAUSE;
+    }
 }
 
 bool settings_init_config2(bool force_clear)
@@ -675,6 +899,21 @@ void settings_set_teststrip_patches(teststrip_patches_t patches)
     }
 }
 
+uint32_t settings_get_teststrip_pause()
+{
+    return setting_teststrip_pause;
+}
+
+void settings_set_teststrip_pause(uint32_t pause)
+{
+    if (setting_teststrip_pause != pause
+        && pause <= 10000) {
+        if (write_u32(PAGE_CONFIG + CONFIG_TESTSTRIP_PAUSE, pause)) {
+            setting_teststrip_pause = pause;
+        }
+    }
+}
+
 uint8_t settings_get_default_enlarger_config_index()
 {
     return setting_enlarger_config;
@@ -796,79 +1035,27 @@ bool settings_get_enlarger_config_name(char *name, uint8_t index)
 {
     if (!name || index >= MAX_ENLARGER_CONFIGS) { return false; }
 
-    log_i("Load enlarger config name: %d", index);
-
-    HAL_StatusTypeDef ret = HAL_OK;
-    uint8_t data[4 + PROFILE_NAME_LEN];
-    memset(data, 0, sizeof(data));
-
-    do {
-        osMutexAcquire(eeprom_i2c_mutex, portMAX_DELAY);
-        ret = m24m01_read_buffer(eeprom_i2c,
-            PAGE_ENLARGER_CONFIG_BASE + (PAGE_SIZE * index),
-            data, sizeof(data));
-        osMutexRelease(eeprom_i2c_mutex);
-        if (ret != HAL_OK) { break; }
-
-        uint32_t config_version = copy_to_u32(data + ENLARGER_CONFIG_VERSION);
-        if (config_version == UINT32_MAX) {
-            log_d("Config index is empty");
-            ret = HAL_ERROR;
-            break;
-        }
-        if (config_version == 0 || config_version > LATEST_ENLARGER_CONFIG_VERSION) {
-            log_w("Invalid config version %ld", config_version);
-            ret = HAL_ERROR;
-            break;
-        }
-
-        strncpy(name, (const char *)(data + ENLARGER_CONFIG_NAME), PROFILE_NAME_LEN);
-        name[PROFILE_NAME_LEN - 1] = '\0';
-
-    } while (0);
+    const settings_profile_index_t *entry = &enlarger_config_index[index];
+    if (entry->version == 0) {
+        return false;
+    }
 
-    return (ret == HAL_OK);
+    strncpy(name, entry->name, PROFILE_NAME_LEN);
+    name[PROFILE_NAME_LEN - 1] = '\0';
+    return true;
 }
 
 bool settings_get_enlarger_config_dmx_control(bool *dmx_control, uint8_t index)
 {
     if (!dmx_control || index >= MAX_ENLARGER_CONFIGS) { return false; }
 
-    log_i("Load enlarger config dmx_mode: %d", index);
-
-    HAL_StatusTypeDef ret = HAL_OK;
-    uint8_t data[5] = {0};
-
-    do {
-        osMutexAcquire(eeprom_i2c_mutex, portMAX_DELAY);
-        ret = m24m01_read_buffer(eeprom_i2c,
-            PAGE_ENLARGER_CONFIG_BASE + (PAGE_SIZE * index),
-            data, 4);
-        if (ret == HAL_OK) {
-            ret = m24m01_read_buffer(eeprom_i2c,
-                PAGE_ENLARGER_CONFIG_BASE + (PAGE_SIZE * index)
-                + ENLARGER_CONFIG_CONTROL_DMX_ENABLED,
-                data + 4, 1);
-        }
-        osMutexRelease(eeprom_i2c_mutex);
-        if (ret != HAL_OK) { break; }
-
-        uint32_t config_version = copy_to_u32(data + ENLARGER_CONFIG_VERSION);
-        if (config_version == UINT32_MAX) {
-            log_d("Config index is empty");
-            ret = HAL_ERROR;
-            break;
-        }
-        if (config_version == 0 || config_version > LATEST_ENLARGER_CONFIG_VERSION) {
-            log_w("Invalid config version %ld", config_version);
-            ret = HAL_ERROR;
-            break;
-        }
-
-        *dmx_control = (bool)data[4];
-    } while (0);
+    const settings_profile_index_t *entry = &enlarger_config_index[index];
+    if (entry->version == 0) {
+        return false;
+    }
 
-    return (ret == HAL_OK);
+    *dmx_control = entry->dmx_control;
+    return true;
 }
 
 bool settings_get_enlarger_config(enlarger_config_t *config, uint8_t index)
@@ -878,7 +1065,7 @@ bool settings_get_enlarger_config(enlarger_config_t *config, uint8_t index)
     log_i("Load enlarger config: %d", index);
 
     HAL_StatusTypeDef ret = HAL_OK;
-    uint8_t data[PAGE_SIZE];
+    uint8_t data[PAGE_SIZE] __attribute__((aligned(4)));
     memset(data, 0, sizeof(data));
 
     do {
@@ -900,6 +1087,11 @@ bool settings_get_enlarger_config(enlarger_config_t *config, uint8_t index)
             ret = HAL_ERROR;
             break;
         }
+        if (!settings_profile_page_check_crc(data, config_version, ENLARGER_CONFIG_CRC)) {
+            log_w("Invalid profile checksum");
+            ret = HAL_ERROR;
+            break;
+        }
 
         settings_enlarger_config_parse_page(config, data);
         enlarger_config_recalculate(config);
@@ -956,7 +1148,7 @@ bool settings_set_enlarger_config(const enlarger_config_t *config, uint8_t index
 
     log_i("Save enlarger config: %d", index);
 
-    uint8_t data[PAGE_SIZE];
+    uint8_t data[PAGE_SIZE] __attribute__((aligned(4)));
     memset(data, 0, sizeof(data));
 
     settings_enlarger_config_populate_page(config, data);
@@ -966,6 +1158,17 @@ bool settings_set_enlarger_config(const enlarger_config_t *config, uint8_t index
         PAGE_ENLARGER_CONFIG_BASE + (PAGE_SIZE * index),
         data, sizeof(data));
     osMutexRelease(eeprom_i2c_mutex);
+
+    /* Update the index to match what was written, or mark it invalid on failure */
+    settings_profile_index_t *entry = &enlarger_config_index[index];
+    memset(entry, 0, sizeof(settings_profile_index_t));
+    if (ret == HAL_OK) {
+        entry->version = LATEST_ENLARGER_CONFIG_VERSION;
+        entry->dmx_control = config->control.dmx_control;
+        strncpy(entry->name, config->name, PROFILE_NAME_LEN);
+        entry->name[PROFILE_NAME_LEN - 1] = '\0';
+    }
+
     return (ret == HAL_OK);
 }
 
@@ -1008,6 +1211,9 @@ void settings_enlarger_config_populate_page(const enlarger_config_t *config, uin
         copy_from_u16(data + offset, config->control.grade_values[CONTRAST_WHOLE_GRADES[i]].channel_white);
         offset += 2;
     }
+
+    copy_from_u32(data + ENLARGER_CONFIG_CRC,
+        HAL_CRC_Calculate(&hcrc, (uint32_t *)data, ENLARGER_CONFIG_CRC / 4UL));
 }
 
 void settings_clear_enlarger_config(uint8_t index)
@@ -1016,6 +1222,8 @@ void settings_clear_enlarger_config(uint8_t index)
 
     uint8_t data[PAGE_SIZE];
 
+    memset(&enlarger_config_index[index], 0, sizeof(settings_profile_index_t));
+
     /* Read the config page, and abort if it is already blank */
     if (m24m01_read_buffer(eeprom_i2c,
         PAGE_ENLARGER_CONFIG_BASE + (PAGE_SIZE * index),
@@ -1050,7 +1258,7 @@ bool settings_get_paper_profile(paper_profile_t *profile, uint8_t index)
     log_i("Load paper profile: %d", index);
 
     HAL_StatusTypeDef ret = HAL_OK;
-    uint8_t data[PAGE_SIZE];
+    uint8_t data[PAGE_SIZE] __attribute__((aligned(4)));
     memset(data, 0, sizeof(data));
 
     do {
@@ -1072,6 +1280,11 @@ bool settings_get_paper_profile(paper_profile_t *profile, uint8_t index)
             ret = HAL_ERROR;
             break;
         }
+        if (!settings_profile_page_check_crc(data, profile_version, PAPER_PROFILE_CRC)) {
+            log_w("Invalid profile checksum");
+            ret = HAL_ERROR;
+            break;
+        }
 
         settings_paper_profile_parse_page(profile, data);
         paper_profile_recalculate(profile);
@@ -1081,6 +1294,20 @@ bool settings_get_paper_profile(paper_profile_t *profile, uint8_t index)
     return (ret == HAL_OK);
 }
 
+bool settings_get_paper_profile_name(char *name, uint8_t index)
+{
+    if (!name || index >= MAX_PAPER_PROFILES) { return false; }
+
+    const settings_profile_index_t *entry = &paper_profile_index[index];
+    if (entry->version == 0) {
+        return false;
+    }
+
+    strncpy(name, entry->name, PROFILE_NAME_LEN);
+    name[PROFILE_NAME_LEN - 1] = '\0';
+    return true;
+}
+
 static void settings_paper_profile_parse_page(paper_profile_t *profile, const uint8_t *data)
 {
     memset(profile, 0, sizeof(paper_profile_t));
@@ -1128,7 +1355,7 @@ bool settings_set_paper_profile(const paper_profile_t *profile, uint8_t index)
 
     log_i("Save paper profile: %d", index);
 
-    uint8_t data[PAGE_SIZE];
+    uint8_t data[PAGE_SIZE] __attribute__((aligned(4)));
     memset(data, 0, sizeof(data));
 
     settings_paper_profile_populate_page(profile, data);
@@ -1138,6 +1365,16 @@ bool settings_set_paper_profile(const paper_profile_t *profile, uint8_t index)
         PAGE_PAPER_PROFILE_BASE + (PAGE_SIZE * index),
         data, sizeof(data));
     osMutexRelease(eeprom_i2c_mutex);
+
+    /* Update the index to match what was written, or mark it invalid on failure */
+    settings_profile_index_t *entry = &paper_profile_index[index];
+    memset(entry, 0, sizeof(settings_profile_index_t));
+    if (ret == HAL_OK) {
+        entry->version = LATEST_PAPER_PROFILE_VERSION;
+        strncpy(entry->name, profile->name, PROFILE_NAME_LEN);
+        entry->name[PROFILE_NAME_LEN - 1] = '\0';
+    }
+
     return (ret == HAL_OK);
 }
 
@@ -1176,6 +1413,9 @@ void settings_paper_profile_populate_page(const paper_profile_t *profile, uint8_
     copy_from_u32(data + PAPER_PROFILE_GRADE5_HS, profile->grade[CONTRAST_GRADE_5].hs_lev100);
 
     copy_from_f32(data + PAPER_PROFILE_DNET, profile->max_net_density);
+
+    copy_from_u32(data + PAPER_PROFILE_CRC,
+        HAL_CRC_Calculate(&hcrc, (uint32_t *)data, PAPER_PROFILE_CRC / 4UL));
 }
 
 void settings_clear_paper_profile(uint8_t index)
@@ -1184,6 +1424,8 @@ void settings_clear_paper_profile(uint8_t index)
 
     uint8_t data[PAGE_SIZE];
 
+    memset(&paper_profile_index[index], 0, sizeof(settings_profile_index_t));
+
     /* Read the profile page, and abort if it is already blank */
     if (m24m01_read_buffer(eeprom_i2c,
         PAGE_PAPER_PROFILE_BASE + (PAGE_SIZE * index),
@@ -1211,6 +1453,129 @@ void settings_clear_paper_profile(uint8_t index)
     osMutexRelease(eeprom_i2c_mutex);
 }
 
+bool settings_get_print_job(print_job_t *job, uint8_t index)
+{
+    if (!job || index >= MAX_PRINT_JOBS) { return false; }
+
+    log_i("Load print job: %d", index);
+
+    HAL_StatusTypeDef ret = HAL_OK;
+    uint8_t data[PAGE_SIZE];
+    memset(data, 0, sizeof(data));
+
+    do {
+        osMutexAcquire(eeprom_i2c_mutex, portMAX_DELAY);
+        ret = m24m01_read_buffer(eeprom_i2c,
+            PAGE_PRINT_JOB_BASE + (PAGE_SIZE * index),
+            data, sizeof(data));
+        osMutexRelease(eeprom_i2c_mutex);
+        if (ret != HAL_OK) { break; }
+
+        uint32_t job_version = copy_to_u32(data + PRINT_JOB_VERSION);
+        if (job_version == UINT32_MAX) {
+            log_d("Print job index is empty");
+            ret = HAL_ERROR;
+            break;
+        }
+        if (job_version == 0 || job_version > LATEST_PRINT_JOB_VERSION) {
+            log_w("Invalid print job version %ld", job_version);
+            ret = HAL_ERROR;
+            break;
+        }
+
+        settings_print_job_parse_page(job, data);
+
+        if (!print_job_is_valid(job)) {
+            log_w("Invalid print job data");
+            ret = HAL_ERROR;
+            break;
+        }
+    } while (0);
+
+    return (ret == HAL_OK);
+}
+
+void settings_print_job_parse_page(print_job_t *job, const uint8_t *data)
+{
+    memset(job, 0, sizeof(print_job_t));
+
+    job->mode = data[PRINT_JOB_MODE];
+    job->contrast_grade = data[PRINT_JOB_CONTRAST_GRADE];
+    job->adjustment_increment = data[PRINT_JOB_ADJUSTMENT_INCREMENT];
+    job->copies = data[PRINT_JOB_COPIES];
+    job->base_time = copy_to_f32(data + PRINT_JOB_BASE_TIME);
+    job->adjustment_value = (int16_t)copy_to_u16(data + PRINT_JOB_ADJUSTMENT_VALUE);
+    job->channel_values[0] = copy_to_u16(data + PRINT_JOB_CHANNEL_RED);
+    job->channel_values[1] = copy_to_u16(data + PRINT_JOB_CHANNEL_GREEN);
+    job->channel_values[2] = copy_to_u16(data + PRINT_JOB_CHANNEL_BLUE);
+    job->burn_dodge_count = MIN(data[PRINT_JOB_BURN_DODGE_COUNT], EXPOSURE_BURN_DODGE_MAX);
+
+    for (uint8_t i = 0; i < job->burn_dodge_count; i++) {
+        const uint8_t *entry = data + PRINT_JOB_BURN_DODGE_LIST + (i * 3);
+        job->burn_dodge_entry[i].contrast_grade = entry[0];
+        job->burn_dodge_entry[i].numerator = (int8_t)entry[1];
+        job->burn_dodge_entry[i].denominator = entry[2];
+    }
+}
+
+bool settings_set_print_job(const print_job_t *job, uint8_t index)
+{
+    if (!job || index >= MAX_PRINT_JOBS) { return false; }
+
+    log_i("Save print job: %d", index);
+
+    uint8_t data[PAGE_SIZE];
+    memset(data, 0, sizeof(data));
+
+    settings_print_job_populate_page(job, data);
+
+    osMutexAcquire(eeprom_i2c_mutex, portMAX_DELAY);
+    HAL_StatusTypeDef ret = m24m01_write_page(eeprom_i2c,
+        PAGE_PRINT_JOB_BASE + (PAGE_SIZE * index),
+        data, sizeof(data));
+    osMutexRelease(eeprom_i2c_mutex);
+    return (ret == HAL_OK);
+}
+
+void settings_print_job_populate_page(const print_job_t *job, uint8_t *data)
+{
+    copy_from_u32(data + PRINT_JOB_VERSION, LATEST_PRINT_JOB_VERSION);
+
+    data[PRINT_JOB_MODE] = (uint8_t)job->mode;
+    data[PRINT_JOB_CONTRAST_GRADE] = (uint8_t)job->contrast_grade;
+    data[PRINT_JOB_ADJUSTMENT_INCREMENT] = job->adjustment_increment;
+    data[PRINT_JOB_COPIES] = job->copies;
+    copy_from_f32(data + PRINT_JOB_BASE_TIME, job->base_time);
+    copy_from_u16(data + PRINT_JOB_ADJUSTMENT_VALUE, (uint16_t)job->adjustment_value);
+    copy_from_u16(data + PRINT_JOB_CHANNEL_RED, job->channel_values[0]);
+    copy_from_u16(data + PRINT_JOB_CHANNEL_GREEN, job->channel_values[1]);
+    copy_from_u16(data + PRINT_JOB_CHANNEL_BLUE, job->channel_values[2]);
+    data[PRINT_JOB_BURN_DODGE_COUNT] = MIN(job->burn_dodge_count, EXPOSURE_BURN_DODGE_MAX);
+
+    for (uint8_t i = 0; i < data[PRINT_JOB_BURN_DODGE_COUNT]; i++) {
+        uint8_t *entry = data + PRINT_JOB_BURN_DODGE_LIST + (i * 3);
+        entry[0] = (uint8_t)job->burn_dodge_entry[i].contrast_grade;
+        entry[1] = (uint8_t)job->burn_dodge_entry[i].numerator;
+        entry[2] = job->burn_dodge_entry[i].denominator;
+    }
+}
+
+void settings_clear_print_job(uint8_t index)
+{
+    if (index >= MAX_PRINT_JOBS) { return; }
+
+    uint8_t data[PAGE_SIZE];
+    memset(data, 0xFF, sizeof(data));
+
+    log_i("Clear print job: %d", index);
+
+    osMutexAcquire(eeprom_i2c_mutex, portMAX_DELAY);
+    m24m01_write_page(eeprom_i2c,
+        PAGE_PRINT_JOB_BASE + (PAGE_SIZE * index),
+        data, sizeof(data));
+    osMutexRelease(eeprom_i2c_mutex);
+}
+
 bool settings_get_step_wedge(step_wedge_t **wedge)
 {
     if (!wedge) { return false; }
@@ -1313,6 +1678,173 @@ void settings_step_wedge_populate_page(const step_wedge_t *wedge, uint8_t *data)
     }
 }
 
+bool settings_accessory_cal_parse_page(settings_accessory_cal_index_t *entry, const uint8_t *data)
+{
+    memset(entry, 0, sizeof(settings_accessory_cal_index_t));
+
+    if (copy_to_u32(data + ACCESSORY_CAL_VERSION) != LATEST_ACCESSORY_CAL_VERSION) {
+        return false;
+    }
+
+    uint32_t crc = copy_to_u32(data + ACCESSORY_CAL_CRC);
+    uint32_t calculated_crc = HAL_CRC_Calculate(&hcrc, (uint32_t *)data, ACCESSORY_CAL_CRC / 4UL);
+    if (crc != calculated_crc) {
+        return false;
+    }
+
+    entry->device_type = data[ACCESSORY_CAL_DEVICE_TYPE];
+    entry->sequence = copy_to_u32(data + ACCESSORY_CAL_SEQUENCE);
+    entry->cal_version = copy_to_u32(data + ACCESSORY_CAL_DATA_VERSION);
+    strncpy(entry->serial, (const char *)(data + ACCESSORY_CAL_SERIAL), ACCESSORY_SERIAL_LEN);
+    entry->serial[ACCESSORY_SERIAL_LEN - 1] = '\0';
+    entry->valid = true;
+    return true;
+}
+
+int settings_accessory_cal_find(uint8_t device_type, const char *serial)
+{
+    for (int i = 0; i < MAX_ACCESSORY_CALS; i++) {
+        const settings_accessory_cal_index_t *entry = &accessory_cal_index[i];
+        if (entry->valid && entry->device_type == device_type
+            && strncmp(entry->serial, serial, ACCESSORY_SERIAL_LEN) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool settings_get_accessory_cal(accessory_cal_t *cal)
+{
+    HAL_StatusTypeDef ret = HAL_OK;
+    settings_accessory_cal_index_t entry;
+    uint8_t data[ACCESSORY_CAL_SIZE] __attribute__((aligned(4)));
+
+    bool result = false;
+
+    if (!cal || cal->serial[0] == '\0') { return false; }
+
+    osMutexAcquire(eeprom_i2c_mutex, portMAX_DELAY);
+    do {
+        int index = settings_accessory_cal_find(cal->device_type, cal->serial);
+        if (index < 0 || accessory_cal_index[index].cal_version != cal->cal_version) {
+            break;
+        }
+
+        ret = m24m01_read_buffer(eeprom_i2c,
+            PAGE_ACCESSORY_CAL_BASE + (PAGE_SIZE * index),
+            data, sizeof(data));
+        if (ret != HAL_OK) {
+            log_e("Unable to read accessory calibration: %d", ret);
+            break;
+        }
+
+        /* Make sure the entry has not changed since it was indexed */
+        if (!settings_accessory_cal_parse_page(&entry, data)
+            || entry.device_type != cal->device_type
+            || entry.cal_version != cal->cal_version
+            || strncmp(entry.serial, cal->serial, ACCESSORY_SERIAL_LEN) != 0) {
+            log_w("Cached accessory calibration is invalid");
+            accessory_cal_index[index].valid = false;
+            break;
+        }
+
+        memcpy(cal->data, data + ACCESSORY_CAL_DATA, ACCESSORY_CAL_DATA_SIZE);
+        result = true;
+    } while (0);
+    osMutexRelease(eeprom_i2c_mutex);
+
+    return result;
+}
+
+bool settings_set_accessory_cal(const accessory_cal_t *cal)
+{
+    HAL_StatusTypeDef ret = HAL_OK;
+    uint8_t data[ACCESSORY_CAL_SIZE] __attribute__((aligned(4)));
+    uint32_t sequence = 0;
+
+    if (!cal || cal->serial[0] == '\0') { return false; }
+
+    osMutexAcquire(eeprom_i2c_mutex, portMAX_DELAY);
+
+    /*
+     * Replace the existing entry for this accessory if there is one,
+     * otherwise use an empty entry or the least recently saved one.
+     */
+    int index = settings_accessory_cal_find(cal->device_type, cal->serial);
+    for (int i = 0; i < MAX_ACCESSORY_CALS; i++) {
+        const settings_accessory_cal_index_t *entry = &accessory_cal_index[i];
+        if (entry->valid && entry->sequence > sequence) {
+            sequence = entry->sequence;
+        }
+        if (index < 0 && !entry->valid) {
+            index = i;
+        }
+    }
+    if (index < 0) {
+        index = 0;
+        for (int i = 1; i < MAX_ACCESSORY_CALS; i++) {
+            if (accessory_cal_index[i].sequence < accessory_cal_index[index].sequence) {
+                index = i;
+            }
+        }
+    }
+    sequence++;
+
+    memset(data, 0, sizeof(data));
+    copy_from_u32(data + ACCESSORY_CAL_VERSION, LATEST_ACCESSORY_CAL_VERSION);
+    data[ACCESSORY_CAL_DEVICE_TYPE] = cal->device_type;
+    copy_from_u32(data + ACCESSORY_CAL_SEQUENCE, sequence);
+    copy_from_u32(data + ACCESSORY_CAL_DATA_VERSION, cal->cal_version);
+    strncpy((char *)(data + ACCESSORY_CAL_SERIAL), cal->serial, ACCESSORY_SERIAL_LEN - 1);
+    memcpy(data + ACCESSORY_CAL_DATA, cal->data, ACCESSORY_CAL_DATA_SIZE);
+    copy_from_u32(data + ACCESSORY_CAL_CRC,
+        HAL_CRC_Calculate(&hcrc, (uint32_t *)data, ACCESSORY_CAL_CRC / 4UL));
+
+    ret = m24m01_write_page(eeprom_i2c,
+        PAGE_ACCESSORY_CAL_BASE + (PAGE_SIZE * index),
+        data, sizeof(data));
+
+    settings_accessory_cal_index_t *entry = &accessory_cal_index[index];
+    if (ret == HAL_OK) {
+        entry->valid = true;
+        entry->device_type = cal->device_type;
+        entry->sequence = sequence;
+        entry->cal_version = cal->cal_version;
+        strncpy(entry->serial, cal->serial, ACCESSORY_SERIAL_LEN);
+        entry->serial[ACCESSORY_SERIAL_LEN - 1] = '\0';
+    } else {
+        entry->valid = false;
+    }
+    osMutexRelease(eeprom_i2c_mutex);
+
+    if (ret != HAL_OK) {
+        log_e("Unable to save accessory calibration: %d", ret);
+        return false;
+    }
+
+    log_i("Cached accessory calibration: %d", index);
+    return true;
+}
+
+void settings_clear_accessory_cal(uint8_t device_type, const char *serial)
+{
+    if (!serial || serial[0] == '\0') { return; }
+
+    uint8_t data[PAGE_SIZE];
+    memset(data, 0xFF, sizeof(data));
+
+    osMutexAcquire(eeprom_i2c_mutex, portMAX_DELAY);
+    int index = settings_accessory_cal_find(device_type, serial);
+    if (index >= 0) {
+        log_i("Clear accessory calibration: %d", index);
+        m24m01_write_page(eeprom_i2c,
+            PAGE_ACCESSORY_CAL_BASE + (PAGE_SIZE * index),
+            data, sizeof(data));
+        accessory_cal_index[index].valid = false;
+    }
+    osMutexRelease(eeprom_i2c_mutex);
+}
+
 bool settings_set_bootloader_firmware(const char *dev_serial, uint32_t checksum, const char *file_path)
 {
     HAL_StatusTypeDef ret = HAL_OK;
@@ -1387,6 +1919,24 @@ bool settings_cleanup_bootloader_firmware()
     return (ret == HAL_OK);
 }
 
+bool settings_request_firmware_verify()
+{
+    HAL_StatusTypeDef ret = HAL_OK;
+    uint8_t data[16];
+
+    memset(data, 0x00, sizeof(data));
+
+    osMutexAcquire(eeprom_i2c_mutex, portMAX_DELAY);
+    ret = m24m01_write_page(eeprom_i2c, PAGE_BOOT_VERIFY + BOOT_VERIFY_MARKER, data, sizeof(data));
+    osMutexRelease(eeprom_i2c_mutex);
+    if (ret != HAL_OK) {
+        log_e("Unable to clear boot verification marker: %d", ret);
+        return false;
+    }
+
+    return true;
+}
+
 bool read_u32(uint32_t address, uint32_t *val)
 {
     uint8_t data[4];
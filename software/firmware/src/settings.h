@@ -14,9 +14,15 @@
 #include "enlarger_config.h"
 #include "paper_profile.h"
 #include "step_wedge.h"
+#include "print_job.h"
 
 #define MAX_ENLARGER_CONFIGS 16
 #define MAX_PAPER_PROFILES 16
+#define MAX_PRINT_JOBS 16
+#define MAX_ACCESSORY_CALS 4
+
+#define ACCESSORY_SERIAL_LEN 32
+#define ACCESSORY_CAL_DATA_SIZE 112
 
 typedef enum {
     SAFELIGHT_MODE_OFF = 0, /*!< Safelight is always off */
@@ -134,6 +140,18 @@ teststrip_patches_t settings_get_teststrip_patches();
 
 void settings_set_teststrip_patches(teststrip_patches_t patches);
 
+/**
+ * Automatic pause between patches for continuous teststrip exposures.
+ *
+ * When this is non-zero, all the patches of a teststrip are exposed
+ * in sequence from a single press of the start button.
+ *
+ * @return Pause time in milliseconds, or 0 if continuous mode is disabled
+ */
+uint32_t settings_get_teststrip_pause();
+
+void settings_set_teststrip_pause(uint32_t pause);
+
 /**
  * Index of the default enlarger configuration.
  *
@@ -164,6 +182,7 @@ bool settings_set_safelight_config(const safelight_config_t *safelight_config);
  *
  * This function is intended to provide an more efficient way of building
  * a list of saved configurations than loading all of them into memory.
+ * It is served from an index kept in RAM, and does not access the EEPROM.
  *
  * @param name Pointer to a buffer with at least 32 bytes.
  * @param index An index value from 0 to 15
@@ -177,6 +196,7 @@ bool settings_get_enlarger_config_name(char *name, uint8_t index);
  * This function is intended to provide an more efficient way of
  * checking just one property of an enlarger configuration without
  * having to load the entire data structure.
+ * It is served from an index kept in RAM, and does not access the EEPROM.
  *
  * @param dmx_control Pointer to the output variable
  * @param index An index value from 0 to 15
@@ -221,6 +241,19 @@ void settings_clear_enlarger_config(uint8_t index);
  */
 bool settings_get_paper_profile(paper_profile_t *profile, uint8_t index);
 
+/**
+ * Get the name of the paper profile saved at the specified index
+ *
+ * This function is intended to provide an more efficient way of building
+ * a list of saved profiles than loading all of them into memory.
+ * It is served from an index kept in RAM, and does not access the EEPROM.
+ *
+ * @param name Pointer to a buffer with at least 32 bytes.
+ * @param index An index value from 0 to 15
+ * @return True if the profile name was found, false otherwise
+ */
+bool settings_get_paper_profile_name(char *name, uint8_t index);
+
 /**
  * Save a paper profile at the specified index
  *
@@ -257,6 +290,77 @@ bool settings_get_step_wedge(step_wedge_t **wedge);
  */
 bool settings_set_step_wedge(const step_wedge_t *wedge);
 
+/**
+ * Get the print job saved at the specified index
+ *
+ * @param job Pointer to the job struct to load data into
+ * @param index An index value from 0 to 15
+ * @return True if the job was successfully loaded, false if no valid
+ *         job was found at the specified index.
+ */
+bool settings_get_print_job(print_job_t *job, uint8_t index);
+
+/**
+ * Save a print job at the specified index
+ *
+ * @param job Pointer to the job struct to save data from
+ * @param index An index value from 0 to 15
+ * @return True if the job was successfully saved
+ */
+bool settings_set_print_job(const print_job_t *job, uint8_t index);
+
+/**
+ * Clear any print job saved at the specified index
+ *
+ * @param index An index value from 0 to 15
+ */
+void settings_clear_print_job(uint8_t index);
+
+/**
+ * Cached copy of the calibration data from a USB accessory.
+ *
+ * The data is stored exactly as read from the accessory's own memory,
+ * and is identified by the accessory type, serial number, and the
+ * version of the calibration data it was read from.
+ */
+typedef struct {
+    uint8_t device_type;                    /*!< Type of the accessory */
+    char serial[ACCESSORY_SERIAL_LEN];      /*!< USB serial number of the accessory */
+    uint32_t cal_version;                   /*!< Version of the calibration data */
+    uint8_t data[ACCESSORY_CAL_DATA_SIZE];  /*!< Raw calibration data */
+} accessory_cal_t;
+
+/**
+ * Load cached accessory calibration data.
+ *
+ * The device type, serial number, and calibration version must be
+ * filled in before calling this function, and the cached data is
+ * only returned if all of them match a saved entry.
+ *
+ * @param cal Pointer to the struct to load data into
+ * @return True if matching data was found and loaded
+ */
+bool settings_get_accessory_cal(accessory_cal_t *cal);
+
+/**
+ * Save accessory calibration data to the cache.
+ *
+ * This replaces any existing entry for the same accessory, otherwise
+ * the entry that was least recently saved is replaced.
+ *
+ * @param cal Pointer to the struct to save data from
+ * @return True if the data was successfully saved
+ */
+bool settings_set_accessory_cal(const accessory_cal_t *cal);
+
+/**
+ * Remove any cached calibration data for an accessory.
+ *
+ * @param device_type Type of the accessory
+ * @param serial USB serial number of the accessory
+ */
+void settings_clear_accessory_cal(uint8_t device_type, const char *serial);
+
 /**
  * Set the firmware file to install on next boot.
  *
@@ -268,4 +372,15 @@ bool settings_set_step_wedge(const step_wedge_t *wedge);
  */
 bool settings_set_bootloader_firmware(const char *dev_serial, uint32_t checksum, const char *file_path);
 
+/**
+ * Request a full verification of the firmware on next boot.
+ *
+ * The bootloader normally skips checksum verification of a firmware
+ * image that it has already verified once. This clears its record of
+ * that verification.
+ *
+ * @return True if the request was successfully saved
+ */
+bool settings_request_firmware_verify();
+
 #endif /* SETTINGS_H */
@@ -13,6 +13,7 @@
 #include <elog.h>
 
 #include "exposure_state.h"
+#include "exposure_math.h"
 #include "display.h"
 #include "keypad.h"
 #include "util.h"
@@ -111,7 +112,7 @@ bool state_edit_adjustment_process(state_t *state_base, state_controller_t *cont
         sprintf(buf_adj_title2, "Area %d", state->working_index + 1);
     } else {
         float adj_stops = (float)state->working_value.numerator / (float)state->working_value.denominator;
-        float adj_time = exposure_get_exposure_time(exposure_state) * powf(2.0f, adj_stops);
+        float adj_time = exposure_get_exposure_time(exposure_state) * exposure_math_exp2(adj_stops);
         float min_exposure_time = exposure_get_min_exposure_time(exposure_state);
 
         if (state->working_value.numerator > 0) {
@@ -31,6 +31,7 @@
 #include "state_timer.h"
 #include "state_test_strip.h"
 #include "state_adjustment.h"
+#include "session_log.h"
 
 struct __state_controller_t {
     state_identifier_t current_state;
@@ -100,6 +101,12 @@ void state_controller_loop()
             state_controller.current_state = state_controller.next_state;
             state_controller.current_state_param = state_controller.next_state_param;
 
+            // Write out any session log records on the way back to
+            // the home state, where file access can't delay an exposure
+            if (state_controller.current_state == STATE_HOME) {
+                session_log_flush();
+            }
+
             if (state_controller.current_state < STATE_MAX && state_map[state_controller.current_state]) {
                 state = state_map[state_controller.current_state];
             } else {
@@ -261,6 +268,11 @@ bool state_menu_process(state_t *state_base, state_controller_t *controller)
     // As such, the menu system is simply hooked in this way and doesn't
     // really participate in the main state machine.
     main_menu_start(controller);
-    state_controller_set_next_state(controller, STATE_HOME, 0);
+
+    // Return to the home state, unless the menu has selected another
+    // state to transition into.
+    if (controller->next_state == STATE_MENU) {
+        state_controller_set_next_state(controller, STATE_HOME, 0);
+    }
     return true;
 }
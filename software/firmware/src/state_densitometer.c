@@ -13,6 +13,7 @@
 #include "buzzer.h"
 #include "usb_host.h"
 #include "densitometer.h"
+#include "exposure_math.h"
 #include "util.h"
 
 typedef enum {
@@ -368,7 +369,7 @@ float state_densitometer_probe_relative_density(state_densitometer_t *state)
     } else if (base_valid && !current_valid) {
         result = 0.0F;
     } else {
-        result = -1.0F * log10f(state->probe_reading_current / state->probe_reading_base);
+        result = -1.0F * exposure_math_log10(state->probe_reading_current / state->probe_reading_base);
     }
 
     /* Prevent negative results */
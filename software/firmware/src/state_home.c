@@ -18,12 +18,19 @@
 #include "relay.h"
 #include "illum_controller.h"
 #include "meter_probe.h"
+#include "meter_scan.h"
+#include "state_timer.h"
 #include "buzzer.h"
 #include "settings.h"
+#include "session_log.h"
 #include "util.h"
 
 #define LIVE_TONE_TIMEOUT pdMS_TO_TICKS(2000)
 
+/* Sensor settings for a 2.5ms integration time while scanning */
+#define SCAN_SAMPLE_TIME 359
+#define SCAN_NUM_SAMPLES 4
+
 typedef enum {
     ACTION_NONE = 0,
     ACTION_TIMER,
@@ -39,9 +46,11 @@ typedef enum {
     ACTION_ADJUST_FINE,
     ACTION_ADJUST_ABSOLUTE,
     ACTION_MENU,
+    ACTION_SPLIT_GRADE,
     ACTION_CLEAR_READINGS,
     ACTION_SET_DEFAULTS,
     ACTION_TAKE_READING,
+    ACTION_TAKE_SCAN,
     ACTION_ENCODER_DEC,
     ACTION_ENCODER_INC,
     ACTION_CHANGE_TIME_INCREMENT,
@@ -93,6 +102,11 @@ static void state_home_select_paper_profile(state_controller_t *controller);
 static void state_home_check_meter_probe(state_home_t *state, const state_controller_t *controller);
 static uint32_t state_home_take_reading(state_home_t *state, state_controller_t *controller);
 static uint32_t state_home_take_live_reading(state_home_t *state, state_controller_t *controller);
+static uint32_t state_home_take_scan(state_home_t *state, state_controller_t *controller);
+static void state_home_show_contrast_fit(state_controller_t *controller);
+static bool state_home_confirm_split_grade(state_controller_t *controller);
+static void state_home_scan_reading_callback(const meter_probe_handle_t *handle,
+    const meter_probe_sensor_reading_t *reading, void *user_data);
 static void state_home_exit(state_t *state_base, state_controller_t *controller, state_identifier_t next_state);
 static state_home_t state_home_data = {
     .base = {
@@ -190,9 +204,9 @@ void state_home_entry(state_t *state_base, state_controller_t *controller, state
     keypad_action_add(KEYPAD_ADD_ADJUSTMENT, ACTION_EDIT_ADJUSTMENT, ACTION_LIST_ADJUSTMENTS, true);
     keypad_action_add(KEYPAD_TEST_STRIP, ACTION_TEST_STRIP, ACTION_SELECT_PROFILE, true);
     keypad_action_add(KEYPAD_ENCODER, ACTION_ADJUST_FINE, ACTION_ADJUST_ABSOLUTE, true);
-    keypad_action_add(KEYPAD_MENU, ACTION_MENU, 0, false);
+    keypad_action_add(KEYPAD_MENU, ACTION_MENU, ACTION_SPLIT_GRADE, false);
     keypad_action_add(KEYPAD_CANCEL, ACTION_CLEAR_READINGS, ACTION_SET_DEFAULTS, true);
-    keypad_action_add(KEYPAD_METER_PROBE, ACTION_TAKE_READING, 0, false);
+    keypad_action_add(KEYPAD_METER_PROBE, ACTION_TAKE_READING, ACTION_TAKE_SCAN, false);
     keypad_action_add_encoder(ACTION_ENCODER_DEC, ACTION_ENCODER_INC);
     keypad_action_add_combo(KEYPAD_INC_EXPOSURE, KEYPAD_DEC_EXPOSURE, ACTION_CHANGE_TIME_INCREMENT);
     keypad_action_add_combo(KEYPAD_INC_CONTRAST, KEYPAD_DEC_CONTRAST, ACTION_CHANGE_MODE);
@@ -428,6 +442,11 @@ bool state_home_process_printing(state_home_t *state, state_controller_t *contro
         } else if (keypad_action.action_id == ACTION_MENU) {
             state_controller_set_next_state(controller, STATE_MENU, 0);
             state->display_dirty = true;
+        } else if (keypad_action.action_id == ACTION_SPLIT_GRADE) {
+            if (mode == EXPOSURE_MODE_PRINTING_BW && state_home_confirm_split_grade(controller)) {
+                state_controller_set_next_state(controller, STATE_TIMER, STATE_TIMER_PARAM_SPLIT_GRADE);
+            }
+            state->display_dirty = true;
         } else if (keypad_action.action_id == ACTION_CLEAR_READINGS) {
             exposure_clear_meter_readings(exposure_state);
             state->display_dirty = true;
@@ -441,6 +460,12 @@ bool state_home_process_printing(state_home_t *state, state_controller_t *contro
                 state->updated_tone_element = state_home_take_reading(state, controller);
                 state->display_dirty = true;
             }
+        } else if (keypad_action.action_id == ACTION_TAKE_SCAN) {
+            if (mode != EXPOSURE_MODE_PRINTING_COLOR
+                && state_controller_is_enlarger_focus(controller) && meter_probe_is_started(meter_probe_handle())) {
+                state->updated_tone_element = state_home_take_scan(state, controller);
+                state->display_dirty = true;
+            }
         }
         return true;
     } else {
@@ -538,10 +563,10 @@ bool state_home_process_calibration(state_home_t *state, state_controller_t *con
 void state_home_select_paper_profile(state_controller_t *controller)
 {
     exposure_state_t *exposure_state = state_controller_get_exposure_state(controller);
-    paper_profile_t *profile_list;
-    profile_list = pvPortMalloc(sizeof(paper_profile_t) * MAX_PAPER_PROFILES);
-    if (!profile_list) {
-        log_e("Unable to allocate memory for profile list");
+    char *profile_name_list;
+    profile_name_list = pvPortMalloc(PROFILE_NAME_LEN * MAX_PAPER_PROFILES);
+    if (!profile_name_list) {
+        log_e("Unable to allocate memory for profile name list");
         return;
     }
 
@@ -554,7 +579,7 @@ void state_home_select_paper_profile(state_controller_t *controller)
     profile_count = 0;
     profile_index = exposure_get_active_paper_profile_index(exposure_state);
     for (size_t i = 0; i < MAX_PAPER_PROFILES; i++) {
-        if (!settings_get_paper_profile(&profile_list[i], i)) {
+        if (!settings_get_paper_profile_name(profile_name_list + (i * PROFILE_NAME_LEN), i)) {
             break;
         } else {
             profile_count = i + 1;
@@ -563,6 +588,7 @@ void state_home_select_paper_profile(state_controller_t *controller)
     log_i("Loaded %d profiles, selected is %d", profile_count, profile_index);
     if (profile_count == 0) {
         log_w("No profiles available");
+        vPortFree(profile_name_list);
         return;
     }
 
@@ -574,10 +600,11 @@ void state_home_select_paper_profile(state_controller_t *controller)
 
     offset = 0;
     for (size_t i = 0; i < profile_count; i++) {
-        if (strlen(profile_list[i].name) > 0) {
+        const char *profile_name = profile_name_list + (i * PROFILE_NAME_LEN);
+        if (strlen(profile_name) > 0) {
             sprintf(buf + offset, "%s %s",
                 ((i == profile_index) ? "-->" : "   "),
-                profile_list[i].name);
+                profile_name);
         } else {
             sprintf(buf + offset, "%s Paper profile %d",
                 ((i == profile_index) ? "-->" : "   "),
@@ -599,7 +626,7 @@ void state_home_select_paper_profile(state_controller_t *controller)
         }
     } while (option != 0 && option != UINT8_MAX);
 
-    vPortFree(profile_list);
+    vPortFree(profile_name_list);
 }
 
 void state_home_check_meter_probe(state_home_t *state, const state_controller_t *controller)
@@ -654,7 +681,9 @@ uint32_t state_home_take_reading(state_home_t *state, state_controller_t *contro
     if (result == METER_READING_OK) {
         buzzer_sequence(BUZZER_SEQUENCE_PROBE_SUCCESS);
         updated_tone_element = exposure_add_meter_reading(exposure_state, lux);
+        session_log_meter_reading(lux);
         log_i("Measured PEV=%lu (Lux=%f)", exposure_get_calibration_pev(exposure_state), lux);
+        state_home_show_contrast_fit(controller);
     } else if (result == METER_READING_LOW) {
         display_draw_mode_text("Light Low");
         buzzer_sequence(BUZZER_SEQUENCE_PROBE_WARNING);
@@ -691,6 +720,169 @@ uint32_t state_home_take_live_reading(state_home_t *state, state_controller_t *c
     return live_tone_element;
 }
 
+uint32_t state_home_take_scan(state_home_t *state, state_controller_t *controller)
+{
+    exposure_state_t *exposure_state = state_controller_get_exposure_state(controller);
+    meter_probe_handle_t *handle = meter_probe_handle();
+    meter_scan_t scan;
+    keypad_event_t keypad_event;
+    char buf[16];
+    bool accepted = false;
+    bool sensor_error = false;
+    uint32_t updated_tone_element = 0;
+
+    meter_scan_init(&scan);
+
+    display_draw_mode_text("Scanning");
+    buzzer_sequence(BUZZER_SEQUENCE_PROBE_START);
+    illum_controller_safelight_state(ILLUM_SAFELIGHT_MEASUREMENT);
+    osDelay(SAFELIGHT_OFF_DELAY / 2);
+
+    /*
+     * Readings in fast mode arrive in batches far more often than this
+     * loop runs, and the reading queue only holds the most recent one.
+     * So the scan is accumulated by a callback within the meter probe
+     * task, which sees every batch, and this loop just shows progress.
+     */
+    do {
+        if (meter_probe_sensor_disable(handle) != osOK
+            || meter_probe_sensor_set_integration(handle, SCAN_SAMPLE_TIME, SCAN_NUM_SAMPLES) != osOK
+            || meter_probe_sensor_enable_agc(handle, SCAN_NUM_SAMPLES) != osOK
+            || meter_probe_sensor_set_reading_callback(handle, state_home_scan_reading_callback, &scan) != osOK
+            || meter_probe_sensor_enable_fast_mode(handle) != osOK) {
+            sensor_error = true;
+            break;
+        }
+
+        uint32_t last_count = 0;
+        for (;;) {
+            if (keypad_wait_for_event(&keypad_event, 100) == HAL_OK) {
+                if (keypad_event.key == KEYPAD_METER_PROBE && keypad_event.pressed) {
+                    accepted = true;
+                    break;
+                } else if (keypad_event.key == KEYPAD_CANCEL && !keypad_event.pressed) {
+                    break;
+                } else if (keypad_event.key == KEYPAD_USB_KEYBOARD && keypad_event.pressed
+                    && keypad_usb_get_keypad_equivalent(&keypad_event) == KEYPAD_CANCEL) {
+                    break;
+                }
+            }
+
+            /* Values may be mid-update, but are only used for this display */
+            const uint32_t count = scan.count;
+            if (count != last_count) {
+                const float stops = meter_scan_range_stops(&scan);
+                if (is_valid_number(stops)) {
+                    snprintf(buf, sizeof(buf), "%.1f Stops", stops);
+                    display_draw_mode_text(buf);
+                }
+                last_count = count;
+            }
+        }
+    } while (0);
+
+    /* Once this returns, the callback is no longer touching the scan */
+    meter_probe_sensor_set_reading_callback(handle, NULL, NULL);
+
+    /* Restore the normal sensor configuration */
+    meter_probe_sensor_disable(handle);
+    meter_probe_sensor_set_integration(handle, 719, 99);
+    meter_probe_sensor_set_mod_calibration(handle, 1);
+    meter_probe_sensor_enable_agc(handle, 99);
+    meter_probe_sensor_enable(handle);
+
+    illum_controller_safelight_state(ILLUM_SAFELIGHT_HOME);
+
+    /* Outliers are dropped from the ends of the scan before it is used */
+    float lux_min = NAN;
+    float lux_max = NAN;
+    const bool has_range = meter_scan_trimmed_range(&scan, &lux_min, &lux_max);
+
+    log_i("Scan: count=%lu, saturated=%lu, invalid=%lu, min=%f, max=%f, trimmed=%f-%f",
+        scan.count, scan.saturated, scan.invalid, scan.lux_min, scan.lux_max, lux_min, lux_max);
+
+    if (sensor_error) {
+        display_draw_mode_text("Meter Error");
+        buzzer_sequence(BUZZER_SEQUENCE_PROBE_ERROR);
+        osDelay(pdMS_TO_TICKS(2000));
+    } else if (accepted && has_range) {
+        buzzer_sequence(BUZZER_SEQUENCE_PROBE_SUCCESS);
+        updated_tone_element = exposure_set_meter_scan(exposure_state, &scan);
+        session_log_meter_reading(lux_min);
+        if (lux_max > lux_min) {
+            session_log_meter_reading(lux_max);
+        }
+        log_i("Scanned PEV=%lu (Lux=%f-%f)", exposure_get_calibration_pev(exposure_state), lux_min, lux_max);
+        state_home_show_contrast_fit(controller);
+    } else if (accepted) {
+        display_draw_mode_text(scan.saturated > 0 ? "Light High" : "Light Low");
+        buzzer_sequence(BUZZER_SEQUENCE_PROBE_WARNING);
+        osDelay(pdMS_TO_TICKS(2000));
+    }
+    return updated_tone_element;
+}
+
+void state_home_show_contrast_fit(state_controller_t *controller)
+{
+    const exposure_state_t *exposure_state = state_controller_get_exposure_state(controller);
+    exposure_contrast_fit_t fit;
+    char buf[16];
+
+    if (!exposure_solve_contrast_grade(exposure_state, &fit)) {
+        return;
+    }
+
+    log_i("Best fit: grade=%s, time=%.2fs, highlight=%+.0f, shadow=%+.0f",
+        contrast_grade_str(fit.contrast_grade), fit.base_time,
+        fit.highlight_offset, fit.shadow_offset);
+
+    /* Only interrupt the display if the grade would change */
+    if (fit.contrast_grade != exposure_get_contrast_grade(exposure_state)) {
+        snprintf(buf, sizeof(buf), "Grade %s", contrast_grade_str(fit.contrast_grade));
+        display_draw_mode_text(buf);
+        osDelay(pdMS_TO_TICKS(1000));
+    }
+}
+
+bool state_home_confirm_split_grade(state_controller_t *controller)
+{
+    const exposure_state_t *exposure_state = state_controller_get_exposure_state(controller);
+    exposure_split_grade_t split;
+    char buf[64];
+
+    if (exposure_burn_dodge_count(exposure_state) > 0) {
+        display_message("Split Grade\n", NULL, "\nNot available with\nburn/dodge adjustments", " OK ");
+        return false;
+    }
+
+    if (!exposure_solve_split_grade(exposure_state, &split)) {
+        display_message("Split Grade\n", NULL,
+            "\nNeeds highlight and shadow\nreadings, and a paper profile\nwith grades 00 and 5", " OK ");
+        return false;
+    }
+
+    sprintf(buf, "\nGrade 00: %.1fs\nGrade 5: %.1fs\n", split.soft_time, split.hard_time);
+    uint8_t option = display_message("Split Grade\n", NULL, buf, " Start \n Cancel ");
+
+    return option == 1;
+}
+
+void state_home_scan_reading_callback(const meter_probe_handle_t *handle,
+    const meter_probe_sensor_reading_t *reading, void *user_data)
+{
+    meter_scan_t *scan = (meter_scan_t *)user_data;
+
+    for (uint8_t i = 0; i < MAX_ALS_COUNT; i++) {
+        const meter_probe_sensor_result_t status = reading->reading[i].status;
+        if (status == METER_SENSOR_RESULT_VALID) {
+            meter_scan_add(scan, meter_probe_lux_result_at(handle, reading, i));
+        } else {
+            meter_scan_add_rejected(scan,
+                status == METER_SENSOR_RESULT_SATURATED_ANALOG || status == METER_SENSOR_RESULT_SATURATED_DIGITAL);
+        }
+    }
+}
+
 void state_home_exit(state_t *state_base, state_controller_t *controller, state_identifier_t next_state)
 {
     state_home_t *state = (state_home_t *)state_base;
@@ -18,6 +18,7 @@
 #include "exposure_timer.h"
 #include "settings.h"
 #include "buzzer.h"
+#include "session_log.h"
 
 typedef struct {
     state_t base;
@@ -29,10 +30,16 @@ typedef struct {
     unsigned int exposure_patch_count;
     unsigned int exposure_patch_offset;
     unsigned int patches_covered;
+    uint32_t patch_time_ms[7];
+    uint32_t pause_time_ms;
     display_test_strip_elements_t elements;
 } state_test_strip_t;
 
-static bool state_test_strip_countdown(const exposure_state_t *exposure_state, const enlarger_config_t *enlarger_config, uint32_t patch_time_ms, bool last_patch);
+static void state_test_strip_prepare_schedule(state_test_strip_t *state, const exposure_state_t *exposure_state);
+static void state_test_strip_update_elements(state_test_strip_t *state);
+static bool state_test_strip_run_continuous(state_test_strip_t *state, const exposure_state_t *exposure_state, const enlarger_config_t *enlarger_config);
+static bool state_test_strip_pause(uint32_t pause_time_ms);
+static bool state_test_strip_countdown(const exposure_state_t *exposure_state, const enlarger_config_t *enlarger_config, uint32_t patch_time_ms, unsigned int patch, bool last_patch);
 
 static void state_test_strip_entry(state_t *state_base, state_controller_t *controller, state_identifier_t prev_state, uint32_t param);
 static void state_test_strip_prepare_elements(state_test_strip_t *state, state_controller_t *controller);
@@ -63,9 +70,12 @@ void state_test_strip_entry(state_t *state_base, state_controller_t *controller,
     state->exposure_patch_count = 0;
     state->exposure_patch_offset = 0;
     state->patches_covered = 0;
+    memset(state->patch_time_ms, 0, sizeof(state->patch_time_ms));
+    state->pause_time_ms = settings_get_teststrip_pause();
     memset(&state->elements, 0, sizeof(display_test_strip_elements_t));
 
     state_test_strip_prepare_elements(state, controller);
+    state_test_strip_prepare_schedule(state, state_controller_get_exposure_state(controller));
 }
 
 void state_test_strip_prepare_elements(state_test_strip_t *state, state_controller_t *controller)
@@ -161,6 +171,46 @@ void state_test_strip_prepare_elements(state_test_strip_t *state, state_controll
     }
 }
 
+/**
+ * Precompute the exposure time for every patch of the test strip,
+ * so the complete sequence is known before the first exposure starts.
+ */
+void state_test_strip_prepare_schedule(state_test_strip_t *state, const exposure_state_t *exposure_state)
+{
+    for (unsigned int i = 0; i < state->exposure_patch_count; i++) {
+        float patch_time;
+        if (i < state->exposure_patch_offset) {
+            patch_time = 0;
+        } else if (state->teststrip_mode == TESTSTRIP_MODE_SEPARATE) {
+            patch_time = exposure_get_test_strip_time_complete(exposure_state, state->exposure_patch_min + i);
+        } else {
+            patch_time = exposure_get_test_strip_time_incremental(exposure_state,
+                state->exposure_patch_min + state->exposure_patch_offset,
+                i - state->exposure_patch_offset);
+        }
+        state->patch_time_ms[i] = rounded_exposure_time_ms(patch_time);
+    }
+}
+
+/**
+ * Update the covered patches and timer display for the next patch
+ * to be exposed.
+ */
+void state_test_strip_update_elements(state_test_strip_t *state)
+{
+    if (state->teststrip_mode == TESTSTRIP_MODE_SEPARATE) {
+        state->elements.covered_patches = 0xFF;
+        state->elements.covered_patches ^= (1 << (state->exposure_patch_count - state->patches_covered - 1));
+    } else {
+        state->elements.covered_patches = 0;
+        for (int i = 0; i < state->patches_covered; i++) {
+            state->elements.covered_patches |= (1 << (state->exposure_patch_count - i - 1));
+        }
+    }
+
+    convert_exposure_to_display_timer(&(state->elements.time_elements), state->patch_time_ms[state->patches_covered]);
+}
+
 bool state_test_strip_process(state_t *state_base, state_controller_t *controller)
 {
     state_test_strip_t *state = (state_test_strip_t *)state_base;
@@ -170,31 +220,15 @@ bool state_test_strip_process(state_t *state_base, state_controller_t *controlle
     enlarger_control_set_state_safe(&enlarger_config->control, false);
 
     bool canceled = false;
-    float patch_time;
     if (state->patches_covered == state->exposure_patch_count) {
-        patch_time = exposure_get_test_strip_time_complete(exposure_state, 0);
+        float patch_time = exposure_get_test_strip_time_complete(exposure_state, 0);
+        convert_exposure_to_display_timer(&(state->elements.time_elements), rounded_exposure_time_ms(patch_time));
         state->elements.covered_patches = 0xFF;
         canceled = true;
-    } else if (state->teststrip_mode == TESTSTRIP_MODE_SEPARATE) {
-        patch_time = exposure_get_test_strip_time_complete(exposure_state, state->exposure_patch_min + state->patches_covered);
-
-        state->elements.covered_patches = 0xFF;
-        state->elements.covered_patches ^= (1 << (state->exposure_patch_count - state->patches_covered - 1));
     } else {
-        patch_time = exposure_get_test_strip_time_incremental(exposure_state,
-            state->exposure_patch_min + state->exposure_patch_offset,
-            state->patches_covered - state->exposure_patch_offset);
-
-        state->elements.covered_patches = 0;
-        for (int i = 0; i < state->patches_covered; i++) {
-            state->elements.covered_patches |= (1 << (state->exposure_patch_count - i - 1));
-        }
+        state_test_strip_update_elements(state);
     }
 
-    uint32_t patch_time_ms = rounded_exposure_time_ms(patch_time);
-
-    convert_exposure_to_display_timer(&(state->elements.time_elements), patch_time_ms);
-
     display_draw_test_strip_elements(&state->elements);
 
     /* Abort if the test strip can't be created */
@@ -226,7 +260,14 @@ bool state_test_strip_process(state_t *state_base, state_controller_t *controlle
         if (keypad_is_key_released_or_repeated(&keypad_event, KEYPAD_START)
             || keypad_is_key_released_or_repeated(&keypad_event, KEYPAD_FOOTSWITCH)) {
 
-            if (state_test_strip_countdown(exposure_state, enlarger_config, patch_time_ms, state->patches_covered == (state->exposure_patch_count - 1))) {
+            if (state->pause_time_ms > 0) {
+                if (!state_test_strip_run_continuous(state, exposure_state, enlarger_config)) {
+                    state_controller_set_next_state(controller, STATE_HOME, 0);
+                    canceled = true;
+                }
+            } else if (state_test_strip_countdown(exposure_state, enlarger_config,
+                state->patch_time_ms[state->patches_covered], state->patches_covered,
+                state->patches_covered == (state->exposure_patch_count - 1))) {
                 if (state->patches_covered < state->exposure_patch_count) {
                     state->patches_covered++;
                 }
@@ -249,6 +290,87 @@ bool state_test_strip_process(state_t *state_base, state_controller_t *controlle
     return true;
 }
 
+/**
+ * Expose all the remaining patches of the test strip in sequence,
+ * with an automatic pause between each patch.
+ *
+ * @return True if the sequence completed, false if it was canceled
+ */
+bool state_test_strip_run_continuous(state_test_strip_t *state, const exposure_state_t *exposure_state, const enlarger_config_t *enlarger_config)
+{
+    log_i("Starting continuous test strip: patches=%d, pause=%ldms",
+        state->exposure_patch_count - state->patches_covered, state->pause_time_ms);
+
+    while (state->patches_covered < state->exposure_patch_count) {
+        const bool last_patch = state->patches_covered == (state->exposure_patch_count - 1);
+
+        if (!state_test_strip_countdown(exposure_state, enlarger_config,
+            state->patch_time_ms[state->patches_covered], state->patches_covered, last_patch)) {
+            return false;
+        }
+        state->patches_covered++;
+
+        if (!last_patch) {
+            /* Show the upcoming patch while waiting for the strip to be moved */
+            state_test_strip_update_elements(state);
+            display_draw_test_strip_elements(&state->elements);
+
+            if (!state_test_strip_pause(state->pause_time_ms)) {
+                log_i("Canceling test strip between patches");
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Wait for the inter-patch pause to elapse, while watching for the
+ * cancel key, and play a cue tone just before the next patch.
+ *
+ * @return True if the pause completed, false if it was canceled
+ */
+bool state_test_strip_pause(uint32_t pause_time_ms)
+{
+    const uint32_t start_ticks = osKernelGetTickCount();
+    const uint32_t pause_ticks = pdMS_TO_TICKS(pause_time_ms);
+    uint32_t elapsed_ticks = 0;
+
+    /*
+     * Write out the session log while the strip is being moved, since
+     * a long continuous strip can otherwise fill the record buffer.
+     * Any time spent here counts against the pause.
+     */
+    session_log_flush();
+    elapsed_ticks = osKernelGetTickCount() - start_ticks;
+
+    while (elapsed_ticks < pause_ticks) {
+        keypad_event_t keypad_event;
+        if (keypad_wait_for_event(&keypad_event, (pause_ticks - elapsed_ticks) * portTICK_RATE_MS) == HAL_OK) {
+            if ((keypad_event.key == KEYPAD_CANCEL && !keypad_event.pressed)
+                || (keypad_usb_get_keypad_equivalent(&keypad_event) == KEYPAD_CANCEL && keypad_event.pressed)) {
+                return false;
+            }
+        }
+        elapsed_ticks = osKernelGetTickCount() - start_ticks;
+    }
+
+    buzzer_volume_t current_volume = buzzer_get_volume();
+    uint16_t current_frequency = buzzer_get_frequency();
+    buzzer_set_volume(settings_get_buzzer_volume());
+
+    buzzer_set_frequency(2000);
+    buzzer_start();
+    osDelay(pdMS_TO_TICKS(50));
+    buzzer_stop();
+
+    buzzer_set_volume(current_volume);
+    buzzer_set_frequency(current_frequency);
+
+    return true;
+}
+
 static bool state_test_strip_exposure_callback(exposure_timer_state_t state, uint32_t time_ms, void *user_data)
 {
     display_exposure_timer_t *elements = user_data;
@@ -269,7 +391,7 @@ static bool state_test_strip_exposure_callback(exposure_timer_state_t state, uin
     return true;
 }
 
-bool state_test_strip_countdown(const exposure_state_t *exposure_state, const enlarger_config_t *enlarger_config, uint32_t patch_time_ms, bool last_patch)
+bool state_test_strip_countdown(const exposure_state_t *exposure_state, const enlarger_config_t *enlarger_config, uint32_t patch_time_ms, unsigned int patch, bool last_patch)
 {
     display_exposure_timer_t elements;
     convert_exposure_to_display_timer(&elements, patch_time_ms);
@@ -306,6 +428,13 @@ bool state_test_strip_countdown(const exposure_state_t *exposure_state, const en
     display_redraw_test_strip_timer(&elements);
 
     HAL_StatusTypeDef ret = exposure_timer_run();
+
+    const uint16_t channels[3] = {
+        timer_config.channel_red, timer_config.channel_green, timer_config.channel_blue
+    };
+    session_log_exposure(SESSION_LOG_TYPE_TEST_STRIP, session_log_timer_result(ret),
+        patch_time_ms, timer_config.contrast_grade, channels, patch, 0, 0);
+
     if (ret == HAL_TIMEOUT) {
         log_e("Exposure timer canceled");
     } else if (ret != HAL_OK) {
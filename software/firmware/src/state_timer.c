@@ -18,40 +18,134 @@
 #include "enlarger_config.h"
 #include "enlarger_control.h"
 #include "exposure_timer.h"
+#include "exposure_math.h"
 #include "settings.h"
+#include "session_log.h"
 
+typedef struct {
+    state_t base;
+    uint32_t copies;
+    uint32_t copy;
+    bool split_grade;
+} state_timer_t;
+
+static void state_timer_entry(state_t *state_base, state_controller_t *controller, state_identifier_t prev_state, uint32_t param);
 static bool state_timer_process(state_t *state_base, state_controller_t *controller);
-static state_t state_timer_data = {
-    .state_process = state_timer_process
+static state_timer_t state_timer_data = {
+    .base = {
+        .state_entry = state_timer_entry,
+        .state_process = state_timer_process
+    }
 };
 
+static bool state_timer_print_copy(exposure_state_t *exposure_state, const enlarger_config_t *enlarger_config, bool split_grade);
+static bool state_timer_sheet_change(uint32_t copy, uint32_t copies);
+static uint8_t state_timer_log_copy();
+
 static bool state_timer_main_exposure(exposure_state_t *exposure_state, const enlarger_config_t *enlarger_config);
 static bool state_timer_main_exposure_callback(exposure_timer_state_t state, uint32_t time_ms, void *user_data);
 static bool state_timer_burn_dodge_exposure(exposure_state_t *exposure_state, const enlarger_config_t *enlarger_config, int burn_dodge_index);
 static bool state_timer_burn_dodge_exposure_callback(exposure_timer_state_t state, uint32_t time_ms, void *user_data);
+static bool state_timer_split_grade_exposure(exposure_state_t *exposure_state, const enlarger_config_t *enlarger_config);
+static bool state_timer_split_grade_single_run(const enlarger_config_t *enlarger_config,
+    uint32_t soft_time_ms, uint32_t hard_time_ms);
+static bool state_timer_split_grade_pass(const enlarger_config_t *enlarger_config,
+    const char *title, uint32_t exposure_time_ms, contrast_grade_t contrast_grade);
 
 state_t *state_timer()
 {
     return (state_t *)&state_timer_data;
 }
 
+void state_timer_entry(state_t *state_base, state_controller_t *controller, state_identifier_t prev_state, uint32_t param)
+{
+    state_timer_t *state = (state_timer_t *)state_base;
+
+    /* The state parameter is the number of copies to print, if non-zero */
+    const uint32_t copies = param & ~STATE_TIMER_PARAM_SPLIT_GRADE;
+    state->copies = (copies > 0) ? copies : 1;
+    state->copy = 1;
+    state->split_grade = (param & STATE_TIMER_PARAM_SPLIT_GRADE) != 0;
+}
+
 bool state_timer_process(state_t *state_base, state_controller_t *controller)
 {
+    state_timer_t *state = (state_timer_t *)state_base;
     exposure_state_t *exposure_state = state_controller_get_exposure_state(controller);
     const enlarger_config_t *enlarger_config = state_controller_get_enlarger_config(controller);
 
-    if (state_timer_main_exposure(exposure_state, enlarger_config)) {
-        for (int i = 0; i < exposure_burn_dodge_count(exposure_state); i++) {
-            if (!state_timer_burn_dodge_exposure(exposure_state, enlarger_config, i)) {
+    for (uint32_t copy = 1; copy <= state->copies; copy++) {
+        state->copy = copy;
+        if (copy > 1) {
+            if (!state_timer_sheet_change(copy, state->copies)) {
                 break;
             }
         }
+        if (!state_timer_print_copy(exposure_state, enlarger_config, state->split_grade)) {
+            if (state->copies > 1) {
+                log_i("Print job stopped after %ld of %ld copies", copy - 1, state->copies);
+            }
+            break;
+        }
     }
 
     state_controller_set_next_state(controller, STATE_HOME, 0);
     return true;
 }
 
+bool state_timer_print_copy(exposure_state_t *exposure_state, const enlarger_config_t *enlarger_config, bool split_grade)
+{
+    if (split_grade) {
+        /* Burn and dodge times are based on a single-grade exposure, so they do not apply here */
+        return state_timer_split_grade_exposure(exposure_state, enlarger_config);
+    }
+
+    if (!state_timer_main_exposure(exposure_state, enlarger_config)) {
+        return false;
+    }
+
+    for (int i = 0; i < exposure_burn_dodge_count(exposure_state); i++) {
+        if (!state_timer_burn_dodge_exposure(exposure_state, enlarger_config, i)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool state_timer_sheet_change(uint32_t copy, uint32_t copies)
+{
+    char buf[64];
+    sprintf(buf, "\nCopy %ld of %ld\n\nChange paper and press START", copy, copies);
+    display_static_list("Print Job", buf);
+
+    /* Write out the session log while waiting, since a long job can fill the buffer */
+    session_log_flush();
+
+    keypad_event_t keypad_event;
+    do {
+        if (keypad_wait_for_event(&keypad_event, -1) == HAL_OK) {
+            if (keypad_is_key_released_or_repeated(&keypad_event, KEYPAD_START)
+                || keypad_is_key_released_or_repeated(&keypad_event, KEYPAD_FOOTSWITCH)) {
+                log_i("Starting copy %ld of %ld", copy, copies);
+                return true;
+            } else if (keypad_event.key == KEYPAD_CANCEL && !keypad_event.pressed) {
+                log_i("Canceling print job at copy %ld of %ld", copy, copies);
+                return false;
+            }
+        }
+    } while (1);
+}
+
+/**
+ * Get the zero-based copy index of the current print job, for the session log.
+ */
+uint8_t state_timer_log_copy()
+{
+    const uint32_t index = (state_timer_data.copy > 0) ? state_timer_data.copy - 1 : 0;
+    return (index > UINT8_MAX) ? UINT8_MAX : (uint8_t)index;
+}
+
 bool state_timer_main_exposure(exposure_state_t *exposure_state, const enlarger_config_t *enlarger_config)
 {
     bool result;
@@ -62,7 +156,7 @@ bool state_timer_main_exposure(exposure_state_t *exposure_state, const enlarger_
     const exposure_burn_dodge_t *burn_dodge_entry = exposure_burn_dodge_get(exposure_state, 0);
     if (burn_dodge_entry && burn_dodge_entry->numerator < 0) {
         float adj_stops = (float)burn_dodge_entry->numerator / (float)burn_dodge_entry->denominator;
-        float adj_time = exposure_get_exposure_time(exposure_state) * powf(2.0f, adj_stops);
+        float adj_time = exposure_get_exposure_time(exposure_state) * exposure_math_exp2(adj_stops);
         float dodge_time = fabsf(exposure_get_exposure_time(exposure_state) - adj_time);
         adjusted_exposure_time -= dodge_time;
         if (adjusted_exposure_time < 0) { adjusted_exposure_time = 0; }
@@ -108,6 +202,13 @@ bool state_timer_main_exposure(exposure_state_t *exposure_state, const enlarger_
     display_draw_exposure_timer(&elements, 0);
 
     HAL_StatusTypeDef ret = exposure_timer_run();
+
+    const uint16_t channels[3] = {
+        timer_config.channel_red, timer_config.channel_green, timer_config.channel_blue
+    };
+    session_log_exposure(SESSION_LOG_TYPE_EXPOSURE, session_log_timer_result(ret),
+        exposure_time_ms, timer_config.contrast_grade, channels, state_timer_log_copy(), 0, 0);
+
     if (ret == HAL_TIMEOUT) {
         log_e("Exposure timer canceled");
         result = false;
@@ -184,7 +285,7 @@ bool state_timer_burn_dodge_exposure(exposure_state_t *exposure_state, const enl
 
     /* Calculate the raw time for the adjustment exposure */
     float adj_stops = (float)entry->numerator / (float)entry->denominator;
-    float adj_time = exposure_get_exposure_time(exposure_state) * powf(2.0f, adj_stops);
+    float adj_time = exposure_get_exposure_time(exposure_state) * exposure_math_exp2(adj_stops);
     float burn_dodge_time = 0;
     if (entry->numerator < 0) {
         /* Dodge adjustment */
@@ -266,6 +367,14 @@ bool state_timer_burn_dodge_exposure(exposure_state_t *exposure_state, const enl
     display_draw_adjustment_exposure_elements(&elements);
 
     HAL_StatusTypeDef ret = exposure_timer_run();
+
+    const uint16_t channels[3] = {
+        timer_config.channel_red, timer_config.channel_green, timer_config.channel_blue
+    };
+    session_log_exposure(SESSION_LOG_TYPE_BURN_DODGE, session_log_timer_result(ret),
+        exposure_time_ms, timer_config.contrast_grade, channels,
+        burn_dodge_index, entry->numerator, entry->denominator);
+
     if (ret == HAL_TIMEOUT) {
         log_e("Exposure timer canceled");
         result = false;
@@ -303,3 +412,198 @@ bool state_timer_burn_dodge_exposure_callback(exposure_timer_state_t state, uint
 
     return true;
 }
+
+bool state_timer_split_grade_exposure(exposure_state_t *exposure_state, const enlarger_config_t *enlarger_config)
+{
+    exposure_split_grade_t split;
+
+    if (!exposure_solve_split_grade(exposure_state, &split)) {
+        log_w("Cannot solve split-grade exposure from current readings");
+        return false;
+    }
+
+    const uint32_t soft_time_ms = rounded_exposure_time_ms(split.soft_time);
+    const uint32_t hard_time_ms = rounded_exposure_time_ms(split.hard_time);
+    log_i("Split-grade exposure: 00=%ldms, 5=%ldms", soft_time_ms, hard_time_ms);
+
+    const enlarger_control_t *control = &enlarger_config->control;
+    const bool has_grade_frames = control->dmx_control
+        && control->contrast_mode == ENLARGER_CONTRAST_MODE_GREEN_BLUE
+        && (control->channel_set == ENLARGER_CHANNEL_SET_RGB || control->channel_set == ENLARGER_CHANNEL_SET_RGBW);
+
+    if (has_grade_frames) {
+        /* The enlarger can change grades by itself, so do both passes in one run */
+        return state_timer_split_grade_single_run(enlarger_config, soft_time_ms, hard_time_ms);
+    }
+
+    /* Otherwise, stop between passes so the filter can be changed */
+    if (soft_time_ms > 0) {
+        if (!state_timer_split_grade_pass(enlarger_config, "Soft Pass", soft_time_ms, CONTRAST_GRADE_00)) {
+            return false;
+        }
+    }
+    if (hard_time_ms > 0) {
+        if (!state_timer_split_grade_pass(enlarger_config, "Hard Pass", hard_time_ms, CONTRAST_GRADE_5)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool state_timer_split_grade_single_run(const enlarger_config_t *enlarger_config,
+    uint32_t soft_time_ms, uint32_t hard_time_ms)
+{
+    bool result;
+    const uint32_t exposure_time_ms = soft_time_ms + hard_time_ms;
+
+    display_exposure_timer_t elements;
+    convert_exposure_to_display_timer(&elements, exposure_time_ms);
+
+    exposure_timer_config_t timer_config = {0};
+    timer_config.end_tone = EXPOSURE_TIMER_END_TONE_REGULAR;
+    timer_config.timer_callback = state_timer_main_exposure_callback;
+    timer_config.user_data = &elements;
+
+    if (elements.fraction_digits == 0) {
+        timer_config.callback_rate = EXPOSURE_TIMER_RATE_1_SEC;
+    } else if (elements.fraction_digits == 1) {
+        timer_config.callback_rate = EXPOSURE_TIMER_RATE_100_MS;
+    } else if (elements.fraction_digits == 2) {
+        timer_config.callback_rate = EXPOSURE_TIMER_RATE_10_MS;
+    } else {
+        timer_config.callback_rate = EXPOSURE_TIMER_RATE_1_SEC;
+    }
+
+    /* A single pass at either grade is just a normal exposure */
+    if (soft_time_ms == 0) {
+        timer_config.contrast_grade = CONTRAST_GRADE_5;
+    } else {
+        timer_config.contrast_grade = CONTRAST_GRADE_00;
+        if (hard_time_ms > 0) {
+            timer_config.split_time = soft_time_ms;
+            timer_config.split_contrast_grade = CONTRAST_GRADE_5;
+        }
+    }
+
+    exposure_timer_set_config_time(&timer_config, exposure_time_ms, enlarger_config);
+
+    exposure_timer_set_config(&timer_config, &enlarger_config->control);
+
+    log_i("Starting split-grade exposure timer for %ldms", exposure_time_ms);
+
+    display_draw_exposure_timer(&elements, 0);
+
+    HAL_StatusTypeDef ret = exposure_timer_run();
+
+    const uint16_t channels[3] = { 0, 0, 0 };
+    if (soft_time_ms > 0) {
+        session_log_exposure(SESSION_LOG_TYPE_EXPOSURE, session_log_timer_result(ret),
+            soft_time_ms, CONTRAST_GRADE_00, channels, state_timer_log_copy(), 0, 0);
+    }
+    if (hard_time_ms > 0) {
+        session_log_exposure(SESSION_LOG_TYPE_EXPOSURE, session_log_timer_result(ret),
+            hard_time_ms, CONTRAST_GRADE_5, channels, state_timer_log_copy(), 0, 0);
+    }
+
+    if (ret == HAL_TIMEOUT) {
+        log_e("Exposure timer canceled");
+        result = false;
+    } else if (ret != HAL_OK) {
+        log_e("Exposure timer error");
+        result = false;
+    } else {
+        result = true;
+    }
+
+    log_i("Exposure timer complete");
+
+    return result;
+}
+
+bool state_timer_split_grade_pass(const enlarger_config_t *enlarger_config,
+    const char *title, uint32_t exposure_time_ms, contrast_grade_t contrast_grade)
+{
+    bool result;
+
+    display_adjustment_exposure_elements_t elements = {0};
+    elements.title = title;
+    elements.contrast_grade = contrast_grade;
+    elements.contrast_note = contrast_filter_grade_str(
+        (enlarger_config->control.dmx_control ? CONTRAST_FILTER_REGULAR : enlarger_config->contrast_filter),
+        contrast_grade);
+    convert_exposure_to_display_timer(&(elements.time_elements), exposure_time_ms);
+
+    uint32_t min_exposure_time_ms = enlarger_config_min_exposure(enlarger_config);
+    elements.time_too_short = (min_exposure_time_ms > 0) && (exposure_time_ms < min_exposure_time_ms);
+
+    display_draw_adjustment_exposure_elements(&elements);
+
+    /* Enable the enlarger in safe mode */
+    enlarger_control_set_state_safe(&enlarger_config->control, false);
+
+    /* Wait for the filter to be set, then start or cancel */
+    keypad_event_t keypad_event;
+    do {
+        if (keypad_wait_for_event(&keypad_event, -1) == HAL_OK) {
+            if (keypad_is_key_released_or_repeated(&keypad_event, KEYPAD_START)
+                || keypad_is_key_released_or_repeated(&keypad_event, KEYPAD_FOOTSWITCH)) {
+                log_i("Starting split-grade pass at grade %s", contrast_grade_str(contrast_grade));
+                break;
+            } else if (keypad_event.key == KEYPAD_CANCEL && !keypad_event.pressed) {
+                log_i("Canceling split-grade pass");
+                enlarger_control_set_state_off(&enlarger_config->control, false);
+                return false;
+            }
+        }
+    } while (1);
+
+    exposure_timer_config_t timer_config = {0};
+    timer_config.start_tone = EXPOSURE_TIMER_START_TONE_COUNTDOWN;
+    timer_config.end_tone = EXPOSURE_TIMER_END_TONE_REGULAR;
+    timer_config.timer_callback = state_timer_burn_dodge_exposure_callback;
+    timer_config.user_data = &(elements.time_elements);
+    timer_config.contrast_grade = contrast_grade;
+
+    if (elements.time_elements.fraction_digits == 0) {
+        timer_config.callback_rate = EXPOSURE_TIMER_RATE_1_SEC;
+    } else if (elements.time_elements.fraction_digits == 1) {
+        timer_config.callback_rate = EXPOSURE_TIMER_RATE_100_MS;
+    } else if (elements.time_elements.fraction_digits == 2) {
+        timer_config.callback_rate = EXPOSURE_TIMER_RATE_10_MS;
+    } else {
+        timer_config.callback_rate = EXPOSURE_TIMER_RATE_1_SEC;
+    }
+
+    exposure_timer_set_config_time(&timer_config, exposure_time_ms, enlarger_config);
+
+    exposure_timer_set_config(&timer_config, &enlarger_config->control);
+
+    log_i("Starting split-grade pass timer for %ldms", exposure_time_ms);
+
+    /* Redraw the display elements in exposure timer mode */
+    elements.contrast_grade = CONTRAST_GRADE_MAX;
+    elements.contrast_note = NULL;
+    display_draw_adjustment_exposure_elements(&elements);
+
+    HAL_StatusTypeDef ret = exposure_timer_run();
+
+    const uint16_t channels[3] = { 0, 0, 0 };
+    session_log_exposure(SESSION_LOG_TYPE_EXPOSURE, session_log_timer_result(ret),
+        exposure_time_ms, contrast_grade, channels, state_timer_log_copy(), 0, 0);
+
+    if (ret == HAL_TIMEOUT) {
+        log_e("Exposure timer canceled");
+        result = false;
+    } else if (ret != HAL_OK) {
+        log_e("Exposure timer error");
+        result = false;
+    } else {
+        result = true;
+    }
+
+    log_i("Exposure timer complete");
+
+    enlarger_control_set_state_off(&enlarger_config->control, false);
+
+    return result;
+}
@@ -3,6 +3,13 @@
 
 #include "state_controller.h"
 
+/**
+ * Flag for the state parameter to print a split-grade exposure, solved
+ * from the current readings, instead of the normal exposure. The rest
+ * of the parameter is the number of copies to print.
+ */
+#define STATE_TIMER_PARAM_SPLIT_GRADE 0x80000000UL
+
 state_t *state_timer();
 
 #endif /* STATE_TIMER_H */
@@ -0,0 +1,232 @@
+#include "stats.h"
+
+#include <math.h>
+
+#if defined(__ARM_ARCH_7EM__) && defined(__ARM_FP) && !defined(STATS_USE_REFERENCE)
+#define STATS_USE_CMSIS_DSP
+#include <arm_math.h>
+#endif
+
+/**
+ * Number of integer values converted to floating point at a time,
+ * so that the integer paths do not need a full-size scratch array.
+ */
+#define STATS_CHUNK_LEN 32U
+
+static float stats_reference_mean_f32(const float *values, size_t len);
+static float stats_reference_mean_u32(const uint32_t *values, size_t len);
+static void stats_summary_clear(stats_summary_t *summary);
+static void stats_u32_chunk(float *chunk, const uint32_t *values, size_t len);
+
+void stats_summary_clear(stats_summary_t *summary)
+{
+    summary->mean = NAN;
+    summary->min = NAN;
+    summary->max = NAN;
+    summary->stddev = NAN;
+}
+
+void stats_u32_chunk(float *chunk, const uint32_t *values, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        chunk[i] = (float)values[i];
+    }
+}
+
+float stats_reference_mean_f32(const float *values, size_t len)
+{
+    if (!values || len == 0) { return NAN; }
+
+    float sum = 0.0F;
+    for (size_t i = 0; i < len; i++) {
+        sum += values[i];
+    }
+    return sum / (float)len;
+}
+
+float stats_reference_mean_u32(const uint32_t *values, size_t len)
+{
+    if (!values || len == 0) { return NAN; }
+
+    float chunk[STATS_CHUNK_LEN];
+    float sum = 0.0F;
+    for (size_t offset = 0; offset < len; offset += STATS_CHUNK_LEN) {
+        const size_t chunk_len = (len - offset < STATS_CHUNK_LEN) ? (len - offset) : STATS_CHUNK_LEN;
+        stats_u32_chunk(chunk, values + offset, chunk_len);
+        for (size_t i = 0; i < chunk_len; i++) {
+            sum += chunk[i];
+        }
+    }
+    return sum / (float)len;
+}
+
+void stats_reference_summary_f32(stats_summary_t *summary, const float *values, size_t len)
+{
+    if (!summary) { return; }
+    if (!values || len == 0) {
+        stats_summary_clear(summary);
+        return;
+    }
+
+    float min = values[0];
+    float max = values[0];
+    for (size_t i = 1; i < len; i++) {
+        if (values[i] < min) { min = values[i]; }
+        if (values[i] > max) { max = values[i]; }
+    }
+
+    const float mean = stats_reference_mean_f32(values, len);
+    float dist_sum = 0.0F;
+    for (size_t i = 0; i < len; i++) {
+        const float dist = values[i] - mean;
+        dist_sum += dist * dist;
+    }
+
+    summary->mean = mean;
+    summary->min = min;
+    summary->max = max;
+    summary->stddev = sqrtf(dist_sum / (float)len);
+}
+
+void stats_reference_summary_u32(stats_summary_t *summary, const uint32_t *values, size_t len)
+{
+    if (!summary) { return; }
+    if (!values || len == 0) {
+        stats_summary_clear(summary);
+        return;
+    }
+
+    uint32_t min = values[0];
+    uint32_t max = values[0];
+    for (size_t i = 1; i < len; i++) {
+        if (values[i] < min) { min = values[i]; }
+        if (values[i] > max) { max = values[i]; }
+    }
+
+    const float mean = stats_reference_mean_u32(values, len);
+    float dist_sum = 0.0F;
+    for (size_t i = 0; i < len; i++) {
+        const float dist = (float)values[i] - mean;
+        dist_sum += dist * dist;
+    }
+
+    summary->mean = mean;
+    summary->min = (float)min;
+    summary->max = (float)max;
+    summary->stddev = sqrtf(dist_sum / (float)len);
+}
+
+#if defined(STATS_USE_CMSIS_DSP)
+
+float stats_mean_f32(const float *values, size_t len)
+{
+    if (!values || len == 0) { return NAN; }
+
+    float32_t mean;
+    arm_mean_f32(values, len, &mean);
+    return mean;
+}
+
+float stats_mean_u32(const uint32_t *values, size_t len)
+{
+    if (!values || len == 0) { return NAN; }
+
+    float32_t chunk[STATS_CHUNK_LEN];
+    float32_t sum = 0.0F;
+    for (size_t offset = 0; offset < len; offset += STATS_CHUNK_LEN) {
+        const size_t chunk_len = (len - offset < STATS_CHUNK_LEN) ? (len - offset) : STATS_CHUNK_LEN;
+        float32_t chunk_mean;
+        stats_u32_chunk(chunk, values + offset, chunk_len);
+        arm_mean_f32(chunk, chunk_len, &chunk_mean);
+        sum += chunk_mean * (float32_t)chunk_len;
+    }
+    return sum / (float32_t)len;
+}
+
+void stats_summary_f32(stats_summary_t *summary, const float *values, size_t len)
+{
+    if (!summary) { return; }
+    if (!values || len == 0) {
+        stats_summary_clear(summary);
+        return;
+    }
+
+    float32_t result;
+    uint32_t index;
+
+    arm_mean_f32(values, len, &result);
+    summary->mean = result;
+
+    arm_min_f32(values, len, &result, &index);
+    summary->min = result;
+
+    arm_max_f32(values, len, &result, &index);
+    summary->max = result;
+
+    /* Library variance is normalized by (n - 1), so rescale it to (n) */
+    if (len > 1) {
+        arm_var_f32(values, len, &result);
+        summary->stddev = sqrtf(result * ((float32_t)(len - 1) / (float32_t)len));
+    } else {
+        summary->stddev = 0.0F;
+    }
+}
+
+void stats_summary_u32(stats_summary_t *summary, const uint32_t *values, size_t len)
+{
+    if (!summary) { return; }
+    if (!values || len == 0) {
+        stats_summary_clear(summary);
+        return;
+    }
+
+    q31_t result_q31;
+    uint32_t index;
+
+    /* Integer values up to INT32_MAX compare identically as q31 */
+    arm_min_q31((const q31_t *)values, len, &result_q31, &index);
+    summary->min = (float)result_q31;
+
+    arm_max_q31((const q31_t *)values, len, &result_q31, &index);
+    summary->max = (float)result_q31;
+
+    const float32_t mean = stats_mean_u32(values, len);
+    summary->mean = mean;
+
+    /* Accumulate the squared distance from the mean, one chunk at a time */
+    float32_t chunk[STATS_CHUNK_LEN];
+    float32_t dist_sum = 0.0F;
+    for (size_t offset = 0; offset < len; offset += STATS_CHUNK_LEN) {
+        const size_t chunk_len = (len - offset < STATS_CHUNK_LEN) ? (len - offset) : STATS_CHUNK_LEN;
+        float32_t chunk_power;
+        stats_u32_chunk(chunk, values + offset, chunk_len);
+        arm_offset_f32(chunk, -mean, chunk, chunk_len);
+        arm_power_f32(chunk, chunk_len, &chunk_power);
+        dist_sum += chunk_power;
+    }
+    summary->stddev = sqrtf(dist_sum / (float32_t)len);
+}
+
+#else
+
+float stats_mean_f32(const float *values, size_t len)
+{
+    return stats_reference_mean_f32(values, len);
+}
+
+float stats_mean_u32(const uint32_t *values, size_t len)
+{
+    return stats_reference_mean_u32(values, len);
+}
+
+void stats_summary_f32(stats_summary_t *summary, const float *values, size_t len)
+{
+    stats_reference_summary_f32(summary, values, len);
+}
+
+void stats_summary_u32(stats_summary_t *summary, const uint32_t *values, size_t len)
+{
+    stats_reference_summary_u32(summary, values, len);
+}
+
+#endif
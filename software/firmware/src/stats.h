@@ -0,0 +1,79 @@
+/*
+ * Summary statistics for sensor readings
+ *
+ * On the target, these functions are implemented on top of the vendored
+ * CMSIS-DSP library. A portable reference implementation is used instead
+ * when building for anything other than a Cortex-M4F, or when
+ * STATS_USE_REFERENCE is defined, and both produce the same results
+ * within normal floating point rounding.
+ *
+ * This code has no dependencies on the HAL or RTOS, so the reference
+ * implementation can also be compiled and tested on a host system.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Summary statistics for a set of values.
+ *
+ * The standard deviation is the population standard deviation,
+ * normalized by the number of values rather than one less than it.
+ */
+typedef struct {
+    float mean;
+    float min;
+    float max;
+    float stddev;
+} stats_summary_t;
+
+/**
+ * Calculate the mean of an array of float values.
+ *
+ * @return The mean, or NAN if the array is empty
+ */
+float stats_mean_f32(const float *values, size_t len);
+
+/**
+ * Calculate the mean of an array of unsigned integer values.
+ *
+ * Values must be no larger than INT32_MAX.
+ *
+ * @return The mean, or NAN if the array is empty
+ */
+float stats_mean_u32(const uint32_t *values, size_t len);
+
+/**
+ * Calculate summary statistics for an array of float values.
+ *
+ * If the array is empty, all fields of the summary are set to NAN.
+ */
+void stats_summary_f32(stats_summary_t *summary, const float *values, size_t len);
+
+/**
+ * Calculate summary statistics for an array of unsigned integer values.
+ *
+ * Values must be no larger than INT32_MAX, which allows the minimum
+ * and maximum to be found directly with the fixed-point functions.
+ * If the array is empty, all fields of the summary are set to NAN.
+ */
+void stats_summary_u32(stats_summary_t *summary, const uint32_t *values, size_t len);
+
+/**
+ * Calculate summary statistics with the portable reference implementation.
+ *
+ * This is always built, even when the functions above are backed by
+ * CMSIS-DSP, so the two can be compared and benchmarked on the target.
+ */
+void stats_reference_summary_f32(stats_summary_t *summary, const float *values, size_t len);
+
+/**
+ * Calculate summary statistics for integer values with the portable
+ * reference implementation.
+ */
+void stats_reference_summary_u32(stats_summary_t *summary, const uint32_t *values, size_t len);
+
+#endif /* STATS_H */
@@ -169,6 +169,46 @@ bool step_wedge_is_valid(const step_wedge_t *wedge)
     return true;
 }
 
+step_wedge_reading_check_t step_wedge_check_reading(const step_wedge_t *wedge, uint32_t step,
+    float prev_density, float density)
+{
+    if (!wedge || step >= wedge->step_count || !is_valid_number(density)) {
+        return STEP_WEDGE_READING_OUT_OF_ORDER;
+    }
+
+    /* Expected density gradient leading into this patch */
+    float gradient;
+    if (step > 0) {
+        gradient = step_wedge_get_density(wedge, step) - step_wedge_get_density(wedge, step - 1);
+    } else if (wedge->step_count > 1) {
+        gradient = step_wedge_get_density(wedge, 1) - step_wedge_get_density(wedge, 0);
+    } else {
+        gradient = wedge->density_increment;
+    }
+
+    /* Without a sensible gradient, there is nothing to check against */
+    if (!is_valid_number(gradient) || gradient < 0.01F) {
+        return STEP_WEDGE_READING_ACCEPT;
+    }
+
+    if (step == 0 || !is_valid_number(prev_density)) {
+        /* Only reject readings that are clearly beyond this patch */
+        if (density > step_wedge_get_density(wedge, step) + (gradient * 0.75F)) {
+            return STEP_WEDGE_READING_OUT_OF_ORDER;
+        }
+        return STEP_WEDGE_READING_ACCEPT;
+    }
+
+    const float delta = density - prev_density;
+    if (delta < gradient * -0.5F || delta > gradient * 1.5F) {
+        return STEP_WEDGE_READING_OUT_OF_ORDER;
+    } else if (delta < gradient * 0.5F) {
+        return STEP_WEDGE_READING_DUPLICATE;
+    } else {
+        return STEP_WEDGE_READING_ACCEPT;
+    }
+}
+
 bool step_wedge_compare(const step_wedge_t *wedge1, const step_wedge_t *wedge2)
 {
     /* Both are the same pointer */
@@ -48,6 +48,16 @@ typedef struct {
 
 } step_wedge_t;
 
+/**
+ * Result of checking a density reading taken during a sequential
+ * sweep across the patches of a step wedge.
+ */
+typedef enum {
+    STEP_WEDGE_READING_ACCEPT = 0,  /*!< Reading is plausible for the patch */
+    STEP_WEDGE_READING_DUPLICATE,   /*!< Reading repeats the previous patch */
+    STEP_WEDGE_READING_OUT_OF_ORDER /*!< Reading belongs to some other patch */
+} step_wedge_reading_check_t;
+
 /**
  * Index for the stock step wedge profile to be loaded when
  * there is no existing configuration.
@@ -118,6 +128,24 @@ float step_wedge_get_density(const step_wedge_t *wedge, uint32_t step);
  */
 bool step_wedge_is_valid(const step_wedge_t *wedge);
 
+/**
+ * Check whether a transmission density reading is plausible for a
+ * particular patch, when the patches are being read in sequence.
+ *
+ * The change from the previous reading is compared against the expected
+ * density gradient between the two patches. A change of less than half
+ * the expected step is a repeat of the previous patch, while a negative
+ * change or one of more than one and a half steps means a patch was
+ * read out of order.
+ *
+ * @param wedge Step wedge being read
+ * @param step Patch the reading would be assigned to
+ * @param prev_density Reading of the previous patch, or NAN if there is none
+ * @param density Reading to check
+ */
+step_wedge_reading_check_t step_wedge_check_reading(const step_wedge_t *wedge, uint32_t step,
+    float prev_density, float density);
+
 /**
  * Check whether the two step wedge profiles are equivalent.
  */
@@ -0,0 +1,247 @@
+#include "trace.h"
+
+#include <stm32f4xx_hal.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+#include <cmsis_os.h>
+
+#include <string.h>
+#include <ff.h>
+
+#define LOG_TAG "trace"
+#include <elog.h>
+
+#include "util.h"
+
+#define TRACE_FILE_MAGIC   "PTRC"
+#define TRACE_FILE_VERSION 1
+#define TRACE_NAME_LEN     24
+#define TRACE_QUEUE_MAX    32
+
+/**
+ * Header at the start of a trace dump file.
+ *
+ * This is followed by the task name table, the queue name table, and then
+ * the trace records in order from oldest to newest.
+ * All multi-byte values are little endian.
+ */
+typedef struct __attribute__((packed)) {
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t timestamp_hz;
+    uint32_t record_count;
+    uint32_t dropped_count;
+    uint16_t task_count;
+    uint16_t queue_count;
+} trace_file_header_t;
+
+/**
+ * Entry in the task and queue name tables of a trace dump file.
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t number;
+    char name[TRACE_NAME_LEN];
+} trace_file_name_t;
+
+static trace_record_t trace_buffer[TRACE_RECORD_COUNT];
+static volatile uint32_t trace_head = 0;
+static volatile bool trace_enabled = false;
+static uint32_t trace_cycles_last = 0;
+static uint32_t trace_cycles_epoch = 0;
+
+static void *trace_queue_list[TRACE_QUEUE_MAX] = {0};
+static uint16_t trace_queue_count = 0;
+
+static uint32_t trace_timestamp();
+static bool trace_write_name_tables(FIL *fp, uint16_t *task_count, uint16_t *queue_count);
+
+void trace_init()
+{
+    /* Enable the DWT cycle counter, which is used for timestamps */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    trace_cycles_last = 0;
+    trace_cycles_epoch = 0;
+
+    trace_head = 0;
+    trace_enabled = true;
+}
+
+/**
+ * Get the current extended timestamp.
+ * This must be called with interrupts disabled.
+ */
+uint32_t trace_timestamp()
+{
+    const uint32_t cycles = DWT->CYCCNT;
+    if (cycles < trace_cycles_last) {
+        trace_cycles_epoch++;
+    }
+    trace_cycles_last = cycles;
+    return (trace_cycles_epoch << (32U - TRACE_TIMESTAMP_SHIFT)) | (cycles >> TRACE_TIMESTAMP_SHIFT);
+}
+
+void trace_tick()
+{
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    trace_timestamp();
+    __set_PRIMASK(primask);
+}
+
+void trace_record(trace_event_t event, uint8_t arg8, uint16_t arg16)
+{
+    if (!trace_enabled) { return; }
+
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    trace_record_t *record = &trace_buffer[trace_head & (TRACE_RECORD_COUNT - 1)];
+    trace_head++;
+    record->timestamp = trace_timestamp();
+    record->event = (uint8_t)event;
+    record->arg8 = arg8;
+    record->arg16 = arg16;
+
+    __set_PRIMASK(primask);
+}
+
+uint16_t trace_queue_register(void *queue)
+{
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint16_t number = ++trace_queue_count;
+    if (number <= TRACE_QUEUE_MAX) {
+        trace_queue_list[number - 1] = queue;
+    }
+
+    __set_PRIMASK(primask);
+    return number;
+}
+
+bool trace_dump_to_file(const char *filename)
+{
+    FRESULT res;
+    FIL fp;
+    UINT bw;
+    bool file_open = false;
+    bool success = false;
+
+    /* Stop recording while the buffer is being written out */
+    trace_enabled = false;
+
+    do {
+        memset(&fp, 0, sizeof(FIL));
+
+        res = f_open(&fp, filename, FA_WRITE | FA_CREATE_NEW);
+        if (res != FR_OK) { break; }
+        file_open = true;
+
+        const uint32_t head = trace_head;
+        const uint32_t count = (head < TRACE_RECORD_COUNT) ? head : TRACE_RECORD_COUNT;
+
+        trace_file_header_t header = {
+            .magic = TRACE_FILE_MAGIC,
+            .version = TRACE_FILE_VERSION,
+            .record_size = sizeof(trace_record_t),
+            .timestamp_hz = SystemCoreClock >> TRACE_TIMESTAMP_SHIFT,
+            .record_count = count,
+            .dropped_count = head - count
+        };
+
+        /* Write a placeholder header, to be updated once the table sizes are known */
+        res = f_write(&fp, &header, sizeof(header), &bw);
+        if (res != FR_OK || bw != sizeof(header)) { break; }
+
+        uint16_t task_count;
+        uint16_t queue_count;
+        if (!trace_write_name_tables(&fp, &task_count, &queue_count)) {
+            break;
+        }
+        header.task_count = task_count;
+        header.queue_count = queue_count;
+
+        /* Write the records in order from oldest to newest */
+        const uint32_t start = (head - count) & (TRACE_RECORD_COUNT - 1);
+        const uint32_t first_len = MIN(count, TRACE_RECORD_COUNT - start);
+        res = f_write(&fp, &trace_buffer[start], first_len * sizeof(trace_record_t), &bw);
+        if (res != FR_OK || bw != first_len * sizeof(trace_record_t)) { break; }
+        if (count > first_len) {
+            res = f_write(&fp, &trace_buffer[0], (count - first_len) * sizeof(trace_record_t), &bw);
+            if (res != FR_OK || bw != (count - first_len) * sizeof(trace_record_t)) { break; }
+        }
+
+        /* Go back and write the completed header */
+        res = f_lseek(&fp, 0);
+        if (res != FR_OK) { break; }
+        res = f_write(&fp, &header, sizeof(header), &bw);
+        if (res != FR_OK || bw != sizeof(header)) { break; }
+
+        log_d("Trace written to file: %s (%ld records)", filename, count);
+        success = true;
+    } while (0);
+
+    if (file_open) {
+        f_close(&fp);
+    }
+
+    if (!success) {
+        log_e("Error writing trace file: %d", res);
+    }
+
+    trace_enabled = true;
+
+    return success;
+}
+
+bool trace_write_name_tables(FIL *fp, uint16_t *task_count, uint16_t *queue_count)
+{
+    FRESULT res = FR_OK;
+    UINT bw;
+    trace_file_name_t entry;
+
+    *task_count = 0;
+    *queue_count = 0;
+
+    UBaseType_t task_list_size = uxTaskGetNumberOfTasks();
+    TaskStatus_t *task_list = pvPortMalloc(task_list_size * sizeof(TaskStatus_t));
+    if (!task_list) {
+        log_e("Unable to allocate task list");
+        return false;
+    }
+
+    task_list_size = uxTaskGetSystemState(task_list, task_list_size, NULL);
+    for (UBaseType_t i = 0; i < task_list_size; i++) {
+        memset(&entry, 0, sizeof(trace_file_name_t));
+        entry.number = (uint16_t)task_list[i].xTaskNumber;
+        strncpy(entry.name, task_list[i].pcTaskName, sizeof(entry.name) - 1);
+
+        res = f_write(fp, &entry, sizeof(trace_file_name_t), &bw);
+        if (res != FR_OK || bw != sizeof(trace_file_name_t)) { break; }
+        (*task_count)++;
+    }
+    vPortFree(task_list);
+    if (*task_count != task_list_size) {
+        return false;
+    }
+
+    const uint16_t queue_list_size = MIN(trace_queue_count, TRACE_QUEUE_MAX);
+    for (uint16_t i = 0; i < queue_list_size; i++) {
+        memset(&entry, 0, sizeof(trace_file_name_t));
+        entry.number = i + 1;
+        const char *name = pcQueueGetName(trace_queue_list[i]);
+        if (name) {
+            strncpy(entry.name, name, sizeof(entry.name) - 1);
+        }
+
+        res = f_write(fp, &entry, sizeof(trace_file_name_t), &bw);
+        if (res != FR_OK || bw != sizeof(trace_file_name_t)) { return false; }
+        (*queue_count)++;
+    }
+
+    return true;
+}
@@ -0,0 +1,120 @@
+/*
+ * Low-overhead binary event tracing
+ *
+ * Fixed-size timestamped records are written into a RAM ring buffer from
+ * both tasks and interrupt handlers. The ring can be dumped to a file on
+ * a USB storage device, and decoded on the host with "tools/tracedump.pl".
+ *
+ * This header is included from FreeRTOSConfig.h to provide the kernel
+ * trace hooks, so it must not include any FreeRTOS headers itself.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Number of records held in the trace ring buffer.
+ * This must be a power of two.
+ */
+#define TRACE_RECORD_COUNT (512U)
+
+/**
+ * Right shift applied to the CPU cycle counter to produce record timestamps.
+ * The cycle counter is extended in software, so at 180MHz this gives
+ * a resolution of ~0.36us and a timestamp wrap period of ~25min.
+ */
+#define TRACE_TIMESTAMP_SHIFT (6U)
+
+typedef enum {
+    TRACE_EVENT_NONE = 0,
+    TRACE_EVENT_TASK_SWITCHED_IN,    /*!< arg16 = task number */
+    TRACE_EVENT_QUEUE_SEND,          /*!< arg8 = messages waiting, arg16 = queue number */
+    TRACE_EVENT_QUEUE_SEND_FROM_ISR, /*!< arg8 = messages waiting, arg16 = queue number */
+    TRACE_EVENT_QUEUE_RECEIVE,       /*!< arg8 = messages waiting, arg16 = queue number */
+    TRACE_EVENT_QUEUE_RECEIVE_FROM_ISR, /*!< arg8 = messages waiting, arg16 = queue number */
+    TRACE_EVENT_DMX_TIMER,           /*!< arg8 = frame state on entry */
+    TRACE_EVENT_DMX_TX_CPLT,         /*!< arg8 = frame state on entry */
+    TRACE_EVENT_EXPOSURE_TICK,       /*!< arg8 = timer state, arg16 = elapsed time (10ms units) */
+    TRACE_EVENT_GPIO_INT,            /*!< arg16 = GPIO pin */
+    TRACE_EVENT_KEYPAD,              /*!< arg8 = key code, arg16 = flags (bit0=pressed, bit1=repeated) */
+    TRACE_EVENT_MARK,                /*!< Arbitrary user marker */
+    TRACE_EVENT_EXPOSURE_CANCEL      /*!< arg16 = cancel key to enlarger off latency (ms) */
+} trace_event_t;
+
+/**
+ * Trace record, as stored in the ring buffer and in the dump file.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t timestamp;
+    uint8_t event;
+    uint8_t arg8;
+    uint16_t arg16;
+} trace_record_t;
+
+/**
+ * Initialize the trace facility.
+ *
+ * This enables the cycle counter used for timestamps, and should be called
+ * as early as possible during startup.
+ */
+void trace_init();
+
+/**
+ * Track cycle counter overflow for timestamp extension.
+ *
+ * This is called from the kernel tick hook, so that the extended
+ * timestamp remains correct even when no events are being recorded.
+ */
+void trace_tick();
+
+/**
+ * Record a trace event.
+ *
+ * This function is safe to call from both tasks and interrupt handlers.
+ */
+void trace_record(trace_event_t event, uint8_t arg8, uint16_t arg16);
+
+/**
+ * Assign a trace number to a newly created queue.
+ *
+ * This is called from the kernel trace hooks, and the returned value is
+ * stored in the queue's own number field.
+ */
+uint16_t trace_queue_register(void *queue);
+
+/**
+ * Write the current contents of the trace buffer to a file.
+ *
+ * Recording is paused while the file is being written, and resumes
+ * afterwards. An existing file is never overwritten, so this fails if
+ * the file already exists.
+ *
+ * @param filename Name of the file to write on the mounted USB device
+ * @return True if the file was written successfully
+ */
+bool trace_dump_to_file(const char *filename);
+
+/*
+ * Kernel trace hooks, mapped to FreeRTOS trace macros in FreeRTOSConfig.h
+ */
+#define trace_kernel_task_switched_in(tcb_number) \
+    trace_record(TRACE_EVENT_TASK_SWITCHED_IN, 0, (uint16_t)(tcb_number))
+
+#define trace_kernel_queue_create(queue) \
+    do { \
+        if ((queue)->ucQueueType == queueQUEUE_TYPE_BASE) { \
+            (queue)->uxQueueNumber = trace_queue_register(queue); \
+        } \
+    } while (0)
+
+#define trace_kernel_queue_event(event, queue) \
+    do { \
+        if ((queue)->ucQueueType == queueQUEUE_TYPE_BASE) { \
+            trace_record((event), (uint8_t)(queue)->uxMessagesWaiting, (uint16_t)(queue)->uxQueueNumber); \
+        } \
+    } while (0)
+
+#endif /* TRACE_H */
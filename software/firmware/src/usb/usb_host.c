@@ -518,13 +518,22 @@ bool usb_serial_is_attached()
     return result;
 }
 
+uint32_t usb_serial_get_attach_count()
+{
+    return usbh_serial_get_attach_count();
+}
+
 void usbh_serial_receive_callback(uint8_t *data, size_t length)
 {
 }
 
 osStatus_t usb_serial_transmit(const uint8_t *buf, size_t length)
 {
-    return usbh_serial_transmit(buf, length);
+    osStatus_t ret = osError;
+    osMutexAcquire(usb_attach_mutex, portMAX_DELAY);
+    ret = usbh_serial_transmit(buf, length);
+    osMutexRelease(usb_attach_mutex);
+    return ret;
 }
 
 void usb_serial_clear_receive_buffer()
@@ -13,6 +13,7 @@ bool usb_msc_is_mounted();
 bool usb_msc_get_serial(uint8_t num, char *buf, size_t len);
 
 bool usb_serial_is_attached();
+uint32_t usb_serial_get_attach_count();
 bool usb_meter_probe_is_attached();
 bool usb_densistick_is_attached();
 
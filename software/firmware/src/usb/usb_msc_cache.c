@@ -0,0 +1,182 @@
+#include "usb_msc_cache.h"
+
+#include <string.h>
+
+#define CACHE_BUF_SECTORS USB_MSC_CACHE_SECTORS
+#define SECTOR_SIZE USB_MSC_CACHE_SECTOR_SIZE
+
+static bool ranges_overlap(uint32_t a_start, uint32_t a_count, uint32_t b_start, uint32_t b_count);
+static void read_buf_update(usb_msc_cache_t *cache, uint32_t sector, const uint8_t *buf, uint32_t count);
+
+void usb_msc_cache_init(usb_msc_cache_t *cache, uint8_t *buf, uint32_t sector_count,
+    usb_msc_cache_read_func_t read_func, usb_msc_cache_write_func_t write_func, void *ctx)
+{
+    memset(cache, 0, sizeof(usb_msc_cache_t));
+    cache->read_func = read_func;
+    cache->write_func = write_func;
+    cache->ctx = ctx;
+    cache->sector_count = sector_count;
+    cache->read_buf = buf;
+    cache->write_buf = buf + (CACHE_BUF_SECTORS * SECTOR_SIZE);
+    cache->read_next = UINT32_MAX;
+}
+
+int usb_msc_cache_read(usb_msc_cache_t *cache, uint32_t sector, uint8_t *buf, uint32_t count)
+{
+    int ret;
+
+    /*
+     * FatFS keeps its own copy of anything it has just written, so
+     * reads of buffered write data are rare enough that it is simpler
+     * to flush the write buffer than to merge it into the result.
+     */
+    if (ranges_overlap(sector, count, cache->write_start, cache->write_count)) {
+        ret = usb_msc_cache_flush(cache);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    /* Large requests go directly to the device */
+    if (count >= CACHE_BUF_SECTORS) {
+        cache->read_next = sector + count;
+        cache->stats.read_transfers++;
+        return cache->read_func(cache->ctx, sector, buf, count);
+    }
+
+    /* Serve the request from the read-ahead buffer if possible */
+    if (sector >= cache->read_start && sector + count <= cache->read_start + cache->read_count) {
+        memcpy(buf, cache->read_buf + ((sector - cache->read_start) * SECTOR_SIZE), count * SECTOR_SIZE);
+        cache->read_next = sector + count;
+        cache->stats.read_hits++;
+        return 0;
+    }
+
+    /*
+     * Only read ahead if this request continues on from the previous
+     * one, so that scattered metadata reads do not pay for the
+     * transfer of sectors that are unlikely to be used.
+     */
+    uint32_t fill_count = count;
+    if (sector == cache->read_next) {
+        fill_count = CACHE_BUF_SECTORS;
+        if (sector + fill_count > cache->sector_count) {
+            fill_count = (sector < cache->sector_count) ? cache->sector_count - sector : count;
+        }
+        if (fill_count < count) {
+            fill_count = count;
+        }
+    }
+
+    cache->read_count = 0;
+    cache->stats.read_transfers++;
+    ret = cache->read_func(cache->ctx, sector, cache->read_buf, fill_count);
+    if (ret < 0) {
+        cache->read_next = UINT32_MAX;
+        return ret;
+    }
+
+    /* The write buffer may hold newer data for the read-ahead sectors */
+    if (ranges_overlap(sector, fill_count, cache->write_start, cache->write_count)) {
+        fill_count = count;
+    }
+
+    cache->read_start = sector;
+    cache->read_count = fill_count;
+    cache->read_next = sector + count;
+
+    memcpy(buf, cache->read_buf, count * SECTOR_SIZE);
+    return 0;
+}
+
+int usb_msc_cache_write(usb_msc_cache_t *cache, uint32_t sector, const uint8_t *buf, uint32_t count)
+{
+    int ret;
+
+    read_buf_update(cache, sector, buf, count);
+
+    if (cache->write_count > 0) {
+        /* Overwrite of sectors that are already buffered */
+        if (sector >= cache->write_start && sector + count <= cache->write_start + cache->write_count) {
+            memcpy(cache->write_buf + ((sector - cache->write_start) * SECTOR_SIZE), buf, count * SECTOR_SIZE);
+            cache->stats.write_merges++;
+            return 0;
+        }
+
+        /* Continuation of the buffered run */
+        if (sector == cache->write_start + cache->write_count
+            && cache->write_count + count <= CACHE_BUF_SECTORS) {
+            memcpy(cache->write_buf + (cache->write_count * SECTOR_SIZE), buf, count * SECTOR_SIZE);
+            cache->write_count += count;
+            cache->stats.write_merges++;
+            return 0;
+        }
+
+        ret = usb_msc_cache_flush(cache);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    /* Large requests go directly to the device */
+    if (count >= CACHE_BUF_SECTORS) {
+        cache->stats.write_transfers++;
+        return cache->write_func(cache->ctx, sector, buf, count);
+    }
+
+    memcpy(cache->write_buf, buf, count * SECTOR_SIZE);
+    cache->write_start = sector;
+    cache->write_count = count;
+    return 0;
+}
+
+int usb_msc_cache_flush(usb_msc_cache_t *cache)
+{
+    int ret = 0;
+
+    if (cache->write_count > 0) {
+        cache->stats.write_transfers++;
+        ret = cache->write_func(cache->ctx, cache->write_start, cache->write_buf, cache->write_count);
+
+        /*
+         * The buffer is released even if the write failed, as the
+         * error is reported back to FatFS which will then treat
+         * the volume as being in an unknown state.
+         */
+        cache->write_count = 0;
+    }
+    return ret;
+}
+
+void usb_msc_cache_invalidate(usb_msc_cache_t *cache)
+{
+    cache->read_count = 0;
+    cache->read_next = UINT32_MAX;
+    cache->write_count = 0;
+}
+
+bool ranges_overlap(uint32_t a_start, uint32_t a_count, uint32_t b_start, uint32_t b_count)
+{
+    if (a_count == 0 || b_count == 0) {
+        return false;
+    }
+    return a_start < b_start + b_count && b_start < a_start + a_count;
+}
+
+void read_buf_update(usb_msc_cache_t *cache, uint32_t sector, const uint8_t *buf, uint32_t count)
+{
+    /* Keep any cached copies of the written sectors current */
+    if (!ranges_overlap(sector, count, cache->read_start, cache->read_count)) {
+        return;
+    }
+
+    uint32_t start = (sector > cache->read_start) ? sector : cache->read_start;
+    uint32_t end = sector + count;
+    if (end > cache->read_start + cache->read_count) {
+        end = cache->read_start + cache->read_count;
+    }
+
+    memcpy(cache->read_buf + ((start - cache->read_start) * SECTOR_SIZE),
+        buf + ((start - sector) * SECTOR_SIZE),
+        (end - start) * SECTOR_SIZE);
+}
@@ -0,0 +1,109 @@
+#ifndef USB_MSC_CACHE_H
+#define USB_MSC_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Sector cache for USB mass storage devices, intended to sit between
+ * FatFS and the MSC class driver.
+ *
+ * Every MSC transfer carries a fixed command/status overhead, which
+ * dominates when FatFS issues many single-sector requests. This cache
+ * combines those requests into fewer, larger transfers:
+ * - Reads that continue on from the previous read fill a read-ahead
+ *   buffer, from which the following requests are served.
+ * - Writes to consecutive sectors are collected into a write buffer,
+ *   which is written out when a non-consecutive write arrives, when
+ *   it fills, or when the cache is explicitly flushed.
+ *
+ * Requests at least as large as a buffer bypass the cache entirely.
+ */
+
+/**
+ * Size of each of the read-ahead and write buffers, in sectors
+ */
+#ifndef USB_MSC_CACHE_SECTORS
+#define USB_MSC_CACHE_SECTORS 8
+#endif
+
+/**
+ * Sector size supported by the cache
+ */
+#define USB_MSC_CACHE_SECTOR_SIZE 512
+
+/**
+ * Size of the buffer that must be provided to the cache
+ */
+#define USB_MSC_CACHE_BUF_SIZE (USB_MSC_CACHE_SECTORS * USB_MSC_CACHE_SECTOR_SIZE * 2)
+
+typedef int (*usb_msc_cache_read_func_t)(void *ctx, uint32_t sector, uint8_t *buf, uint32_t count);
+typedef int (*usb_msc_cache_write_func_t)(void *ctx, uint32_t sector, const uint8_t *buf, uint32_t count);
+
+typedef struct {
+    uint32_t read_transfers;  /*!< Read transfers issued to the device */
+    uint32_t write_transfers; /*!< Write transfers issued to the device */
+    uint32_t read_hits;       /*!< Read requests served entirely from the cache */
+    uint32_t write_merges;    /*!< Write requests merged into the write buffer */
+} usb_msc_cache_stats_t;
+
+typedef struct {
+    usb_msc_cache_read_func_t read_func;
+    usb_msc_cache_write_func_t write_func;
+    void *ctx;
+    uint32_t sector_count;
+    uint8_t *read_buf;
+    uint32_t read_start;
+    uint32_t read_count;
+    uint32_t read_next;
+    uint8_t *write_buf;
+    uint32_t write_start;
+    uint32_t write_count;
+    usb_msc_cache_stats_t stats;
+} usb_msc_cache_t;
+
+/**
+ * Initialize a sector cache.
+ *
+ * @param cache Cache to initialize
+ * @param buf Buffer of USB_MSC_CACHE_BUF_SIZE bytes, which must remain
+ *            valid for as long as the cache is in use
+ * @param sector_count Total number of sectors on the device
+ * @param read_func Function that reads sectors from the device
+ * @param write_func Function that writes sectors to the device
+ * @param ctx Context pointer passed to the read and write functions
+ */
+void usb_msc_cache_init(usb_msc_cache_t *cache, uint8_t *buf, uint32_t sector_count,
+    usb_msc_cache_read_func_t read_func, usb_msc_cache_write_func_t write_func, void *ctx);
+
+/**
+ * Read sectors through the cache.
+ *
+ * @return 0 on success, or the negative error code from the device
+ */
+int usb_msc_cache_read(usb_msc_cache_t *cache, uint32_t sector, uint8_t *buf, uint32_t count);
+
+/**
+ * Write sectors through the cache.
+ *
+ * The data may remain in the write buffer until the next call to
+ * usb_msc_cache_flush().
+ *
+ * @return 0 on success, or the negative error code from the device
+ */
+int usb_msc_cache_write(usb_msc_cache_t *cache, uint32_t sector, const uint8_t *buf, uint32_t count);
+
+/**
+ * Write any buffered data out to the device.
+ *
+ * @return 0 on success, or the negative error code from the device
+ */
+int usb_msc_cache_flush(usb_msc_cache_t *cache);
+
+/**
+ * Discard all cached and buffered data, without writing it out.
+ */
+void usb_msc_cache_invalidate(usb_msc_cache_t *cache);
+
+#endif /* USB_MSC_CACHE_H */
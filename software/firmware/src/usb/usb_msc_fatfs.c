@@ -1,5 +1,7 @@
 #include "usb_msc_fatfs.h"
 
+#include <FreeRTOS.h>
+
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
@@ -8,6 +10,7 @@
 
 #include "usbh_core.h"
 #include "usbh_msc.h"
+#include "usb_msc_cache.h"
 
 #define LOG_TAG "usb_msc"
 #include <elog.h>
@@ -23,16 +26,27 @@ typedef struct {
     bool linked;
     bool mounted;
     bool ready;
+    uint32_t generation;
     FATFS usbh_fatfs;  /* File system object for USBH logical drive */
+    usb_msc_cache_t cache;
+    uint8_t *cache_buf;
 } usbh_msc_fatfs_handle_t;
 
 static usbh_msc_fatfs_handle_t msc_handles[CONFIG_USBHOST_MAX_MSC_CLASS];
 
+/*
+ * Shared across all drives, so that a drive never repeats a generation
+ * value it had before being detached and attached again.
+ */
+static uint32_t msc_generation = 0;
+
 static DSTATUS fatfs_diskio_initialize(BYTE pdrv);
 static DSTATUS fatfs_diskio_status(BYTE pdrv);
 static DRESULT fatfs_diskio_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
 static DRESULT fatfs_diskio_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count);
 static DRESULT fatfs_diskio_ioctl(BYTE pdrv, BYTE cmd, void *buff);
+static int fatfs_cache_read(void *ctx, uint32_t sector, uint8_t *buf, uint32_t count);
+static int fatfs_cache_write(void *ctx, uint32_t sector, const uint8_t *buf, uint32_t count);
 
 static const Diskio_drvTypeDef fatfs_usbh_msc_driver = {
     fatfs_diskio_initialize,
@@ -74,6 +88,20 @@ void usbh_msc_fatfs_attached(struct usbh_msc *msc_class)
     handle->ready = false;
     memset(&handle->usbh_fatfs, 0, sizeof(FATFS));
 
+    /*
+     * Set up the sector cache, if the device uses a compatible sector
+     * size. Otherwise, all requests go directly to the device.
+     */
+    if (msc_class->blocksize == USB_MSC_CACHE_SECTOR_SIZE) {
+        handle->cache_buf = pvPortMalloc(USB_MSC_CACHE_BUF_SIZE);
+        if (handle->cache_buf) {
+            usb_msc_cache_init(&handle->cache, handle->cache_buf, msc_class->blocknum,
+                fatfs_cache_read, fatfs_cache_write, msc_class);
+        } else {
+            log_w("Unable to allocate sector cache");
+        }
+    }
+
     /* Link the driver callbacks */
     ret = FATFS_LinkDriver(&fatfs_usbh_msc_driver, handle->usbh_path, devno);
     if (ret != 0) {
@@ -106,6 +134,7 @@ void usbh_msc_fatfs_attached(struct usbh_msc *msc_class)
         log_i("Drive has %ld KB total space, %ld KB available", total_sectors / 2, free_sectors / 2);
     }
 
+    handle->generation = ++msc_generation;
     handle->ready = true;
 }
 
@@ -146,6 +175,15 @@ void usbh_msc_fatfs_detached(struct usbh_msc *msc_class)
         handle->linked = false;
     }
 
+    if (handle->cache_buf) {
+        log_d("Cache stats: reads=%lu, writes=%lu, read_hits=%lu, write_merges=%lu",
+            handle->cache.stats.read_transfers, handle->cache.stats.write_transfers,
+            handle->cache.stats.read_hits, handle->cache.stats.write_merges);
+        usb_msc_cache_invalidate(&handle->cache);
+        vPortFree(handle->cache_buf);
+        handle->cache_buf = NULL;
+    }
+
     handle->msc_class = NULL;
 }
 
@@ -193,6 +231,15 @@ bool usbh_msc_drive_serial(uint8_t num, char *buf, size_t len)
     }
 }
 
+uint32_t usbh_msc_drive_generation(uint8_t num)
+{
+    if (num < CONFIG_USBHOST_MAX_MSC_CLASS && msc_handles[num].ready) {
+        return msc_handles[num].generation;
+    } else {
+        return 0;
+    }
+}
+
 uint8_t usbh_msc_max_drives()
 {
     return CONFIG_USBHOST_MAX_MSC_CLASS;
@@ -229,10 +276,16 @@ DSTATUS fatfs_diskio_status(BYTE pdrv)
  */
 DRESULT fatfs_diskio_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
 {
+    int ret;
     if (pdrv >= CONFIG_USBHOST_MAX_MSC_CLASS || !msc_handles[pdrv].msc_class) {
         return RES_ERROR;
     }
-    return usbh_msc_scsi_read10(msc_handles[pdrv].msc_class, sector, buff, count);
+    if (msc_handles[pdrv].cache_buf) {
+        ret = usb_msc_cache_read(&msc_handles[pdrv].cache, sector, buff, count);
+    } else {
+        ret = usbh_msc_scsi_read10(msc_handles[pdrv].msc_class, sector, buff, count);
+    }
+    return (ret < 0) ? RES_ERROR : RES_OK;
 }
 
 /**
@@ -245,10 +298,17 @@ DRESULT fatfs_diskio_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
  */
 DRESULT fatfs_diskio_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
 {
+    int ret;
     if (pdrv >= CONFIG_USBHOST_MAX_MSC_CLASS || !msc_handles[pdrv].msc_class) {
         return RES_ERROR;
     }
-    return usbh_msc_scsi_write10(msc_handles[pdrv].msc_class, sector, buff, count);
+    msc_handles[pdrv].generation = ++msc_generation;
+    if (msc_handles[pdrv].cache_buf) {
+        ret = usb_msc_cache_write(&msc_handles[pdrv].cache, sector, buff, count);
+    } else {
+        ret = usbh_msc_scsi_write10(msc_handles[pdrv].msc_class, sector, buff, count);
+    }
+    return (ret < 0) ? RES_ERROR : RES_OK;
 }
 
 /**
@@ -269,7 +329,11 @@ DRESULT fatfs_diskio_ioctl(BYTE pdrv, BYTE cmd, void *buff)
 
     switch (cmd) {
     case CTRL_SYNC:
-        result = RES_OK;
+        if (msc_handles[pdrv].cache_buf) {
+            result = (usb_msc_cache_flush(&msc_handles[pdrv].cache) < 0) ? RES_ERROR : RES_OK;
+        } else {
+            result = RES_OK;
+        }
         break;
     case GET_SECTOR_SIZE:
         *(WORD *) buff = msc_class->blocksize;
@@ -289,3 +353,13 @@ DRESULT fatfs_diskio_ioctl(BYTE pdrv, BYTE cmd, void *buff)
     }
     return result;
 }
+
+int fatfs_cache_read(void *ctx, uint32_t sector, uint8_t *buf, uint32_t count)
+{
+    return usbh_msc_scsi_read10((struct usbh_msc *)ctx, sector, buf, count);
+}
+
+int fatfs_cache_write(void *ctx, uint32_t sector, const uint8_t *buf, uint32_t count)
+{
+    return usbh_msc_scsi_write10((struct usbh_msc *)ctx, sector, buf, count);
+}
@@ -14,6 +14,16 @@ void usbh_msc_fatfs_detached(struct usbh_msc *msc_class);
 bool usbh_msc_is_mounted(uint8_t num);
 const char *usbh_msc_drive_label(uint8_t num);
 bool usbh_msc_drive_serial(uint8_t num, char *buf, size_t len);
+
+/**
+ * Get a value that changes whenever a drive is mounted or written to.
+ *
+ * This allows information read from the drive to be cached, and
+ * later checked for staleness without any device access.
+ *
+ * @return Generation value, or 0 if the drive is not mounted
+ */
+uint32_t usbh_msc_drive_generation(uint8_t num);
 uint8_t usbh_msc_max_drives();
 
 #endif /* USB_MSC_FATFS_H */
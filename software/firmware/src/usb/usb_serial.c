@@ -12,18 +12,22 @@
 #include "class/usbh_serial_ftdi.h"
 #include "class/usbh_serial_cp210x.h"
 #include "class/usbh_serial_pl2303.h"
+#include "usb_serial_buf.h"
 
 #define LOG_TAG "usb_serial"
 #include <elog.h>
 
 #define SERIAL_BULK_IN_BUF_SIZE 64
-#define SERIAL_RECV_BUF_SIZE 256
+#define SERIAL_BULK_IN_BUF_COUNT 4
+#define SERIAL_BULK_OUT_BUF_SIZE 64
+#define SERIAL_BULK_OUT_TIMEOUT 100
 
 typedef enum {
     USB_SERIAL_ATTACH = 0,
     USB_SERIAL_DETACH,
     USB_SERIAL_CLEAR_RECV,
     USB_SERIAL_RECV_LINE,
+    USB_SERIAL_TRANSMIT,
     USB_SERIAL_DATA
 } usb_serial_event_type_t;
 
@@ -32,20 +36,44 @@ typedef struct {
     struct usbh_serial_class *serial_class;
 } usb_serial_event_t;
 
+typedef struct {
+    USB_MEM_ALIGNX uint8_t buf[SERIAL_BULK_IN_BUF_SIZE];
+    uint8_t len;
+} usb_serial_bulk_in_t;
+
+/*
+ * Bulk IN transfers are received into a ring of buffers, so that the
+ * next transfer can be started from the completion callback without
+ * waiting for the task to process the data from the previous one.
+ * The completion callback advances the head as buffers are filled,
+ * and the task advances the tail as it consumes them.
+ */
 typedef struct {
     struct usbh_serial_class *serial_class;
     uint8_t active;
-    USB_MEM_ALIGNX uint8_t bulk_in_buf[SERIAL_BULK_IN_BUF_SIZE];
-    uint8_t bulk_in_buf_len;
-    uint8_t recv_buf[SERIAL_RECV_BUF_SIZE];
-    size_t recv_buf_len;
+    usb_serial_bulk_in_t bulk_in[SERIAL_BULK_IN_BUF_COUNT];
+    volatile uint8_t bulk_in_head;
+    volatile uint8_t bulk_in_tail;
+    volatile bool bulk_in_pending;
+    volatile bool data_event_missed;
+    usb_serial_buf_t recv_buf;
+    USB_MEM_ALIGNX uint8_t bulk_out_buf[SERIAL_BULK_OUT_BUF_SIZE];
 } usb_serial_handle_t;
 
 static usb_serial_handle_t *serial_handles[CONFIG_USBHOST_MAX_SERIAL_CLASS] = {0};
 
+/* Count of device attachments, used to detect that the device may have changed */
+static volatile uint32_t serial_attach_count = 0;
+
+/* Set when a data event could not be queued, because the queue was full */
+static volatile bool serial_data_event_missed = false;
+
 static uint8_t *recv_line_buf;
 static size_t recv_line_buf_len;
 
+static const uint8_t *transmit_buf;
+static size_t transmit_buf_len;
+
 static osThreadId_t serial_task = NULL;
 static const osThreadAttr_t serial_task_attrs = {
     .name = "usb_serial_task",
@@ -76,7 +104,11 @@ static void usb_serial_thread(void *argument);
 static bool usb_serial_start_device(usb_serial_handle_t *dev_handle);
 static bool usb_serial_start_next_bulk_in(usb_serial_handle_t *dev_handle);
 static void usb_serial_bulk_in_complete(void *arg, int nbytes);
+static void usb_serial_post_data_event(usb_serial_handle_t *dev_handle);
+static void usb_serial_handle_missed_data();
+static void usb_serial_handle_data(usb_serial_handle_t *dev_handle);
 static bool usb_serial_handle_recv_line(usb_serial_handle_t *dev_handle);
+static bool usb_serial_handle_transmit(usb_serial_handle_t *dev_handle);
 
 bool usbh_serial_init()
 {
@@ -145,10 +177,16 @@ bool usbh_serial_is_attached()
     return serial_task != NULL;
 }
 
+uint32_t usbh_serial_get_attach_count()
+{
+    return serial_attach_count;
+}
+
 void usb_serial_thread(void *argument)
 {
     for (;;) {
         usb_serial_event_t event;
+        usb_serial_handle_missed_data();
         if(osMessageQueueGet(usb_serial_queue, &event, NULL, portMAX_DELAY) == osOK) {
             if (event.event_type == USB_SERIAL_ATTACH) {
                 do {
@@ -166,6 +204,7 @@ void usb_serial_thread(void *argument)
 
                     memset(dev_handle, 0, sizeof(usb_serial_handle_t));
                     dev_handle->serial_class = event.serial_class;
+                    usb_serial_buf_init(&dev_handle->recv_buf);
 
                     serial_handles[event.serial_class->devnum] = dev_handle;
 
@@ -175,6 +214,8 @@ void usb_serial_thread(void *argument)
                         break;
                     }
 
+                    serial_attach_count++;
+
                 } while (0);
 
             } else if (event.event_type == USB_SERIAL_DETACH) {
@@ -192,9 +233,8 @@ void usb_serial_thread(void *argument)
             } else if (event.event_type == USB_SERIAL_CLEAR_RECV) {
                 for (uint8_t i = 0; i < CONFIG_USBHOST_MAX_SERIAL_CLASS; i++) {
                     usb_serial_handle_t *dev_handle = serial_handles[i];
-                    if (dev_handle && dev_handle->recv_buf_len > 0) {
-                        memset(dev_handle->recv_buf, 0, SERIAL_RECV_BUF_SIZE);
-                        dev_handle->recv_buf_len = 0;
+                    if (dev_handle) {
+                        usb_serial_buf_init(&dev_handle->recv_buf);
                     }
                 }
 
@@ -203,7 +243,7 @@ void usb_serial_thread(void *argument)
                 if (recv_line_buf && recv_line_buf_len > 0) {
                     for (uint8_t i = 0; i < CONFIG_USBHOST_MAX_SERIAL_CLASS; i++) {
                         usb_serial_handle_t *dev_handle = serial_handles[i];
-                        if (dev_handle && dev_handle->recv_buf_len > 0) {
+                        if (dev_handle && usb_serial_buf_count(&dev_handle->recv_buf) > 0) {
                             if (usb_serial_handle_recv_line(dev_handle)) {
                                 has_line = true;
                                 break;
@@ -217,6 +257,24 @@ void usb_serial_thread(void *argument)
                     recv_line_buf = NULL;
                 }
 
+            } else if (event.event_type == USB_SERIAL_TRANSMIT) {
+                bool sent = false;
+                if (transmit_buf && transmit_buf_len > 0) {
+                    /* Send to the first active device */
+                    for (uint8_t i = 0; i < CONFIG_USBHOST_MAX_SERIAL_CLASS; i++) {
+                        usb_serial_handle_t *dev_handle = serial_handles[i];
+                        if (dev_handle && dev_handle->active) {
+                            sent = usb_serial_handle_transmit(dev_handle);
+                            break;
+                        }
+                    }
+                }
+
+                /* Clear the buffer pointer to indicate that nothing was sent */
+                if (!sent) {
+                    transmit_buf = NULL;
+                }
+
             } else if (event.event_type == USB_SERIAL_DATA) {
                 usb_serial_handle_t *dev_handle = serial_handles[event.serial_class->devnum];
                 if (!dev_handle) {
@@ -224,22 +282,7 @@ void usb_serial_thread(void *argument)
                     continue;
                 }
 
-                /* Update the receive buffer */
-                if (dev_handle->bulk_in_buf_len > 0) {
-                    log_d("[len=%d], \"%.*s\"", dev_handle->bulk_in_buf_len, dev_handle->bulk_in_buf_len, dev_handle->bulk_in_buf);
-
-                    /* Append to the receive buffer */
-                    size_t copy_len = MIN(SERIAL_RECV_BUF_SIZE - dev_handle->recv_buf_len, dev_handle->bulk_in_buf_len);
-                    if (copy_len > 0) {
-                        memcpy(dev_handle->recv_buf + dev_handle->recv_buf_len, dev_handle->bulk_in_buf, copy_len);
-                        dev_handle->recv_buf_len += copy_len;
-                    }
-                }
-
-                /* Start the next bulk in transfer */
-                if (!usb_serial_start_next_bulk_in(dev_handle)) {
-                    dev_handle->active = 0;
-                }
+                usb_serial_handle_data(dev_handle);
             }
 
             if (event.event_type != USB_SERIAL_DATA) {
@@ -287,7 +330,9 @@ bool usb_serial_start_device(usb_serial_handle_t *dev_handle)
 
     dev_handle->active = 1;
 
+    dev_handle->bulk_in_pending = true;
     if (!usb_serial_start_next_bulk_in(dev_handle)) {
+        dev_handle->bulk_in_pending = false;
         dev_handle->active = 0;
         return false;
     }
@@ -297,7 +342,8 @@ bool usb_serial_start_device(usb_serial_handle_t *dev_handle)
 
 bool usb_serial_start_next_bulk_in(usb_serial_handle_t *dev_handle)
 {
-    int ret = usbh_serial_bulk_in_transfer(dev_handle->serial_class, dev_handle->bulk_in_buf, SERIAL_BULK_IN_BUF_SIZE,
+    usb_serial_bulk_in_t *bulk_in = &dev_handle->bulk_in[dev_handle->bulk_in_head % SERIAL_BULK_IN_BUF_COUNT];
+    int ret = usbh_serial_bulk_in_transfer(dev_handle->serial_class, bulk_in->buf, SERIAL_BULK_IN_BUF_SIZE,
         0, usb_serial_bulk_in_complete, dev_handle);
     if (ret < 0) {
         log_d("usbh_serial_bulk_in_transfer error: %d", ret);
@@ -310,94 +356,182 @@ void usb_serial_bulk_in_complete(void *arg, int nbytes)
 {
     int ret;
     usb_serial_handle_t *dev_handle = (usb_serial_handle_t *)arg;
+    usb_serial_bulk_in_t *bulk_in = &dev_handle->bulk_in[dev_handle->bulk_in_head % SERIAL_BULK_IN_BUF_COUNT];
 
     /* Do any device-specific post-processing of the buffer */
-    ret = usbh_serial_bulk_in_check_result(dev_handle->serial_class, dev_handle->bulk_in_buf, nbytes);
+    ret = usbh_serial_bulk_in_check_result(dev_handle->serial_class, bulk_in->buf, nbytes);
 
-    /* If we got a valid result, then inform the task */
     if (ret >= 0) {
-        dev_handle->bulk_in_buf_len = ret;
+        if (ret > 0) {
+            bulk_in->len = ret;
+            dev_handle->bulk_in_head++;
+        }
+
+        /*
+         * The device is sending data, so immediately start the next
+         * transfer if there is a free buffer to receive it into.
+         * Otherwise the task will start it once a buffer is free.
+         */
+        bool restarted = false;
+        if ((uint8_t)(dev_handle->bulk_in_head - dev_handle->bulk_in_tail) < SERIAL_BULK_IN_BUF_COUNT) {
+            restarted = usb_serial_start_next_bulk_in(dev_handle);
+        }
+        if (!restarted) {
+            dev_handle->bulk_in_pending = false;
+        }
 
-        usb_serial_event_t event = {
-            .event_type = USB_SERIAL_DATA,
-            .serial_class = dev_handle->serial_class
-        };
-        osMessageQueuePut(usb_serial_queue, &event, 0, 0);
+        if (ret > 0 || !restarted) {
+            usb_serial_post_data_event(dev_handle);
+        }
 
     } else if (ret == -USB_ERR_NAK) {
-        dev_handle->bulk_in_buf_len = 0;
-
-        usb_serial_event_t event = {
-            .event_type = USB_SERIAL_DATA,
-            .serial_class = dev_handle->serial_class
-        };
-        osMessageQueuePut(usb_serial_queue, &event, 0, 0);
+        /*
+         * Leave the restart to the task, so an idle device does not
+         * keep the transfer cycling from within the interrupt.
+         */
+        dev_handle->bulk_in_pending = false;
+        usb_serial_post_data_event(dev_handle);
     } else if (ret < 0) {
+        dev_handle->bulk_in_pending = false;
         log_w("usb_serial_bulk_in_complete[dev=%d] error: %d", dev_handle->serial_class->devnum, ret);
     }
 }
 
-bool usb_serial_handle_recv_line(usb_serial_handle_t *dev_handle)
+void usb_serial_post_data_event(usb_serial_handle_t *dev_handle)
 {
-    bool has_line = false;
+    usb_serial_event_t event = {
+        .event_type = USB_SERIAL_DATA,
+        .serial_class = dev_handle->serial_class
+    };
 
-    /* Scan the buffer to see if it contains a line break */
-    for (size_t i = 0; i < dev_handle->recv_buf_len; i++) {
-        if (dev_handle->recv_buf[i] == '\r' || dev_handle->recv_buf[i] == '\n') {
-            has_line = true;
-            break;
-        }
+    if (osMessageQueuePut(usb_serial_queue, &event, 0, 0) != osOK) {
+        /*
+         * This is called from the interrupt, so it cannot wait for space
+         * in the queue. Without the event, nothing would move the data or
+         * restart the bulk in transfer, so leave a flag for the task.
+         * The queue is full, so the task will be back around its loop
+         * to check the flag once it has worked through the queue.
+         */
+        dev_handle->data_event_missed = true;
+        serial_data_event_missed = true;
     }
+}
 
-    /* Process the buffer if it has a line break or is otherwise full */
-    if (has_line || dev_handle->recv_buf_len == SERIAL_RECV_BUF_SIZE) {
-        size_t i = 0;
-        size_t j = 0;
-        bool has_start = false;
-        bool has_end = false;
-        for (i = 0; i < dev_handle->recv_buf_len; i++) {
-            /* Strip line breaks out of the result, but use them as start/end markers */
-            if (dev_handle->recv_buf[i] == '\r' || dev_handle->recv_buf[i] == '\n') {
-                if (has_start) {
-                    has_end = true;
-                }
-            } else {
-                if (has_end) {
-                    break;
-                }
-                has_start = true;
-                /* Populate the provided buffer as long as it has space */
-                if (j < recv_line_buf_len) {
-                    recv_line_buf[j++] = dev_handle->recv_buf[i];
-                }
-            }
+void usb_serial_handle_missed_data()
+{
+    if (!serial_data_event_missed) {
+        return;
+    }
+
+    /* Clear first, so an event missed while handling these is not lost */
+    serial_data_event_missed = false;
+
+    for (uint8_t i = 0; i < CONFIG_USBHOST_MAX_SERIAL_CLASS; i++) {
+        usb_serial_handle_t *dev_handle = serial_handles[i];
+        if (dev_handle && dev_handle->data_event_missed) {
+            dev_handle->data_event_missed = false;
+            log_d("Handling missed data event [dev=%d]", dev_handle->serial_class->devnum);
+            usb_serial_handle_data(dev_handle);
         }
+    }
+}
+
+void usb_serial_handle_data(usb_serial_handle_t *dev_handle)
+{
+    /* Move all the filled transfer buffers into the receive buffer */
+    while (dev_handle->bulk_in_tail != dev_handle->bulk_in_head) {
+        const usb_serial_bulk_in_t *bulk_in = &dev_handle->bulk_in[dev_handle->bulk_in_tail % SERIAL_BULK_IN_BUF_COUNT];
+
+        log_d("[len=%d], \"%.*s\"", bulk_in->len, bulk_in->len, bulk_in->buf);
 
-        /* Ensure that the buffer is null-terminated */
-        if (j > recv_line_buf_len - 1) {
-            j = recv_line_buf_len - 1;
+        if (usb_serial_buf_write(&dev_handle->recv_buf, bulk_in->buf, bulk_in->len) < bulk_in->len) {
+            log_w("Receive buffer overflow [dev=%d], dropped=%lu",
+                dev_handle->serial_class->devnum, dev_handle->recv_buf.dropped);
         }
-        recv_line_buf[j] = '\0';
-
-        /* Clear or adjust the internal buffer for the next receive */
-        if (i == dev_handle->recv_buf_len) {
-            dev_handle->recv_buf_len = 0;
-        } else {
-            size_t remaining = dev_handle->recv_buf_len - i;
-            memmove(dev_handle->recv_buf, dev_handle->recv_buf + i, remaining);
-            dev_handle->recv_buf_len -= i;
+
+        dev_handle->bulk_in_tail++;
+    }
+
+    /*
+     * Start the next bulk in transfer, if the completion callback was
+     * unable to do so. Nothing else starts a transfer while one is
+     * pending, so there is no risk of two being started at once.
+     */
+    if (dev_handle->active && !dev_handle->bulk_in_pending) {
+        dev_handle->bulk_in_pending = true;
+        if (!usb_serial_start_next_bulk_in(dev_handle)) {
+            dev_handle->bulk_in_pending = false;
+            dev_handle->active = 0;
         }
+    }
+}
 
-        return true;
-    } else {
+bool usb_serial_handle_recv_line(usb_serial_handle_t *dev_handle)
+{
+    usb_serial_slice_t line;
+
+    if (!usb_serial_buf_next_line(&dev_handle->recv_buf, &line)) {
         return false;
     }
+
+    usb_serial_slice_copy(&line, (char *)recv_line_buf, recv_line_buf_len);
+    usb_serial_buf_consume(&dev_handle->recv_buf, &line);
+    return true;
+}
+
+bool usb_serial_handle_transmit(usb_serial_handle_t *dev_handle)
+{
+    size_t offset = 0;
+
+    /* Transfers need an aligned buffer, so send the data in chunks */
+    while (offset < transmit_buf_len) {
+        size_t chunk_len = MIN(transmit_buf_len - offset, SERIAL_BULK_OUT_BUF_SIZE);
+        memcpy(dev_handle->bulk_out_buf, transmit_buf + offset, chunk_len);
+
+        int ret = usbh_serial_bulk_out_transfer(dev_handle->serial_class, dev_handle->bulk_out_buf, chunk_len,
+            SERIAL_BULK_OUT_TIMEOUT, NULL, NULL);
+        if (ret < 0) {
+            log_w("usbh_serial_bulk_out_transfer[dev=%d] error: %d", dev_handle->serial_class->devnum, ret);
+            return false;
+        }
+        offset += chunk_len;
+    }
+
+    return true;
 }
 
 osStatus_t usbh_serial_transmit(const uint8_t *buf, size_t length)
 {
-    //TODO
-    return osErrorParameter;
+    bool sent;
+
+    if (!buf || length == 0) {
+        return osErrorParameter;
+    }
+
+    if (!serial_task) {
+        return osErrorResource;
+    }
+
+    /* Set the buffer pointer used by the task */
+    transmit_buf = buf;
+    transmit_buf_len = length;
+
+    /* Send a message requesting the transmit */
+    usb_serial_event_t event = {
+        .event_type = USB_SERIAL_TRANSMIT
+    };
+    osMessageQueuePut(usb_serial_queue, &event, 0, 0);
+
+    /* Block until the command has been processed */
+    osSemaphoreAcquire(usb_serial_task_semaphore, portMAX_DELAY);
+
+    sent = transmit_buf != NULL;
+
+    /* Clear the buffer pointer used by the task */
+    transmit_buf = NULL;
+    transmit_buf_len = 0;
+
+    return sent ? osOK : osError;
 }
 
 void usbh_serial_clear_receive_buffer()
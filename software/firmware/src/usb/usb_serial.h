@@ -14,6 +14,7 @@ void usbh_serial_attached(struct usbh_serial_class *serial_class);
 void usbh_serial_detached(struct usbh_serial_class *serial_class);
 
 bool usbh_serial_is_attached();
+uint32_t usbh_serial_get_attach_count();
 
 osStatus_t usbh_serial_transmit(const uint8_t *buf, size_t length);
 void usbh_serial_clear_receive_buffer();
@@ -0,0 +1,104 @@
+#include "usb_serial_buf.h"
+
+#include <string.h>
+
+#define BUF_MASK (USB_SERIAL_BUF_SIZE - 1)
+
+#ifndef __CDT_PARSER__
+_Static_assert((USB_SERIAL_BUF_SIZE & BUF_MASK) == 0, "USB_SERIAL_BUF_SIZE must be a power of two");
+#endif
+
+static bool is_line_break(uint8_t value);
+
+void usb_serial_buf_init(usb_serial_buf_t *buf)
+{
+    memset(buf, 0, sizeof(usb_serial_buf_t));
+}
+
+size_t usb_serial_buf_write(usb_serial_buf_t *buf, const uint8_t *data, size_t len)
+{
+    const size_t space = USB_SERIAL_BUF_SIZE - (buf->head - buf->tail);
+    if (len > space) {
+        buf->dropped += len - space;
+        len = space;
+    }
+
+    /* Copy in at most two parts, split where the buffer wraps around */
+    const size_t offset = buf->head & BUF_MASK;
+    const size_t first = (len < USB_SERIAL_BUF_SIZE - offset) ? len : USB_SERIAL_BUF_SIZE - offset;
+    memcpy(buf->data + offset, data, first);
+    memcpy(buf->data, data + first, len - first);
+
+    buf->head += len;
+    return len;
+}
+
+size_t usb_serial_buf_count(const usb_serial_buf_t *buf)
+{
+    return buf->head - buf->tail;
+}
+
+bool usb_serial_buf_next_line(usb_serial_buf_t *buf, usb_serial_slice_t *line)
+{
+    /* Discard any line breaks ahead of the next line */
+    while (buf->tail != buf->head && is_line_break(buf->data[buf->tail & BUF_MASK])) {
+        buf->tail++;
+    }
+    if ((int32_t)(buf->scan - buf->tail) < 0) {
+        buf->scan = buf->tail;
+    }
+
+    /* Continue the search for the end of the line from where it last stopped */
+    while (buf->scan != buf->head && !is_line_break(buf->data[buf->scan & BUF_MASK])) {
+        buf->scan++;
+    }
+
+    /* A full buffer with no line break is treated as a complete line */
+    if (buf->scan == buf->head && buf->head - buf->tail < USB_SERIAL_BUF_SIZE) {
+        return false;
+    }
+
+    const size_t offset = buf->tail & BUF_MASK;
+    const size_t len = buf->scan - buf->tail;
+    const size_t first = (len < USB_SERIAL_BUF_SIZE - offset) ? len : USB_SERIAL_BUF_SIZE - offset;
+
+    line->data[0] = buf->data + offset;
+    line->len[0] = first;
+    line->data[1] = buf->data;
+    line->len[1] = len - first;
+    return true;
+}
+
+void usb_serial_buf_consume(usb_serial_buf_t *buf, const usb_serial_slice_t *line)
+{
+    buf->tail += line->len[0] + line->len[1];
+    if ((int32_t)(buf->scan - buf->tail) < 0) {
+        buf->scan = buf->tail;
+    }
+}
+
+size_t usb_serial_slice_copy(const usb_serial_slice_t *slice, char *str, size_t str_len)
+{
+    size_t count = 0;
+
+    if (!str || str_len == 0) {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < 2; i++) {
+        size_t len = slice->len[i];
+        if (len > str_len - 1 - count) {
+            len = str_len - 1 - count;
+        }
+        memcpy(str + count, slice->data[i], len);
+        count += len;
+    }
+    str[count] = '\0';
+
+    return count;
+}
+
+bool is_line_break(uint8_t value)
+{
+    return value == '\r' || value == '\n';
+}
@@ -0,0 +1,95 @@
+#ifndef USB_SERIAL_BUF_H
+#define USB_SERIAL_BUF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Receive buffer for USB serial devices, which splits the incoming
+ * byte stream into lines.
+ *
+ * Data is appended to a ring buffer as it arrives, and lines are
+ * returned as slices that point directly into that buffer. The search
+ * for line breaks resumes from where it last stopped, so each byte is
+ * only ever examined once no matter how the data is split up across
+ * transfers.
+ *
+ * This code has no dependencies on the HAL or RTOS, so it can also be
+ * compiled and tested on a host system.
+ */
+
+/**
+ * Size of the receive buffer, which must be a power of two
+ */
+#ifndef USB_SERIAL_BUF_SIZE
+#define USB_SERIAL_BUF_SIZE 512
+#endif
+
+/**
+ * A line within the receive buffer, which may be split into two
+ * parts if it wraps around the end of the buffer.
+ */
+typedef struct {
+    const uint8_t *data[2];
+    size_t len[2];
+} usb_serial_slice_t;
+
+typedef struct {
+    uint8_t data[USB_SERIAL_BUF_SIZE];
+    uint32_t head;    /*!< Position where the next received byte is written */
+    uint32_t tail;    /*!< Position of the first byte not yet consumed */
+    uint32_t scan;    /*!< Position of the next byte to check for a line break */
+    uint32_t dropped; /*!< Count of bytes dropped because the buffer was full */
+} usb_serial_buf_t;
+
+/**
+ * Initialize or clear the receive buffer.
+ */
+void usb_serial_buf_init(usb_serial_buf_t *buf);
+
+/**
+ * Append received data to the buffer.
+ *
+ * Any data that does not fit in the buffer is dropped.
+ *
+ * @return Number of bytes actually appended
+ */
+size_t usb_serial_buf_write(usb_serial_buf_t *buf, const uint8_t *data, size_t len);
+
+/**
+ * Get the number of bytes in the buffer that have not been consumed.
+ */
+size_t usb_serial_buf_count(const usb_serial_buf_t *buf);
+
+/**
+ * Find the next complete line in the buffer.
+ *
+ * Line breaks are not included in the result, and empty lines are
+ * skipped. If the buffer fills up without a line break, then its
+ * entire contents are returned as a line.
+ *
+ * The returned slice remains valid until it is consumed, or the
+ * buffer is cleared.
+ *
+ * @param line Set to the slice containing the line
+ * @return True if a line was found
+ */
+bool usb_serial_buf_next_line(usb_serial_buf_t *buf, usb_serial_slice_t *line);
+
+/**
+ * Release a line returned by usb_serial_buf_next_line().
+ */
+void usb_serial_buf_consume(usb_serial_buf_t *buf, const usb_serial_slice_t *line);
+
+/**
+ * Copy the contents of a slice into a null-terminated string.
+ *
+ * @param slice Slice to copy from
+ * @param str Buffer to copy into
+ * @param str_len Size of the buffer, including space for the terminator
+ * @return Number of characters copied, not including the terminator
+ */
+size_t usb_serial_slice_copy(const usb_serial_slice_t *slice, char *str, size_t str_len);
+
+#endif /* USB_SERIAL_BUF_H */
@@ -0,0 +1,386 @@
+/*
+ * Host tests for the bootloader's packed image decompressor
+ *
+ * A synthetic firmware image, complete with an app descriptor and
+ * checksum, is packed by the same tools/fwpack.pl script that the
+ * firmware build uses. The packed data is then fed through app_unpack
+ * in chunks of random size, and the output is checked against the
+ * original image. Truncated and corrupted copies of the packed data are
+ * also checked to make sure they fail cleanly, rather than producing
+ * an image that would pass its checksum. With "--bench", the
+ * decompression throughput is also timed.
+ */
+
+#include "app_unpack.h"
+#include "app_pack.h"
+
+#include <stdlib.h>
+
+#include "test_util.h"
+
+#ifndef PERL_COMMAND
+#define PERL_COMMAND "perl"
+#endif
+#ifndef FWPACK_SCRIPT
+#define FWPACK_SCRIPT "../tools/fwpack.pl"
+#endif
+#ifndef TEST_WORK_DIR
+#define TEST_WORK_DIR "."
+#endif
+
+#define IMAGE_SIZE (96 * 1024)
+#define CORRUPT_ITERATIONS 500
+
+typedef struct {
+    uint8_t *data;
+    uint32_t size;
+    uint32_t pos;
+    bool fail_at_end;
+    bool misaligned;
+} unpack_output_t;
+
+static uint8_t image[IMAGE_SIZE];
+static uint8_t output_buf[IMAGE_SIZE];
+static uint8_t *pack_file = NULL;
+static size_t pack_file_size = 0;
+static app_pack_header_t pack_header;
+static const uint8_t *packed_data = NULL;
+static app_unpack_t unpack;
+
+/**
+ * Calculate the CRC-32 checksum of a block of words, using the same
+ * algorithm as the hardware CRC module inside the STM32F4.
+ */
+static uint32_t stm_crc32(const uint8_t *data, size_t len)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i + 4 <= len; i += 4) {
+        const uint32_t word = (uint32_t)data[i] | ((uint32_t)data[i + 1] << 8)
+            | ((uint32_t)data[i + 2] << 16) | ((uint32_t)data[i + 3] << 24);
+        crc ^= word;
+        for (int bit = 0; bit < 32; bit++) {
+            crc = (crc & 0x80000000UL) ? (crc << 1) ^ 0x04C11DB7UL : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+/**
+ * Build an image that compresses roughly like real firmware, with runs
+ * of repeated instruction patterns and tables between stretches of
+ * incompressible data, followed by a valid app descriptor.
+ */
+static void build_image()
+{
+    app_descriptor_t *descriptor = (app_descriptor_t *)(image + IMAGE_SIZE - sizeof(app_descriptor_t));
+    size_t pos = 0;
+
+    srand(39);
+    while (pos < IMAGE_SIZE - sizeof(app_descriptor_t)) {
+        size_t len = 16 + (size_t)(rand() % 512);
+        if (len > IMAGE_SIZE - sizeof(app_descriptor_t) - pos) {
+            len = IMAGE_SIZE - sizeof(app_descriptor_t) - pos;
+        }
+
+        switch (rand() % 4) {
+        case 0:
+            /* Random bytes */
+            for (size_t i = 0; i < len; i++) { image[pos + i] = (uint8_t)rand(); }
+            break;
+        case 1:
+            /* Zero fill */
+            memset(image + pos, 0, len);
+            break;
+        case 2:
+            /* Copy of earlier data, sometimes beyond the decompressor window */
+            if (pos > len) {
+                const size_t src = (size_t)rand() % (pos - len);
+                memmove(image + pos, image + src, len);
+                break;
+            }
+            /* fall through */
+        default:
+            /* Short repeating pattern */
+            for (size_t i = 0; i < len; i++) { image[pos + i] = (uint8_t)(0x40 + (i % 6) * 3); }
+            break;
+        }
+        pos += len;
+    }
+
+    memset(descriptor, 0, sizeof(app_descriptor_t));
+    descriptor->magic_word = APP_DESCRIPTOR_MAGIC_WORD;
+    strcpy(descriptor->project_name, "Printalyzer");
+    strcpy(descriptor->version, "test");
+    descriptor->crc32 = stm_crc32(image, IMAGE_SIZE - 4);
+}
+
+/**
+ * Pack the image with the firmware packer script, and load the result.
+ */
+static bool pack_image()
+{
+    const char *in_name = TEST_WORK_DIR "/test_app_unpack-in.bin";
+    const char *out_name = TEST_WORK_DIR "/test_app_unpack-pack.bin";
+    char command[1024];
+    FILE *fp;
+
+    fp = fopen(in_name, "wb");
+    if (!fp || fwrite(image, 1, IMAGE_SIZE, fp) != IMAGE_SIZE) {
+        fprintf(stderr, "Unable to write image: %s\n", in_name);
+        if (fp) { fclose(fp); }
+        return false;
+    }
+    fclose(fp);
+
+    snprintf(command, sizeof(command), "\"%s\" \"%s\" \"%s\" \"%s\"",
+        PERL_COMMAND, FWPACK_SCRIPT, in_name, out_name);
+    if (system(command) != 0) {
+        fprintf(stderr, "Packer failed: %s\n", command);
+        return false;
+    }
+
+    fp = fopen(out_name, "rb");
+    if (!fp) {
+        fprintf(stderr, "Unable to open packed image: %s\n", out_name);
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    pack_file_size = (size_t)ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    pack_file = malloc(pack_file_size);
+    if (!pack_file || fread(pack_file, 1, pack_file_size, fp) != pack_file_size) {
+        fprintf(stderr, "Unable to read packed image: %s\n", out_name);
+        fclose(fp);
+        return false;
+    }
+    fclose(fp);
+
+    remove(in_name);
+    remove(out_name);
+
+    if (pack_file_size < sizeof(app_pack_header_t)) {
+        fprintf(stderr, "Packed image is too short\n");
+        return false;
+    }
+    memcpy(&pack_header, pack_file, sizeof(app_pack_header_t));
+    packed_data = pack_file + sizeof(app_pack_header_t);
+    return true;
+}
+
+static bool unpack_output(const uint8_t *data, size_t length, void *user_data)
+{
+    unpack_output_t *output = user_data;
+
+    /* Every span except the last must be made of whole, aligned words */
+    if (((uintptr_t)data & 0x03) != 0
+        || ((length & 0x03) != 0 && output->pos + length != unpack.image_size)) {
+        output->misaligned = true;
+    }
+
+    if (length > output->size - output->pos) {
+        return false;
+    }
+    memcpy(output->data + output->pos, data, length);
+    output->pos += (uint32_t)length;
+
+    return !(output->fail_at_end && output->pos == output->size);
+}
+
+/**
+ * Feed packed data to the decompressor in chunks of random size, and
+ * return the first error.
+ */
+static app_unpack_result_t unpack_chunks(const uint8_t *data, size_t length, unpack_output_t *output, size_t max_chunk)
+{
+    app_unpack_result_t result = APP_UNPACK_OK;
+    size_t offset = 0;
+
+    memset(output, 0, sizeof(unpack_output_t));
+    output->data = output_buf;
+    output->size = IMAGE_SIZE;
+    app_unpack_init(&unpack, pack_header.image_size, unpack_output, output);
+
+    while (offset < length && result == APP_UNPACK_OK) {
+        size_t chunk = 1 + (size_t)rand() % max_chunk;
+        if (chunk > length - offset) {
+            chunk = length - offset;
+        }
+        result = app_unpack_process(&unpack, data + offset, chunk);
+        offset += chunk;
+    }
+
+    if (result == APP_UNPACK_OK) {
+        result = app_unpack_finish(&unpack);
+    }
+    return result;
+}
+
+static void test_header()
+{
+    CHECK(pack_header.magic_word == APP_PACK_MAGIC_WORD);
+    CHECK(pack_header.version == APP_PACK_VERSION);
+    CHECK(pack_header.window_bits <= APP_UNPACK_WINDOW_BITS);
+    CHECK(pack_header.image_size == IMAGE_SIZE);
+    CHECK(pack_header.packed_size <= pack_file_size - sizeof(app_pack_header_t));
+    CHECK(pack_file_size % 4 == 0);
+    CHECK(memcmp(&pack_header.descriptor, image + IMAGE_SIZE - sizeof(app_descriptor_t), sizeof(app_descriptor_t)) == 0);
+
+    /* The packed data checksum covers the padding */
+    CHECK(pack_header.packed_crc32 == stm_crc32(packed_data, pack_file_size - sizeof(app_pack_header_t)));
+
+    printf("packed: %u bytes into %u bytes\n", pack_header.image_size, pack_header.packed_size);
+}
+
+static void test_round_trip()
+{
+    static const size_t max_chunks[] = { 1, 3, 64, 512, 4096, 65536 };
+    unpack_output_t output;
+
+    srand(1);
+    for (size_t i = 0; i < sizeof(max_chunks) / sizeof(max_chunks[0]); i++) {
+        for (int pass = 0; pass < 4; pass++) {
+            memset(output_buf, 0xA5, sizeof(output_buf));
+            const app_unpack_result_t result = unpack_chunks(packed_data, pack_header.packed_size, &output, max_chunks[i]);
+            if (result != APP_UNPACK_OK || output.pos != IMAGE_SIZE || memcmp(output_buf, image, IMAGE_SIZE) != 0) {
+                fprintf(stderr, "round trip: max chunk %zu, pass %d: result=%d, size=%u\n",
+                    max_chunks[i], pass, result, output.pos);
+                test_failures++;
+            }
+            CHECK(!output.misaligned);
+        }
+    }
+
+    /* The whole packed image in a single call */
+    CHECK(unpack_chunks(packed_data, pack_header.packed_size, &output, pack_header.packed_size) == APP_UNPACK_OK);
+    CHECK(memcmp(output_buf, image, IMAGE_SIZE) == 0);
+}
+
+static void test_truncated()
+{
+    unpack_output_t output;
+    uint32_t cuts = 0;
+
+    /* Every cut point near the ends, and a spread of them in between */
+    srand(2);
+    for (uint32_t len = 0; len < pack_header.packed_size; len++) {
+        if (len > 64 && len + 64 < pack_header.packed_size && (len % 97) != 0) {
+            continue;
+        }
+        const app_unpack_result_t result = unpack_chunks(packed_data, len, &output, 256);
+        if (result == APP_UNPACK_OK || output.pos > IMAGE_SIZE) {
+            fprintf(stderr, "truncated: %u bytes was accepted\n", len);
+            test_failures++;
+            break;
+        }
+        CHECK(result == APP_UNPACK_TRUNCATED);
+        cuts++;
+    }
+    printf("truncated: %u cut points rejected\n", cuts);
+
+    /* Trailing data, such as the padding, is not part of the packed data */
+    CHECK(unpack_chunks(packed_data, pack_header.packed_size + 1, &output, 256) == APP_UNPACK_OVERRUN);
+}
+
+static void test_corrupted()
+{
+    static uint8_t corrupt[IMAGE_SIZE * 2];
+    unpack_output_t output;
+    uint32_t rejected = 0;
+    uint32_t caught_by_crc = 0;
+
+    CHECK(pack_header.packed_size <= sizeof(corrupt));
+
+    srand(3);
+    for (uint32_t i = 0; i < CORRUPT_ITERATIONS; i++) {
+        memcpy(corrupt, packed_data, pack_header.packed_size);
+        const int edits = 1 + (rand() % 3);
+        for (int j = 0; j < edits; j++) {
+            corrupt[(size_t)rand() % pack_header.packed_size] ^= (uint8_t)(1 + (rand() % 255));
+        }
+
+        const app_unpack_result_t result = unpack_chunks(corrupt, pack_header.packed_size, &output, 1024);
+        if (output.pos > IMAGE_SIZE) {
+            fprintf(stderr, "corrupted: output overran the image\n");
+            test_failures++;
+            break;
+        }
+
+        if (result != APP_UNPACK_OK) {
+            rejected++;
+        } else if (stm_crc32(output_buf, IMAGE_SIZE - 4) != ((app_descriptor_t *)(output_buf + IMAGE_SIZE - sizeof(app_descriptor_t)))->crc32) {
+            /* Decoded to the right length, so the image checksum has to catch it */
+            caught_by_crc++;
+        } else if (memcmp(output_buf, image, IMAGE_SIZE) != 0) {
+            fprintf(stderr, "corrupted: iteration %u produced an image that passes its checksum\n", i);
+            test_failures++;
+        }
+    }
+    printf("corrupted: %u rejected, %u caught by image checksum, of %u\n",
+        rejected, caught_by_crc, CORRUPT_ITERATIONS);
+
+    /* The packed data checksum catches all of these before decoding starts */
+    memcpy(corrupt, pack_file + sizeof(app_pack_header_t), pack_file_size - sizeof(app_pack_header_t));
+    corrupt[pack_header.packed_size / 2] ^= 0x01;
+    CHECK(stm_crc32(corrupt, pack_file_size - sizeof(app_pack_header_t)) != pack_header.packed_crc32);
+}
+
+static void test_output_error()
+{
+    unpack_output_t output;
+
+    memset(&output, 0, sizeof(output));
+    output.data = output_buf;
+    output.size = IMAGE_SIZE;
+    output.fail_at_end = true;
+    app_unpack_init(&unpack, pack_header.image_size, unpack_output, &output);
+
+    app_unpack_result_t result = app_unpack_process(&unpack, packed_data, pack_header.packed_size);
+    if (result == APP_UNPACK_OK) {
+        result = app_unpack_finish(&unpack);
+    }
+    CHECK(result == APP_UNPACK_OUTPUT);
+}
+
+static void bench_unpack()
+{
+    unpack_output_t output;
+    const uint32_t rounds = 200;
+
+    uint64_t start = test_time_ns();
+    for (uint32_t r = 0; r < rounds; r++) {
+        memset(&output, 0, sizeof(output));
+        output.data = output_buf;
+        output.size = IMAGE_SIZE;
+        app_unpack_init(&unpack, pack_header.image_size, unpack_output, &output);
+        for (size_t offset = 0; offset < pack_header.packed_size; offset += 512) {
+            const size_t chunk = (pack_header.packed_size - offset < 512) ? pack_header.packed_size - offset : 512;
+            app_unpack_process(&unpack, packed_data + offset, chunk);
+        }
+        app_unpack_finish(&unpack);
+    }
+    const uint64_t elapsed = test_time_ns() - start;
+    test_bench_report("app_unpack per image (512 byte chunks)", elapsed, rounds);
+    test_bench_report("app_unpack per output byte", elapsed, rounds * IMAGE_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+    build_image();
+    if (!pack_image()) {
+        test_failures++;
+        return test_finish("app_unpack");
+    }
+
+    test_header();
+    test_round_trip();
+    test_truncated();
+    test_corrupted();
+    test_output_error();
+
+    if (test_bench_requested(argc, argv)) {
+        bench_unpack();
+    }
+
+    free(pack_file);
+    return test_finish("app_unpack");
+}
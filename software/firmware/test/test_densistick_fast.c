@@ -0,0 +1,381 @@
+/*
+ * Host tests for the fast DensiStick measurement logic
+ *
+ * Measurements are run against a simulated sensor, which returns the
+ * reading for a patch of known density with a configurable amount of
+ * noise, and saturates once the raw signal gets too large. Each reading
+ * takes 50ms, and the first reading after a gain change is discarded,
+ * as the sensor driver does when it is reconfigured. The tests check
+ * that measurements converge on the right density, stay within their
+ * reading limits, back off the gain when the sensor saturates, and
+ * give up on persistent errors. With "--bench", the measurement logic
+ * itself is also timed.
+ */
+
+#include "densistick_fast.h"
+
+#include <stdlib.h>
+
+#include "test_util.h"
+
+/* Gain steps of the sensor, from 0.5x to 256x */
+#define SIM_MAX_GAIN 9
+
+/* Gain adjusted reading of the light source through a clear patch */
+#define SIM_REFERENCE 4000.0F
+
+/* Raw reading at which the simulated sensor saturates */
+#define SIM_SATURATION 60000.0F
+
+/* Time taken by each reading */
+#define SIM_READING_MS 50
+
+typedef struct {
+    float density;   /*!< Density of the patch under the sensor */
+    float noise;     /*!< Relative amplitude of the reading noise, at a quarter of saturation */
+    int gain;        /*!< Current gain step */
+    bool discard;    /*!< Set after a gain change */
+    int invalid;     /*!< Number of invalid readings to return first */
+    uint32_t elapsed_ms;
+    int reading_count;
+} sim_sensor_t;
+
+static float sim_density(float reading, void *user_data)
+{
+    (void)user_data;
+    return log10f(SIM_REFERENCE / reading);
+}
+
+static float sim_gain_factor(int gain)
+{
+    return ldexpf(0.5F, gain);
+}
+
+/**
+ * Take the next reading from the simulated sensor.
+ */
+static densistick_fast_sample_t sim_next_reading(sim_sensor_t *sensor, int *gain, float *reading)
+{
+    for (;;) {
+        sensor->elapsed_ms += SIM_READING_MS;
+        sensor->reading_count++;
+        if (sensor->discard) {
+            sensor->discard = false;
+            continue;
+        }
+        break;
+    }
+
+    *gain = sensor->gain;
+    *reading = NAN;
+
+    if (sensor->invalid > 0) {
+        sensor->invalid--;
+        return DENSISTICK_FAST_SAMPLE_INVALID;
+    }
+
+    /* Shot noise, which grows as the raw signal gets smaller */
+    float basic = SIM_REFERENCE * powf(10.0F, -sensor->density);
+    const float raw = basic * sim_gain_factor(sensor->gain);
+    float amplitude = sensor->noise * sqrtf(SIM_SATURATION / 4.0F / raw);
+    if (amplitude > 0.5F) {
+        amplitude = 0.5F;
+    }
+    basic *= 1.0F + amplitude * ((float)rand() / (float)RAND_MAX * 2.0F - 1.0F);
+    if (basic * sim_gain_factor(sensor->gain) > SIM_SATURATION) {
+        return DENSISTICK_FAST_SAMPLE_SATURATED;
+    }
+
+    *reading = basic;
+    return DENSISTICK_FAST_SAMPLE_VALID;
+}
+
+/**
+ * Run a complete measurement against the simulated sensor, in the same
+ * way as densistick_measure_fast() drives the real one.
+ */
+static densistick_fast_action_t sim_measure(densistick_fast_t *fast, sim_sensor_t *sensor,
+    int prev_gain, float prev_reading)
+{
+    densistick_fast_action_t action;
+    int gain;
+    float reading;
+
+    sensor->elapsed_ms = 0;
+    sensor->reading_count = 0;
+    densistick_fast_init(fast, SIM_MAX_GAIN, prev_gain, prev_reading, sim_density, NULL);
+
+    do {
+        const densistick_fast_sample_t sample = sim_next_reading(sensor, &gain, &reading);
+        action = densistick_fast_add_reading(fast, sample, gain, reading);
+        if (action == DENSISTICK_FAST_SET_GAIN) {
+            CHECK(fast->gain >= 0 && fast->gain <= SIM_MAX_GAIN);
+            sensor->gain = fast->gain;
+            sensor->discard = true;
+        }
+        if (sensor->reading_count > 100) {
+            fprintf(stderr, "measurement did not finish\n");
+            test_failures++;
+            break;
+        }
+    } while (action == DENSISTICK_FAST_CONTINUE || action == DENSISTICK_FAST_SET_GAIN);
+
+    return action;
+}
+
+/**
+ * Pick the gain that AGC would settle on, which is the highest one
+ * that keeps the raw signal below a quarter of saturation.
+ */
+static int sim_agc_gain(float density)
+{
+    const float basic = SIM_REFERENCE * powf(10.0F, -density);
+    int gain = SIM_MAX_GAIN;
+    while (gain > 0 && basic * sim_gain_factor(gain) > SIM_SATURATION / 4.0F) {
+        gain--;
+    }
+    return gain;
+}
+
+static void test_convergence()
+{
+    densistick_fast_t fast;
+    sim_sensor_t sensor;
+
+    /* Without noise, the second reading always matches the first */
+    for (float density = 0.0F; density <= 3.0F; density += 0.25F) {
+        memset(&sensor, 0, sizeof(sensor));
+        sensor.density = density;
+        sensor.gain = sim_agc_gain(density);
+
+        CHECK(sim_measure(&fast, &sensor, sensor.gain, NAN) == DENSISTICK_FAST_DONE);
+        CHECK(fast.reading_count == 2);
+        CHECK_NEAR(fast.density, density, 0.0005);
+        CHECK(fast.gain == sensor.gain);
+    }
+
+    /* With noise, readings continue until the estimate settles */
+    srand(47);
+    for (float density = 0.1F; density <= 3.0F; density += 0.1F) {
+        for (int pass = 0; pass < 20; pass++) {
+            memset(&sensor, 0, sizeof(sensor));
+            sensor.density = density;
+            sensor.noise = 0.01F;
+            sensor.gain = sim_agc_gain(density);
+
+            CHECK(sim_measure(&fast, &sensor, sensor.gain, NAN) == DENSISTICK_FAST_DONE);
+            CHECK(fast.reading_count >= 2 && fast.reading_count <= DENSISTICK_FAST_MAX_READINGS);
+            CHECK_NEAR(fast.density, density, 0.03);
+        }
+    }
+}
+
+static void test_reading_cap()
+{
+    densistick_fast_t fast;
+    sim_sensor_t sensor;
+
+    /*
+     * With enough noise that the estimate never settles, the number of
+     * readings grows with the density, up to the fixed limit.
+     */
+    srand(48);
+    for (float density = 0.0F; density <= 4.0F; density += 0.5F) {
+        int expected = 2 + (int)(density * 2.0F);
+        if (expected > DENSISTICK_FAST_MAX_READINGS) {
+            expected = DENSISTICK_FAST_MAX_READINGS;
+        }
+
+        int max_count = 0;
+        for (int pass = 0; pass < 20; pass++) {
+            memset(&sensor, 0, sizeof(sensor));
+            sensor.density = density;
+            sensor.noise = 0.3F;
+            sensor.gain = sim_agc_gain(density);
+
+            CHECK(sim_measure(&fast, &sensor, sensor.gain, NAN) == DENSISTICK_FAST_DONE);
+            CHECK(fast.reading_count <= expected + 1);
+            CHECK(sensor.reading_count <= DENSISTICK_FAST_MAX_READINGS);
+            if (fast.reading_count > max_count) {
+                max_count = fast.reading_count;
+            }
+        }
+
+        /* The densest patches always run into the limit */
+        if (density >= 3.0F) {
+            CHECK(max_count == DENSISTICK_FAST_MAX_READINGS);
+        }
+    }
+}
+
+static void test_gain_prediction()
+{
+    densistick_fast_t fast;
+    sim_sensor_t sensor;
+
+    /* Start each patch at the gain of the previous one, as a warm measurement does */
+    for (float prev_density = 0.0F; prev_density <= 3.0F; prev_density += 0.5F) {
+        for (float density = 0.0F; density <= 3.0F; density += 0.5F) {
+            const int prev_gain = sim_agc_gain(prev_density);
+            const float prev_reading = SIM_REFERENCE * powf(10.0F, -prev_density);
+
+            memset(&sensor, 0, sizeof(sensor));
+            sensor.density = density;
+            sensor.gain = prev_gain;
+
+            CHECK(sim_measure(&fast, &sensor, prev_gain, prev_reading) == DENSISTICK_FAST_DONE);
+            CHECK_NEAR(fast.density, density, 0.0005);
+
+            /* The signal stays near the level AGC chose, within the gain limits */
+            int expected = prev_gain + densistick_fast_gain_steps(prev_reading, SIM_REFERENCE * powf(10.0F, -density));
+            if (expected < 0) { expected = 0; }
+            if (expected > SIM_MAX_GAIN) { expected = SIM_MAX_GAIN; }
+            if (fast.gain != expected && fast.gain != expected - 2) {
+                fprintf(stderr, "gain prediction: D=%.1f -> D=%.1f, gain %d, expected %d\n",
+                    prev_density, density, fast.gain, expected);
+                test_failures++;
+            }
+        }
+    }
+
+    /* Each factor of two between the readings is one gain step */
+    CHECK(densistick_fast_gain_steps(100.0F, 100.0F) == 0);
+    CHECK(densistick_fast_gain_steps(800.0F, 100.0F) == 3);
+    CHECK(densistick_fast_gain_steps(100.0F, 800.0F) == -3);
+    CHECK(densistick_fast_gain_steps(100.0F, 70.0F) == 1);
+    CHECK(densistick_fast_gain_steps(100.0F, 72.0F) == 0);
+    for (float ratio = 1.0F / 4096.0F; ratio < 4096.0F; ratio *= 1.01F) {
+        CHECK(densistick_fast_gain_steps(ratio * 50.0F, 50.0F) == (int)lroundf(log2f(ratio)));
+    }
+}
+
+static void test_saturation()
+{
+    densistick_fast_t fast;
+    sim_sensor_t sensor;
+
+    /* A clear patch at full gain saturates, and is backed off two steps at a time */
+    memset(&sensor, 0, sizeof(sensor));
+    sensor.density = 0.0F;
+    sensor.gain = SIM_MAX_GAIN;
+    CHECK(sim_measure(&fast, &sensor, SIM_MAX_GAIN, NAN) == DENSISTICK_FAST_DONE);
+    CHECK(fast.gain <= SIM_MAX_GAIN - 2);
+    CHECK((SIM_MAX_GAIN - fast.gain) % 2 == 0);
+    CHECK(SIM_REFERENCE * sim_gain_factor(fast.gain) <= SIM_SATURATION);
+    CHECK_NEAR(fast.density, 0.0, 0.0005);
+
+    /* Readings from before the back-off are not part of the average */
+    CHECK(fast.reading_count == 2);
+
+    /* Saturation at the lowest gain means the patch cannot be measured */
+    densistick_fast_init(&fast, SIM_MAX_GAIN, 0, NAN, sim_density, NULL);
+    CHECK(densistick_fast_add_reading(&fast, DENSISTICK_FAST_SAMPLE_SATURATED, 0, NAN) == DENSISTICK_FAST_HIGH);
+
+    /* From 1x, the back-off stops at the lowest gain */
+    densistick_fast_init(&fast, SIM_MAX_GAIN, 1, NAN, sim_density, NULL);
+    CHECK(densistick_fast_add_reading(&fast, DENSISTICK_FAST_SAMPLE_SATURATED, 1, NAN) == DENSISTICK_FAST_SET_GAIN);
+    CHECK(fast.gain == 0);
+
+    /* A light source too bright for any gain eventually gives up */
+    memset(&sensor, 0, sizeof(sensor));
+    sensor.density = -2.0F;
+    sensor.gain = SIM_MAX_GAIN;
+    CHECK(sim_measure(&fast, &sensor, SIM_MAX_GAIN, NAN) == DENSISTICK_FAST_HIGH);
+}
+
+static void test_errors()
+{
+    densistick_fast_t fast;
+    sim_sensor_t sensor;
+
+    /* A few invalid readings are skipped */
+    memset(&sensor, 0, sizeof(sensor));
+    sensor.density = 1.0F;
+    sensor.gain = sim_agc_gain(1.0F);
+    sensor.invalid = DENSISTICK_FAST_MAX_INVALID;
+    CHECK(sim_measure(&fast, &sensor, sensor.gain, NAN) == DENSISTICK_FAST_DONE);
+    CHECK_NEAR(fast.density, 1.0, 0.0005);
+
+    /* Too many invalid readings time out */
+    memset(&sensor, 0, sizeof(sensor));
+    sensor.density = 1.0F;
+    sensor.gain = sim_agc_gain(1.0F);
+    sensor.invalid = DENSISTICK_FAST_MAX_INVALID + 1;
+    CHECK(sim_measure(&fast, &sensor, sensor.gain, NAN) == DENSISTICK_FAST_TIMEOUT);
+
+    /* Readings that cannot be converted to a density fail */
+    densistick_fast_init(&fast, SIM_MAX_GAIN, 5, NAN, sim_density, NULL);
+    CHECK(densistick_fast_add_reading(&fast, DENSISTICK_FAST_SAMPLE_VALID, 5, 0.0F) == DENSISTICK_FAST_FAIL);
+    densistick_fast_init(&fast, SIM_MAX_GAIN, 5, NAN, sim_density, NULL);
+    CHECK(densistick_fast_add_reading(&fast, DENSISTICK_FAST_SAMPLE_VALID, 5, -1.0F) == DENSISTICK_FAST_FAIL);
+    densistick_fast_init(&fast, SIM_MAX_GAIN, 5, NAN, sim_density, NULL);
+    CHECK(densistick_fast_add_reading(&fast, DENSISTICK_FAST_SAMPLE_VALID, 5, NAN) == DENSISTICK_FAST_FAIL);
+}
+
+static void report_timing()
+{
+    static const float densities[] = { 0.1F, 0.5F, 1.5F, 2.5F };
+    densistick_fast_t fast;
+    sim_sensor_t sensor;
+
+    /*
+     * Simulated time spent reading the sensor, for a warm measurement
+     * that starts from the right gain, and for one that follows a much
+     * lighter patch and has to change gain first.
+     */
+    srand(50);
+    for (size_t i = 0; i < sizeof(densities) / sizeof(densities[0]); i++) {
+        uint32_t warm_ms = 0;
+        uint32_t change_ms = 0;
+        for (int pass = 0; pass < 100; pass++) {
+            memset(&sensor, 0, sizeof(sensor));
+            sensor.density = densities[i];
+            sensor.noise = 0.01F;
+            sensor.gain = sim_agc_gain(densities[i]);
+            sim_measure(&fast, &sensor, sensor.gain, SIM_REFERENCE * powf(10.0F, -densities[i]));
+            warm_ms += sensor.elapsed_ms;
+
+            memset(&sensor, 0, sizeof(sensor));
+            sensor.density = densities[i];
+            sensor.noise = 0.01F;
+            sensor.gain = 0;
+            sim_measure(&fast, &sensor, 0, SIM_REFERENCE * 10.0F);
+            change_ms += sensor.elapsed_ms;
+        }
+        printf("simulated D=%.1f: %ums warm, %ums after a gain change\n",
+            densities[i], warm_ms / 100, change_ms / 100);
+    }
+}
+
+static void bench_measure()
+{
+    densistick_fast_t fast;
+    const uint32_t rounds = 200000;
+    volatile float sink = 0;
+
+    uint64_t start = test_time_ns();
+    for (uint32_t r = 0; r < rounds; r++) {
+        densistick_fast_init(&fast, SIM_MAX_GAIN, 5, 100.0F, sim_density, NULL);
+        densistick_fast_add_reading(&fast, DENSISTICK_FAST_SAMPLE_VALID, 5, 100.0F + (float)(r & 7));
+        densistick_fast_add_reading(&fast, DENSISTICK_FAST_SAMPLE_VALID, 5, 100.0F);
+        sink += fast.density;
+    }
+    test_bench_report("two reading measurement", test_time_ns() - start, rounds);
+    (void)sink;
+}
+
+int main(int argc, char *argv[])
+{
+    test_convergence();
+    test_reading_cap();
+    test_gain_prediction();
+    test_saturation();
+    test_errors();
+    report_timing();
+
+    if (test_bench_requested(argc, argv)) {
+        bench_measure();
+    }
+
+    return test_finish("densistick_fast");
+}
@@ -0,0 +1,275 @@
+/*
+ * Host tests for the densitometer reading parsers
+ *
+ * Every line in the corpus of instrument output is parsed and checked
+ * against its expected reading. The corpus lines are then used as seeds
+ * for a simple mutation fuzzer, which checks that every line either is
+ * rejected or produces a sane reading. With "--bench", the parsing
+ * throughput over the corpus is also timed.
+ *
+ * The bundled corpus is synthetic, written from the output examples
+ * documented in the parsers rather than captured from instruments.
+ * Another corpus file can be given as the first argument, such as a
+ * capture from a real instrument.
+ */
+
+#include "densitometer_parse.h"
+
+#include <stdlib.h>
+
+#include "test_util.h"
+
+#ifndef DENSITOMETER_CORPUS
+#define DENSITOMETER_CORPUS "data/densitometer_corpus.txt"
+#endif
+
+/* Matches the line buffer used when receiving from the instrument */
+#define LINE_LEN 64
+#define MAX_ENTRIES 256
+#define FUZZ_ITERATIONS 500000U
+
+typedef struct {
+    char line[LINE_LEN];
+    char expected[96];
+    bool reset;
+    unsigned line_num;
+} corpus_entry_t;
+
+static corpus_entry_t corpus[MAX_ENTRIES];
+static size_t corpus_count = 0;
+
+static bool load_corpus(const char *filename)
+{
+    char buf[256];
+    unsigned line_num = 0;
+    bool reset = true;
+
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        fprintf(stderr, "Unable to open corpus: %s\n", filename);
+        return false;
+    }
+
+    while (fgets(buf, sizeof(buf), fp) && corpus_count < MAX_ENTRIES) {
+        line_num++;
+        buf[strcspn(buf, "\r\n")] = '\0';
+
+        if (buf[0] == '\0' || buf[0] == '#') {
+            continue;
+        }
+        if (buf[0] == '[') {
+            reset = true;
+            continue;
+        }
+
+        char *tab = strchr(buf, '\t');
+        if (!tab || strlen(tab + 1) >= LINE_LEN || (size_t)(tab - buf) >= sizeof(corpus[0].expected)) {
+            fprintf(stderr, "%s:%u: malformed entry\n", filename, line_num);
+            test_failures++;
+            continue;
+        }
+
+        corpus_entry_t *entry = &corpus[corpus_count++];
+        memcpy(entry->expected, buf, tab - buf);
+        entry->expected[tab - buf] = '\0';
+        strcpy(entry->line, tab + 1);
+        entry->reset = reset;
+        entry->line_num = line_num;
+        reset = false;
+    }
+
+    fclose(fp);
+    return corpus_count > 0;
+}
+
+static void format_channel(char *buf, size_t len, float value)
+{
+    if (isnan(value)) {
+        snprintf(buf, len, "-");
+    } else {
+        snprintf(buf, len, "%g", value);
+    }
+}
+
+static void format_reading(char *buf, size_t len, densitometer_result_t result, const densitometer_reading_t *reading)
+{
+    char channels[4][16];
+
+    if (result != DENSITOMETER_RESULT_OK) {
+        snprintf(buf, len, "INVALID");
+        return;
+    }
+
+    format_channel(channels[0], sizeof(channels[0]), reading->visual);
+    format_channel(channels[1], sizeof(channels[1]), reading->red);
+    format_channel(channels[2], sizeof(channels[2]), reading->green);
+    format_channel(channels[3], sizeof(channels[3]), reading->blue);
+    snprintf(buf, len, "%c %s %s %s %s",
+        (reading->mode == DENSITOMETER_MODE_TRANSMISSION) ? 'T'
+        : (reading->mode == DENSITOMETER_MODE_REFLECTION) ? 'R' : 'U',
+        channels[0], channels[1], channels[2], channels[3]);
+}
+
+static void test_corpus(const char *filename)
+{
+    densitometer_reading_t reading;
+    char actual[96];
+
+    for (size_t i = 0; i < corpus_count; i++) {
+        const corpus_entry_t *entry = &corpus[i];
+        if (entry->reset) {
+            densitometer_parse_reset();
+        }
+
+        memset(&reading, 0, sizeof(reading));
+        const densitometer_result_t result = densitometer_parse_reading(&reading, entry->line);
+        format_reading(actual, sizeof(actual), result, &reading);
+
+        if (strcmp(actual, entry->expected) != 0) {
+            fprintf(stderr, "%s:%u: \"%s\" parsed as \"%s\", expected \"%s\"\n",
+                filename, entry->line_num, entry->line, actual, entry->expected);
+            test_failures++;
+        }
+    }
+    printf("corpus: %zu lines checked\n", corpus_count);
+}
+
+/**
+ * Check that a parsed reading could plausibly have come from an instrument.
+ */
+static bool reading_is_sane(const densitometer_reading_t *reading)
+{
+    const float values[] = { reading->visual, reading->red, reading->green, reading->blue };
+    bool has_value = false;
+
+    if (reading->mode != DENSITOMETER_MODE_UNKNOWN
+        && reading->mode != DENSITOMETER_MODE_TRANSMISSION
+        && reading->mode != DENSITOMETER_MODE_REFLECTION) {
+        return false;
+    }
+
+    for (size_t i = 0; i < 4; i++) {
+        if (isnan(values[i])) { continue; }
+        if (!isfinite(values[i])) { return false; }
+        has_value = true;
+    }
+    return has_value;
+}
+
+static void mutate_line(char *line, const char *seed)
+{
+    static const char charset[] = "0123456789.+-, DRTVGBZ%rgbpcmyPCMYAenx\t";
+    size_t len = strlen(seed);
+
+    memcpy(line, seed, len + 1);
+
+    const int edits = 1 + (rand() % 4);
+    for (int i = 0; i < edits; i++) {
+        const size_t pos = (len > 0) ? (size_t)rand() % len : 0;
+        switch (rand() % 5) {
+        case 0:
+            /* Replace with a character that the parsers look for */
+            if (len > 0) { line[pos] = charset[rand() % (sizeof(charset) - 1)]; }
+            break;
+        case 1:
+            /* Replace with any non-zero byte */
+            if (len > 0) { line[pos] = (char)(1 + (rand() % 255)); }
+            break;
+        case 2:
+            /* Truncate */
+            len = pos;
+            line[len] = '\0';
+            break;
+        case 3:
+            /* Insert */
+            if (len + 1 < LINE_LEN) {
+                memmove(line + pos + 1, line + pos, len - pos + 1);
+                line[pos] = charset[rand() % (sizeof(charset) - 1)];
+                len++;
+            }
+            break;
+        default:
+            /* Delete */
+            if (len > 0) {
+                memmove(line + pos, line + pos + 1, len - pos);
+                len--;
+            }
+            break;
+        }
+    }
+}
+
+static void test_fuzz()
+{
+    densitometer_reading_t reading;
+    char line[LINE_LEN];
+    uint32_t accepted = 0;
+
+    srand(17);
+    for (uint32_t i = 0; i < FUZZ_ITERATIONS; i++) {
+        /* Occasionally forget the remembered format, as on a device change */
+        if (rand() % 64 == 0) {
+            densitometer_parse_reset();
+        }
+
+        mutate_line(line, corpus[(size_t)rand() % corpus_count].line);
+
+        memset(&reading, 0xA5, sizeof(reading));
+        const densitometer_result_t result = densitometer_parse_reading(&reading, line);
+        if (result == DENSITOMETER_RESULT_OK) {
+            accepted++;
+            if (!reading_is_sane(&reading)) {
+                fprintf(stderr, "fuzz: \"%s\" produced an invalid reading\n", line);
+                test_failures++;
+                break;
+            }
+        } else if (result != DENSITOMETER_RESULT_INVALID) {
+            fprintf(stderr, "fuzz: \"%s\" returned unexpected result %d\n", line, result);
+            test_failures++;
+            break;
+        }
+    }
+    printf("fuzz: %u lines, %u accepted\n", FUZZ_ITERATIONS, accepted);
+}
+
+static void bench_corpus()
+{
+    densitometer_reading_t reading;
+    const uint32_t rounds = 20000;
+    volatile float sink = 0;
+
+    densitometer_parse_reset();
+    uint64_t start = test_time_ns();
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < corpus_count; i++) {
+            if (densitometer_parse_reading(&reading, corpus[i].line) == DENSITOMETER_RESULT_OK) {
+                sink += reading.visual;
+            }
+        }
+    }
+    test_bench_report("densitometer_parse_reading (corpus)", test_time_ns() - start,
+        rounds * (uint32_t)corpus_count);
+    (void)sink;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *filename = DENSITOMETER_CORPUS;
+    if (argc > 1 && !test_bench_requested(argc, argv)) {
+        filename = argv[1];
+    }
+
+    if (!load_corpus(filename)) {
+        test_failures++;
+        return test_finish("densitometer_parse");
+    }
+
+    test_corpus(filename);
+    test_fuzz();
+
+    if (test_bench_requested(argc, argv)) {
+        bench_corpus();
+    }
+
+    return test_finish("densitometer_parse");
+}
@@ -0,0 +1,180 @@
+/*
+ * Host tests for the fast exposure math functions
+ *
+ * Each function is checked against the double precision libm result
+ * on an evenly strided sample of every float in its documented range,
+ * using the error bounds stated in the header. With "--bench", each
+ * function is also timed against the single precision libm function
+ * it replaces.
+ */
+
+#include "exposure_math.h"
+
+#include <stdlib.h>
+
+#include "test_util.h"
+
+/* Check every Nth float in each range, which keeps the run short */
+#define SAMPLE_STRIDE 257U
+
+static uint32_t float_bits(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static float bits_float(uint32_t u)
+{
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static void test_twelfth_stops()
+{
+    for (int adj = -12 * 40; adj <= 12 * 40; adj++) {
+        const double expected = exp2((double)adj / 12.0);
+        CHECK_NEAR(exposure_math_twelfth_stops(adj), expected, expected * 1.2e-7);
+    }
+    CHECK(exposure_math_twelfth_stops(0) == 1.0F);
+    CHECK(exposure_math_twelfth_stops(12) == 2.0F);
+    CHECK(exposure_math_twelfth_stops(-24) == 0.25F);
+}
+
+static void test_exp2()
+{
+    double max_err = 0;
+    for (uint32_t u = 0; u <= float_bits(126.0F); u += SAMPLE_STRIDE) {
+        for (int sign = 0; sign < 2; sign++) {
+            const float x = sign ? -bits_float(u) : bits_float(u);
+            const double expected = exp2((double)x);
+            const double err = fabs((double)exposure_math_exp2(x) - expected) / expected;
+            if (err > max_err) { max_err = err; }
+        }
+    }
+    printf("exp2:  max relative error %.3g\n", max_err);
+    CHECK(max_err < 2e-7);
+
+    CHECK(exposure_math_exp2(3.0F) == 8.0F);
+    CHECK(exposure_math_exp2(-1.0F) == 0.5F);
+    CHECK(isinf(exposure_math_exp2(200.0F)));
+    CHECK(exposure_math_exp2(-200.0F) == 0.0F);
+    CHECK(isnan(exposure_math_exp2(NAN)));
+}
+
+static void test_exp10()
+{
+    double max_err = 0;
+    for (uint32_t u = 0; u <= float_bits(6.0F); u += SAMPLE_STRIDE) {
+        for (int sign = 0; sign < 2; sign++) {
+            const float x = sign ? -bits_float(u) : bits_float(u);
+            const double expected = pow(10.0, (double)x);
+            const double err = fabs((double)exposure_math_exp10(x) - expected) / expected;
+            if (err > max_err) { max_err = err; }
+        }
+    }
+    printf("exp10: max relative error %.3g\n", max_err);
+    CHECK(max_err < 1.2e-6);
+}
+
+static void test_log2()
+{
+    double max_err = 0;
+    for (uint32_t u = float_bits(1e-6F); u <= float_bits(1e7F); u += SAMPLE_STRIDE) {
+        const float x = bits_float(u);
+        const double err = fabs((double)exposure_math_log2(x) - log2((double)x));
+        if (err > max_err) { max_err = err; }
+    }
+    printf("log2:  max absolute error %.3g\n", max_err);
+    CHECK(max_err < 1.2e-6);
+
+    CHECK(exposure_math_log2(1.0F) == 0.0F);
+    CHECK(exposure_math_log2(1024.0F) == 10.0F);
+    CHECK(isinf(exposure_math_log2(0.0F)) && exposure_math_log2(0.0F) < 0);
+    CHECK(isnan(exposure_math_log2(-1.0F)));
+    CHECK(isnan(exposure_math_log2(NAN)));
+}
+
+static void test_log10()
+{
+    double max_err = 0;
+    for (uint32_t u = float_bits(1e-6F); u <= float_bits(1e7F); u += SAMPLE_STRIDE) {
+        const float x = bits_float(u);
+        const double err = fabs((double)exposure_math_log10(x) - log10((double)x));
+        if (err > max_err) { max_err = err; }
+    }
+    printf("log10: max absolute error %.3g\n", max_err);
+    CHECK(max_err < 4e-7);
+
+    /* Near the worst case of the previous implementation */
+    for (float x = 2.80e6F; x < 2.86e6F; x += 7.0F) {
+        CHECK_NEAR(exposure_math_log10(x), log10((double)x), 4e-7);
+    }
+
+    CHECK(exposure_math_log10(1.0F) == 0.0F);
+    CHECK_NEAR(exposure_math_log10(1000.0F), 3.0, 4e-7);
+    CHECK(isinf(exposure_math_log10(0.0F)) && exposure_math_log10(0.0F) < 0);
+    CHECK(isnan(exposure_math_log10(-1.0F)));
+}
+
+#define BENCH_LEN 1024U
+
+static void bench_functions()
+{
+    static float inputs_exp[BENCH_LEN];
+    static float inputs_log[BENCH_LEN];
+    const uint32_t rounds = 2000;
+    const uint32_t iterations = rounds * BENCH_LEN;
+    volatile float sink = 0;
+    float sum;
+    uint64_t start;
+
+    /* Stop adjustments and light readings of the sort the exposure paths see */
+    srand(3);
+    for (uint32_t i = 0; i < BENCH_LEN; i++) {
+        inputs_exp[i] = ((float)(rand() % 12000) / 1000.0F) - 6.0F;
+        inputs_log[i] = exp2f(((float)(rand() % 30000) / 1000.0F) - 10.0F);
+    }
+
+#define BENCH_LOOP(name, expr, inputs) do { \
+        sum = 0; \
+        start = test_time_ns(); \
+        for (uint32_t r = 0; r < rounds; r++) { \
+            for (uint32_t i = 0; i < BENCH_LEN; i++) { \
+                const float x = inputs[i]; \
+                sum += (expr); \
+            } \
+        } \
+        test_bench_report(name, test_time_ns() - start, iterations); \
+        sink += sum; \
+    } while (0)
+
+    BENCH_LOOP("exposure_math_exp2", exposure_math_exp2(x), inputs_exp);
+    BENCH_LOOP("exp2f", exp2f(x), inputs_exp);
+    BENCH_LOOP("exposure_math_exp10", exposure_math_exp10(x), inputs_exp);
+    BENCH_LOOP("powf(10, x)", powf(10.0F, x), inputs_exp);
+    BENCH_LOOP("exposure_math_log2", exposure_math_log2(x), inputs_log);
+    BENCH_LOOP("log2f", log2f(x), inputs_log);
+    BENCH_LOOP("exposure_math_log10", exposure_math_log10(x), inputs_log);
+    BENCH_LOOP("log10f", log10f(x), inputs_log);
+
+#undef BENCH_LOOP
+    (void)sink;
+}
+
+int main(int argc, char *argv[])
+{
+    test_twelfth_stops();
+    test_exp2();
+    test_exp10();
+    test_log2();
+    test_log10();
+
+    if (test_bench_requested(argc, argv)) {
+        printf("Host timings, which do not reflect the relative cost on the target:\n");
+        bench_functions();
+    }
+
+    return test_finish("exposure_math");
+}
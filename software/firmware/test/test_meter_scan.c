@@ -0,0 +1,251 @@
+/*
+ * Host tests for the meter probe scan statistics
+ *
+ * Readings are fed in the way the probe callback does during a scan,
+ * and the summary is checked against the readings. Scans with stray
+ * readings at either end check that those outliers are kept out of
+ * the range used for exposure. With "--bench", the cost of adding
+ * each reading is also timed, since it runs in the sensor callback.
+ */
+
+#include "meter_scan.h"
+
+#include <stdlib.h>
+
+#include "test_util.h"
+
+#define SCAN_READINGS 2000
+
+static uint32_t histogram_total(const meter_scan_t *scan)
+{
+    uint32_t total = 0;
+    for (int i = 0; i < METER_SCAN_HISTOGRAM_BINS; i++) {
+        total += scan->histogram[i];
+    }
+    return total;
+}
+
+static void test_empty()
+{
+    meter_scan_t scan;
+    float lux_min = 1.0F;
+    float lux_max = 1.0F;
+
+    meter_scan_init(&scan);
+    CHECK(scan.count == 0);
+    CHECK(scan.saturated == 0 && scan.invalid == 0);
+    CHECK(isnan(scan.lux_min) && isnan(scan.lux_max));
+    CHECK(histogram_total(&scan) == 0);
+    CHECK(isnan(meter_scan_range_stops(&scan)));
+    CHECK(!meter_scan_trimmed_range(&scan, &lux_min, &lux_max));
+    CHECK(lux_min == 1.0F && lux_max == 1.0F);
+}
+
+static void test_min_max_count()
+{
+    meter_scan_t scan;
+    const float readings[] = { 20.0F, 5.0F, 80.0F, 10.0F, 40.0F, 2.5F, 160.0F, 12.0F };
+    const uint32_t len = sizeof(readings) / sizeof(readings[0]);
+    float lux_min;
+    float lux_max;
+
+    meter_scan_init(&scan);
+    for (uint32_t i = 0; i < len; i++) {
+        CHECK(meter_scan_add(&scan, readings[i]));
+        CHECK(scan.count == i + 1);
+    }
+    CHECK(scan.lux_min == 2.5F);
+    CHECK(scan.lux_max == 160.0F);
+    CHECK(histogram_total(&scan) == len);
+
+    /* The two most extreme readings at each end are dropped */
+    CHECK(meter_scan_trimmed_range(&scan, &lux_min, &lux_max));
+    CHECK(lux_min == 10.0F);
+    CHECK(lux_max == 40.0F);
+    CHECK_NEAR(meter_scan_range_stops(&scan), 2.0F, 0.0001F);
+
+    /* Only the lowest and highest readings are needed */
+    CHECK(meter_scan_trimmed_range(&scan, NULL, &lux_max));
+    CHECK(meter_scan_trimmed_range(&scan, &lux_min, NULL));
+}
+
+static void test_too_few()
+{
+    meter_scan_t scan;
+    float lux_min;
+    float lux_max;
+
+    meter_scan_init(&scan);
+    for (int i = 0; i < METER_SCAN_TRIM_COUNT * 2; i++) {
+        meter_scan_add(&scan, 10.0F * (float)(i + 1));
+        CHECK(!meter_scan_trimmed_range(&scan, &lux_min, &lux_max));
+        CHECK(isnan(meter_scan_range_stops(&scan)));
+    }
+
+    /* One reading left over once both ends are dropped */
+    meter_scan_add(&scan, 25.0F);
+    CHECK(meter_scan_trimmed_range(&scan, &lux_min, &lux_max));
+    CHECK(lux_min == 25.0F && lux_max == 25.0F);
+    CHECK(meter_scan_range_stops(&scan) == 0.0F);
+}
+
+static void test_rejected()
+{
+    meter_scan_t scan;
+    const float invalid[] = { 0.0F, -1.0F, -0.0F, NAN, INFINITY, -INFINITY };
+
+    meter_scan_init(&scan);
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        CHECK(!meter_scan_add(&scan, invalid[i]));
+    }
+    CHECK(scan.invalid == sizeof(invalid) / sizeof(invalid[0]));
+
+    meter_scan_add_rejected(&scan, true);
+    meter_scan_add_rejected(&scan, true);
+    meter_scan_add_rejected(&scan, false);
+    CHECK(scan.saturated == 2);
+    CHECK(scan.invalid == (sizeof(invalid) / sizeof(invalid[0])) + 1);
+
+    /* Nothing rejected may touch the readings */
+    CHECK(scan.count == 0);
+    CHECK(isnan(scan.lux_min) && isnan(scan.lux_max));
+    CHECK(histogram_total(&scan) == 0);
+    CHECK(isnan(meter_scan_range_stops(&scan)));
+
+    /* Saturated readings mixed into a scan leave its range alone */
+    for (int i = 0; i < 10; i++) {
+        meter_scan_add(&scan, 50.0F);
+        meter_scan_add_rejected(&scan, true);
+    }
+    CHECK(scan.count == 10);
+    CHECK(scan.saturated == 12);
+    CHECK(scan.lux_min == 50.0F && scan.lux_max == 50.0F);
+    CHECK(meter_scan_range_stops(&scan) == 0.0F);
+}
+
+static void test_histogram()
+{
+    meter_scan_t scan;
+
+    meter_scan_init(&scan);
+
+    /* Readings off either end of the histogram land in the end bins */
+    meter_scan_add(&scan, 1e-6F);
+    meter_scan_add(&scan, 1e6F);
+    CHECK(scan.histogram[0] == 1);
+    CHECK(scan.histogram[METER_SCAN_HISTOGRAM_BINS - 1] == 1);
+
+    /* Each bin center falls back into its own bin */
+    for (uint8_t bin = 0; bin < METER_SCAN_HISTOGRAM_BINS; bin++) {
+        const float lux = meter_scan_bin_lux(bin);
+        const uint32_t before = scan.histogram[bin];
+        CHECK(meter_scan_add(&scan, lux));
+        CHECK(scan.histogram[bin] == before + 1);
+    }
+    CHECK(isnan(meter_scan_bin_lux(METER_SCAN_HISTOGRAM_BINS)));
+    CHECK_NEAR(log10f(meter_scan_bin_lux(1)) - log10f(meter_scan_bin_lux(0)), METER_SCAN_HISTOGRAM_STEP, 0.0001F);
+}
+
+static float scan_reading(float lux_low, float lux_high, uint32_t i)
+{
+    /* A sweep across the easel, with a little noise on each reading */
+    const float t = (float)i / (float)(SCAN_READINGS - 1);
+    const float noise = 1.0F + (((float)(rand() % 1000) - 500.0F) / 50000.0F);
+    return lux_low * powf(lux_high / lux_low, t) * noise;
+}
+
+static void test_outliers()
+{
+    meter_scan_t scan;
+    float lux_min;
+    float lux_max;
+
+    /* A clean sweep covers its range, give or take the noise */
+    srand(7);
+    meter_scan_init(&scan);
+    for (uint32_t i = 0; i < SCAN_READINGS; i++) {
+        meter_scan_add(&scan, scan_reading(4.0F, 64.0F, i));
+    }
+    CHECK(meter_scan_trimmed_range(&scan, &lux_min, &lux_max));
+    CHECK_NEAR(lux_min, 4.0F, 0.05F);
+    CHECK_NEAR(lux_max, 64.0F, 0.8F);
+    CHECK_NEAR(meter_scan_range_stops(&scan), 4.0F, 0.03F);
+
+    /* Single spikes in either direction are dropped */
+    srand(7);
+    meter_scan_init(&scan);
+    for (uint32_t i = 0; i < SCAN_READINGS; i++) {
+        meter_scan_add(&scan, scan_reading(4.0F, 64.0F, i));
+        if (i == 500) { meter_scan_add(&scan, 5000.0F); }
+        if (i == 1500) { meter_scan_add(&scan, 0.01F); }
+    }
+    CHECK(scan.lux_min == 0.01F);
+    CHECK(scan.lux_max == 5000.0F);
+    CHECK(meter_scan_trimmed_range(&scan, &lux_min, &lux_max));
+    CHECK_NEAR(lux_min, 4.0F, 0.05F);
+    CHECK_NEAR(lux_max, 64.0F, 0.8F);
+
+    /* So are two stray readings at each end, even if they agree */
+    srand(7);
+    meter_scan_init(&scan);
+    for (uint32_t i = 0; i < SCAN_READINGS; i++) {
+        meter_scan_add(&scan, scan_reading(4.0F, 64.0F, i));
+        if (i == 100 || i == 1900) { meter_scan_add(&scan, 900.0F); }
+        if (i == 300) { meter_scan_add(&scan, 0.2F); }
+        if (i == 1200) { meter_scan_add(&scan, 0.05F); }
+    }
+    CHECK(meter_scan_trimmed_range(&scan, &lux_min, &lux_max));
+    CHECK_NEAR(lux_min, 4.0F, 0.05F);
+    CHECK_NEAR(lux_max, 64.0F, 0.8F);
+
+    /* A third matching reading is treated as part of the scan */
+    meter_scan_add(&scan, 900.0F);
+    CHECK(meter_scan_trimmed_range(&scan, NULL, &lux_max));
+    CHECK(lux_max == 900.0F);
+
+    /* Readings in descending order are kept in the same way */
+    meter_scan_init(&scan);
+    for (uint32_t i = 0; i < 100; i++) {
+        meter_scan_add(&scan, 100.0F - (float)i);
+    }
+    CHECK(meter_scan_trimmed_range(&scan, &lux_min, &lux_max));
+    CHECK(lux_min == 3.0F && lux_max == 98.0F);
+    CHECK(scan.lux_min == 1.0F && scan.lux_max == 100.0F);
+}
+
+static void bench_add()
+{
+    meter_scan_t scan;
+    const uint32_t rounds = 2000;
+    float readings[SCAN_READINGS];
+
+    srand(11);
+    for (uint32_t i = 0; i < SCAN_READINGS; i++) {
+        readings[i] = scan_reading(1.0F, 1000.0F, (uint32_t)rand() % SCAN_READINGS);
+    }
+
+    uint64_t start = test_time_ns();
+    for (uint32_t r = 0; r < rounds; r++) {
+        meter_scan_init(&scan);
+        for (uint32_t i = 0; i < SCAN_READINGS; i++) {
+            meter_scan_add(&scan, readings[i]);
+        }
+    }
+    test_bench_report("meter_scan_add", test_time_ns() - start, rounds * SCAN_READINGS);
+}
+
+int main(int argc, char *argv[])
+{
+    test_empty();
+    test_min_max_count();
+    test_too_few();
+    test_rejected();
+    test_histogram();
+    test_outliers();
+
+    if (test_bench_requested(argc, argv)) {
+        bench_add();
+    }
+
+    return test_finish("meter_scan");
+}
@@ -0,0 +1,307 @@
+/*
+ * Host tests for the paper characteristic curve solver
+ *
+ * The dataset is a grade 2 calibration print made through a 21-step
+ * wedge, with the patch densities as read by the densitometer.
+ * The solver results are checked against an independent double
+ * precision natural spline, and against the expected reference
+ * point PEV values for this print.
+ */
+
+#include "paper_curve.h"
+
+#include <stdlib.h>
+
+#include "test_util.h"
+
+#define WEDGE_STEPS 21
+#define CALIBRATION_PEV 250
+
+/* Step wedge densities, from the least dense step */
+static const float wedge_density[WEDGE_STEPS] = {
+    0.05F, 0.20F, 0.35F, 0.50F, 0.65F, 0.80F, 0.95F, 1.10F, 1.25F, 1.40F, 1.55F,
+    1.70F, 1.85F, 2.00F, 2.15F, 2.30F, 2.45F, 2.60F, 2.75F, 2.90F, 3.05F
+};
+
+/* Measured paper densities under each wedge step, NAN for unreadable patches */
+static const float patch_density[WEDGE_STEPS] = {
+    2.05F, 2.05F, 2.04F, 2.03F, 2.00F, 1.94F, 1.83F, 1.66F, 1.45F, 1.21F, 0.96F,
+    0.72F, 0.51F, 0.34F, 0.22F, 0.14F, 0.10F, NAN, 0.08F, 0.08F, 0.08F
+};
+
+static const float paper_dmin = 0.08F;
+static const float paper_dmax = 2.05F;
+
+/* Expected reference point PEV values for this print */
+static const float expected_ht_pev = 14.05F;
+static const float expected_hm_pev = 77.33F;
+static const float expected_hs_pev = 157.54F;
+
+typedef struct {
+    size_t count;
+    double x[WEDGE_STEPS];
+    double y[WEDGE_STEPS];
+    double m[WEDGE_STEPS];
+} reference_spline_t;
+
+/**
+ * Populate curve points the same way the calibration menu does,
+ * with PEV increasing from the densest wedge step.
+ */
+static size_t load_points(float *x, float *y)
+{
+    size_t p = 0;
+    for (int i = WEDGE_STEPS - 1; i >= 0; --i) {
+        if (!isnan(patch_density[i])) {
+            x[p] = roundf((float)CALIBRATION_PEV - (wedge_density[i] * 100.0F));
+            y[p] = patch_density[i];
+            p++;
+        }
+    }
+    return p;
+}
+
+/**
+ * Solve a natural spline for its second derivatives, using the
+ * textbook tridiagonal formulation in double precision.
+ */
+static void reference_solve(reference_spline_t *ref)
+{
+    const size_t n = ref->count;
+    double diag[WEDGE_STEPS];
+    double rhs[WEDGE_STEPS];
+
+    ref->m[0] = 0.0;
+    ref->m[n - 1] = 0.0;
+
+    for (size_t i = 1; i < n - 1; i++) {
+        const double h0 = ref->x[i] - ref->x[i - 1];
+        const double h1 = ref->x[i + 1] - ref->x[i];
+        diag[i] = 2.0 * (h0 + h1);
+        rhs[i] = 6.0 * (((ref->y[i + 1] - ref->y[i]) / h1) - ((ref->y[i] - ref->y[i - 1]) / h0));
+        if (i > 1) {
+            const double w = h0 / diag[i - 1];
+            diag[i] -= w * h0;
+            rhs[i] -= w * rhs[i - 1];
+        }
+    }
+
+    for (size_t i = n - 2; i >= 1; i--) {
+        const double h1 = ref->x[i + 1] - ref->x[i];
+        ref->m[i] = (rhs[i] - h1 * ref->m[i + 1]) / diag[i];
+    }
+}
+
+static double reference_evaluate(const reference_spline_t *ref, double x)
+{
+    size_t i = 0;
+    while (i < ref->count - 2 && x >= ref->x[i + 1]) {
+        i++;
+    }
+    const double h = ref->x[i + 1] - ref->x[i];
+    const double a = ref->x[i + 1] - x;
+    const double b = x - ref->x[i];
+    return (ref->m[i] * a * a * a + ref->m[i + 1] * b * b * b) / (6.0 * h)
+        + (ref->y[i] / h - ref->m[i] * h / 6.0) * a
+        + (ref->y[i + 1] / h - ref->m[i + 1] * h / 6.0) * b;
+}
+
+/**
+ * Find a crossing by dense evaluation at every whole PEV, which is how
+ * the calibration menu used to do it. Used as the benchmark baseline.
+ */
+static float dense_find_x(const paper_curve_t *curve, float y)
+{
+    const int min_x = lroundf(curve->x[0]);
+    const int max_x = lroundf(curve->x[curve->count - 1]);
+    for (int x = min_x; x <= max_x; x++) {
+        if (paper_curve_evaluate(curve, (float)x) >= y) {
+            return (float)x;
+        }
+    }
+    return (float)max_x;
+}
+
+static void test_arena()
+{
+    float arena[5 * WEDGE_STEPS];
+    paper_curve_t curve;
+
+    CHECK(paper_curve_arena_size(0) == 0);
+    CHECK(paper_curve_arena_size(1) == 0);
+    CHECK(paper_curve_arena_size(2) == sizeof(float) * 8);
+    CHECK(paper_curve_arena_size(WEDGE_STEPS) <= sizeof(arena));
+
+    CHECK(!paper_curve_init(&curve, arena, sizeof(arena), 1));
+    CHECK(!paper_curve_init(&curve, arena, paper_curve_arena_size(WEDGE_STEPS) - 1, WEDGE_STEPS));
+    CHECK(!paper_curve_init(&curve, NULL, sizeof(arena), WEDGE_STEPS));
+    CHECK(paper_curve_init(&curve, arena, paper_curve_arena_size(WEDGE_STEPS), WEDGE_STEPS));
+
+    /* Every array must stay within the arena */
+    CHECK(curve.d + (WEDGE_STEPS - 1) == arena + (paper_curve_arena_size(WEDGE_STEPS) / sizeof(float)));
+}
+
+static void test_rejects_unordered()
+{
+    float arena[5 * 4];
+    paper_curve_t curve;
+
+    CHECK(paper_curve_init(&curve, arena, sizeof(arena), 4));
+    const float x[4] = { 0.0F, 10.0F, 10.0F, 20.0F };
+    const float y[4] = { 0.1F, 0.5F, 0.9F, 1.5F };
+    memcpy(curve.x, x, sizeof(x));
+    memcpy(curve.y, y, sizeof(y));
+    CHECK(!paper_curve_solve(&curve));
+}
+
+static void test_two_points()
+{
+    float arena[5 * 2];
+    paper_curve_t curve;
+
+    /* Two points give a straight line, which must also extrapolate */
+    CHECK(paper_curve_init(&curve, arena, sizeof(arena), 2));
+    curve.x[0] = 100.0F; curve.y[0] = 0.5F;
+    curve.x[1] = 200.0F; curve.y[1] = 1.5F;
+    CHECK(paper_curve_solve(&curve));
+    CHECK_NEAR(paper_curve_evaluate(&curve, 150.0F), 1.0F, 1e-6);
+    CHECK_NEAR(paper_curve_evaluate(&curve, 50.0F), 0.0F, 1e-6);
+    CHECK_NEAR(paper_curve_evaluate(&curve, 250.0F), 2.0F, 1e-6);
+
+    bool exact = false;
+    CHECK_NEAR(paper_curve_find_x(&curve, 1.25F, &exact), 175.0F, 0.01F);
+    CHECK(exact);
+}
+
+static void test_step_wedge()
+{
+    float arena[5 * WEDGE_STEPS];
+    float x[WEDGE_STEPS];
+    float y[WEDGE_STEPS];
+    paper_curve_t curve;
+    reference_spline_t ref;
+
+    const size_t count = load_points(x, y);
+    CHECK(count == WEDGE_STEPS - 1);
+
+    CHECK(paper_curve_init(&curve, arena, sizeof(arena), count));
+    memcpy(curve.x, x, sizeof(float) * count);
+    memcpy(curve.y, y, sizeof(float) * count);
+    CHECK(paper_curve_solve(&curve));
+
+    ref.count = count;
+    for (size_t i = 0; i < count; i++) {
+        ref.x[i] = x[i];
+        ref.y[i] = y[i];
+    }
+    reference_solve(&ref);
+
+    /* The solve must not disturb the input points */
+    CHECK(memcmp(curve.x, x, sizeof(float) * count) == 0);
+    CHECK(memcmp(curve.y, y, sizeof(float) * count) == 0);
+
+    /* Natural spline end conditions, and agreement on second derivatives */
+    CHECK(curve.c[0] == 0.0F);
+    CHECK(curve.c[count - 1] == 0.0F);
+    for (size_t i = 0; i < count; i++) {
+        CHECK_NEAR(curve.c[i] * 2.0F, ref.m[i], 1e-6);
+    }
+
+    /* The curve must interpolate the points and match the reference in between */
+    for (size_t i = 0; i < count; i++) {
+        CHECK_NEAR(paper_curve_evaluate(&curve, x[i]), y[i], 1e-5);
+    }
+    for (float pev = x[0]; pev <= x[count - 1]; pev += 0.5F) {
+        CHECK_NEAR(paper_curve_evaluate(&curve, pev), reference_evaluate(&ref, pev), 1e-4);
+    }
+
+    /* Solve for the reference points the same way calibration does */
+    const float ht_d = paper_dmin + 0.04F;
+    const float hm_d = paper_dmin + 0.60F;
+    const float hs_d = paper_dmin + ((paper_dmax - paper_dmin) * 0.90F);
+    bool ht_exact = false;
+    bool hm_exact = false;
+    bool hs_exact = false;
+    const float ht_x = paper_curve_find_x(&curve, ht_d, &ht_exact);
+    const float hm_x = paper_curve_find_x(&curve, hm_d, &hm_exact);
+    const float hs_x = paper_curve_find_x(&curve, hs_d, &hs_exact);
+
+    CHECK(ht_exact && hm_exact && hs_exact);
+    CHECK(ht_x < hm_x && hm_x < hs_x);
+
+    /* Each crossing must land on the target density of the reference curve */
+    CHECK_NEAR(reference_evaluate(&ref, ht_x), ht_d, 1e-3);
+    CHECK_NEAR(reference_evaluate(&ref, hm_x), hm_d, 1e-3);
+    CHECK_NEAR(reference_evaluate(&ref, hs_x), hs_d, 1e-3);
+
+    CHECK_NEAR(ht_x, expected_ht_pev, 0.1F);
+    CHECK_NEAR(hm_x, expected_hm_pev, 0.1F);
+    CHECK_NEAR(hs_x, expected_hs_pev, 0.1F);
+
+    /* The old whole-PEV search must agree to within its resolution */
+    CHECK_NEAR(dense_find_x(&curve, ht_d), ht_x, 1.0F);
+    CHECK_NEAR(dense_find_x(&curve, hm_d), hm_x, 1.0F);
+    CHECK_NEAR(dense_find_x(&curve, hs_d), hs_x, 1.0F);
+
+    /* Values the curve never reaches fall back to the closest point */
+    bool exact = true;
+    CHECK(paper_curve_find_x(&curve, 2.50F, &exact) == x[count - 2]);
+    CHECK(!exact);
+    CHECK(paper_curve_find_x(&curve, 0.01F, &exact) == x[0]);
+    CHECK(!exact);
+}
+
+static void bench_step_wedge()
+{
+    static float arena[5 * WEDGE_STEPS];
+    float x[WEDGE_STEPS];
+    float y[WEDGE_STEPS];
+    paper_curve_t curve;
+    const uint32_t iterations = 200000;
+    volatile float sink = 0;
+
+    const size_t count = load_points(x, y);
+    const float ht_d = paper_dmin + 0.04F;
+    const float hm_d = paper_dmin + 0.60F;
+    const float hs_d = paper_dmin + ((paper_dmax - paper_dmin) * 0.90F);
+
+    uint64_t start = test_time_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        paper_curve_init(&curve, arena, sizeof(arena), count);
+        memcpy(curve.x, x, sizeof(float) * count);
+        memcpy(curve.y, y, sizeof(float) * count);
+        paper_curve_solve(&curve);
+    }
+    test_bench_report("paper_curve_solve", test_time_ns() - start, iterations);
+
+    start = test_time_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        sink += paper_curve_find_x(&curve, ht_d, NULL);
+        sink += paper_curve_find_x(&curve, hm_d, NULL);
+        sink += paper_curve_find_x(&curve, hs_d, NULL);
+    }
+    test_bench_report("paper_curve_find_x (3 points)", test_time_ns() - start, iterations);
+
+    start = test_time_ns();
+    for (uint32_t i = 0; i < iterations / 10; i++) {
+        sink += dense_find_x(&curve, ht_d);
+        sink += dense_find_x(&curve, hm_d);
+        sink += dense_find_x(&curve, hs_d);
+    }
+    test_bench_report("dense evaluation (3 points)", test_time_ns() - start, iterations / 10);
+    (void)sink;
+}
+
+int main(int argc, char *argv[])
+{
+    test_arena();
+    test_rejects_unordered();
+    test_two_points();
+    test_step_wedge();
+
+    if (test_bench_requested(argc, argv)) {
+        bench_step_wedge();
+    }
+
+    return test_finish("paper_curve");
+}
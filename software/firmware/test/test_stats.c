@@ -0,0 +1,164 @@
+/*
+ * Host tests for the summary statistics module
+ *
+ * On the host, the public functions use the portable reference
+ * implementation, which is checked here against double precision
+ * calculations. The CMSIS-DSP implementation can only be compared
+ * on the target, using the "Stats Benchmark" diagnostics item.
+ */
+
+#include "stats.h"
+
+#include <stdlib.h>
+
+#include "test_util.h"
+
+#define READING_COUNT 96
+
+static void reference_summary(double *mean, double *stddev, const double *values, size_t len)
+{
+    double sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum += values[i];
+    }
+    *mean = sum / (double)len;
+
+    double dist_sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        dist_sum += (values[i] - *mean) * (values[i] - *mean);
+    }
+    *stddev = sqrt(dist_sum / (double)len);
+}
+
+static void test_empty()
+{
+    stats_summary_t summary = { 1.0F, 1.0F, 1.0F, 1.0F };
+    const float values_f32[1] = { 1.0F };
+    const uint32_t values_u32[1] = { 1 };
+
+    CHECK(isnan(stats_mean_f32(values_f32, 0)));
+    CHECK(isnan(stats_mean_u32(values_u32, 0)));
+    CHECK(isnan(stats_mean_f32(NULL, 1)));
+
+    stats_summary_f32(&summary, values_f32, 0);
+    CHECK(isnan(summary.mean) && isnan(summary.min) && isnan(summary.max) && isnan(summary.stddev));
+
+    summary.mean = 1.0F;
+    stats_summary_u32(&summary, NULL, 1);
+    CHECK(isnan(summary.mean) && isnan(summary.min) && isnan(summary.max) && isnan(summary.stddev));
+}
+
+static void test_single()
+{
+    stats_summary_t summary;
+    const uint32_t value = 1234;
+
+    stats_summary_u32(&summary, &value, 1);
+    CHECK(summary.mean == 1234.0F);
+    CHECK(summary.min == 1234.0F);
+    CHECK(summary.max == 1234.0F);
+    CHECK(summary.stddev == 0.0F);
+}
+
+static void test_readings_u32()
+{
+    uint32_t values[READING_COUNT];
+    double values_d[READING_COUNT];
+    stats_summary_t summary;
+    double mean;
+    double stddev;
+
+    /* Light sensor counts with a little noise, spanning several conversion chunks */
+    srand(1);
+    for (size_t i = 0; i < READING_COUNT; i++) {
+        values[i] = 52000U + (uint32_t)(rand() % 600);
+        values_d[i] = values[i];
+    }
+    values[17] = 51000U;
+    values_d[17] = 51000.0;
+    values[80] = 53500U;
+    values_d[80] = 53500.0;
+
+    reference_summary(&mean, &stddev, values_d, READING_COUNT);
+    stats_summary_u32(&summary, values, READING_COUNT);
+
+    CHECK_NEAR(summary.mean, mean, mean * 1e-6);
+    CHECK_NEAR(summary.stddev, stddev, stddev * 1e-3);
+    CHECK(summary.min == 51000.0F);
+    CHECK(summary.max == 53500.0F);
+    CHECK_NEAR(stats_mean_u32(values, READING_COUNT), mean, mean * 1e-6);
+
+    /* Odd lengths exercise the partial final chunk */
+    reference_summary(&mean, &stddev, values_d, 37);
+    stats_summary_u32(&summary, values, 37);
+    CHECK_NEAR(summary.mean, mean, mean * 1e-6);
+    CHECK_NEAR(summary.stddev, stddev, stddev * 1e-3);
+}
+
+static void test_readings_f32()
+{
+    float values[READING_COUNT];
+    double values_d[READING_COUNT];
+    stats_summary_t summary;
+    double mean;
+    double stddev;
+
+    /* Density readings around a single patch value */
+    srand(2);
+    for (size_t i = 0; i < READING_COUNT; i++) {
+        values[i] = 1.20F + ((float)(rand() % 200) - 100.0F) / 10000.0F;
+        values_d[i] = values[i];
+    }
+
+    reference_summary(&mean, &stddev, values_d, READING_COUNT);
+    stats_summary_f32(&summary, values, READING_COUNT);
+
+    CHECK_NEAR(summary.mean, mean, 1e-6);
+    CHECK_NEAR(summary.stddev, stddev, 1e-5);
+    CHECK_NEAR(stats_mean_f32(values, READING_COUNT), mean, 1e-6);
+    CHECK(summary.min >= 1.19F && summary.min <= summary.mean);
+    CHECK(summary.max <= 1.21F && summary.max >= summary.mean);
+}
+
+static void bench_summary()
+{
+    static float values_f32[READING_COUNT];
+    static uint32_t values_u32[READING_COUNT];
+    stats_summary_t summary;
+    const uint32_t iterations = 200000;
+    volatile float sink = 0;
+
+    for (uint32_t i = 0; i < READING_COUNT; i++) {
+        values_u32[i] = 40000U + ((i * 7919U) % 997U);
+        values_f32[i] = (float)values_u32[i] / 100.0F;
+    }
+
+    uint64_t start = test_time_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        stats_summary_f32(&summary, values_f32, READING_COUNT);
+        sink += summary.stddev;
+    }
+    test_bench_report("stats_summary_f32 (96 values)", test_time_ns() - start, iterations);
+
+    start = test_time_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        stats_summary_u32(&summary, values_u32, READING_COUNT);
+        sink += summary.stddev;
+    }
+    test_bench_report("stats_summary_u32 (96 values)", test_time_ns() - start, iterations);
+    (void)sink;
+}
+
+int main(int argc, char *argv[])
+{
+    test_empty();
+    test_single();
+    test_readings_u32();
+    test_readings_f32();
+
+    if (test_bench_requested(argc, argv)) {
+        bench_summary();
+    }
+
+    return test_finish("stats");
+}
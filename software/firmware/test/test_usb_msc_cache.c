@@ -0,0 +1,343 @@
+/*
+ * Host tests for the USB mass storage sector cache
+ *
+ * The cache is run against a RAM-backed fake block device, which counts
+ * every transfer it is asked to perform. A randomized sequence of reads
+ * and writes is checked against a reference copy of the device contents,
+ * and a set of access patterns typical of FatFS is replayed both with
+ * and without the cache, to report how many device transactions the
+ * cache saves. With "--bench", the host cost of the cache is also timed.
+ */
+
+#include "usb_msc_cache.h"
+
+#include <stdlib.h>
+
+#include "test_util.h"
+
+#define SECTOR_SIZE USB_MSC_CACHE_SECTOR_SIZE
+#define DISK_SECTORS 2048U
+
+/* Layout loosely modeled on a small FAT volume */
+#define FAT_START 32U
+#define FAT_SECTORS 16U
+#define DIR_START 64U
+#define DATA_START 128U
+#define CLUSTER_SECTORS 8U
+
+typedef struct {
+    uint8_t data[DISK_SECTORS * SECTOR_SIZE];
+    uint32_t read_transfers;
+    uint32_t write_transfers;
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+    int fail;
+} fake_disk_t;
+
+typedef struct {
+    fake_disk_t *disk;
+    usb_msc_cache_t *cache;
+} target_t;
+
+static fake_disk_t disk;
+static uint8_t reference[DISK_SECTORS * SECTOR_SIZE];
+static uint8_t cache_buf[USB_MSC_CACHE_BUF_SIZE];
+
+static int fake_disk_read(void *ctx, uint32_t sector, uint8_t *buf, uint32_t count)
+{
+    fake_disk_t *d = ctx;
+    CHECK(count > 0 && sector + count <= DISK_SECTORS);
+    if (d->fail) { return -5; }
+    d->read_transfers++;
+    d->sectors_read += count;
+    memcpy(buf, d->data + (sector * SECTOR_SIZE), count * SECTOR_SIZE);
+    return 0;
+}
+
+static int fake_disk_write(void *ctx, uint32_t sector, const uint8_t *buf, uint32_t count)
+{
+    fake_disk_t *d = ctx;
+    CHECK(count > 0 && sector + count <= DISK_SECTORS);
+    if (d->fail) { return -5; }
+    d->write_transfers++;
+    d->sectors_written += count;
+    memcpy(d->data + (sector * SECTOR_SIZE), buf, count * SECTOR_SIZE);
+    return 0;
+}
+
+static void fake_disk_reset(fake_disk_t *d)
+{
+    for (uint32_t i = 0; i < sizeof(d->data); i++) {
+        d->data[i] = (uint8_t)((i * 31U) ^ (i >> 9));
+    }
+    d->read_transfers = 0;
+    d->write_transfers = 0;
+    d->sectors_read = 0;
+    d->sectors_written = 0;
+    d->fail = 0;
+}
+
+static int target_read(target_t *t, uint32_t sector, uint8_t *buf, uint32_t count)
+{
+    if (t->cache) {
+        return usb_msc_cache_read(t->cache, sector, buf, count);
+    } else {
+        return fake_disk_read(t->disk, sector, buf, count);
+    }
+}
+
+static int target_write(target_t *t, uint32_t sector, const uint8_t *buf, uint32_t count)
+{
+    if (t->cache) {
+        return usb_msc_cache_write(t->cache, sector, buf, count);
+    } else {
+        return fake_disk_write(t->disk, sector, buf, count);
+    }
+}
+
+static void target_flush(target_t *t)
+{
+    if (t->cache) {
+        CHECK(usb_msc_cache_flush(t->cache) == 0);
+    }
+}
+
+static void fill_sector(uint8_t *buf, uint32_t sector, uint32_t seed)
+{
+    for (uint32_t i = 0; i < SECTOR_SIZE; i++) {
+        buf[i] = (uint8_t)(sector + seed + (i * 7U));
+    }
+}
+
+/**
+ * Reading a file cluster by cluster, one sector at a time, with a FAT
+ * lookup at each cluster boundary.
+ */
+static void workload_file_read(target_t *t)
+{
+    uint8_t buf[SECTOR_SIZE];
+    for (uint32_t i = 0; i < 512; i++) {
+        if (i % CLUSTER_SECTORS == 0) {
+            CHECK(target_read(t, FAT_START + (i / 128), buf, 1) == 0);
+        }
+        CHECK(target_read(t, DATA_START + i, buf, 1) == 0);
+    }
+}
+
+/**
+ * Writing a file one sector at a time, updating the FAT and the
+ * directory entry at each cluster boundary.
+ */
+static void workload_file_write(target_t *t)
+{
+    uint8_t buf[SECTOR_SIZE];
+    for (uint32_t i = 0; i < 512; i++) {
+        fill_sector(buf, i, 1);
+        CHECK(target_write(t, DATA_START + 1024 + i, buf, 1) == 0);
+        if (i % CLUSTER_SECTORS == CLUSTER_SECTORS - 1) {
+            CHECK(target_write(t, FAT_START + (i / 128), buf, 1) == 0);
+            CHECK(target_write(t, DIR_START, buf, 1) == 0);
+        }
+    }
+    target_flush(t);
+}
+
+/**
+ * Listing a directory that spans several clusters.
+ */
+static void workload_dir_scan(target_t *t)
+{
+    uint8_t buf[SECTOR_SIZE];
+    for (uint32_t i = 0; i < 64; i++) {
+        CHECK(target_read(t, DIR_START + i, buf, 1) == 0);
+    }
+}
+
+/**
+ * Scattered single sector reads, such as following a fragmented
+ * cluster chain, which the cache should not make any worse.
+ */
+static void workload_scattered(target_t *t)
+{
+    uint8_t buf[SECTOR_SIZE];
+    srand(7);
+    for (uint32_t i = 0; i < 256; i++) {
+        const uint32_t sector = FAT_START + (uint32_t)(rand() % (FAT_SECTORS * 4U)) * 2U;
+        CHECK(target_read(t, sector, buf, 1) == 0);
+    }
+}
+
+/**
+ * Large multi-sector transfers, which bypass the cache.
+ */
+static void workload_bulk(target_t *t)
+{
+    static uint8_t buf[32 * SECTOR_SIZE];
+    for (uint32_t i = 0; i < 16; i++) {
+        CHECK(target_read(t, DATA_START + (i * 32U), buf, 32) == 0);
+    }
+    for (uint32_t i = 0; i < 16; i++) {
+        CHECK(target_write(t, DATA_START + (i * 32U), buf, 32) == 0);
+    }
+    target_flush(t);
+}
+
+static void run_workload(const char *name, void (*workload)(target_t *t), uint32_t min_saving_pct)
+{
+    usb_msc_cache_t cache;
+    target_t target = { &disk, NULL };
+    uint32_t direct;
+    uint32_t cached;
+    uint32_t direct_sectors;
+
+    fake_disk_reset(&disk);
+    workload(&target);
+    direct = disk.read_transfers + disk.write_transfers;
+    direct_sectors = disk.sectors_read + disk.sectors_written;
+    memcpy(reference, disk.data, sizeof(reference));
+
+    fake_disk_reset(&disk);
+    usb_msc_cache_init(&cache, cache_buf, DISK_SECTORS, fake_disk_read, fake_disk_write, &disk);
+    target.cache = &cache;
+    workload(&target);
+    cached = disk.read_transfers + disk.write_transfers;
+
+    /* Whatever the cache did, the device must end up with the same contents */
+    CHECK(memcmp(reference, disk.data, sizeof(reference)) == 0);
+    CHECK(cache.stats.read_transfers == disk.read_transfers);
+    CHECK(cache.stats.write_transfers == disk.write_transfers);
+
+    const uint32_t saving_pct = (direct > cached) ? ((direct - cached) * 100U) / direct : 0;
+    printf("%-12s %4u -> %4u transactions (%3u%% saved), %4u -> %4u sectors\n",
+        name, direct, cached, saving_pct,
+        direct_sectors, disk.sectors_read + disk.sectors_written);
+
+    CHECK(cached <= direct);
+    CHECK(saving_pct >= min_saving_pct);
+}
+
+static void test_workloads()
+{
+    run_workload("file read", workload_file_read, 60);
+    run_workload("file write", workload_file_write, 50);
+    run_workload("dir scan", workload_dir_scan, 80);
+    run_workload("scattered", workload_scattered, 0);
+    run_workload("bulk", workload_bulk, 0);
+}
+
+static void test_random_consistency()
+{
+    usb_msc_cache_t cache;
+    static uint8_t buf[12 * SECTOR_SIZE];
+
+    fake_disk_reset(&disk);
+    memcpy(reference, disk.data, sizeof(reference));
+    usb_msc_cache_init(&cache, cache_buf, DISK_SECTORS, fake_disk_read, fake_disk_write, &disk);
+
+    /*
+     * Keep the accesses within a small range, so that reads and writes
+     * frequently overlap the read-ahead and write buffers, and include
+     * the end of the device to exercise the read-ahead clamp.
+     */
+    srand(11);
+    for (uint32_t i = 0; i < 50000; i++) {
+        const uint32_t count = 1U + (uint32_t)(rand() % 12);
+        uint32_t sector = (uint32_t)(rand() % 48);
+        if (rand() % 8 == 0) {
+            sector = DISK_SECTORS - count - (uint32_t)(rand() % 4);
+        }
+        const int op = rand() % 16;
+
+        if (op < 9) {
+            CHECK(usb_msc_cache_read(&cache, sector, buf, count) == 0);
+            if (memcmp(buf, reference + (sector * SECTOR_SIZE), count * SECTOR_SIZE) != 0) {
+                fprintf(stderr, "read mismatch at op %u, sector %u, count %u\n", i, sector, count);
+                test_failures++;
+                break;
+            }
+        } else if (op < 15) {
+            for (uint32_t j = 0; j < count; j++) {
+                fill_sector(buf + (j * SECTOR_SIZE), sector + j, i);
+            }
+            CHECK(usb_msc_cache_write(&cache, sector, buf, count) == 0);
+            memcpy(reference + (sector * SECTOR_SIZE), buf, count * SECTOR_SIZE);
+        } else {
+            CHECK(usb_msc_cache_flush(&cache) == 0);
+            CHECK(memcmp(reference, disk.data, sizeof(reference)) == 0);
+        }
+    }
+
+    CHECK(usb_msc_cache_flush(&cache) == 0);
+    CHECK(memcmp(reference, disk.data, sizeof(reference)) == 0);
+}
+
+static void test_errors()
+{
+    usb_msc_cache_t cache;
+    uint8_t buf[SECTOR_SIZE];
+
+    fake_disk_reset(&disk);
+    usb_msc_cache_init(&cache, cache_buf, DISK_SECTORS, fake_disk_read, fake_disk_write, &disk);
+
+    /* Sectors already read ahead are still served while the device fails */
+    CHECK(usb_msc_cache_read(&cache, 100, buf, 1) == 0);
+    CHECK(usb_msc_cache_read(&cache, 101, buf, 1) == 0);
+    disk.fail = 1;
+    CHECK(usb_msc_cache_read(&cache, 102, buf, 1) == 0);
+
+    /* A failed read must not leave stale data to be served later */
+    CHECK(usb_msc_cache_read(&cache, 300, buf, 1) == -5);
+    CHECK(usb_msc_cache_read(&cache, 301, buf, 1) == -5);
+
+    /* Buffered writes report the device error when they are written out */
+    disk.fail = 0;
+    fill_sector(buf, 400, 3);
+    CHECK(usb_msc_cache_write(&cache, 400, buf, 1) == 0);
+    disk.fail = 1;
+    CHECK(usb_msc_cache_flush(&cache) == -5);
+    CHECK(usb_msc_cache_flush(&cache) == 0);
+
+    /* Invalidation drops buffered writes without touching the device */
+    disk.fail = 0;
+    CHECK(usb_msc_cache_write(&cache, 500, buf, 1) == 0);
+    usb_msc_cache_invalidate(&cache);
+    const uint32_t writes = disk.write_transfers;
+    CHECK(usb_msc_cache_flush(&cache) == 0);
+    CHECK(disk.write_transfers == writes);
+}
+
+static void bench_cache()
+{
+    usb_msc_cache_t cache;
+    target_t target = { &disk, &cache };
+    const uint32_t rounds = 2000;
+    uint64_t start;
+
+    fake_disk_reset(&disk);
+    usb_msc_cache_init(&cache, cache_buf, DISK_SECTORS, fake_disk_read, fake_disk_write, &disk);
+
+    start = test_time_ns();
+    for (uint32_t i = 0; i < rounds; i++) {
+        workload_file_read(&target);
+    }
+    test_bench_report("file read (576 requests)", test_time_ns() - start, rounds);
+
+    start = test_time_ns();
+    for (uint32_t i = 0; i < rounds; i++) {
+        workload_file_write(&target);
+    }
+    test_bench_report("file write (640 requests)", test_time_ns() - start, rounds);
+}
+
+int main(int argc, char *argv[])
+{
+    test_workloads();
+    test_random_consistency();
+    test_errors();
+
+    if (test_bench_requested(argc, argv)) {
+        bench_cache();
+    }
+
+    return test_finish("usb_msc_cache");
+}
@@ -0,0 +1,297 @@
+/*
+ * Host tests for the USB serial receive buffer
+ *
+ * Device output is fed into the buffer in the kinds of pieces that
+ * arrive over USB: lines split across transfers at every possible
+ * point, several lines packed into one transfer, and bursts that are
+ * larger than the free space in the buffer. The lines that come back
+ * out are checked against the original text, along with the count of
+ * dropped bytes. With "--bench", the throughput of the buffer is also
+ * timed.
+ */
+
+#include "usb_serial_buf.h"
+
+#include <stdlib.h>
+
+#include "test_util.h"
+
+#define MAX_LINES 256
+#define MAX_LINE_LEN (USB_SERIAL_BUF_SIZE + 1)
+
+typedef struct {
+    char lines[MAX_LINES][MAX_LINE_LEN];
+    size_t count;
+} line_list_t;
+
+static usb_serial_buf_t buf;
+
+static size_t write_str(usb_serial_buf_t *b, const char *str)
+{
+    return usb_serial_buf_write(b, (const uint8_t *)str, strlen(str));
+}
+
+/**
+ * Collect every complete line currently in the buffer.
+ */
+static void drain_lines(usb_serial_buf_t *b, line_list_t *list)
+{
+    usb_serial_slice_t line;
+    while (usb_serial_buf_next_line(b, &line)) {
+        if (list->count < MAX_LINES) {
+            usb_serial_slice_copy(&line, list->lines[list->count], MAX_LINE_LEN);
+            list->count++;
+        }
+        usb_serial_buf_consume(b, &line);
+    }
+}
+
+static void test_single_line()
+{
+    static line_list_t list;
+    usb_serial_slice_t line;
+
+    usb_serial_buf_init(&buf);
+    list.count = 0;
+
+    /* A line is not returned until its line break arrives */
+    CHECK(write_str(&buf, "D=1.23") == 6);
+    CHECK(!usb_serial_buf_next_line(&buf, &line));
+    CHECK(usb_serial_buf_count(&buf) == 6);
+
+    write_str(&buf, "\r\n");
+    drain_lines(&buf, &list);
+    CHECK(list.count == 1);
+    CHECK(strcmp(list.lines[0], "D=1.23") == 0);
+
+    /* The trailing line feed is left behind, and skipped on the next call */
+    CHECK(!usb_serial_buf_next_line(&buf, &line));
+    CHECK(usb_serial_buf_count(&buf) == 0);
+    CHECK(buf.dropped == 0);
+}
+
+static void test_split_chunks()
+{
+    static line_list_t list;
+    const char *text = "R  1.23D\r\nT  0.05D\r\n";
+    const size_t text_len = strlen(text);
+
+    /* Split the text into two transfers at every possible point */
+    for (size_t split = 0; split <= text_len; split++) {
+        usb_serial_buf_init(&buf);
+        list.count = 0;
+
+        usb_serial_buf_write(&buf, (const uint8_t *)text, split);
+        drain_lines(&buf, &list);
+        usb_serial_buf_write(&buf, (const uint8_t *)text + split, text_len - split);
+        drain_lines(&buf, &list);
+
+        CHECK(list.count == 2);
+        CHECK(strcmp(list.lines[0], "R  1.23D") == 0);
+        CHECK(strcmp(list.lines[1], "T  0.05D") == 0);
+    }
+
+    /* One byte per transfer */
+    usb_serial_buf_init(&buf);
+    list.count = 0;
+    for (size_t i = 0; i < text_len; i++) {
+        usb_serial_buf_write(&buf, (const uint8_t *)text + i, 1);
+        drain_lines(&buf, &list);
+    }
+    CHECK(list.count == 2);
+    CHECK(strcmp(list.lines[1], "T  0.05D") == 0);
+}
+
+static void test_burst()
+{
+    static line_list_t list;
+
+    usb_serial_buf_init(&buf);
+    list.count = 0;
+
+    /* Several lines in one transfer, with mixed and repeated line breaks */
+    write_str(&buf, "\r\nfirst\r\n\r\nsecond\nthird\r\r\nfour");
+    drain_lines(&buf, &list);
+    CHECK(list.count == 3);
+    CHECK(strcmp(list.lines[0], "first") == 0);
+    CHECK(strcmp(list.lines[1], "second") == 0);
+    CHECK(strcmp(list.lines[2], "third") == 0);
+
+    write_str(&buf, "th\n");
+    drain_lines(&buf, &list);
+    CHECK(list.count == 4);
+    CHECK(strcmp(list.lines[3], "fourth") == 0);
+}
+
+static void test_wrap()
+{
+    static line_list_t list;
+    usb_serial_slice_t line;
+    char expected[64];
+
+    usb_serial_buf_init(&buf);
+
+    /* Move the buffer position to just short of the wrap point */
+    for (size_t i = 0; i < USB_SERIAL_BUF_SIZE - 5; i++) {
+        usb_serial_buf_write(&buf, (const uint8_t *)"x", 1);
+    }
+    write_str(&buf, "\n");
+    list.count = 0;
+    drain_lines(&buf, &list);
+    CHECK(list.count == 1);
+    CHECK(strlen(list.lines[0]) == USB_SERIAL_BUF_SIZE - 5);
+
+    /* This line straddles the end of the buffer */
+    strcpy(expected, "WRAPPED LINE");
+    write_str(&buf, "WRAPPED LINE\r\n");
+    CHECK(usb_serial_buf_next_line(&buf, &line));
+    CHECK(line.len[0] > 0 && line.len[1] > 0);
+    CHECK(line.len[0] + line.len[1] == strlen(expected));
+
+    char out[64];
+    CHECK(usb_serial_slice_copy(&line, out, sizeof(out)) == strlen(expected));
+    CHECK(strcmp(out, expected) == 0);
+
+    /* Copies are truncated to fit the destination */
+    char small[6];
+    CHECK(usb_serial_slice_copy(&line, small, sizeof(small)) == 5);
+    CHECK(strcmp(small, "WRAPP") == 0);
+
+    usb_serial_buf_consume(&buf, &line);
+    CHECK(!usb_serial_buf_next_line(&buf, &line));
+}
+
+static void test_overflow()
+{
+    static line_list_t list;
+    static uint8_t data[USB_SERIAL_BUF_SIZE + 100];
+
+    /* A burst with no line break fills the buffer, which then counts as a line */
+    usb_serial_buf_init(&buf);
+    list.count = 0;
+    memset(data, 'A', sizeof(data));
+    CHECK(usb_serial_buf_write(&buf, data, sizeof(data)) == USB_SERIAL_BUF_SIZE);
+    CHECK(buf.dropped == 100);
+    drain_lines(&buf, &list);
+    CHECK(list.count == 1);
+    CHECK(strlen(list.lines[0]) == USB_SERIAL_BUF_SIZE);
+    CHECK(usb_serial_buf_count(&buf) == 0);
+
+    /* Lines already received survive a burst that overflows behind them */
+    usb_serial_buf_init(&buf);
+    list.count = 0;
+    write_str(&buf, "kept 1\r\nkept 2\r\n");
+    const size_t space = USB_SERIAL_BUF_SIZE - usb_serial_buf_count(&buf);
+    CHECK(usb_serial_buf_write(&buf, data, space + 10) == space);
+    CHECK(buf.dropped == 10);
+    CHECK(usb_serial_buf_write(&buf, (const uint8_t *)"\r\n", 2) == 0);
+    CHECK(buf.dropped == 12);
+
+    drain_lines(&buf, &list);
+    CHECK(list.count == 2);
+    CHECK(strcmp(list.lines[0], "kept 1") == 0);
+    CHECK(strcmp(list.lines[1], "kept 2") == 0);
+
+    /* The rest of the burst waits for a line break, as the buffer is no longer full */
+    CHECK(usb_serial_buf_count(&buf) == space);
+    write_str(&buf, "\r\nafter\r\n");
+    drain_lines(&buf, &list);
+    CHECK(list.count == 4);
+    CHECK(strlen(list.lines[2]) == space);
+    CHECK(strcmp(list.lines[3], "after") == 0);
+    CHECK(buf.dropped == 12);
+}
+
+static void test_random_chunks()
+{
+    static char stream[8192];
+    static char expected[MAX_LINES][MAX_LINE_LEN];
+    static line_list_t list;
+    size_t expected_count = 0;
+    size_t stream_len = 0;
+
+    /* Lines like those from a densitometer, joined with assorted line breaks */
+    srand(5);
+    while (expected_count < 200) {
+        const char *breaks[] = { "\r\n", "\n", "\r", "\r\n\r\n" };
+        sprintf(expected[expected_count], "%c%c %d.%02dD %u",
+            "RTV"[rand() % 3], "BGRV"[rand() % 4], rand() % 5, rand() % 100, (unsigned)expected_count);
+        stream_len += sprintf(stream + stream_len, "%s%s", expected[expected_count], breaks[rand() % 4]);
+        expected_count++;
+    }
+
+    /* Feed the stream in transfers of random size, draining after each one */
+    for (int pass = 0; pass < 20; pass++) {
+        usb_serial_buf_init(&buf);
+        list.count = 0;
+
+        size_t offset = 0;
+        while (offset < stream_len) {
+            size_t chunk = 1 + (size_t)(rand() % 64);
+            if (chunk > stream_len - offset) {
+                chunk = stream_len - offset;
+            }
+            CHECK(usb_serial_buf_write(&buf, (const uint8_t *)stream + offset, chunk) == chunk);
+            offset += chunk;
+            drain_lines(&buf, &list);
+        }
+
+        CHECK(buf.dropped == 0);
+        CHECK(list.count == expected_count);
+        for (size_t i = 0; i < list.count && i < expected_count; i++) {
+            if (strcmp(list.lines[i], expected[i]) != 0) {
+                fprintf(stderr, "pass %d, line %zu: \"%s\" != \"%s\"\n", pass, i, list.lines[i], expected[i]);
+                test_failures++;
+                break;
+            }
+        }
+    }
+}
+
+static void bench_buffer()
+{
+    static char stream[4096];
+    char line_buf[64];
+    size_t stream_len = 0;
+    const uint32_t rounds = 5000;
+    uint32_t lines = 0;
+
+    while (stream_len < sizeof(stream) - 32) {
+        stream_len += sprintf(stream + stream_len, "R  %d.%02dD\r\n", (int)(stream_len % 4), (int)(stream_len % 100));
+    }
+
+    uint64_t start = test_time_ns();
+    for (uint32_t r = 0; r < rounds; r++) {
+        usb_serial_buf_init(&buf);
+        for (size_t offset = 0; offset < stream_len; offset += 64) {
+            const size_t chunk = (stream_len - offset < 64) ? stream_len - offset : 64;
+            usb_serial_buf_write(&buf, (const uint8_t *)stream + offset, chunk);
+
+            usb_serial_slice_t line;
+            while (usb_serial_buf_next_line(&buf, &line)) {
+                usb_serial_slice_copy(&line, line_buf, sizeof(line_buf));
+                usb_serial_buf_consume(&buf, &line);
+                lines++;
+            }
+        }
+    }
+    const uint64_t elapsed = test_time_ns() - start;
+    test_bench_report("per line (64 byte transfers)", elapsed, lines);
+    test_bench_report("per byte", elapsed, (uint32_t)(stream_len * rounds));
+}
+
+int main(int argc, char *argv[])
+{
+    test_single_line();
+    test_split_chunks();
+    test_burst();
+    test_wrap();
+    test_overflow();
+    test_random_chunks();
+
+    if (test_bench_requested(argc, argv)) {
+        bench_buffer();
+    }
+
+    return test_finish("usb_serial_buf");
+}
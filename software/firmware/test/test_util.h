@@ -0,0 +1,78 @@
+/*
+ * Minimal helpers for the host-side unit tests
+ *
+ * Each test program is a plain executable that returns non-zero if any
+ * check has failed. When run with "--bench" as its first argument, a test
+ * program also runs its timing loops and prints the results.
+ */
+
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+static int test_failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        test_failures++; \
+    } \
+} while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) do { \
+    const double check_a = (double)(actual); \
+    const double check_e = (double)(expected); \
+    if (!(fabs(check_a - check_e) <= (double)(tolerance))) { \
+        fprintf(stderr, "%s:%d: check failed: %s = %g, expected %g +/- %g\n", \
+            __FILE__, __LINE__, #actual, check_a, check_e, (double)(tolerance)); \
+        test_failures++; \
+    } \
+} while (0)
+
+/**
+ * Check whether the benchmark loops were requested on the command line.
+ */
+static inline bool test_bench_requested(int argc, char *argv[])
+{
+    return argc > 1 && strcmp(argv[1], "--bench") == 0;
+}
+
+/**
+ * Get a monotonic timestamp in nanoseconds.
+ */
+static inline uint64_t test_time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Print the result of a timing loop.
+ */
+static inline void test_bench_report(const char *name, uint64_t elapsed_ns, uint32_t iterations)
+{
+    printf("%-36s %10.1f ns/iter (%u iterations)\n",
+        name, (double)elapsed_ns / (double)iterations, iterations);
+}
+
+/**
+ * Print a summary line and get the program exit code.
+ */
+static inline int test_finish(const char *name)
+{
+    if (test_failures > 0) {
+        printf("%s: %d check(s) failed\n", name, test_failures);
+        return 1;
+    }
+    printf("%s: all checks passed\n", name);
+    return 0;
+}
+
+#endif /* TEST_UTIL_H */
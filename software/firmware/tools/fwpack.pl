@@ -0,0 +1,283 @@
+#!/usr/bin/perl
+
+##
+## This script compresses an STM32 firmware image into the packed
+## format that the bootloader can decompress while it is programming
+## the flash. The output consists of an app_pack_header_t, followed by
+## the image compressed using the LZ4 block format.
+##
+## Match offsets are limited to the window size supported by the
+## bootloader's decompressor, so this output cannot be assumed to be
+## compatible with other LZ4 decoders (or vice versa).
+##
+
+use 5.006;
+use strict;
+use warnings;
+
+use constant PACK_MAGIC_WORD => 0x4B504450;
+use constant PACK_VERSION => 1;
+use constant WINDOW_BITS => 12;
+use constant WINDOW_SIZE => (1 << WINDOW_BITS);
+use constant MIN_MATCH => 4;
+use constant MAX_CHAIN => 16;
+use constant DESCRIPTOR_SIZE => 256;
+
+#
+# Calculate the CRC-32 checksum on a block of data, using the same algorithm
+# used by the hardware CRC module inside the STM32F4 microcontroller.
+#
+# Based on the C implementation posted here:
+# https://community.st.com/s/question/0D50X0000AIeYIb/stm32f4-crc32-algorithm-headache
+#
+sub stm_crc32_fast {
+    my ($crc, $data) = @_;
+    my @crc_table = (0x00000000, 0x04C11DB7, 0x09823B6E, 0x0D4326D9,
+                     0x130476DC, 0x17C56B6B, 0x1A864DB2, 0x1E475005,
+                     0x2608EDB8, 0x22C9F00F, 0x2F8AD6D6, 0x2B4BCB61,
+                     0x350C9B64, 0x31CD86D3, 0x3C8EA00A, 0x384FBDBD);
+
+    $crc = ($crc ^ $data) & 0xFFFFFFFF;
+    $crc = (($crc << 4) & 0xFFFFFFFF) ^ $crc_table[($crc >> 28) & 0xFF];
+    $crc = (($crc << 4) & 0xFFFFFFFF) ^ $crc_table[($crc >> 28) & 0xFF];
+    $crc = (($crc << 4) & 0xFFFFFFFF) ^ $crc_table[($crc >> 28) & 0xFF];
+    $crc = (($crc << 4) & 0xFFFFFFFF) ^ $crc_table[($crc >> 28) & 0xFF];
+    $crc = (($crc << 4) & 0xFFFFFFFF) ^ $crc_table[($crc >> 28) & 0xFF];
+    $crc = (($crc << 4) & 0xFFFFFFFF) ^ $crc_table[($crc >> 28) & 0xFF];
+    $crc = (($crc << 4) & 0xFFFFFFFF) ^ $crc_table[($crc >> 28) & 0xFF];
+    $crc = (($crc << 4) & 0xFFFFFFFF) ^ $crc_table[($crc >> 28) & 0xFF];
+
+    return $crc;
+}
+
+#
+# Iterate across an entire binary string and compute the CRC-32 checksum.
+#
+sub stm_crc32_fast_block {
+    my ($crc, $input) = @_;
+
+    foreach my $x (unpack ('V*', $input)) {
+        $crc = stm_crc32_fast($crc, $x);
+    }
+
+    return $crc;
+}
+
+#
+# Find the length of the common prefix of the data at two positions,
+# comparing in progressively larger blocks to keep long runs fast.
+#
+sub match_length {
+    my ($data, $ref, $pos, $max) = @_;
+    my $len = 0;
+    my $step = 64;
+
+    while ($len < $max) {
+        my $size = ($max - $len < $step) ? $max - $len : $step;
+        my $diff = substr($$data, $ref + $len, $size) ^ substr($$data, $pos + $len, $size);
+        if ($diff =~ /[^\0]/g) {
+            return $len + pos($diff) - 1;
+        }
+        $len += $size;
+        $step *= 2;
+    }
+
+    return $max;
+}
+
+#
+# Encode an LZ4 length extension.
+#
+sub encode_length {
+    my ($len) = @_;
+    my $out = '';
+
+    while ($len >= 255) {
+        $out .= "\xFF";
+        $len -= 255;
+    }
+    $out .= chr($len);
+
+    return $out;
+}
+
+#
+# Compress a block of data into a series of LZ4 sequences.
+#
+sub lz4_compress {
+    my ($data) = @_;
+    my $size = length($data);
+    my %chains;
+    my $out = '';
+    my $lit_start = 0;
+    my $pos = 0;
+
+    while ($pos + MIN_MATCH <= $size) {
+        my $key = substr($data, $pos, MIN_MATCH);
+        my $chain = $chains{$key};
+        my $best_len = 0;
+        my $best_offset = 0;
+
+        if ($chain) {
+            foreach my $ref (reverse @$chain) {
+                my $offset = $pos - $ref;
+                last if $offset > WINDOW_SIZE;
+                my $len = match_length(\$data, $ref, $pos, $size - $pos);
+                if ($len > $best_len) {
+                    $best_len = $len;
+                    $best_offset = $offset;
+                }
+            }
+        }
+
+        if ($best_len < MIN_MATCH) {
+            push @{$chains{$key}}, $pos;
+            shift @{$chains{$key}} if @{$chains{$key}} > MAX_CHAIN;
+            $pos++;
+            next;
+        }
+
+        # Emit the sequence
+        my $lit_len = $pos - $lit_start;
+        my $match_code = $best_len - MIN_MATCH;
+        my $token = (($lit_len < 15) ? $lit_len : 15) << 4;
+        $token |= ($match_code < 15) ? $match_code : 15;
+        $out .= chr($token);
+        $out .= encode_length($lit_len - 15) if $lit_len >= 15;
+        $out .= substr($data, $lit_start, $lit_len);
+        $out .= pack('v', $best_offset);
+        $out .= encode_length($match_code - 15) if $match_code >= 15;
+
+        # Index the matched positions, skipping the middle of long runs
+        for (my $i = $pos; $i < $pos + $best_len && $i + MIN_MATCH <= $size; $i++) {
+            next if $i > $pos + 32 && $i < $pos + $best_len - 32;
+            my $k = substr($data, $i, MIN_MATCH);
+            push @{$chains{$k}}, $i;
+            shift @{$chains{$k}} if @{$chains{$k}} > MAX_CHAIN;
+        }
+
+        $pos += $best_len;
+        $lit_start = $pos;
+    }
+
+    # Emit the final literals, if any
+    my $lit_len = $size - $lit_start;
+    if ($lit_len > 0) {
+        $out .= chr((($lit_len < 15) ? $lit_len : 15) << 4);
+        $out .= encode_length($lit_len - 15) if $lit_len >= 15;
+        $out .= substr($data, $lit_start, $lit_len);
+    }
+
+    return $out;
+}
+
+#
+# Decompress a series of LZ4 sequences, following the same rules
+# as the decompressor in the bootloader.
+#
+sub lz4_decompress {
+    my ($data, $size) = @_;
+    my $out = '';
+    my $pos = 0;
+
+    while (length($out) < $size) {
+        die "Truncated input\n" if $pos >= length($data);
+        my $token = ord(substr($data, $pos++, 1));
+
+        my $lit_len = $token >> 4;
+        if ($lit_len == 15) {
+            my $b;
+            do {
+                $b = ord(substr($data, $pos++, 1));
+                $lit_len += $b;
+            } while ($b == 255);
+        }
+        $out .= substr($data, $pos, $lit_len);
+        $pos += $lit_len;
+        last if length($out) >= $size;
+
+        my $offset = unpack('v', substr($data, $pos, 2));
+        $pos += 2;
+        die "Invalid offset: $offset\n" if $offset == 0 || $offset > WINDOW_SIZE || $offset > length($out);
+
+        my $match_len = ($token & 0x0F) + MIN_MATCH;
+        if (($token & 0x0F) == 15) {
+            my $b;
+            do {
+                $b = ord(substr($data, $pos++, 1));
+                $match_len += $b;
+            } while ($b == 255);
+        }
+
+        my $start = length($out) - $offset;
+        for (my $i = 0; $i < $match_len; $i++) {
+            $out .= substr($out, $start + $i, 1);
+        }
+    }
+
+    die "Trailing input\n" if $pos != length($data);
+    return $out;
+}
+
+# Collect the command line arguments
+my ($infile, $outfile) = @ARGV;
+die "Usage: $0 INFILE OUTFILE\n" if not $outfile;
+
+# Open the input file as binary
+open my $in, '<', $infile or die;
+binmode $in;
+
+# Read the input file
+my $cont = '';
+while (1) {
+    my $success = read $in, $cont, 1024, length($cont);
+    die $! if not defined $success;
+    last if not $success;
+}
+close $in;
+
+if (length($cont) < DESCRIPTOR_SIZE || (length($cont) % 4) != 0) {
+    die "Invalid image size";
+}
+
+# The app descriptor is at the end of the image
+my $descriptor = substr($cont, length($cont) - DESCRIPTOR_SIZE, DESCRIPTOR_SIZE);
+
+# Check that the descriptor starts with the magic bytes
+if (substr($descriptor, 0, 4) ne "\x54\x76\xCD\xAB") {
+    die "Invalid descriptor magic"
+}
+
+# Check that the image checksum has already been embedded
+my $image_crc = stm_crc32_fast_block(0xFFFFFFFF, substr($cont, 0, length($cont) - 4));
+if (pack('V', $image_crc) ne substr($descriptor, DESCRIPTOR_SIZE - 4, 4)) {
+    die "Image checksum does not match descriptor";
+}
+
+# Compress the image, and make sure it decompresses correctly
+my $packed = lz4_compress($cont);
+if (lz4_decompress($packed, length($cont)) ne $cont) {
+    die "Packed image does not match the input";
+}
+
+my $packed_size = length($packed);
+$packed .= "\0" x ((4 - ($packed_size % 4)) % 4);
+
+# Assemble the header
+my $header = pack('VCCvVVVV3',
+    PACK_MAGIC_WORD, PACK_VERSION, WINDOW_BITS, 0,
+    length($cont), $packed_size,
+    stm_crc32_fast_block(0xFFFFFFFF, $packed),
+    0, 0, 0);
+$header .= $descriptor;
+
+# Write the output file
+open my $out, '>', $outfile or die;
+binmode $out;
+print $out $header;
+print $out $packed;
+close $out;
+
+printf("Packed %d bytes into %d bytes (%.1f%%)\n",
+    length($cont), length($header) + length($packed),
+    100.0 * (length($header) + length($packed)) / length($cont));
@@ -0,0 +1,79 @@
+#!/usr/bin/perl
+
+##
+## This script converts a binary exposure session log, as written to a USB
+## storage device by the printer, into CSV format.
+##
+
+use 5.010;
+use strict;
+use warnings;
+
+my @type_names = (
+    'NONE', 'SESSION_START', 'EXPOSURE', 'BURN_DODGE',
+    'TEST_STRIP', 'METER_READING');
+
+my @result_names = ('OK', 'CANCELED', 'ERROR');
+
+my @grade_names = (
+    '00', '0', '0.5', '1', '1.5', '2', '2.5', '3', '3.5', '4', '4.5', '5');
+
+my $infile = $ARGV[0];
+die "Usage: $0 LOGFILE\n" if not $infile;
+
+# Read the input file
+open my $in, '<', $infile or die "Unable to open $infile: $!\n";
+binmode $in;
+my $cont = '';
+while (1) {
+    my $success = read $in, $cont, 1024, length($cont);
+    die $! if not defined $success;
+    last if not $success;
+}
+close $in;
+
+# Parse the file header
+die "File too short\n" if length($cont) < 8;
+my ($magic, $version, $record_size) = unpack('a4 v v', $cont);
+die "Invalid session log file magic\n" if $magic ne 'PSLG';
+die "Unsupported session log version: $version\n" if $version != 1;
+die "Unsupported record size: $record_size\n" if $record_size != 24;
+my $offset = 8;
+
+sub name_or_value {
+    my ($list, $value) = @_;
+    return $value < scalar(@{$list}) ? $list->[$value] : $value;
+}
+
+print "session,time_ms,type,result,index,time_s,lux,grade,red,green,blue,adjustment\n";
+
+my $session = 0;
+while ($offset + $record_size <= length($cont)) {
+    my ($ticks, $type, $result, $grade, $index, $value_raw,
+        $red, $green, $blue, $adj_num, $adj_den) =
+        unpack('V C C C C a4 v v v c C', substr($cont, $offset, $record_size));
+    $offset += $record_size;
+
+    my $type_name = name_or_value(\@type_names, $type);
+    $session++ if $type_name eq 'SESSION_START';
+
+    my $time_s = '';
+    my $lux = '';
+    if ($type_name eq 'METER_READING') {
+        $lux = sprintf('%.4f', unpack('f<', $value_raw));
+    } elsif ($type_name ne 'SESSION_START') {
+        $time_s = sprintf('%.2f', unpack('V', $value_raw) / 1000.0);
+    }
+
+    my $grade_str = ($grade < scalar(@grade_names)) ? $grade_names[$grade] : '';
+    my $is_color = ($type_name =~ /^(EXPOSURE|BURN_DODGE|TEST_STRIP)$/) && $grade_str eq '';
+    my $adjustment = ($type_name eq 'BURN_DODGE' && $adj_den > 0)
+        ? sprintf('%+d/%d', $adj_num, $adj_den) : '';
+
+    printf("%d,%d,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s\n",
+        $session, $ticks, $type_name, name_or_value(\@result_names, $result),
+        ($type_name =~ /^(EXPOSURE|BURN_DODGE|TEST_STRIP)$/) ? $index + 1 : '',
+        $time_s, $lux, $grade_str,
+        $is_color ? $red : '', $is_color ? $green : '', $is_color ? $blue : '',
+        $adjustment);
+}
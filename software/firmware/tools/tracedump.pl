@@ -0,0 +1,189 @@
+#!/usr/bin/perl
+
+##
+## This script decodes a binary event trace dump, as written to a USB
+## storage device from the diagnostics menu, and prints it as a timeline.
+##
+## By default a text timeline is printed. With the "--json" option, the
+## output is instead in the Chrome trace event format, which can be viewed
+## in a browser via "chrome://tracing" or "https://ui.perfetto.dev".
+##
+
+use 5.006;
+use strict;
+use warnings;
+
+use Getopt::Long;
+
+my @event_names = (
+    'NONE', 'TASK_SWITCH', 'QUEUE_SEND', 'QUEUE_SEND_ISR',
+    'QUEUE_RECV', 'QUEUE_RECV_ISR', 'DMX_TIMER', 'DMX_TX_CPLT',
+    'EXPOSURE_TICK', 'GPIO_INT', 'KEYPAD', 'MARK', 'EXPOSURE_CANCEL');
+
+my @timer_states = ('NONE', 'START', 'TICK', 'END', 'DONE');
+my @dmx_states = ('IDLE', 'MARK_BEFORE_BREAK', 'BREAK', 'MARK_AFTER_BREAK', 'DATA');
+
+my %key_names = (
+    105 => 'START', 106 => 'FOCUS', 107 => 'INC_EXPOSURE', 108 => 'DEC_EXPOSURE',
+    109 => 'INC_CONTRAST', 110 => 'DEC_CONTRAST', 111 => 'TEST_STRIP',
+    112 => 'ADD_ADJUSTMENT', 113 => 'CANCEL', 114 => 'MENU', 97 => 'ENCODER',
+    98 => 'BLACKOUT', 99 => 'FOOTSWITCH', 200 => 'ENCODER_CCW',
+    201 => 'ENCODER_CW', 210 => 'METER_PROBE', 211 => 'DENSISTICK');
+
+# Collect the command line arguments
+my $json_output = 0;
+GetOptions('json' => \$json_output);
+
+my $infile = $ARGV[0];
+die "Usage: $0 [--json] TRACEFILE\n" if not $infile;
+
+# Read the input file
+open my $in, '<', $infile or die "Unable to open $infile: $!\n";
+binmode $in;
+my $cont = '';
+while (1) {
+    my $success = read $in, $cont, 1024, length($cont);
+    die $! if not defined $success;
+    last if not $success;
+}
+close $in;
+
+# Parse the file header
+die "File too short\n" if length($cont) < 24;
+my ($magic, $version, $record_size, $timestamp_hz, $record_count,
+    $dropped_count, $task_count, $queue_count) = unpack('a4 v v V V V v v', $cont);
+die "Invalid trace file magic\n" if $magic ne 'PTRC';
+die "Unsupported trace file version: $version\n" if $version != 1;
+die "Unsupported record size: $record_size\n" if $record_size != 8;
+my $offset = 24;
+
+# Parse the task and queue name tables
+my %task_names;
+my %queue_names;
+for (my $i = 0; $i < $task_count; $i++) {
+    my ($number, $name) = unpack('v Z24', substr($cont, $offset, 26));
+    $task_names{$number} = $name;
+    $offset += 26;
+}
+for (my $i = 0; $i < $queue_count; $i++) {
+    my ($number, $name) = unpack('v Z24', substr($cont, $offset, 26));
+    $queue_names{$number} = length($name) > 0 ? $name : "queue$number";
+    $offset += 26;
+}
+
+# Parse the records, unwrapping the 32-bit timestamps
+my @records;
+my $last_raw;
+my $wrap_base = 0;
+for (my $i = 0; $i < $record_count; $i++) {
+    last if $offset + $record_size > length($cont);
+    my ($raw, $event, $arg8, $arg16) = unpack('V C C v', substr($cont, $offset, $record_size));
+    $offset += $record_size;
+
+    if (defined $last_raw && $raw < $last_raw) {
+        $wrap_base += 4294967296;
+    }
+    $last_raw = $raw;
+
+    push @records, {
+        time => ($wrap_base + $raw) * 1000000.0 / $timestamp_hz,
+        event => $event,
+        arg8 => $arg8,
+        arg16 => $arg16
+    };
+}
+
+sub task_name {
+    my ($number) = @_;
+    return exists $task_names{$number} ? $task_names{$number} : "task$number";
+}
+
+sub queue_name {
+    my ($number) = @_;
+    return exists $queue_names{$number} ? $queue_names{$number} : "queue$number";
+}
+
+sub event_name {
+    my ($event) = @_;
+    return $event < scalar(@event_names) ? $event_names[$event] : "EVENT$event";
+}
+
+sub describe_event {
+    my ($rec) = @_;
+    my $event = $rec->{event};
+    my $name = event_name($event);
+
+    if ($name eq 'TASK_SWITCH') {
+        return task_name($rec->{arg16});
+    } elsif ($name =~ /^QUEUE_/) {
+        return sprintf('%s (waiting=%d)', queue_name($rec->{arg16}), $rec->{arg8});
+    } elsif ($name eq 'DMX_TIMER' || $name eq 'DMX_TX_CPLT') {
+        return $rec->{arg8} < scalar(@dmx_states) ? $dmx_states[$rec->{arg8}] : $rec->{arg8};
+    } elsif ($name eq 'EXPOSURE_TICK') {
+        my $state = $rec->{arg8} < scalar(@timer_states) ? $timer_states[$rec->{arg8}] : $rec->{arg8};
+        return sprintf('%s elapsed=%dms', $state, $rec->{arg16} * 10);
+    } elsif ($name eq 'EXPOSURE_CANCEL') {
+        return sprintf('key-to-off latency=%dms', $rec->{arg16});
+    } elsif ($name eq 'GPIO_INT') {
+        return sprintf('pin=0x%04X', $rec->{arg16});
+    } elsif ($name eq 'KEYPAD') {
+        my $key = exists $key_names{$rec->{arg8}} ? $key_names{$rec->{arg8}} : $rec->{arg8};
+        my $action = ($rec->{arg16} & 0x02) ? 'repeat' : (($rec->{arg16} & 0x01) ? 'pressed' : 'released');
+        return "$key $action";
+    } else {
+        return sprintf('arg8=%d arg16=%d', $rec->{arg8}, $rec->{arg16});
+    }
+}
+
+if (!@records) {
+    print STDERR "No trace records\n";
+    exit 0;
+}
+
+my $start_time = $records[0]->{time};
+
+if ($json_output) {
+    my @entries;
+    my $current_task;
+    my $current_start;
+    foreach my $rec (@records) {
+        my $ts = $rec->{time} - $start_time;
+        my $name = event_name($rec->{event});
+        if ($name eq 'TASK_SWITCH') {
+            if (defined $current_task) {
+                push @entries, sprintf('{"name":"%s","ph":"X","pid":1,"tid":"%s","ts":%.3f,"dur":%.3f}',
+                    task_name($current_task), task_name($current_task), $current_start, $ts - $current_start);
+            }
+            $current_task = $rec->{arg16};
+            $current_start = $ts;
+        } else {
+            my $tid = ($name =~ /ISR$/ || $name =~ /^(DMX_|EXPOSURE_|GPIO_)/)
+                ? 'ISR' : (defined $current_task ? task_name($current_task) : 'unknown');
+            my $args = describe_event($rec);
+            $args =~ s/"/\\"/g;
+            push @entries, sprintf('{"name":"%s","ph":"i","s":"t","pid":1,"tid":"%s","ts":%.3f,"args":{"detail":"%s"}}',
+                $name, $tid, $ts, $args);
+        }
+    }
+    print "{\"traceEvents\":[\n";
+    print join(",\n", @entries);
+    print "\n]}\n";
+} else {
+    printf("Records: %d, dropped: %d, resolution: %.3fus\n",
+        scalar(@records), $dropped_count, 1000000.0 / $timestamp_hz);
+    printf("%12s %10s  %-16s %-15s %s\n", 'TIME(us)', 'DELTA(us)', 'TASK', 'EVENT', 'DETAIL');
+
+    my $current_task;
+    my $last_time = $start_time;
+    foreach my $rec (@records) {
+        my $name = event_name($rec->{event});
+        if ($name eq 'TASK_SWITCH') {
+            $current_task = $rec->{arg16};
+        }
+        printf("%12.2f %10.2f  %-16s %-15s %s\n",
+            $rec->{time} - $start_time, $rec->{time} - $last_time,
+            defined $current_task ? task_name($current_task) : '-',
+            $name, describe_event($rec));
+        $last_time = $rec->{time};
+    }
+}